@@ -5,36 +5,38 @@ static const uint64_t EDGE_BLOCK_BITS = 6;
 static const uint64_t EDGE_BLOCK_SIZE = 1 << EDGE_BLOCK_BITS;
 static const uint64_t EDGE_BLOCK_MASK = EDGE_BLOCK_SIZE - 1;
 
-// fills buffer with EDGE_BLOCK_SIZE siphash outputs for block containing edge in cuckaroo graph
-// return siphash output for given edge
-static uint64_t sip_block(siphash_keys &keys, uint64_t edge, uint64_t *buf) {
-  siphash_state shs(keys);
-  uint64_t edge0 = edge & ~EDGE_BLOCK_MASK;
-  for (size_t i = 0; i < EDGE_BLOCK_SIZE; i++) {
-    shs.hash24(edge0 + i);
-    buf[i] = shs.xor_lanes();
-  }
+// siphash output for given edge from the EDGE_BLOCK_SIZE siphash outputs of
+// the block containing it in cuckaroo graph
+static uint64_t sip_block_edge(const uint64_t *buf, uint64_t edge) {
   uint64_t last = buf[EDGE_BLOCK_MASK];
-  for (size_t i = 0; i < EDGE_BLOCK_MASK; i++)
-    buf[i] ^= last;
-  return buf[edge & EDGE_BLOCK_MASK];
+  if ((edge & EDGE_BLOCK_MASK) == EDGE_BLOCK_MASK)
+    return last;
+  return buf[edge & EDGE_BLOCK_MASK] ^ last;
 }
 
 // verify that edges are ascending and form a cycle in header-generated graph
 bool verify_cuckaroo(const std::vector<uint64_t> &edges, siphash_keys &keys, uint32_t edge_bits) {
   uint64_t xor0 = 0, xor1 = 0;
-  uint64_t sips[EDGE_BLOCK_SIZE];
   size_t proof_size = edges.size();
   std::vector<uint64_t> uvs(2 * proof_size);
   uint64_t edge_size = static_cast<uint64_t>(1) << edge_bits;
   uint64_t edge_mask = edge_size - 1;
 
+  std::vector<uint64_t> starts(proof_size);
   for (size_t n = 0; n < proof_size; n++) {
     if (edges[n] > edge_mask)
       return false;
     if (n && edges[n] <= edges[n-1])
       return false;
-    uint64_t edge = sip_block(keys, edges[n], sips);
+    starts[n] = edges[n] & ~EDGE_BLOCK_MASK;
+  }
+
+  // the blocks of all edges at once
+  std::vector<uint64_t> sips(proof_size * EDGE_BLOCK_SIZE);
+  siphash24_blocks(keys, starts.data(), proof_size, EDGE_BLOCK_SIZE, sips.data());
+
+  for (size_t n = 0; n < proof_size; n++) {
+    uint64_t edge = sip_block_edge(&sips[n * EDGE_BLOCK_SIZE], edges[n]);
     xor0 ^= uvs[2*n  ] = edge & edge_mask;
     xor1 ^= uvs[2*n+1] = (edge >> 32) & edge_mask;
   }
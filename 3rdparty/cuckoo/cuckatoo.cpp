@@ -1,11 +1,6 @@
 #include "cuckatoo.h"
 #include "siphash.h"
 
-// generate edge endpoint in cuck(at)oo graph without partition bit
-static uint64_t sip_node(siphash_keys &keys, uint64_t edge, uint64_t uorv, uint64_t edge_mask) {
-  return keys.siphash24(2 * edge + uorv) & edge_mask;
-}
-
 // verify that edges are ascending and form a cycle in header-generated graph
 bool verify_cuckatoo(const std::vector<uint64_t> &edges, siphash_keys &keys, uint32_t edge_bits) {
   uint64_t xor0, xor1;
@@ -15,13 +10,22 @@ bool verify_cuckatoo(const std::vector<uint64_t> &edges, siphash_keys &keys, uin
   uint64_t edge_size = static_cast<uint64_t>(1) << edge_bits;
   uint64_t edge_mask = edge_size - 1;
 
+  // edge endpoints in cuck(at)oo graph without partition bit,
+  // u = siphash24(2 * edge), v = siphash24(2 * edge + 1)
+  std::vector<uint64_t> nonces(2 * proof_size);
   for (size_t n = 0; n < proof_size; n++) {
     if (edges[n] > edge_mask)
       return false;
     if (n && edges[n] <= edges[n-1])
       return false;
-    xor0 ^= uvs[2*n  ] = sip_node(keys, edges[n], 0, edge_mask);
-    xor1 ^= uvs[2*n+1] = sip_node(keys, edges[n], 1, edge_mask);
+    nonces[2*n  ] = 2 * edges[n];
+    nonces[2*n+1] = 2 * edges[n] + 1;
+  }
+  siphash24_batch(keys, nonces.data(), uvs.data(), 2 * proof_size);
+
+  for (size_t n = 0; n < proof_size; n++) {
+    xor0 ^= uvs[2*n  ] &= edge_mask;
+    xor1 ^= uvs[2*n+1] &= edge_mask;
   }
   if (xor0|xor1)              // optional check for obviously bad proofs
     return false;
@@ -12,4 +12,123 @@ uint64_t siphash_keys::siphash24(const uint64_t nonce) const {
   siphash_state v(*this);
   v.hash24(nonce);
   return v.xor_lanes();
-}
\ No newline at end of file
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SIPHASH_AVX2 __attribute__((target("avx2")))
+
+// 4 siphash states, one per 64-bit lane
+struct siphash_state_x4 {
+  __m256i v0, v1, v2, v3;
+
+  SIPHASH_AVX2 explicit siphash_state_x4(const siphash_keys &sk) {
+    v0 = _mm256_set1_epi64x(sk.k0);
+    v1 = _mm256_set1_epi64x(sk.k1);
+    v2 = _mm256_set1_epi64x(sk.k2);
+    v3 = _mm256_set1_epi64x(sk.k3);
+  }
+  SIPHASH_AVX2 static inline __m256i rotl(__m256i x, int b) {
+    return _mm256_or_si256(_mm256_slli_epi64(x, b), _mm256_srli_epi64(x, 64 - b));
+  }
+  SIPHASH_AVX2 static inline __m256i rotl16(__m256i x) {
+    const __m256i mask = _mm256_setr_epi8(
+      6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11, 12, 13,
+      6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11, 12, 13);
+    return _mm256_shuffle_epi8(x, mask);
+  }
+  SIPHASH_AVX2 static inline __m256i rotl32(__m256i x) {
+    return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+  }
+  SIPHASH_AVX2 inline __m256i xor_lanes() const {
+    return _mm256_xor_si256(_mm256_xor_si256(v0, v1), _mm256_xor_si256(v2, v3));
+  }
+  SIPHASH_AVX2 inline void sip_round() {
+    v0 = _mm256_add_epi64(v0, v1); v2 = _mm256_add_epi64(v2, v3); v1 = rotl(v1, 13);
+    v3 = rotl16(v3); v1 = _mm256_xor_si256(v1, v0); v3 = _mm256_xor_si256(v3, v2);
+    v0 = rotl32(v0); v2 = _mm256_add_epi64(v2, v1); v0 = _mm256_add_epi64(v0, v3);
+    v1 = rotl(v1, 17); v3 = rotl(v3, 21);
+    v1 = _mm256_xor_si256(v1, v2); v3 = _mm256_xor_si256(v3, v0); v2 = rotl32(v2);
+  }
+  SIPHASH_AVX2 inline void hash24(__m256i nonce) {
+    v3 = _mm256_xor_si256(v3, nonce);
+    sip_round(); sip_round();
+    v0 = _mm256_xor_si256(v0, nonce);
+    v2 = _mm256_xor_si256(v2, _mm256_set1_epi64x(0xff));
+    sip_round(); sip_round(); sip_round(); sip_round();
+  }
+};
+
+SIPHASH_AVX2 static size_t siphash24_batch_avx2(
+    const siphash_keys &keys, const uint64_t *nonces, uint64_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    siphash_state_x4 v(keys);
+    v.hash24(_mm256_loadu_si256((const __m256i *)(nonces + i)));
+    _mm256_storeu_si256((__m256i *)(out + i), v.xor_lanes());
+  }
+  return i;
+}
+
+SIPHASH_AVX2 static size_t siphash24_blocks_avx2(
+    const siphash_keys &keys, const uint64_t *starts, size_t n,
+    size_t block_size, uint64_t *out) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    siphash_state_x4 v(keys);
+    __m256i nonce = _mm256_loadu_si256((const __m256i *)(starts + i));
+    const __m256i one = _mm256_set1_epi64x(1);
+    uint64_t *row = out + i * block_size;
+    for (size_t j = 0; j < block_size; j++) {
+      v.hash24(nonce);
+      nonce = _mm256_add_epi64(nonce, one);
+
+      alignas(32) uint64_t lanes[4];
+      _mm256_store_si256((__m256i *)lanes, v.xor_lanes());
+      row[j] = lanes[0];
+      row[block_size + j] = lanes[1];
+      row[2 * block_size + j] = lanes[2];
+      row[3 * block_size + j] = lanes[3];
+    }
+  }
+  return i;
+}
+
+static bool has_avx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#else
+static bool has_avx2() {
+  return false;
+}
+static size_t siphash24_batch_avx2(
+    const siphash_keys &, const uint64_t *, uint64_t *, size_t) {
+  return 0;
+}
+static size_t siphash24_blocks_avx2(
+    const siphash_keys &, const uint64_t *, size_t, size_t, uint64_t *) {
+  return 0;
+}
+#endif
+
+void siphash24_batch(const siphash_keys &keys, const uint64_t *nonces,
+                     uint64_t *out, size_t n) {
+  size_t i = has_avx2() ? siphash24_batch_avx2(keys, nonces, out, n) : 0;
+  for (; i < n; i++)
+    out[i] = keys.siphash24(nonces[i]);
+}
+
+void siphash24_blocks(const siphash_keys &keys, const uint64_t *starts,
+                      size_t n, size_t block_size, uint64_t *out) {
+  size_t i = has_avx2() ?
+    siphash24_blocks_avx2(keys, starts, n, block_size, out) : 0;
+  for (; i < n; i++) {
+    siphash_state shs(keys);
+    for (size_t j = 0; j < block_size; j++) {
+      shs.hash24(starts[i] + j);
+      out[i * block_size + j] = shs.xor_lanes();
+    }
+  }
+}
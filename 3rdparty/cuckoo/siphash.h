@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>    // for size_t
 #include <stdint.h>    // for types uint32_t,uint64_t
 #ifndef __APPLE__
 #include <endian.h>    // for htole32/64
@@ -23,6 +24,19 @@ public:
   uint64_t siphash24(const uint64_t nonce) const;
 };
 
+// Batch edge API, 4 lanes at a time with AVX2 if the CPU has it,
+// bit-exact with the scalar siphash_keys / siphash_state code.
+
+// out[i] = keys.siphash24(nonces[i]) for i < n
+void siphash24_batch(const siphash_keys &keys, const uint64_t *nonces,
+                     uint64_t *out, size_t n);
+
+// Cuckaroo blocks: one siphash_state runs through the nonces
+// starts[i] .. starts[i] + block_size - 1, out[i * block_size + j] is
+// xor_lanes() after hash24(starts[i] + j).
+void siphash24_blocks(const siphash_keys &keys, const uint64_t *starts,
+                      size_t n, size_t block_size, uint64_t *out);
+
 class siphash_state {
 public:
   uint64_t v0;
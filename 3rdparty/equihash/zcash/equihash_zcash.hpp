@@ -12,6 +12,7 @@
 #include <exception>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <vector>
 
@@ -39,6 +40,8 @@ eh_trunc TruncateIndex(const eh_index i, const unsigned int ilen);
 
 std::vector<eh_index> GetIndicesFromMinimal(std::vector<unsigned char> minimal,
                                             size_t cBitLen);
+void GetIndicesFromMinimal(const unsigned char* minimal, size_t minimalLen,
+                           size_t cBitLen, std::vector<eh_index>& indices);
 std::vector<unsigned char> GetMinimalFromIndices(std::vector<eh_index> indices,
                                                  size_t cBitLen);
 
@@ -194,6 +197,8 @@ public:
                         const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
     bool IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+    bool IsValidSolution(const eh_HashState& base_state,
+                         const unsigned char* soln, size_t solnLen);
 };
 
 } // namespace
@@ -284,6 +289,90 @@ inline bool EhOptimisedSolveUncancellable(unsigned int n, unsigned int k, const
         throw std::invalid_argument("Unsupported Equihash parameters"); \
     }
 
+inline bool EhIsValidSolution(unsigned int n, unsigned int k, const eh_HashState& base_state,
+                              const unsigned char* soln, size_t solnLen)
+{
+    if (n == 96 && k == 3) {
+        return Eh96_3.IsValidSolution(base_state, soln, solnLen);
+    } else if (n == 200 && k == 9) {
+        return Eh200_9.IsValidSolution(base_state, soln, solnLen);
+    } else if (n == 96 && k == 5) {
+        return Eh96_5.IsValidSolution(base_state, soln, solnLen);
+    } else if (n == 48 && k == 5) {
+        return Eh48_5.IsValidSolution(base_state, soln, solnLen);
+    } else {
+        throw std::invalid_argument("Unsupported Equihash parameters");
+    }
+}
+
+// Blake2b states of the recently seen block headers.
+//
+// All shares of a job hash the same input I (the header without nonce and
+// solution) after the same personalization, only the nonce differs. The
+// personalized state is built once and the states after I are kept for the
+// last few headers, so a share only hashes its nonce before its solution is
+// checked. Thread-safe.
+class EhHeaderStateCache
+{
+public:
+    enum : size_t { MaxEntries=16 };
+    enum : size_t { MaxInputLen=160 };
+
+    EhHeaderStateCache(unsigned int n, unsigned int k) : clock(0)
+    {
+        EhZecInitialiseState(n, k, personalized);
+        for (size_t i = 0; i < MaxEntries; i++) {
+            entries[i].len = 0;
+            entries[i].lastUsed = 0;
+        }
+    }
+
+    // base_state = the personalized state updated with input[0..len)
+    void GetState(const unsigned char* input, size_t len, eh_HashState& base_state)
+    {
+        if (len > MaxInputLen) {
+            base_state = personalized;
+            crypto_generichash_blake2b_update(&base_state, input, len);
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        Entry* oldest = &entries[0];
+        for (size_t i = 0; i < MaxEntries; i++) {
+            Entry& e = entries[i];
+            if (e.len == len && memcmp(e.input, input, len) == 0) {
+                e.lastUsed = ++clock;
+                base_state = e.state;
+                return;
+            }
+            if (e.lastUsed < oldest->lastUsed) {
+                oldest = &e;
+            }
+        }
+
+        oldest->state = personalized;
+        crypto_generichash_blake2b_update(&oldest->state, input, len);
+        memcpy(oldest->input, input, len);
+        oldest->len = len;
+        oldest->lastUsed = ++clock;
+        base_state = oldest->state;
+    }
+
+private:
+    // States are kept inline, the Blake2b state may be over-aligned.
+    struct Entry {
+        eh_HashState state;
+        unsigned char input[MaxInputLen];
+        size_t len;
+        uint64_t lastUsed;
+    };
+
+    eh_HashState personalized;
+    Entry entries[MaxEntries];
+    uint64_t clock;
+    std::mutex lock;
+};
+
 } // namespace
 
 #pragma GCC diagnostic pop
@@ -179,6 +179,22 @@ std::vector<eh_index> GetIndicesFromMinimal(std::vector<unsigned char> minimal,
     return ret;
 }
 
+void GetIndicesFromMinimal(const unsigned char* minimal, size_t minimalLen,
+                           size_t cBitLen, std::vector<eh_index>& indices)
+{
+    assert(((cBitLen+1)+7)/8 <= sizeof(eh_index));
+    size_t lenIndices { 8*sizeof(eh_index)*minimalLen/(cBitLen+1) };
+    size_t bytePad { sizeof(eh_index) - ((cBitLen+1)+7)/8 };
+    // expand in place, then convert the big-endian indices
+    indices.resize(lenIndices/sizeof(eh_index));
+    unsigned char* array = (unsigned char*)indices.data();
+    ExpandArray(minimal, minimalLen,
+                array, lenIndices, cBitLen+1, bytePad);
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = ArrayToEhIndex(array+i*sizeof(eh_index));
+    }
+}
+
 std::vector<unsigned char> GetMinimalFromIndices(std::vector<eh_index> indices,
                                                  size_t cBitLen)
 {
@@ -716,16 +732,27 @@ invalidsolution:
 template<unsigned int N, unsigned int K>
 bool Equihash<N,K>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln)
 {
-    if (soln.size() != SolutionWidth) {
+    return IsValidSolution(base_state, soln.data(), soln.size());
+}
+
+template<unsigned int N, unsigned int K>
+bool Equihash<N,K>::IsValidSolution(const eh_HashState& base_state,
+                                    const unsigned char* soln, size_t solnLen)
+{
+    if (solnLen != SolutionWidth) {
         LogPrint("pow", "Invalid solution length: %d (expected %d)\n",
-                 soln.size(), SolutionWidth);
+                 solnLen, SolutionWidth);
         return false;
     }
 
+    std::vector<eh_index> indices;
+    indices.reserve(1 << K);
+    GetIndicesFromMinimal(soln, solnLen, CollisionBitLength, indices);
+
     std::vector<FullStepRow<FinalFullWidth>> X;
     X.reserve(1 << K);
     unsigned char tmpHash[HashOutput];
-    for (eh_index i : GetIndicesFromMinimal(soln, CollisionBitLength)) {
+    for (eh_index i : indices) {
         GenerateHash(base_state, i/IndicesPerHashOutput, tmpHash, HashOutput);
         X.emplace_back(tmpHash+((i % IndicesPerHashOutput) * N/8),
                        N/8, HashLength, CollisionBitLength, i);
@@ -735,6 +762,7 @@ bool Equihash<N,K>::IsValidSolution(const eh_HashState& base_state, std::vector<
     size_t lenIndices = sizeof(eh_index);
     while (X.size() > 1) {
         std::vector<FullStepRow<FinalFullWidth>> Xc;
+        Xc.reserve(X.size()/2);
         for (int i = 0; i < X.size(); i += 2) {
             if (!HasCollision(X[i], X[i+1], CollisionByteLength)) {
                 LogPrint("pow", "Invalid solution: invalid collision length between StepRows\n");
@@ -752,7 +780,7 @@ bool Equihash<N,K>::IsValidSolution(const eh_HashState& base_state, std::vector<
             }
             Xc.emplace_back(X[i], X[i+1], hashLen, lenIndices, CollisionByteLength);
         }
-        X = Xc;
+        X.swap(Xc);
         hashLen -= CollisionByteLength;
         lenIndices *= 2;
     }
@@ -772,6 +800,8 @@ template bool Equihash<96,3>::OptimisedSolve(const eh_HashState& base_state,
                                              const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<96,3>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<96,3>::IsValidSolution(const eh_HashState& base_state,
+                                             const unsigned char* soln, size_t solnLen);
 
 // Explicit instantiations for Equihash<200,9>
 template int Equihash<200,9>::InitialiseState(eh_HashState& base_state);
@@ -784,6 +814,8 @@ template bool Equihash<200,9>::OptimisedSolve(const eh_HashState& base_state,
                                               const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<200,9>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<200,9>::IsValidSolution(const eh_HashState& base_state,
+                                             const unsigned char* soln, size_t solnLen);
 
 // Explicit instantiations for Equihash<96,5>
 template int Equihash<96,5>::InitialiseState(eh_HashState& base_state);
@@ -796,6 +828,8 @@ template bool Equihash<96,5>::OptimisedSolve(const eh_HashState& base_state,
                                              const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<96,5>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<96,5>::IsValidSolution(const eh_HashState& base_state,
+                                             const unsigned char* soln, size_t solnLen);
 
 // Explicit instantiations for Equihash<48,5>
 template int Equihash<48,5>::InitialiseState(eh_HashState& base_state);
@@ -808,5 +842,7 @@ template bool Equihash<48,5>::OptimisedSolve(const eh_HashState& base_state,
                                              const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<48,5>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<48,5>::IsValidSolution(const eh_HashState& base_state,
+                                             const unsigned char* soln, size_t solnLen);
 
 } // namespace
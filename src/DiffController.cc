@@ -23,6 +23,8 @@
  */
 #include "DiffController.h"
 
+#include "VardiffEngine.h"
+
 //////////////////////////////// DiffController ////////////////////////////////
 void DiffController::setMinDiff(uint64_t minDiff) {
   if (minDiff < kMinDiff_) {
@@ -52,8 +54,8 @@ void DiffController::resetCurDiff(uint64_t curDiff) {
   shares_.mapMultiply(0);
 }
 
-void DiffController::addAcceptedShare(const uint64_t share) {
-  const int64_t k = time(nullptr) / kRecordSeconds_;
+void DiffController::addAcceptedShare(const uint64_t share, const time_t now) {
+  const int64_t k = now / kRecordSeconds_;
   sharesNum_.insert(k, 1.0);
   shares_.insert(k, share);
 }
@@ -92,30 +94,40 @@ static int __hashRateUp(int level) {
 
 // TODO: test case
 int DiffController::adjustHashRateLevel(const double hashRateT) {
+  curHashRateLevel_ = AdjustHashRateLevel(curHashRateLevel_, hashRateT);
+  return curHashRateLevel_;
+}
+
+int DiffController::AdjustHashRateLevel(int level, const double hashRateT) {
   // hashrate is always danceing,
   // so need to use rate high and low to check it's level
   const double rateHigh = 1.50;
   const double rateLow = 0.75;
 
   // reduce level
-  if (curHashRateLevel_ > 0 && hashRateT < __hashRateDown(curHashRateLevel_)) {
-    while (curHashRateLevel_ > 0 &&
-           hashRateT <= __hashRateDown(curHashRateLevel_) * rateLow) {
-      curHashRateLevel_--;
+  if (level > 0 && hashRateT < __hashRateDown(level)) {
+    while (level > 0 && hashRateT <= __hashRateDown(level) * rateLow) {
+      level--;
     }
-    return curHashRateLevel_;
+    return level;
   }
 
   // increase level
-  if (curHashRateLevel_ <= 7 && hashRateT > __hashRateUp(curHashRateLevel_)) {
-    while (curHashRateLevel_ <= 7 &&
-           hashRateT >= __hashRateUp(curHashRateLevel_) * rateHigh) {
-      curHashRateLevel_++;
+  if (level <= 7 && hashRateT > __hashRateUp(level)) {
+    while (level <= 7 && hashRateT >= __hashRateUp(level) * rateHigh) {
+      level++;
     }
-    return curHashRateLevel_;
+    return level;
   }
 
-  return curHashRateLevel_;
+  return level;
+}
+
+double DiffController::HashRateLevelCoefficient(int level) {
+  const double c[] = {1.0, 1.0, 1.0, 1.2, 1.5, 2.0, 3.0, 4.0, 6.0};
+  assert(sizeof(c) / sizeof(c[0]) == 9);
+  assert(level >= 0 && level <= 8);
+  return c[level];
 }
 
 double DiffController::minerCoefficient(const time_t now, const int64_t idx) {
@@ -127,26 +139,29 @@ double DiffController::minerCoefficient(const time_t now, const int64_t idx) {
   double hashRateT = (double)shares * pow(2, 32) / shareWindow / pow(10, 12);
   adjustHashRateLevel(hashRateT);
   assert(curHashRateLevel_ >= 0 && curHashRateLevel_ <= 8);
-
-  const double c[] = {1.0, 1.0, 1.0, 1.2, 1.5, 2.0, 3.0, 4.0, 6.0};
-  assert(sizeof(c) / sizeof(c[0]) == 9);
-  return c[curHashRateLevel_];
+  return HashRateLevelCoefficient(curHashRateLevel_);
 }
 
-uint64_t DiffController::calcCurDiff() {
-  uint64_t diff = _calcCurDiff();
+uint64_t DiffController::calcCurDiff(const time_t now) {
+  uint64_t diff = _calcCurDiff(now);
   if (diff < minDiff_) {
     diff = minDiff_;
   }
   return diff;
 }
 
-uint64_t DiffController::_calcCurDiff() {
-  const time_t now = time(nullptr);
+std::shared_ptr<VardiffEngine> DiffController::getVardiffEngine() const {
+  if (!vardiffEngine_) {
+    vardiffEngine_ = std::make_shared<VardiffEngine>(*this);
+  }
+  return vardiffEngine_;
+}
+
+uint64_t DiffController::_calcCurDiff(const time_t now) {
   const int64_t k = now / kRecordSeconds_;
   const double sharesCount = (double)sharesNum_.sum(k);
   if (startTime_ == 0) { // first time, we set the start time
-    startTime_ = time(nullptr);
+    startTime_ = now;
   }
 
   const double kRateHigh = 1.40;
@@ -27,6 +27,8 @@
 #include "Common.h"
 #include "Statistics.h"
 
+class VardiffEngine;
+
 //////////////////////////////// DiffController ////////////////////////////////
 class DiffController {
 public:
@@ -46,9 +48,14 @@ public:
   StatsWindow<uint64_t> shares_; // share
 
   void setCurDiff(uint64_t curDiff); // set current diff with bounds checking
-  virtual uint64_t _calcCurDiff();
+  virtual uint64_t _calcCurDiff(const time_t now);
   int adjustHashRateLevel(const double hashRateT);
 
+  // the next hashrate level from the current one, and its coefficient of
+  // the expected share count
+  static int AdjustHashRateLevel(int level, const double hashRateT);
+  static double HashRateLevelCoefficient(int level);
+
   inline bool isFullWindow(const time_t now) {
     return now >= startTime_ + kDiffWindow_;
   }
@@ -56,6 +63,9 @@ public:
 private:
   double minerCoefficient(const time_t now, const int64_t idx);
 
+  // the engine of the miners copied from this one, see getVardiffEngine()
+  mutable std::shared_ptr<VardiffEngine> vardiffEngine_;
+
 public:
   DiffController(
       const uint64_t defaultDifficulty,
@@ -114,10 +124,18 @@ public:
   virtual ~DiffController() {}
 
   // recalc miner's diff before send an new stratum job
-  uint64_t calcCurDiff();
+  uint64_t calcCurDiff() { return calcCurDiff(time(nullptr)); }
+  uint64_t calcCurDiff(const time_t now);
 
   // we need to add every share, so we can calc worker's hashrate
-  void addAcceptedShare(const uint64_t share);
+  void addAcceptedShare(const uint64_t share) {
+    addAcceptedShare(share, time(nullptr));
+  }
+  void addAcceptedShare(const uint64_t share, const time_t now);
+
+  // The vardiff state of the miners copied from this controller, kept in
+  // one store. Created on the first call.
+  std::shared_ptr<VardiffEngine> getVardiffEngine() const;
 
   // maybe worker has it's own min diff
   void setMinDiff(uint64_t minDiff);
@@ -44,13 +44,14 @@ GwMaker::GwMaker(shared_ptr<GwMakerHandler> handler, const string &kafkaBrokers)
   , kafkaProducer_(
         kafkaBrokers.c_str(),
         handler->def().rawGwTopic_.c_str(),
-        0 /* partition */) {
+        0 /* partition */)
+  , workNotified_(false) {
 }
 
 GwMaker::~GwMaker() {
 }
 
-bool GwMaker::init() {
+bool GwMaker::initKafkaProducer() {
   map<string, string> options;
   // set to 1 (0 is an illegal value here), deliver msg as soon as possible.
   options["queue.buffering.max.ms"] = "1";
@@ -64,14 +65,29 @@ bool GwMaker::init() {
     LOG(ERROR) << "kafka is NOT alive";
     return false;
   }
+  return true;
+}
+
+bool GwMaker::init() {
+  if (!initKafkaProducer()) {
+    return false;
+  }
+
+  // fetch the work in run(), notifications come from other threads
+  auto callback = [this]() -> void { notifyWorkChanged(); };
 
   if (handler_->def().notifyHost_.length() > 0) {
-    auto callback = [&]() -> void { submitRawGwMsg(); };
     notification_ = make_shared<GwNotification>(
         callback, handler_->def().notifyHost_, handler_->def().notifyPort_);
     notification_->setupHttpd();
   }
 
+  if (handler_->def().zmqAddr_.length() > 0) {
+    zmqSubscriber_ = make_shared<GwZmqSubscriber>(
+        callback, handler_->def().zmqAddr_, handler_->def().zmqTopic_);
+    zmqSubscriber_->setup();
+  }
+
   // TODO: check rskd is alive in a similar way as done for btcd
 
   return true;
@@ -82,6 +98,10 @@ void GwMaker::stop() {
     return;
   }
   running_ = false;
+  workChanged_.notify_all();
+  if (zmqSubscriber_) {
+    zmqSubscriber_->stop();
+  }
   LOG(INFO) << "stop GwMaker " << handler_->def().chainType_
             << ", topic: " << handler_->def().rawGwTopic_;
 }
@@ -94,29 +114,68 @@ string GwMaker::makeRawGwMsg() {
   return handler_->makeRawGwMsg();
 }
 
-void GwMaker::submitRawGwMsg() {
+bool GwMaker::submitRawGwMsg() {
 
   const string rawGwMsg = makeRawGwMsg();
   if (rawGwMsg.length() == 0) {
     LOG(ERROR) << "get rawGw failure";
-    return;
+    return false;
+  }
+
+  const string workId = handler_->getWorkId(rawGwMsg);
+  const bool changed = workId.empty() || workId != lastWorkId_;
+  const auto now = std::chrono::steady_clock::now();
+  if (!changed &&
+      now - lastProduceTime_ <
+          std::chrono::milliseconds(handler_->def().workRefreshInterval_)) {
+    DLOG(INFO) << "work unchanged, skip: " << workId;
+    return false;
   }
+  lastWorkId_ = workId;
+  lastProduceTime_ = now;
 
   // submit to Kafka
   LOG(INFO) << "submit to Kafka msg len: " << rawGwMsg.length();
   kafkaProduceMsg(rawGwMsg.c_str(), rawGwMsg.length());
+  return changed;
+}
+
+void GwMaker::notifyWorkChanged() {
+  {
+    ScopeLock sl(workLock_);
+    workNotified_ = true;
+  }
+  workChanged_.notify_one();
 }
 
 void GwMaker::run() {
+  const GwMakerDefinition &def = handler_->def();
+  const bool isPushed = notification_ || zmqSubscriber_;
+  uint32_t interval = def.rpcInterval_;
 
   while (running_) {
-    std::this_thread::sleep_for(
-        std::chrono::milliseconds{handler_->def().rpcInterval_});
-    submitRawGwMsg();
+    {
+      unique_lock<mutex> ul(workLock_);
+      workChanged_.wait_for(ul, std::chrono::milliseconds{interval}, [this]() {
+        return workNotified_ || !running_;
+      });
+      workNotified_ = false;
+    }
+    if (!running_) {
+      break;
+    }
+
+    // Polling is only the fallback of pushed notifications, so back off
+    // while the work is unchanged.
+    if (submitRawGwMsg() || !isPushed) {
+      interval = def.rpcInterval_;
+    } else {
+      interval = std::min(interval * 2, def.rpcIntervalMax_);
+    }
   }
 
-  LOG(INFO) << "GwMaker " << handler_->def().chainType_
-            << ", topic: " << handler_->def().rawGwTopic_ << " stopped";
+  LOG(INFO) << "GwMaker " << def.chainType_ << ", topic: " << def.rawGwTopic_
+            << " stopped";
 }
 
 ///////////////////////////////GwNotification////////////////////////////////////
@@ -187,6 +246,69 @@ void GwNotification::stop() {
   event_base_loopexit(base_, NULL);
 }
 
+///////////////////////////////GwZmqSubscriber////////////////////////////////////
+GwZmqSubscriber::GwZmqSubscriber(
+    std::function<void(void)> callback,
+    const string &address,
+    const string &topic)
+  : callback_(callback)
+  , address_(address)
+  , topic_(topic)
+  , running_(true)
+  , context_(1 /*i/o threads*/) {
+}
+
+GwZmqSubscriber::~GwZmqSubscriber() {
+  stop();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void GwZmqSubscriber::setup() {
+  thread_ = std::thread(&GwZmqSubscriber::run, this);
+}
+
+void GwZmqSubscriber::stop() {
+  if (running_) {
+    LOG(INFO) << "stop zmq subscriber " << address_ << " ...";
+    running_ = false;
+  }
+}
+
+void GwZmqSubscriber::run() {
+  // wake up to check running_, zmq reconnects by itself
+  const int timeoutMs = 1000;
+
+  zmq::socket_t subscriber(context_, ZMQ_SUB);
+  subscriber.connect(address_);
+  subscriber.setsockopt(ZMQ_SUBSCRIBE, topic_.c_str(), topic_.size());
+  subscriber.setsockopt(ZMQ_RCVTIMEO, &timeoutMs, sizeof(timeoutMs));
+
+  while (running_) {
+    zmq::message_t zmsg;
+    try {
+      if (subscriber.recv(&zmsg) == false) {
+        continue; // timeout
+      }
+      // drop the rest parts of the message
+      while (zmsg.more()) {
+        subscriber.recv(&zmsg);
+      }
+    } catch (zmq::error_t &e) {
+      LOG(ERROR) << address_ << " zmq recv exception: " << e.what();
+      std::this_thread::sleep_for(1s);
+      continue;
+    }
+
+    LOG(INFO) << "GwZmqSubscriber: work changed, notified by " << address_;
+    callback_();
+  }
+
+  subscriber.close();
+  LOG(INFO) << "stop thread listen to " << address_;
+}
+
 ///////////////////////////////GwMakerHandler////////////////////////////////////
 GwMakerHandler::~GwMakerHandler() {
 }
@@ -201,6 +323,19 @@ string GwMakerHandler::makeRawGwMsg() {
   return processRawGw(gw);
 }
 
+string GwMakerHandler::getWorkId(const string &rawGwMsg) {
+  const string field = getWorkIdField();
+  JsonNode r;
+  if (field.empty() ||
+      !JsonNode::parse(
+          rawGwMsg.c_str(), rawGwMsg.c_str() + rawGwMsg.length(), r) ||
+      r.type() != Utilities::JS::type::Obj ||
+      r[field.c_str()].type() != Utilities::JS::type::Str) {
+    return "";
+  }
+  return r[field.c_str()].str();
+}
+
 bool GwMakerHandler::callRpcGw(string &response) {
   string request = getRequestData();
   string userAgent = getUserAgent();
@@ -39,6 +39,7 @@
 #include "Common.h"
 #include "Kafka.h"
 #include "utilities_js.hpp"
+#include "zmq.hpp"
 #include <event2/event.h>
 
 struct GwMakerDefinition {
@@ -48,10 +49,19 @@ struct GwMakerDefinition {
   string rpcAddr_;
   string rpcUserPwd_;
   uint32_t rpcInterval_;
+  // If the node pushes work changes (HTTP notify or ZMQ), polling backs off
+  // up to it while the work is unchanged.
+  uint32_t rpcIntervalMax_;
+  // Unchanged work is produced again after it (ms), so that the jobmaker
+  // doesn't take it as stale.
+  uint32_t workRefreshInterval_;
 
   string notifyHost_;
   uint32_t notifyPort_;
 
+  string zmqAddr_;
+  string zmqTopic_;
+
   string rawGwTopic_;
 };
 
@@ -69,6 +79,10 @@ public:
   // and ignore all the following virtual functions.
   virtual string makeRawGwMsg();
 
+  // Identifies the work in a RawGw message made by makeRawGwMsg(), the same
+  // work is not produced twice in a row. Returns "" if it is unknown.
+  virtual string getWorkId(const string &rawGwMsg);
+
 protected:
   // These virtual functions make it easier to implement the makeRawGwMsg()
   // interface. In most cases, you just need to override getRequestData() and
@@ -87,6 +101,9 @@ protected:
   // HTTP header `User-Agent` used by callRpcGw().
   virtual string getUserAgent() { return "curl"; }
 
+  // Field of the RawGw message used by getWorkId().
+  virtual string getWorkIdField() { return "hHash"; }
+
   // blockchain and RPC-server definitions
   GwMakerDefinition def_;
 };
@@ -119,6 +136,30 @@ public:
   void stop();
 };
 
+/*
+ * Subscribes a ZMQ publisher of the node, any message means a work change.
+ */
+class GwZmqSubscriber {
+  std::function<void(void)> callback_;
+  string address_;
+  string topic_;
+  atomic<bool> running_;
+  zmq::context_t context_;
+  thread thread_;
+
+  void run();
+
+public:
+  GwZmqSubscriber(
+      std::function<void(void)> callback,
+      const string &address,
+      const string &topic);
+  ~GwZmqSubscriber();
+
+  void setup();
+  void stop();
+};
+
 class GwMaker {
   shared_ptr<GwMakerHandler> handler_;
   atomic<bool> running_;
@@ -127,10 +168,25 @@ private:
   string kafkaBrokers_;
   KafkaProducer kafkaProducer_;
   shared_ptr<GwNotification> notification_;
+  shared_ptr<GwZmqSubscriber> zmqSubscriber_;
+
+  // work change notifications wake up run()
+  mutex workLock_;
+  condition_variable workChanged_;
+  bool workNotified_;
+
+  string lastWorkId_;
+  std::chrono::steady_clock::time_point lastProduceTime_;
 
   string makeRawGwMsg();
-  void submitRawGwMsg();
-  void kafkaProduceMsg(const void *payload, size_t len);
+  // returns true if the work changed
+  bool submitRawGwMsg();
+  void notifyWorkChanged();
+
+protected:
+  // virtual for tests that capture the RawGw messages without kafka
+  virtual bool initKafkaProducer();
+  virtual void kafkaProduceMsg(const void *payload, size_t len);
 
 public:
   GwMaker(shared_ptr<GwMakerHandler> handle, const string &kafkaBrokers);
@@ -0,0 +1,323 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "HttpClient.h"
+
+#include <future>
+
+#include <sys/eventfd.h>
+
+#include <curl/curl.h>
+#include <glog/logging.h>
+
+// Idle easy handles kept for one endpoint, more are cleaned up.
+static const size_t kMaxIdleHandlesPerEndpoint = 16;
+
+struct AsyncHttpClient::Transfer {
+  HttpRequest request_;
+  HttpCallback callback_;
+  string endpoint_;
+  string response_;
+  struct curl_slist *headers_ = nullptr;
+
+  ~Transfer() {
+    if (headers_ != nullptr) {
+      curl_slist_free_all(headers_);
+    }
+  }
+};
+
+static size_t
+CurlWriteStringCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+  size_t realsize = size * nmemb;
+  static_cast<string *>(userp)->append((const char *)contents, realsize);
+  return realsize;
+}
+
+AsyncHttpClient::AsyncHttpClient(long maxConnsPerHost)
+  : maxConnsPerHost_(maxConnsPerHost)
+  , multi_(curl_multi_init())
+  , wakeupFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  , running_(true) {
+  if (multi_ == nullptr || wakeupFd_ == -1) {
+    LOG(FATAL) << "AsyncHttpClient: cannot create curl multi handle or eventfd";
+  }
+
+  CURLM *multi = (CURLM *)multi_;
+  curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxConnsPerHost_);
+  curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, maxConnsPerHost_ * 16);
+  // HTTP/1.1 pipelining is gone from libcurl, HTTP/2 streams are multiplexed
+  // on one connection if the node supports it.
+  curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+  thread_ = std::thread(&AsyncHttpClient::run, this);
+}
+
+AsyncHttpClient::~AsyncHttpClient() {
+  running_ = false;
+  wakeup();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  CURLM *multi = (CURLM *)multi_;
+  for (auto &itr : transfers_) {
+    curl_multi_remove_handle(multi, (CURL *)itr.first);
+    curl_easy_cleanup((CURL *)itr.first);
+  }
+  transfers_.clear();
+  for (auto &itr : idleHandles_) {
+    for (void *curl : itr.second) {
+      curl_easy_cleanup((CURL *)curl);
+    }
+  }
+  idleHandles_.clear();
+
+  curl_multi_cleanup(multi);
+  close(wakeupFd_);
+}
+
+AsyncHttpClient &AsyncHttpClient::shared() {
+  static AsyncHttpClient client;
+  return client;
+}
+
+string AsyncHttpClient::endpointOf(const string &url) {
+  // scheme://host:port/path -> scheme://host:port
+  size_t pos = url.find("://");
+  pos = (pos == string::npos) ? 0 : pos + 3;
+  pos = url.find('/', pos);
+  return pos == string::npos ? url : url.substr(0, pos);
+}
+
+void AsyncHttpClient::wakeup() {
+  uint64_t one = 1;
+  if (write(wakeupFd_, &one, sizeof(one)) != sizeof(one)) {
+    // the counter is already non-zero, the loop will wake up anyway
+  }
+}
+
+void AsyncHttpClient::request(HttpRequest request, HttpCallback callback) {
+  auto transfer = std::make_unique<Transfer>();
+  transfer->endpoint_ = endpointOf(request.url_);
+  transfer->request_ = std::move(request);
+  transfer->callback_ = std::move(callback);
+  {
+    ScopeLock sl(lock_);
+    pending_.push_back(std::move(transfer));
+  }
+  wakeup();
+}
+
+bool AsyncHttpClient::requestSync(const HttpRequest &request, string &response) {
+  assert(std::this_thread::get_id() != thread_.get_id());
+
+  std::promise<bool> done;
+  auto future = done.get_future();
+  this->request(request, [&done, &response](bool ok, const string &resp) {
+    response = resp;
+    done.set_value(ok);
+  });
+  return future.get();
+}
+
+void AsyncHttpClient::rpcCall(
+    const string &url,
+    const string &userpwd,
+    shared_ptr<const string> request,
+    HttpCallback callback,
+    long timeoutMs) {
+  HttpRequest req;
+  req.url_ = url;
+  req.userpwd_ = userpwd;
+  req.body_ = std::move(request);
+  req.contentType_ = "application/json";
+  req.timeoutMs_ = timeoutMs;
+  this->request(std::move(req), std::move(callback));
+}
+
+void *AsyncHttpClient::acquireHandle(const string &endpoint) {
+  auto &idle = idleHandles_[endpoint];
+  if (!idle.empty()) {
+    CURL *curl = (CURL *)idle.back();
+    idle.pop_back();
+    // keeps the connection and the TLS session, clears the options
+    curl_easy_reset(curl);
+    return curl;
+  }
+  return curl_easy_init();
+}
+
+void AsyncHttpClient::releaseHandle(const string &endpoint, void *curl) {
+  auto &idle = idleHandles_[endpoint];
+  if (idle.size() < kMaxIdleHandlesPerEndpoint) {
+    idle.push_back(curl);
+  } else {
+    curl_easy_cleanup((CURL *)curl);
+  }
+}
+
+void AsyncHttpClient::startTransfer(unique_ptr<Transfer> transfer) {
+  CURL *curl = (CURL *)acquireHandle(transfer->endpoint_);
+  if (curl == nullptr) {
+    LOG(ERROR) << "AsyncHttpClient: curl_easy_init() failed";
+    transfer->callback_(false, transfer->response_);
+    return;
+  }
+
+  const HttpRequest &req = transfer->request_;
+
+  if (!req.contentType_.empty()) {
+    string contentType = string("Content-Type: ") + req.contentType_;
+    transfer->headers_ =
+        curl_slist_append(transfer->headers_, contentType.c_str());
+  }
+  // The blocking httpPOST() used HTTP/1.0 only because RSK doesn't support
+  // 'Expect: 100-Continue' in HTTP/1.1. HTTP/1.0 closes the connection after
+  // every request, which defeats the pooled handles, so stay on HTTP/1.1 and
+  // suppress the 'Expect:' header instead (see TestHttpClient.cc).
+  transfer->headers_ = curl_slist_append(transfer->headers_, "Expect:");
+
+  curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->headers_);
+  curl_easy_setopt(curl, CURLOPT_URL, req.url_.c_str());
+
+  if (req.body_) {
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)req.body_->size());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req.body_->data());
+  }
+
+  if (!req.userpwd_.empty()) {
+    curl_easy_setopt(curl, CURLOPT_USERPWD, req.userpwd_.c_str());
+  }
+
+  curl_easy_setopt(curl, CURLOPT_USE_SSL, CURLUSESSL_TRY);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, req.sslVerifyPeer_ ? 1L : 0L);
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, req.agent_.c_str());
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, req.timeoutMs_);
+
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWriteStringCallback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&transfer->response_);
+
+  CURLMcode mc = curl_multi_add_handle((CURLM *)multi_, curl);
+  if (mc != CURLM_OK) {
+    LOG(ERROR) << "AsyncHttpClient: curl_multi_add_handle() failed: "
+               << curl_multi_strerror(mc);
+    curl_easy_cleanup(curl);
+    transfer->callback_(false, transfer->response_);
+    return;
+  }
+  transfers_[curl] = std::move(transfer);
+}
+
+void AsyncHttpClient::finishTransfer(void *handle, int result) {
+  CURL *curl = (CURL *)handle;
+  auto itr = transfers_.find(handle);
+  if (itr == transfers_.end()) {
+    return;
+  }
+  unique_ptr<Transfer> transfer = std::move(itr->second);
+  transfers_.erase(itr);
+
+  curl_multi_remove_handle((CURLM *)multi_, curl);
+
+  bool ok = false;
+  if (result != CURLE_OK) {
+    LOG(ERROR) << "unable to request data from: " << transfer->request_.url_
+               << ", error: " << curl_easy_strerror((CURLcode)result);
+  } else {
+    long code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    // status code 200 - 208 indicates ok
+    // sia returns 204 as success
+    if (code < 200 || code > 208) {
+      LOG(ERROR) << "server responded with code: " << code;
+    } else {
+      ok = true;
+    }
+  }
+
+  if (result == CURLE_OK) {
+    releaseHandle(transfer->endpoint_, curl);
+  } else {
+    // don't reuse a handle whose connection may be broken
+    curl_easy_cleanup(curl);
+  }
+
+  transfer->callback_(ok, transfer->response_);
+}
+
+void AsyncHttpClient::run() {
+  CURLM *multi = (CURLM *)multi_;
+
+  while (running_) {
+    std::deque<unique_ptr<Transfer>> pending;
+    {
+      ScopeLock sl(lock_);
+      pending.swap(pending_);
+    }
+    for (auto &transfer : pending) {
+      startTransfer(std::move(transfer));
+    }
+
+    int stillRunning = 0;
+    curl_multi_perform(multi, &stillRunning);
+
+    CURLMsg *msg;
+    int msgsLeft = 0;
+    while ((msg = curl_multi_info_read(multi, &msgsLeft)) != nullptr) {
+      if (msg->msg == CURLMSG_DONE) {
+        finishTransfer(msg->easy_handle, msg->data.result);
+      }
+    }
+
+    struct curl_waitfd waitfd;
+    waitfd.fd = wakeupFd_;
+    waitfd.events = CURL_WAIT_POLLIN;
+    waitfd.revents = 0;
+    curl_multi_wait(multi, &waitfd, 1, 1000, nullptr);
+
+    if (waitfd.revents != 0) {
+      uint64_t counter;
+      if (read(wakeupFd_, &counter, sizeof(counter)) != sizeof(counter)) {
+        // nothing to read, spurious wakeup
+      }
+    }
+  }
+
+  // fail the requests left
+  std::deque<unique_ptr<Transfer>> pending;
+  {
+    ScopeLock sl(lock_);
+    pending.swap(pending_);
+  }
+  for (auto &transfer : pending) {
+    transfer->callback_(false, transfer->response_);
+  }
+  while (!transfers_.empty()) {
+    finishTransfer(transfers_.begin()->first, CURLE_ABORTED_BY_CALLBACK);
+  }
+}
@@ -0,0 +1,110 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#ifndef HTTP_CLIENT_H_
+#define HTTP_CLIENT_H_
+
+#include "Common.h"
+
+/////////////////////////////////// HttpRequest ////////////////////////////////
+struct HttpRequest {
+  string url_;
+  string userpwd_; // optional, "user:password"
+  // POST if not nullptr, otherwise GET.
+  // It is shared so that the same block can be sent to many nodes.
+  shared_ptr<const string> body_;
+  string contentType_; // optional
+  string agent_ = "curl";
+  long timeoutMs_ = 5000;
+  bool sslVerifyPeer_ = true;
+};
+
+// `ok` is true if the request is done with a 2xx status code (200 - 208).
+using HttpCallback = std::function<void(bool ok, const string &response)>;
+
+///////////////////////////////// AsyncHttpClient //////////////////////////////
+//
+// A non-blocking HTTP client built on curl-multi, used for the RPC calls to
+// blockchain nodes.
+//
+// All requests run on one thread of the client:
+//  * Connections are kept alive and reused. curl-multi shares its connection
+//    cache between all transfers, and finished easy handles are pooled per
+//    endpoint (scheme://host:port) so they are not re-created.
+//  * At most `maxConnsPerHost` connections are opened to one endpoint. More
+//    concurrent requests queue up behind them (or are multiplexed on HTTP/2)
+//    instead of opening new connections.
+//  * A request never takes longer than its timeoutMs_.
+//
+// Callbacks run on the client's thread, they should be quick and must not
+// call requestSync().
+//
+class AsyncHttpClient {
+public:
+  explicit AsyncHttpClient(long maxConnsPerHost = 8);
+  ~AsyncHttpClient();
+
+  // The process-wide client, started on first use.
+  static AsyncHttpClient &shared();
+
+  // thread-safe
+  void request(HttpRequest request, HttpCallback callback);
+  // thread-safe, blocks the calling thread until the request is done
+  bool requestSync(const HttpRequest &request, string &response);
+
+  // JSON-RPC over HTTP POST
+  void rpcCall(
+      const string &url,
+      const string &userpwd,
+      shared_ptr<const string> request,
+      HttpCallback callback,
+      long timeoutMs = 5000);
+
+private:
+  struct Transfer;
+
+  void run();
+  void wakeup();
+  void startTransfer(unique_ptr<Transfer> transfer);
+  void finishTransfer(void *curl, int result);
+  void *acquireHandle(const string &endpoint);
+  void releaseHandle(const string &endpoint, void *curl);
+
+  static string endpointOf(const string &url);
+
+  const long maxConnsPerHost_;
+  void *multi_; // CURLM *
+  int wakeupFd_;
+
+  mutex lock_;
+  std::deque<unique_ptr<Transfer>> pending_;
+
+  // only accessed by the client's thread
+  std::map<void * /* CURL * */, unique_ptr<Transfer>> transfers_;
+  std::map<string /* endpoint */, vector<void *>> idleHandles_;
+
+  atomic<bool> running_;
+  thread thread_;
+};
+
+#endif // HTTP_CLIENT_H_
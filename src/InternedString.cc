@@ -0,0 +1,88 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "InternedString.h"
+
+#include <mutex>
+#include <unordered_map>
+
+const std::string InternedString::empty_;
+
+// The pool may be used before main() and after the sessions are gone, so it
+// is never destroyed.
+static std::mutex &poolLock() {
+  static auto lock = new std::mutex;
+  return *lock;
+}
+
+static std::unordered_map<std::string, size_t> &pool() {
+  static auto pool = new std::unordered_map<std::string, size_t>;
+  return *pool;
+}
+
+InternedString::InternedString(const std::string &str)
+  : entry_(nullptr) {
+  if (str.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> sl(poolLock());
+  // the nodes of unordered_map never move
+  entry_ = &*pool().emplace(str, 0).first;
+  entry_->second++;
+}
+
+InternedString::InternedString(const InternedString &other)
+  : entry_(other.entry_) {
+  if (entry_) {
+    std::lock_guard<std::mutex> sl(poolLock());
+    entry_->second++;
+  }
+}
+
+InternedString &InternedString::operator=(const InternedString &other) {
+  if (entry_ != other.entry_) {
+    InternedString copy(other);
+    std::swap(entry_, copy.entry_);
+  }
+  return *this;
+}
+
+InternedString::~InternedString() {
+  release();
+}
+
+void InternedString::release() {
+  if (entry_) {
+    std::lock_guard<std::mutex> sl(poolLock());
+    if (--entry_->second == 0) {
+      // erase by iterator, the key is part of the node
+      pool().erase(pool().find(entry_->first));
+    }
+    entry_ = nullptr;
+  }
+}
+
+size_t InternedString::poolSize() {
+  std::lock_guard<std::mutex> sl(poolLock());
+  return pool().size();
+}
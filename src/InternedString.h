@@ -0,0 +1,80 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#ifndef BPOOL_INTERNED_STRING_H_
+#define BPOOL_INTERNED_STRING_H_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+
+//////////////////////////////// InternedString ////////////////////////////////
+//
+// A string shared by many sessions (client agent, user name) is kept once in
+// a process wide pool. InternedString is a pointer to the pool entry, which
+// is reference counted and freed with its last InternedString.
+//
+class InternedString {
+public:
+  InternedString()
+    : entry_(nullptr) {}
+  InternedString(const std::string &str);
+  InternedString(const char *str)
+    : InternedString(std::string(str)) {}
+  InternedString(const InternedString &other);
+  InternedString &operator=(const InternedString &other);
+  ~InternedString();
+
+  const std::string &str() const { return entry_ ? entry_->first : empty_; }
+  operator const std::string &() const { return str(); }
+
+  size_t size() const { return str().size(); }
+  bool empty() const { return str().empty(); }
+  const char *c_str() const { return str().c_str(); }
+
+  // Interned strings are equal if they have the same entry.
+  bool operator==(const InternedString &r) const { return entry_ == r.entry_; }
+  bool operator!=(const InternedString &r) const { return entry_ != r.entry_; }
+  bool operator==(const std::string &r) const { return str() == r; }
+  bool operator!=(const std::string &r) const { return str() != r; }
+  bool operator==(const char *r) const { return str() == r; }
+  bool operator!=(const char *r) const { return str() != r; }
+
+  // number of distinct strings in the pool
+  static size_t poolSize();
+
+private:
+  using Entry = std::pair<const std::string, size_t>;
+
+  void release();
+
+  static const std::string empty_;
+  Entry *entry_;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const InternedString &s) {
+  return os << s.str();
+}
+
+#endif // BPOOL_INTERNED_STRING_H_
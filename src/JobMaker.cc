@@ -65,6 +65,20 @@ bool JobMaker::setupKafkaProducer() {
   return true;
 }
 
+bool JobMaker::setupShmJobBus() {
+  const string &busName = handler_->def()->shmJobBus_;
+  if (busName.empty()) {
+    return true;
+  }
+  shmJobBusWriter_ = std::make_unique<ShmJobBusWriter>(busName);
+  if (!shmJobBusWriter_->setup()) {
+    LOG(ERROR) << "shm job bus " << busName << " setup failure";
+    return false;
+  }
+  LOG(INFO) << "jobs will also be written to shm job bus " << busName;
+  return true;
+}
+
 bool JobMaker::init() {
   if (handler_->def()->serverId_ == 0) {
     // assign id from zookeeper
@@ -87,6 +101,9 @@ bool JobMaker::init() {
   if (!setupKafkaProducer())
     return false;
 
+  if (!setupShmJobBus())
+    return false;
+
   /* setup kafka consumers */
   if (!handler_->initConsumerHandlers(kafkaBrokers_, kafkaConsumerHandlers_)) {
     return false;
@@ -137,6 +154,10 @@ void JobMaker::produceStratumJob() {
 
   if (!jobMsg.empty()) {
     LOG(INFO) << "new " << handler_->def()->jobTopic_ << " job: " << jobMsg;
+    // local sservers first, Kafka is the durable / remote path
+    if (shmJobBusWriter_) {
+      shmJobBusWriter_->write(jobMsg.data(), jobMsg.size());
+    }
     kafkaProducer_.produce(jobMsg.data(), jobMsg.size());
   }
 
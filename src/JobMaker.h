@@ -26,6 +26,7 @@
 
 #include "Common.h"
 #include "Kafka.h"
+#include "ShmJobBus.h"
 
 #include "Zookeeper.h"
 
@@ -65,6 +66,11 @@ struct JobMakerDefinition {
 
   string zookeeperLockPath_;
   string fileLastJobTime_;
+
+  // optional, the name of a local shared memory job bus (e.g.
+  // "/btcpool_BtcJob"). Jobs are written to it in addition to Kafka so the
+  // sservers on the same host receive them without a broker round-trip.
+  string shmJobBus_;
 };
 
 struct GwJobMakerDefinition : public JobMakerDefinition {
@@ -157,6 +163,7 @@ protected:
 
   string kafkaBrokers_;
   KafkaProducer kafkaProducer_;
+  unique_ptr<ShmJobBusWriter> shmJobBusWriter_;
 
   vector<JobMakerConsumerHandler> kafkaConsumerHandlers_;
   vector<shared_ptr<thread>> kafkaConsumerWorkers_;
@@ -184,6 +191,7 @@ public:
 
 private:
   bool setupKafkaProducer();
+  bool setupShmJobBus();
 };
 
 #endif
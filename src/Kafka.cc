@@ -483,6 +483,13 @@ bool KafkaProducer::checkAlive() {
   return true;
 }
 
+int KafkaProducer::getQueueLength() const {
+  if (producer_ == nullptr) {
+    return 0;
+  }
+  return rd_kafka_outq_len(producer_);
+}
+
 void KafkaProducer::produce(const void *payload, size_t len) {
   // rd_kafka_produce() is non-blocking
   // Returns 0 on success or -1 on error
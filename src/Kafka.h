@@ -147,6 +147,8 @@ public:
   // some cases, such as the local queue is full. In this case, the sender can
   // choose to try again later.
   bool tryProduce(const void *payload, size_t len);
+  // messages waiting to be sent or acknowledged by the brokers
+  int getQueueLength() const;
 };
 
 #endif
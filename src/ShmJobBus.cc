@@ -0,0 +1,356 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "ShmJobBus.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <glog/logging.h>
+
+// The header lives in memory shared by different processes, so its atomics
+// must not fall back to a lock.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "atomic<uint64_t> must be lock-free");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "atomic<uint32_t> must be lock-free");
+
+namespace ShmJobBus {
+
+size_t mappingSize(uint32_t slotCount, uint32_t slotSize) {
+  return sizeof(Header) + (size_t)slotCount * slotSize;
+}
+
+// The geometry is passed in, not read from the shared header which the
+// writer may be re-initializing.
+static inline SlotHeader *
+slotAt(Header *header, uint32_t slotCount, uint32_t slotSize, uint64_t seq) {
+  char *slots = (char *)header + sizeof(Header);
+  return (SlotHeader *)(slots + (seq % slotCount) * slotSize);
+}
+
+static inline char *slotData(SlotHeader *slot) {
+  return (char *)slot + sizeof(SlotHeader);
+}
+
+// The futex is not FUTEX_PRIVATE_FLAG, it is shared between processes.
+static void futexWait(atomic<uint32_t> *addr, uint32_t value, int timeoutMs) {
+  struct timespec ts;
+  ts.tv_sec = timeoutMs / 1000;
+  ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+  syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, value, &ts, nullptr, 0);
+}
+
+static void futexWakeAll(atomic<uint32_t> *addr) {
+  syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace ShmJobBus
+
+//////////////////////////////// ShmJobBusWriter //////////////////////////////
+ShmJobBusWriter::ShmJobBusWriter(
+    const string &name, uint32_t slotCount, uint32_t slotSize)
+  : name_(name)
+  , fd_(-1)
+  , mem_(MAP_FAILED)
+  , memSize_(0)
+  , header_(nullptr)
+  , slotCount_(slotCount)
+  , slotSize_(slotSize) {
+  assert(slotCount_ > 0);
+  assert(slotSize_ > sizeof(ShmJobBus::SlotHeader) && slotSize_ % 64 == 0);
+}
+
+ShmJobBusWriter::~ShmJobBusWriter() {
+  // The shared memory object is not unlinked: sservers keep their mapping
+  // and continue to receive jobs after the jobmaker restarts.
+  if (mem_ != MAP_FAILED) {
+    munmap(mem_, memSize_);
+  }
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+uint32_t ShmJobBusWriter::maxMessageSize() const {
+  return slotSize_ - sizeof(ShmJobBus::SlotHeader);
+}
+
+// Invalidates the header of a ring of another size and unlinks it. The readers
+// keep their mapping of the old object until they see the invalid header.
+static void RetireRing(const string &name, int fd, size_t size) {
+  if (size >= sizeof(ShmJobBus::Header)) {
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem != MAP_FAILED) {
+      auto header = (ShmJobBus::Header *)mem;
+      header->magic_ = 0;
+      header->notify_.fetch_add(1, std::memory_order_release);
+      ShmJobBus::futexWakeAll(&header->notify_);
+      munmap(mem, size);
+    }
+  }
+  shm_unlink(name.c_str());
+}
+
+bool ShmJobBusWriter::setup() {
+  fd_ = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0644);
+  if (fd_ == -1) {
+    LOG(ERROR) << "shm job bus " << name_
+               << ": shm_open failed: " << strerror(errno);
+    return false;
+  }
+
+  memSize_ = ShmJobBus::mappingSize(slotCount_, slotSize_);
+
+  struct stat st;
+  if (fstat(fd_, &st) == -1) {
+    LOG(ERROR) << "shm job bus " << name_
+               << ": fstat failed: " << strerror(errno);
+    return false;
+  }
+  if (st.st_size != 0 && (size_t)st.st_size != memSize_) {
+    LOG(INFO) << "shm job bus " << name_ << ": replacing a ring of "
+              << st.st_size << " bytes";
+    RetireRing(name_, fd_, st.st_size);
+    close(fd_);
+    fd_ = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd_ == -1) {
+      LOG(ERROR) << "shm job bus " << name_
+                 << ": shm_open failed: " << strerror(errno);
+      return false;
+    }
+    st.st_size = 0;
+  }
+  if (st.st_size == 0 && ftruncate(fd_, memSize_) == -1) {
+    LOG(ERROR) << "shm job bus " << name_
+               << ": ftruncate failed: " << strerror(errno);
+    return false;
+  }
+
+  mem_ = mmap(nullptr, memSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (mem_ == MAP_FAILED) {
+    LOG(ERROR) << "shm job bus " << name_
+               << ": mmap failed: " << strerror(errno);
+    return false;
+  }
+  header_ = (ShmJobBus::Header *)mem_;
+
+  // Keep the existing ring (and its sequence) if a previous jobmaker left one
+  // with the same geometry, so attached readers don't have to resync.
+  if (header_->magic_ != ShmJobBus::kMagic ||
+      header_->version_ != ShmJobBus::kVersion ||
+      header_->slotCount_ != slotCount_ || header_->slotSize_ != slotSize_) {
+    LOG(INFO) << "shm job bus " << name_ << ": initializing, slots: "
+              << slotCount_ << ", slot size: " << slotSize_;
+    header_->magic_ = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    memset((char *)mem_ + sizeof(ShmJobBus::Header),
+           0,
+           memSize_ - sizeof(ShmJobBus::Header));
+    header_->version_ = ShmJobBus::kVersion;
+    header_->slotCount_ = slotCount_;
+    header_->slotSize_ = slotSize_;
+    header_->writeSeq_.store(0, std::memory_order_relaxed);
+    header_->notify_.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic_ = ShmJobBus::kMagic;
+  } else {
+    LOG(INFO) << "shm job bus " << name_ << ": reusing, write seq: "
+              << header_->writeSeq_.load();
+  }
+
+  return true;
+}
+
+bool ShmJobBusWriter::write(const char *data, size_t len) {
+  if (header_ == nullptr) {
+    return false;
+  }
+  if (len > maxMessageSize()) {
+    LOG(WARNING) << "shm job bus " << name_ << ": message too large (" << len
+                 << " > " << maxMessageSize() << " bytes), skipped";
+    return false;
+  }
+
+  const uint64_t seq = header_->writeSeq_.load(std::memory_order_relaxed);
+  ShmJobBus::SlotHeader *slot =
+      ShmJobBus::slotAt(header_, slotCount_, slotSize_, seq);
+
+  // odd: the slot is being written
+  slot->seq_.store(seq * 2 + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->len_ = (uint32_t)len;
+  memcpy(ShmJobBus::slotData(slot), data, len);
+
+  // even: the slot holds message `seq`
+  slot->seq_.store(seq * 2 + 2, std::memory_order_release);
+  header_->writeSeq_.store(seq + 1, std::memory_order_release);
+
+  header_->notify_.fetch_add(1, std::memory_order_release);
+  ShmJobBus::futexWakeAll(&header_->notify_);
+  return true;
+}
+
+//////////////////////////////// ShmJobBusReader //////////////////////////////
+ShmJobBusReader::ShmJobBusReader(const string &name)
+  : name_(name)
+  , fd_(-1)
+  , mem_(MAP_FAILED)
+  , memSize_(0)
+  , header_(nullptr)
+  , readSeq_(0)
+  , slotCount_(0)
+  , slotSize_(0) {
+}
+
+ShmJobBusReader::~ShmJobBusReader() {
+  detach();
+}
+
+void ShmJobBusReader::detach() {
+  if (mem_ != MAP_FAILED) {
+    munmap(mem_, memSize_);
+    mem_ = MAP_FAILED;
+  }
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+  header_ = nullptr;
+}
+
+bool ShmJobBusReader::attach() {
+  fd_ = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd_ == -1) {
+    // the jobmaker has not created it yet
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd_, &st) == -1 || (size_t)st.st_size < sizeof(ShmJobBus::Header)) {
+    detach();
+    return false;
+  }
+
+  memSize_ = st.st_size;
+  mem_ = mmap(nullptr, memSize_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (mem_ == MAP_FAILED) {
+    LOG(ERROR) << "shm job bus " << name_
+               << ": mmap failed: " << strerror(errno);
+    detach();
+    return false;
+  }
+
+  auto header = (ShmJobBus::Header *)mem_;
+  if (header->magic_ != ShmJobBus::kMagic ||
+      header->version_ != ShmJobBus::kVersion ||
+      ShmJobBus::mappingSize(header->slotCount_, header->slotSize_) >
+          memSize_) {
+    // not initialized yet, or written by an incompatible jobmaker
+    detach();
+    return false;
+  }
+
+  header_ = header;
+  slotCount_ = header_->slotCount_;
+  slotSize_ = header_->slotSize_;
+  // Start at the next message. The latest job is already provided by Kafka.
+  readSeq_ = header_->writeSeq_.load(std::memory_order_acquire);
+
+  LOG(INFO) << "shm job bus " << name_ << " attached, slots: "
+            << header_->slotCount_ << ", slot size: " << header_->slotSize_
+            << ", write seq: " << readSeq_;
+  return true;
+}
+
+bool ShmJobBusReader::isValid() const {
+  return header_->magic_ == ShmJobBus::kMagic &&
+      header_->version_ == ShmJobBus::kVersion &&
+      header_->slotCount_ == slotCount_ && header_->slotSize_ == slotSize_;
+}
+
+bool ShmJobBusReader::read(string &msg, int timeoutMs) {
+  if (header_ != nullptr && !isValid()) {
+    // retired or being re-initialized by a restarted jobmaker
+    LOG(WARNING) << "shm job bus " << name_ << " changed, attaching again";
+    detach();
+  }
+  if (header_ == nullptr && !attach()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+    return false;
+  }
+
+  const uint32_t notify = header_->notify_.load(std::memory_order_acquire);
+  uint64_t writeSeq = header_->writeSeq_.load(std::memory_order_acquire);
+
+  if (readSeq_ > writeSeq) {
+    // the ring was re-initialized by a restarted jobmaker
+    LOG(WARNING) << "shm job bus " << name_ << " was reset, resync at "
+                 << writeSeq;
+    readSeq_ = writeSeq;
+  }
+
+  if (readSeq_ == writeSeq) {
+    ShmJobBus::futexWait(&header_->notify_, notify, timeoutMs);
+    writeSeq = header_->writeSeq_.load(std::memory_order_acquire);
+    if (readSeq_ >= writeSeq) {
+      return false;
+    }
+  }
+
+  const uint32_t maxLen = slotSize_ - sizeof(ShmJobBus::SlotHeader);
+
+  // A few retries are enough: the writer publishes a job every few seconds,
+  // a slot can only be overwritten if this reader is a full ring behind.
+  for (int retry = 0; retry < 3; retry++) {
+    if (writeSeq - readSeq_ > slotCount_) {
+      LOG(WARNING) << "shm job bus " << name_ << " reader lagged, skipped "
+                   << (writeSeq - 1 - readSeq_) << " messages";
+      readSeq_ = writeSeq - 1;
+    }
+
+    ShmJobBus::SlotHeader *slot =
+        ShmJobBus::slotAt(header_, slotCount_, slotSize_, readSeq_);
+    const uint64_t seq1 = slot->seq_.load(std::memory_order_acquire);
+
+    if (seq1 == readSeq_ * 2 + 2 && slot->len_ <= maxLen) {
+      msg.assign(ShmJobBus::slotData(slot), slot->len_);
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (slot->seq_.load(std::memory_order_relaxed) == seq1) {
+        readSeq_++;
+        return true;
+      }
+    }
+
+    // overwritten during the copy, jump to the latest message
+    writeSeq = header_->writeSeq_.load(std::memory_order_acquire);
+    readSeq_ = writeSeq > 0 ? writeSeq - 1 : 0;
+  }
+
+  return false;
+}
@@ -0,0 +1,142 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#ifndef SHM_JOB_BUS_H_
+#define SHM_JOB_BUS_H_
+
+#include "Common.h"
+
+//
+// A local transport of stratum jobs between a jobmaker and the sservers
+// running on the same host.
+//
+// It is a single-producer / multi-consumer broadcast ring in POSIX shared
+// memory (shm_open). Every reader sees every message, readers never block the
+// writer, and a reader that falls more than a full ring behind skips to the
+// latest message (only the newest job matters to a sserver).
+//
+// Kafka stays the durable / remote path. A sserver consumes both and drops
+// the job it receives second (see JobRepository::consumeStratumJob()).
+//
+// Layout of the shared memory:
+//
+//   +----------------------+---------+---------+-----+---------+
+//   | ShmJobBus::Header    | slot 0  | slot 1  | ... | slot N-1|
+//   +----------------------+---------+---------+-----+---------+
+//
+// Every slot is guarded by a seqlock: the writer sets the slot's sequence to
+// an odd value before copying a message in and to an even value after that,
+// a reader copies the message out and accepts it only if the sequence was
+// unchanged and even during the copy.
+//
+namespace ShmJobBus {
+
+const uint64_t kMagic = 0x42554a424f4a5042ULL; // "BPJOBJUB"
+const uint32_t kVersion = 1;
+
+// The stratum job json is a few KB even with merged mining fields.
+const uint32_t kDefaultSlotCount = 16;
+const uint32_t kDefaultSlotSize = 64 * 1024;
+
+struct Header {
+  uint64_t magic_;
+  uint32_t version_;
+  uint32_t slotCount_;
+  uint32_t slotSize_;
+  // how many messages have been published
+  alignas(64) atomic<uint64_t> writeSeq_;
+  // increased and woken after each publish, readers wait on it with futex
+  alignas(64) atomic<uint32_t> notify_;
+};
+
+struct SlotHeader {
+  atomic<uint64_t> seq_;
+  uint32_t len_;
+  uint32_t reserved_;
+};
+
+size_t mappingSize(uint32_t slotCount, uint32_t slotSize);
+
+} // namespace ShmJobBus
+
+//////////////////////////////// ShmJobBusWriter //////////////////////////////
+// not thread-safe, there should be only one writer of a bus.
+//
+// A ring of another size is never resized in place (readers would get SIGBUS
+// on the truncated pages): the writer invalidates its header, unlinks it and
+// creates a new one, readers notice the invalid header and attach again.
+class ShmJobBusWriter {
+  string name_;
+  int fd_;
+  void *mem_;
+  size_t memSize_;
+  ShmJobBus::Header *header_;
+  uint32_t slotCount_;
+  uint32_t slotSize_;
+
+public:
+  ShmJobBusWriter(
+      const string &name,
+      uint32_t slotCount = ShmJobBus::kDefaultSlotCount,
+      uint32_t slotSize = ShmJobBus::kDefaultSlotSize);
+  ~ShmJobBusWriter();
+
+  bool setup();
+  // false if the message is larger than a slot
+  bool write(const char *data, size_t len);
+
+  const string &name() const { return name_; }
+  uint32_t maxMessageSize() const;
+};
+
+//////////////////////////////// ShmJobBusReader //////////////////////////////
+// not thread-safe, each consumer thread should have its own reader.
+class ShmJobBusReader {
+  string name_;
+  int fd_;
+  void *mem_;
+  size_t memSize_;
+  ShmJobBus::Header *header_;
+  uint64_t readSeq_;
+  // the geometry at attach(), the ring is remapped if it changes
+  uint32_t slotCount_;
+  uint32_t slotSize_;
+
+  bool attach();
+  void detach();
+  bool isValid() const;
+
+public:
+  ShmJobBusReader(const string &name);
+  ~ShmJobBusReader();
+
+  // Returns true and fills `msg` with the next message, or returns false
+  // after `timeoutMs` if nothing was published (or the bus does not exist
+  // yet, the reader keeps trying to attach it).
+  bool read(string &msg, int timeoutMs);
+
+  const string &name() const { return name_; }
+  bool isAttached() const { return header_ != nullptr; }
+};
+
+#endif // SHM_JOB_BUS_H_
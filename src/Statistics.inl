@@ -28,21 +28,21 @@
 template <typename T>
 StatsWindow<T>::StatsWindow(const int windowSize)
   : maxRingIdx_(-1)
-  , windowSize_(windowSize)
-  , elements_(windowSize) {
+  , windowSize_(windowSize) {
+  // elements_ is allocated by the first insert, many windows never get one
 }
 
 template <typename T>
 void StatsWindow<T>::mapMultiply(const T val) {
-  for (int32_t i = 0; i < windowSize_; i++) {
-    elements_[i] *= val;
+  for (auto &element : elements_) {
+    element *= val;
   }
 }
 
 template <typename T>
 void StatsWindow<T>::mapDivide(const T val) {
-  for (int32_t i = 0; i < windowSize_; i++) {
-    elements_[i] /= val;
+  for (auto &element : elements_) {
+    element /= val;
   }
 }
 
@@ -78,7 +78,7 @@ template <typename T>
 T StatsWindow<T>::sum(int64_t beginRingIdx, int len) {
   T sum = 0;
   len = std::min(len, windowSize_);
-  if (len <= 0 || beginRingIdx - len >= maxRingIdx_) {
+  if (len <= 0 || elements_.empty() || beginRingIdx - len >= maxRingIdx_) {
     return 0;
   }
   int64_t endRingIdx = beginRingIdx - len;
@@ -114,7 +114,7 @@ void StratumWorker::resetNames() {
   workerHashId_ = 0;
 
   fullName_.clear();
-  userName_.clear();
+  userName_ = InternedString();
   workerName_.clear();
 }
 
@@ -135,16 +135,17 @@ void StratumWorker::setChainIdAndUserId(
 void StratumWorker::setNames(const string &fullName) {
   resetNames();
 
+  string userName;
   auto pos = fullName.find(".");
   if (pos == fullName.npos) {
-    userName_ = fullName;
+    userName = fullName;
   } else {
-    userName_ = fullName.substr(0, pos);
+    userName = fullName.substr(0, pos);
     workerName_ = fullName.substr(pos + 1);
   }
 
   // the user name and worker name will insert to DB, so must be filter
-  userName_ = filterWorkerName(userName_);
+  userName_ = filterWorkerName(userName);
   workerName_ = filterWorkerName(workerName_);
 
   // max length for worker name is 20
@@ -157,7 +158,7 @@ void StratumWorker::setNames(const string &fullName) {
   }
 
   workerHashId_ = calcWorkerId(workerName_);
-  fullName_ = userName_ + "." + workerName_;
+  fullName_ = userName_.str() + "." + workerName_;
 }
 
 int64_t StratumWorker::calcWorkerId(const string &workerName) {
@@ -27,6 +27,9 @@
 #include "Common.h"
 #include "Utils.h"
 #include "Network.h"
+#include "InternedString.h"
+
+#include <algorithm>
 
 // default worker name
 #define DEFAULT_WORKER_NAME "__default__"
@@ -124,7 +127,7 @@ public:
   int64_t workerHashId_; // substr(0, 8, HASH(wokerName))
 
   string fullName_; // fullName = username.workername
-  string userName_;
+  InternedString userName_; // shared by the workers of the user
   string workerName_; // workername, max is: 20
 
   void resetNames();
@@ -223,19 +226,58 @@ struct LocalShare {
     }
     return false;
   }
+
+  bool operator==(const LocalShare &r) const {
+    return exNonce2_ == r.exNonce2_ && nonce_ == r.nonce_ && time_ == r.time_ &&
+        versionMask_ == r.versionMask_;
+  }
 };
 
+namespace std {
+template <>
+struct hash<LocalShare> {
+public:
+  size_t operator()(const LocalShare &s) const {
+    uint64_t h = s.exNonce2_ ^
+        (((uint64_t)s.nonce_ << 32) | s.time_) * 0x9e3779b97f4a7c15ULL;
+    h ^= (uint64_t)s.versionMask_ * 0xc2b2ae3d27d4eb4fULL;
+    return h ^ (h >> 29);
+  }
+};
+} // namespace std
+
 struct LocalJob {
+  // A flat vector is much smaller than a hash set for the few shares of a
+  // miner, but an agent puts the shares of all its miners into one job:
+  // past kMaxFlatShares they move to a hash set.
+  static const size_t kMaxFlatShares = 64;
+
   size_t chainId_;
   uint64_t jobId_;
-  std::set<LocalShare> submitShares_;
+  std::vector<LocalShare> submitShares_;
+  std::unique_ptr<std::unordered_set<LocalShare>> manyShares_;
 
   LocalJob(size_t chainId, uint64_t jobId)
     : chainId_(chainId)
     , jobId_(jobId) {}
 
   bool addLocalShare(const LocalShare &localShare) {
-    return submitShares_.insert(localShare).second;
+    if (manyShares_) {
+      return manyShares_->insert(localShare).second;
+    }
+    if (std::find(submitShares_.begin(), submitShares_.end(), localShare) !=
+        submitShares_.end()) {
+      return false;
+    }
+    if (submitShares_.size() < kMaxFlatShares) {
+      submitShares_.push_back(localShare);
+      return true;
+    }
+    manyShares_ = std::make_unique<std::unordered_set<LocalShare>>(
+        submitShares_.begin(), submitShares_.end());
+    manyShares_->insert(localShare);
+    std::vector<LocalShare>().swap(submitShares_);
+    return true;
   }
 };
 
@@ -22,6 +22,7 @@
  THE SOFTWARE.
  */
 #include "StratumClient.h"
+#include "StratumSession.h"
 #include "Utils.h"
 #include "ssl/SSLUtils.h"
 
@@ -31,13 +32,39 @@
 #include <signal.h>
 #include <event2/bufferevent_ssl.h>
 
+#include <libconfig.h++>
+
 #include <random>
 
+using std::chrono::steady_clock;
+
 static map<string, StratumClient::Factory> gStratumClientFactories;
 bool StratumClient::registerFactory(const string &chainType, Factory factory) {
   return gStratumClientFactories.emplace(chainType, move(factory)).second;
 }
 
+//////////////////////////// StratumClientLatencies ////////////////////////////
+StratumClientLatencies::StratumClientLatencies() {
+  // 10us to about 80s, 8 buckets per doubling (9% apart)
+  for (int i = 0; i < NUM_REQUESTS; i++) {
+    histograms_.emplace_back(
+        prometheus::Histogram::ExponentialBounds(0.00001, pow(2, 0.125), 184));
+  }
+}
+
+const char *StratumClientLatencies::Name(Request request) {
+  switch (request) {
+  case SUBSCRIBE:
+    return "subscribe";
+  case AUTHORIZE:
+    return "authorize";
+  case SUBMIT:
+    return "submit";
+  default:
+    return "unknown";
+  }
+}
+
 ///////////////////////////////// StratumClient ////////////////////////////////
 StratumClient::StratumClient(
     bool enableTLS,
@@ -47,7 +74,8 @@ StratumClient::StratumClient(
   : enableTLS_(enableTLS)
   , workerFullName_(workerFullName)
   , workerPasswd_(workerPasswd)
-  , isMining_(false) {
+  , isMining_(false)
+  , latencies_(nullptr) {
   inBuf_ = evbuffer_new();
 
   evdnsBase_ = evdns_base_new(base, 1);
@@ -118,6 +146,7 @@ bool StratumClient::connect(const string &host, uint16_t port) {
 }
 
 void StratumClient::sendHelloData() {
+  requestSent(StratumClientLatencies::SUBSCRIBE);
   sendData(
       "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[\"__simulator__/"
       "0.1\"]}\n");
@@ -127,10 +156,62 @@ void StratumClient::readBuf(struct evbuffer *buf) {
   // moves all data from src to the end of dst
   evbuffer_add_buffer(inBuf_, buf);
 
-  string line;
-  while (tryReadLine(line)) {
-    handleLine(line);
+  // ex-messages of BTCAgent sessions come between the lines
+  string message;
+  uint8_t magic;
+  while (evbuffer_copyout(inBuf_, &magic, 1) == 1) {
+    if (magic == StratumMessageEx::CMD_MAGIC_NUMBER) {
+      if (!tryReadExMessage(message)) {
+        break;
+      }
+      handleExMessage(message);
+    } else {
+      if (!tryReadLine(message)) {
+        break;
+      }
+      handleLine(message);
+    }
+  }
+}
+
+bool StratumClient::tryReadExMessage(string &exMessage) {
+  // | magic_number(1) | cmd(1) | len (2) | ...
+  uint8_t header[4];
+  if (evbuffer_copyout(inBuf_, header, 4) < 4) {
+    return false;
+  }
+  size_t len = header[2] | (header[3] << 8);
+  if (len < 4) {
+    len = 4; // broken, drop the header
+  }
+  if (evbuffer_get_length(inBuf_) < len) {
+    return false;
+  }
+  exMessage.resize(len);
+  evbuffer_remove(inBuf_, (void *)exMessage.data(), len);
+  return true;
+}
+
+void StratumClient::requestSent(StratumClientLatencies::Request request) {
+  if (latencies_ == nullptr) {
+    return;
+  }
+  // a server not responding to something
+  if (pendingRequests_.size() >= kMaxPendingRequests) {
+    pendingRequests_.pop_front();
+  }
+  pendingRequests_.emplace_back(request, steady_clock::now());
+}
+
+void StratumClient::responseReceived() {
+  if (latencies_ == nullptr || pendingRequests_.empty()) {
+    return;
   }
+  auto &request = pendingRequests_.front();
+  latencies_->histograms_[request.first].observe(
+      std::chrono::duration<double>(steady_clock::now() - request.second)
+          .count());
+  pendingRequests_.pop_front();
 }
 
 bool StratumClient::tryReadLine(string &line) {
@@ -177,6 +258,7 @@ void StratumClient::handleLine(const string &line) {
     }
     return;
   }
+  responseReceived();
 
   if (state_ == AUTHENTICATED) {
     //
@@ -218,6 +300,7 @@ void StratumClient::handleLine(const string &line) {
         "\"params\": [\"\%s\", \"%s\"]}\n",
         workerFullName_,
         workerPasswd_);
+    requestSent(StratumClientLatencies::AUTHORIZE);
     sendData(s);
     return;
   }
@@ -250,7 +333,9 @@ void StratumClient::submitShare() {
   if (state_ != AUTHENTICATED)
     return;
 
-  sendData(constructShare());
+  string share = constructShare();
+  requestSent(StratumClientLatencies::SUBMIT);
+  sendData(share);
 }
 
 void StratumClient::sendData(const char *data, size_t len) {
@@ -259,6 +344,96 @@ void StratumClient::sendData(const char *data, size_t len) {
   DLOG(INFO) << "send(" << len << "): " << data;
 }
 
+////////////////////////////// StratumClientAgent //////////////////////////////
+StratumClientAgent::StratumClientAgent(
+    bool enableTLS,
+    struct event_base *base,
+    const string &workerFullName,
+    const string &workerPasswd,
+    const libconfig::Config &config)
+  : StratumClient(enableTLS, base, workerFullName, workerPasswd)
+  , numWorkers_(100)
+  , registered_(false)
+  , gen_(std::random_device()()) {
+  config.lookupValue("simulator.agent_workers", numWorkers_);
+  numWorkers_ = std::max<uint32_t>(
+      1,
+      std::min<uint32_t>(
+          numWorkers_, StratumMessageEx::AGENT_MAX_SESSION_ID + 1));
+}
+
+void StratumClientAgent::sendHelloData() {
+  requestSent(StratumClientLatencies::SUBSCRIBE);
+  sendData(
+      "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[\"btccom-agent/"
+      "__simulator__\"]}\n");
+}
+
+void StratumClientAgent::handleLine(const string &line) {
+  StratumClient::handleLine(line);
+  if (state_ == AUTHENTICATED && !registered_) {
+    registerWorkers();
+    registered_ = true;
+  }
+}
+
+void StratumClientAgent::registerWorkers() {
+  //
+  // REGISTER_WORKER:
+  // | magic_number(1) | cmd(1) | len (2) | session_id(2) | clientAgent |
+  // worker_name |
+  //
+  auto pos = workerFullName_.find('.');
+  string prefix = pos == string::npos ? workerFullName_
+                                      : workerFullName_.substr(pos + 1);
+  string exMessage;
+  for (uint32_t sessionId = 0; sessionId < numWorkers_; sessionId++) {
+    string body;
+    body.push_back(sessionId & 0xff);
+    body.push_back(sessionId >> 8);
+    body.append("__simulator__");
+    body.push_back('\0');
+    body.append(Strings::Format("%s-%05u", prefix, sessionId));
+    body.push_back('\0');
+    uint16_t len = 4 + body.size();
+    exMessage.push_back(StratumMessageEx::CMD_MAGIC_NUMBER);
+    exMessage.push_back((char)StratumCommandEx::REGISTER_WORKER);
+    exMessage.push_back(len & 0xff);
+    exMessage.push_back(len >> 8);
+    exMessage.append(body);
+  }
+  sendData(exMessage);
+}
+
+void StratumClientAgent::submitShare() {
+  if (state_ != AUTHENTICATED || !registered_)
+    return;
+
+  //
+  // SUBMIT_SHARE:
+  // | magic_number(1) | cmd(1) | len (2) | jobId (uint8_t) |
+  // session_id (uint16_t) | extra_nonce2 (uint32_t) | nNonce (uint32_t) |
+  //
+  // The server does not respond to it.
+  //
+  uint16_t sessionId = gen_() % numWorkers_;
+  uint32_t exNonce2 = (uint32_t)++extraNonce2_;
+  uint32_t nonce = (uint32_t)time(nullptr);
+  uint8_t exMessage[15] = {
+      StratumMessageEx::CMD_MAGIC_NUMBER,
+      (uint8_t)StratumCommandEx::SUBMIT_SHARE,
+      15,
+      0,
+      (uint8_t)strtoul(latestJobId_.c_str(), nullptr, 10),
+      (uint8_t)(sessionId & 0xff),
+      (uint8_t)(sessionId >> 8)};
+  for (int i = 0; i < 4; i++) {
+    exMessage[7 + i] = (exNonce2 >> (8 * i)) & 0xff;
+    exMessage[11 + i] = (nonce >> (8 * i)) & 0xff;
+  }
+  sendData((const char *)exMessage, sizeof(exMessage));
+}
+
 ////////////////////////////// StratumClientWrapper ////////////////////////////
 StratumClientWrapper::StratumClientWrapper(
     bool enableTLS,
@@ -274,37 +449,81 @@ StratumClientWrapper::StratumClientWrapper(
   , enableTLS_(enableTLS)
   , host_(host)
   , port_(port)
-  , base_(event_base_new())
+  , reportTimer_(nullptr)
+  , sigterm_(nullptr)
+  , sigint_(nullptr)
   , numConnections_(numConnections)
   , userName_(userName)
   , minerNamePrefix_(minerNamePrefix)
   , passwd_(passwd)
   , type_(type)
-  , config_(config) {
+  , config_(config)
+  , numThreads_(1)
+  , shareInterval_(15)
+  , churnInterval_(0)
+  , reportInterval_(10)
+  , submitted_(0)
+  , reconnected_(0)
+  , lastSubmitted_(0)
+  , lastReconnected_(0) {
 
   if (minerNamePrefix_.empty())
     minerNamePrefix_ = "simulator";
+
+  config_.lookupValue("simulator.threads", numThreads_);
+  config_.lookupValue("simulator.share_interval", shareInterval_);
+  config_.lookupValue("simulator.churn_interval", churnInterval_);
+  config_.lookupValue("simulator.report_interval", reportInterval_);
+  if (numThreads_ < 1) {
+    numThreads_ = 1;
+  }
+  if (shareInterval_ <= 0) {
+    LOG(FATAL) << "simulator.share_interval should be > 0";
+  }
+
+  std::random_device rd;
+  for (size_t i = 0; i < numThreads_; i++) {
+    auto loop = std::make_unique<Loop>();
+    loop->wrapper_ = this;
+    loop->base_ = event_base_new();
+    loop->gen_.seed(rd());
+    loops_.push_back(move(loop));
+  }
 }
 
 StratumClientWrapper::~StratumClientWrapper() {
   stop();
 
-  event_free(sigint_);
-  event_free(sigterm_);
-  event_free(timer_);
+  if (sigint_)
+    event_free(sigint_);
+  if (sigterm_)
+    event_free(sigterm_);
+  if (reportTimer_)
+    event_free(reportTimer_);
 
-  // It has to be cleared here to free client events before event base
-  connections_.clear();
+  for (auto &loop : loops_) {
+    if (loop->thread_.joinable()) {
+      loop->thread_.join();
+    }
+    if (loop->shareTimer_)
+      event_free(loop->shareTimer_);
+    if (loop->churnTimer_)
+      event_free(loop->churnTimer_);
 
-  event_base_free(base_);
+    // It has to be cleared here to free client events before event base
+    loop->connections_.clear();
+
+    event_base_free(loop->base_);
+  }
 }
 
 void StratumClientWrapper::stop() {
-  if (!running_)
+  if (!running_.exchange(false))
     return;
 
-  running_ = false;
-  event_base_loopexit(base_, NULL);
+  for (auto &loop : loops_) {
+    event_base_loopexit(loop->base_, NULL);
+  }
 
   LOG(INFO) << "StratumClientWrapper::stop...";
 }
@@ -331,10 +550,22 @@ void StratumClientWrapper::readCallback(
   client->readBuf(bufferevent_get_input(bev));
 }
 
-void StratumClientWrapper::timerCallback(
+void StratumClientWrapper::shareTimerCallback(
+    evutil_socket_t fd, short event, void *ptr) {
+  auto loop = static_cast<Loop *>(ptr);
+  loop->wrapper_->submitShares(*loop);
+}
+
+void StratumClientWrapper::churnTimerCallback(
+    evutil_socket_t fd, short event, void *ptr) {
+  auto loop = static_cast<Loop *>(ptr);
+  loop->wrapper_->churnConnections(*loop);
+}
+
+void StratumClientWrapper::reportTimerCallback(
     evutil_socket_t fd, short event, void *ptr) {
   auto wrapper = static_cast<StratumClientWrapper *>(ptr);
-  wrapper->submitShares();
+  wrapper->report(false);
 }
 
 void StratumClientWrapper::signalCallback(
@@ -343,64 +574,198 @@ void StratumClientWrapper::signalCallback(
   wrapper->stop();
 }
 
+bool StratumClientWrapper::connect(Loop &loop, size_t index) {
+  const string &workerFullName = loop.workerNames_[index];
+  auto client = createClient(enableTLS_, loop.base_, workerFullName, passwd_);
+  if (!client) {
+    LOG(ERROR) << "unknown simulator type: " << type_;
+    return false;
+  }
+  client->setLatencies(&latencies_);
+  if (!client->connect(host_, port_)) {
+    LOG(ERROR) << "client connnect failure: " << workerFullName;
+    return false;
+  }
+  loop.connections_[index] = move(client);
+  return true;
+}
+
+// the time of the next event of a Poisson process of the rate (per second)
+static steady_clock::time_point
+nextArrival(steady_clock::time_point last, double rate, std::mt19937_64 &gen) {
+  std::exponential_distribution<double> dis(rate);
+  return last +
+      std::chrono::duration_cast<steady_clock::duration>(
+             std::chrono::duration<double>(dis(gen)));
+}
+
+static void addTimer(struct event *timer, steady_clock::duration delay) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(delay);
+  if (us.count() < 0) {
+    us = std::chrono::microseconds(0);
+  }
+  struct timeval tv {
+    (time_t)(us.count() / 1000000), (suseconds_t)(us.count() % 1000000)
+  };
+  event_add(timer, &tv);
+}
+
 void StratumClientWrapper::run() {
   //
-  // create clients
+  // create clients, spread over the threads
   //
   for (size_t i = 0; i < numConnections_; i++) {
-    const string workerFullName =
-        Strings::Format("%s.%s-%05d", userName_, minerNamePrefix_, i);
-    auto client = createClient(enableTLS_, base_, workerFullName, passwd_);
-
-    if (!client->connect(host_, port_)) {
-      LOG(ERROR) << "client connnect failure: " << workerFullName;
+    auto &loop = *loops_[i % loops_.size()];
+    loop.workerNames_.push_back(
+        Strings::Format("%s.%s-%05d", userName_, minerNamePrefix_, i));
+    loop.connections_.emplace_back();
+    if (!connect(loop, loop.connections_.size() - 1)) {
       return;
     }
-    connections_.push_back(move(client));
-  }
-
-  // create timer
-  timer_ = event_new(
-      base_, -1, EV_PERSIST, StratumClientWrapper::timerCallback, this);
-  // Submit a share every 15 seconds (in probability) for each connection.
-  // After the timer is triggered, a connection will be randomly selected to
-  // submit a share.
-  int sleepTime = 15000000 / connections_.size();
-  struct timeval interval {
-    sleepTime / 1000000, sleepTime % 1000000
-  };
-  event_add(timer_, &interval);
+    loop.numWorkers_ += loop.connections_.back()->numWorkers();
+  }
+
+  // Every miner submits a share every share_interval seconds on average,
+  // and every connection is replaced every churn_interval seconds.
+  startTime_ = lastReportTime_ = steady_clock::now();
+  for (auto &loop : loops_) {
+    if (loop->connections_.empty()) {
+      continue;
+    }
+    loop->shareTimer_ = evtimer_new(
+        loop->base_, StratumClientWrapper::shareTimerCallback, loop.get());
+    loop->nextShare_ = nextArrival(
+        startTime_, loop->numWorkers_ / shareInterval_, loop->gen_);
+    addTimer(loop->shareTimer_, loop->nextShare_ - startTime_);
+
+    if (churnInterval_ > 0) {
+      loop->churnTimer_ = evtimer_new(
+          loop->base_, StratumClientWrapper::churnTimerCallback, loop.get());
+      loop->nextChurn_ = nextArrival(
+          startTime_, loop->connections_.size() / churnInterval_, loop->gen_);
+      addTimer(loop->churnTimer_, loop->nextChurn_ - startTime_);
+    }
+  }
+
+  // reports and signals are handled by the first loop
+  auto base = loops_[0]->base_;
+  for (size_t i = 0; i < StratumClientLatencies::NUM_REQUESTS; i++) {
+    lastReport_.push_back(latencies_.histograms_[i].snapshot());
+  }
+  if (reportInterval_ > 0) {
+    reportTimer_ = event_new(
+        base, -1, EV_PERSIST, StratumClientWrapper::reportTimerCallback, this);
+    struct timeval interval {
+      (time_t)reportInterval_, 0
+    };
+    event_add(reportTimer_, &interval);
+  }
 
   // create signals
   sigterm_ = event_new(
-      base_,
+      base,
       SIGTERM,
       EV_SIGNAL | EV_PERSIST,
       StratumClientWrapper::signalCallback,
       this);
   event_add(sigterm_, nullptr);
   sigint_ = event_new(
-      base_,
+      base,
       SIGINT,
       EV_SIGNAL | EV_PERSIST,
       StratumClientWrapper::signalCallback,
       this);
   event_add(sigint_, nullptr);
 
-  // event loop
-  event_base_dispatch(base_);
+  // event loops
+  for (size_t i = 1; i < loops_.size(); i++) {
+    auto loop = loops_[i].get();
+    loop->thread_ = std::thread([loop]() { event_base_dispatch(loop->base_); });
+  }
+  event_base_dispatch(base);
+  stop();
+  for (auto &loop : loops_) {
+    if (loop->thread_.joinable()) {
+      loop->thread_.join();
+    }
+  }
 
+  report(true);
   LOG(INFO) << "StratumClientWrapper::run() stop";
 }
 
-void StratumClientWrapper::submitShares() {
-  // randomly select a connection to submit a share.
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  static std::uniform_int_distribution<size_t> dis(0, connections_.size() - 1);
+void StratumClientWrapper::submitShares(Loop &loop) {
+  // Submit all shares due by now, a slow server does not slow them down.
+  std::uniform_int_distribution<size_t> dis(0, loop.connections_.size() - 1);
+  auto now = steady_clock::now();
+  double rate = loop.numWorkers_ / shareInterval_;
+  while (loop.nextShare_ <= now) {
+    auto &client = loop.connections_[dis(loop.gen_)];
+    if (client) {
+      client->submitShare();
+      submitted_++;
+    }
+    loop.nextShare_ = nextArrival(loop.nextShare_, rate, loop.gen_);
+  }
+  addTimer(loop.shareTimer_, loop.nextShare_ - now);
+}
+
+void StratumClientWrapper::churnConnections(Loop &loop) {
+  std::uniform_int_distribution<size_t> dis(0, loop.connections_.size() - 1);
+  auto now = steady_clock::now();
+  double rate = loop.connections_.size() / churnInterval_;
+  while (loop.nextChurn_ <= now) {
+    size_t index = dis(loop.gen_);
+    // closed before the new one connects
+    loop.connections_[index].reset();
+    connect(loop, index);
+    reconnected_++;
+    loop.nextChurn_ = nextArrival(loop.nextChurn_, rate, loop.gen_);
+  }
+  addTimer(loop.churnTimer_, loop.nextChurn_ - now);
+}
 
-  size_t i = dis(gen);
-  connections_[i]->submitShare();
+void StratumClientWrapper::report(bool final) {
+  auto now = steady_clock::now();
+  auto since = final ? startTime_ : lastReportTime_;
+  double seconds = std::chrono::duration<double>(now - since).count();
+
+  uint64_t submitted = submitted_;
+  uint64_t reconnected = reconnected_;
+  uint64_t shares = submitted - (final ? 0 : lastSubmitted_);
+  uint64_t reconnections = reconnected - (final ? 0 : lastReconnected_);
+  lastSubmitted_ = submitted;
+  lastReconnected_ = reconnected;
+
+  LOG(INFO) << Strings::Format(
+      "%s %.1fs: submitted %u shares, %.1f/s, reconnected %u connections, "
+      "%.1f/s",
+      final ? "total" : "last",
+      seconds,
+      shares,
+      shares / seconds,
+      reconnections,
+      reconnections / seconds);
+  for (size_t i = 0; i < StratumClientLatencies::NUM_REQUESTS; i++) {
+    auto snapshot = latencies_.histograms_[i].snapshot();
+    auto interval = final ? snapshot : snapshot.since(lastReport_[i]);
+    lastReport_[i] = snapshot;
+    if (interval.count == 0) {
+      continue;
+    }
+    LOG(INFO) << Strings::Format(
+        "  %-9s %9u, %10.1f/s, mean %8.3fms, p50 %8.3fms, p90 %8.3fms, "
+        "p99 %8.3fms, p99.9 %8.3fms",
+        StratumClientLatencies::Name((StratumClientLatencies::Request)i),
+        interval.count,
+        interval.count / seconds,
+        interval.sum / interval.count * 1000,
+        interval.quantile(0.5) * 1000,
+        interval.quantile(0.9) * 1000,
+        interval.quantile(0.99) * 1000,
+        interval.quantile(0.999) * 1000);
+  }
+  lastReportTime_ = now;
 }
 
 unique_ptr<StratumClient> StratumClientWrapper::createClient(
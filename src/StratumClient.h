@@ -28,7 +28,10 @@
 
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <chrono>
 #include <deque>
+#include <random>
+#include <thread>
 #include <vector>
 
 #include <event2/event.h>
@@ -40,6 +43,7 @@
 #include <arith_uint256.h>
 #include <uint256.h>
 #include "utilities_js.hpp"
+#include "prometheus/Histogram.h"
 
 #include <type_traits>
 
@@ -47,6 +51,17 @@ namespace libconfig {
 class Config;
 }
 
+// Round-trip times of the requests of simulated miners, in seconds.
+// Shared by the clients of all threads.
+struct StratumClientLatencies {
+  enum Request { SUBSCRIBE = 0, AUTHORIZE = 1, SUBMIT = 2, NUM_REQUESTS = 3 };
+
+  StratumClientLatencies();
+  static const char *Name(Request request);
+
+  std::vector<prometheus::Histogram> histograms_; // by Request
+};
+
 ///////////////////////////////// StratumClient ////////////////////////////////
 class StratumClient {
 protected:
@@ -64,8 +79,21 @@ protected:
   string latestJobId_;
   uint64_t latestDiff_;
 
+  // Requests in the order they were sent, the server responds to them in
+  // the same order. Only tracked with latencies_ set.
+  static const size_t kMaxPendingRequests = 1024;
+  std::deque<std::pair<
+      StratumClientLatencies::Request,
+      std::chrono::steady_clock::time_point>>
+      pendingRequests_;
+  StratumClientLatencies *latencies_;
+
   bool tryReadLine(string &line);
+  bool tryReadExMessage(string &exMessage);
   virtual void handleLine(const string &line);
+  virtual void handleExMessage(const string &exMessage) {}
+  void requestSent(StratumClientLatencies::Request request);
+  void responseReceived();
 
 public:
   // mining state
@@ -127,18 +155,68 @@ public:
   inline void sendData(const string &str) { sendData(str.data(), str.size()); }
 
   void readBuf(struct evbuffer *buf);
-  void submitShare();
+  virtual void submitShare();
   virtual string constructShare();
+
+  // miners submitting shares through this connection
+  virtual size_t numWorkers() const { return 1; }
+  void setLatencies(StratumClientLatencies *latencies) {
+    latencies_ = latencies;
+  }
+};
+
+////////////////////////////// StratumClientAgent //////////////////////////////
+// A BTCAgent with simulator.agent_workers miners behind it, which are
+// registered and submit their shares with ex-messages.
+class StratumClientAgent : public StratumClient {
+public:
+  StratumClientAgent(
+      bool enableTLS,
+      struct event_base *base,
+      const string &workerFullName,
+      const string &workerPasswd,
+      const libconfig::Config &config);
+
+  void sendHelloData() override;
+  void submitShare() override;
+  size_t numWorkers() const override { return numWorkers_; }
+
+protected:
+  void handleLine(const string &line) override;
+  void registerWorkers();
+
+  uint32_t numWorkers_;
+  bool registered_;
+  std::mt19937 gen_;
 };
 
 ////////////////////////////// StratumClientWrapper ////////////////////////////
+//
+// Open loop: shares and reconnections arrive as Poisson processes of the
+// configured rates whatever the server does, the connections are spread over
+// simulator.threads event loops.
+//
 class StratumClientWrapper {
-  bool running_;
+  // an event loop thread and its connections
+  struct Loop {
+    StratumClientWrapper *wrapper_ = nullptr;
+    struct event_base *base_ = nullptr;
+    struct event *shareTimer_ = nullptr;
+    struct event *churnTimer_ = nullptr;
+    std::vector<unique_ptr<StratumClient>> connections_;
+    std::vector<string> workerNames_; // of the connections
+    size_t numWorkers_ = 0;
+    std::chrono::steady_clock::time_point nextShare_;
+    std::chrono::steady_clock::time_point nextChurn_;
+    std::mt19937_64 gen_;
+    std::thread thread_;
+  };
+
+  std::atomic<bool> running_;
   bool enableTLS_;
   string host_;
   uint16_t port_;
-  struct event_base *base_;
-  struct event *timer_;
+  struct event *reportTimer_;
   struct event *sigterm_;
   struct event *sigint_;
   uint32_t numConnections_;
@@ -147,9 +225,26 @@ class StratumClientWrapper {
   string passwd_; // miner password, used to set difficulty
   string type_;
   const libconfig::Config &config_;
-  std::vector<unique_ptr<StratumClient>> connections_;
 
-  void submitShares();
+  uint32_t numThreads_;
+  double shareInterval_; // seconds between two shares of a miner
+  double churnInterval_; // seconds a connection lasts, 0 to keep them
+  uint32_t reportInterval_; // seconds
+  std::vector<unique_ptr<Loop>> loops_;
+  StratumClientLatencies latencies_;
+  std::chrono::steady_clock::time_point startTime_;
+  std::chrono::steady_clock::time_point lastReportTime_;
+  std::vector<prometheus::Histogram::Snapshot> lastReport_;
+  std::atomic<uint64_t> submitted_;
+  std::atomic<uint64_t> reconnected_;
+  // at the last report
+  uint64_t lastSubmitted_;
+  uint64_t lastReconnected_;
+
+  void submitShares(Loop &loop);
+  void churnConnections(Loop &loop);
+  bool connect(Loop &loop, size_t index);
+  void report(bool final);
 
 public:
   StratumClientWrapper(
@@ -166,7 +261,9 @@ public:
 
   static void readCallback(struct bufferevent *bev, void *connection);
   static void eventCallback(struct bufferevent *bev, short events, void *ptr);
-  static void timerCallback(evutil_socket_t fd, short event, void *ptr);
+  static void shareTimerCallback(evutil_socket_t fd, short event, void *ptr);
+  static void churnTimerCallback(evutil_socket_t fd, short event, void *ptr);
+  static void reportTimerCallback(evutil_socket_t fd, short event, void *ptr);
   static void signalCallback(evutil_socket_t fd, short event, void *ptr);
 
   void stop();
@@ -28,6 +28,7 @@
 #include "StratumServer.h"
 #include "StratumMiner.h"
 #include "DiffController.h"
+#include "VardiffEngine.h"
 
 #include <glog/logging.h>
 
@@ -155,8 +156,8 @@ StratumMessageAgentDispatcher::StratumMessageAgentDispatcher(
 }
 
 StratumMessageAgentDispatcher::~StratumMessageAgentDispatcher() {
-  while (!miners_.empty()) {
-    unregisterWorker(miners_.begin()->first);
+  while (!sessionIds_.empty()) {
+    unregisterWorker(sessionIds_.back());
   }
 }
 
@@ -191,14 +192,14 @@ void StratumMessageAgentDispatcher::handleExMessage(const string &exMessage) {
 }
 
 void StratumMessageAgentDispatcher::setMinDiff(uint64_t minDiff) {
-  for (auto &p : miners_) {
-    p.second->setMinDiff(minDiff);
+  for (auto sessionId : sessionIds_) {
+    miners_[sessionId].miner_->setMinDiff(minDiff);
   }
 }
 
 void StratumMessageAgentDispatcher::resetCurDiff(uint64_t curDiff) {
-  for (auto &p : miners_) {
-    p.second->resetCurDiff(curDiff);
+  for (auto sessionId : sessionIds_) {
+    miners_[sessionId].miner_->resetCurDiff(curDiff);
   }
 }
 
@@ -209,17 +210,33 @@ void StratumMessageAgentDispatcher::addLocalJob(LocalJob &localJob) {
     curDiff_ = agentDiff;
   }
 
-  map<uint8_t, vector<uint16_t>> newDiffs;
-  for (auto &p : miners_) {
-    uint64_t curDiff = p.second->getCurDiff();
-    uint8_t oldDiff = curDiff ? log2(curDiff) : 0;
-    uint8_t newDiff = log2(p.second->addLocalJob(localJob));
-    if (newDiff != oldDiff) {
-      newDiffs[newDiff].push_back(p.first);
+  // the difficulties of all the miners in one pass, taken by their
+  // addLocalJob() below
+  if (!sessionIds_.empty()) {
+    auto &vardiff = miners_[sessionIds_[0]].miner_->getVardiffEngine();
+    vardiffSlots_.clear();
+    for (auto sessionId : sessionIds_) {
+      auto &miner = *miners_[sessionId].miner_;
+      if (&miner.getVardiffEngine() == &vardiff) {
+        vardiffSlots_.push_back(miner.getVardiffSlot());
+      }
+    }
+    vardiff.calcCurDiffs(
+        vardiffSlots_.data(), vardiffSlots_.size(), time(nullptr));
+  }
+
+  bool moved = false;
+  for (auto sessionId : sessionIds_) {
+    auto &slot = miners_[sessionId];
+    uint8_t newDiff = log2(slot.miner_->addLocalJob(localJob));
+    if (newDiff != slot.diffExp_) {
+      slot.diffExp_ = newDiff;
+      diffChanges_[newDiff].push_back(sessionId);
+      moved = true;
     }
   }
 
-  if (!newDiffs.empty()) {
+  if (moved) {
     //
     // CMD_MINING_SET_DIFF:
     // | magic_number(1) | cmd(1) | len (2) | diff_2_exp(1) | count(2) |
@@ -230,37 +247,39 @@ void StratumMessageAgentDispatcher::addLocalJob(LocalJob &localJob) {
     //     65535 -1-1-2-1-2 = 65,528
     //     65,528 / 2 = 32,764
     //
-    string data;
-    getSetDiffCommand(newDiffs, data);
-    session_.sendData(data);
+    setDiffMessage_.clear();
+    for (uint8_t diffExp = 0; diffExp < 64; diffExp++) {
+      auto &sessionIds = diffChanges_[diffExp];
+      if (!sessionIds.empty()) {
+        appendSetDiffCommand(diffExp, sessionIds, setDiffMessage_);
+        sessionIds.clear();
+      }
+    }
+    session_.sendData(setDiffMessage_);
   }
 }
 
 void StratumMessageAgentDispatcher::removeLocalJob(LocalJob &localJob) {
-  for (auto &p : miners_) {
-    p.second->removeLocalJob(localJob);
+  for (auto sessionId : sessionIds_) {
+    miners_[sessionId].miner_->removeLocalJob(localJob);
   }
 }
 
 void StratumMessageAgentDispatcher::beforeSwitchChain() {
   // remove worker from the old chain
-  for (auto &itr : miners_) {
-    auto &miner = itr.second;
-    if (miner) {
-      session_.removeWorker(
-          miner->clientAgent(), miner->workerName(), miner->workerId());
-    }
+  for (auto sessionId : sessionIds_) {
+    auto &miner = miners_[sessionId].miner_;
+    session_.removeWorker(
+        miner->clientAgent(), miner->workerName(), miner->workerId());
   }
 }
 
 void StratumMessageAgentDispatcher::afterSwitchChain() {
   // add worker to the new chain
-  for (auto &itr : miners_) {
-    auto &miner = itr.second;
-    if (miner) {
-      session_.addWorker(
-          miner->clientAgent(), miner->workerName(), miner->workerId());
-    }
+  for (auto sessionId : sessionIds_) {
+    auto &miner = miners_[sessionId].miner_;
+    session_.addWorker(
+        miner->clientAgent(), miner->workerName(), miner->workerId());
   }
 }
 
@@ -324,9 +343,8 @@ void StratumMessageAgentDispatcher::handleExMessage_SessionSpecific(
   // | magic_number(1) | cmd(1) | len (2) | ... | session_id(2) | ...
   //
   auto sessionId = session_.decodeSessionId(exMessage);
-  auto iter = miners_.find(sessionId);
-  if (iter != miners_.end()) {
-    iter->second->handleExMessage(exMessage);
+  if (sessionId < miners_.size() && miners_[sessionId].miner_) {
+    miners_[sessionId].miner_->handleExMessage(exMessage);
   }
 }
 
@@ -338,23 +356,51 @@ void StratumMessageAgentDispatcher::registerWorker(
   DLOG(INFO) << "[agent] clientAgent: " << clientAgent
              << ", workerName: " << workerName << ", workerId: " << workerId
              << ", session id:" << sessionId;
-  miners_.emplace(
-      sessionId, session_.createMiner(clientAgent, workerName, workerId));
+  auto miner = session_.createMiner(clientAgent, workerName, workerId);
+  if (sessionId >= miners_.size()) {
+    miners_.resize(sessionId + 1);
+  }
+  auto &slot = miners_[sessionId];
+  if (!slot.miner_ && miner) {
+    uint64_t curDiff = miner->getCurDiff();
+    slot.miner_ = move(miner);
+    slot.index_ = sessionIds_.size();
+    slot.diffExp_ = curDiff ? log2(curDiff) : 0;
+    sessionIds_.push_back(sessionId);
+  }
   session_.addWorker(clientAgent, workerName, workerId);
 }
 
 void StratumMessageAgentDispatcher::unregisterWorker(uint32_t sessionId) {
-  auto &miner = miners_[sessionId];
-  if (miner) {
-    session_.removeWorker(
-        miner->clientAgent(), miner->workerName(), miner->workerId());
+  if (sessionId >= miners_.size() || !miners_[sessionId].miner_) {
+    return;
   }
-  miners_.erase(sessionId);
+  auto &slot = miners_[sessionId];
+  auto &miner = slot.miner_;
+  session_.removeWorker(
+      miner->clientAgent(), miner->workerName(), miner->workerId());
+  miner.reset();
+
+  // move the last id to the hole
+  uint16_t lastId = sessionIds_.back();
+  sessionIds_[slot.index_] = lastId;
+  miners_[lastId].index_ = slot.index_;
+  sessionIds_.pop_back();
 }
 
 void StratumMessageAgentDispatcher::getSetDiffCommand(
     std::map<uint8_t, std::vector<uint16_t>> &diffSessionIds,
     std::string &exMessage) {
+  exMessage.clear();
+  for (auto &p : diffSessionIds) {
+    appendSetDiffCommand(p.first, p.second, exMessage);
+  }
+}
+
+void StratumMessageAgentDispatcher::appendSetDiffCommand(
+    uint8_t diffExp,
+    const std::vector<uint16_t> &sessionIds,
+    std::string &exMessage) {
   //
   // CMD_MINING_SET_DIFF:
   // | magic_number(1) | cmd(1) | len (2) | diff_2_exp(1) | count(2) |
@@ -366,44 +412,39 @@ void StratumMessageAgentDispatcher::getSetDiffCommand(
   //     65,528 / 2 = 32,764
   //
   static const size_t kMaxCount = 32764;
-  exMessage.clear();
 
-  for (auto &p : diffSessionIds) {
-    auto iter = p.second.begin();
-    auto iend = p.second.end();
-    while (iter != iend) {
-      size_t count = distance(iter, iend);
-      if (count > kMaxCount)
-        count = kMaxCount;
-
-      string buf;
-      uint16_t len = 1 + 1 + 2 + 1 + 2 + count * 2;
-      buf.resize(len);
-      auto start = &buf.front();
-      auto header = reinterpret_cast<StratumMessageExMiningSetDiff *>(start);
-
-      // cmd
-      header->magic = StratumMessageEx::CMD_MAGIC_NUMBER;
-      header->command = static_cast<uint8_t>(StratumCommandEx::MINING_SET_DIFF);
-
-      // len
-      header->length = len;
-
-      // diff, 2 exp
-      header->diffExp = p.first;
-
-      // count
-      header->count = count;
-      auto p = reinterpret_cast<boost::endian::little_uint16_buf_t *>(
-          start + 1 + 1 + 2 + 1 + 2);
-
-      // session ids
-      for (size_t j = 0; j < count; j++) {
-        *(p++) = *(iter++);
-      }
-
-      exMessage.append(buf);
-
-    } /* /while */
-  } /* /for */
+  auto iter = sessionIds.begin();
+  auto iend = sessionIds.end();
+  while (iter != iend) {
+    size_t count = distance(iter, iend);
+    if (count > kMaxCount)
+      count = kMaxCount;
+
+    // written in place, the caller's buffer keeps its capacity
+    uint16_t len = 1 + 1 + 2 + 1 + 2 + count * 2;
+    size_t offset = exMessage.size();
+    exMessage.resize(offset + len);
+    auto start = &exMessage[offset];
+    auto header = reinterpret_cast<StratumMessageExMiningSetDiff *>(start);
+
+    // cmd
+    header->magic = StratumMessageEx::CMD_MAGIC_NUMBER;
+    header->command = static_cast<uint8_t>(StratumCommandEx::MINING_SET_DIFF);
+
+    // len
+    header->length = len;
+
+    // diff, 2 exp
+    header->diffExp = diffExp;
+
+    // count
+    header->count = count;
+    auto p = reinterpret_cast<boost::endian::little_uint16_buf_t *>(
+        start + 1 + 1 + 2 + 1 + 2);
+
+    // session ids
+    for (size_t j = 0; j < count; j++) {
+      *(p++) = *(iter++);
+    }
+  } /* /while */
 }
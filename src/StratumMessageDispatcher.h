@@ -147,12 +147,32 @@ public:
   static void getSetDiffCommand(
       std::map<uint8_t, std::vector<uint16_t>> &diffSessionIds,
       std::string &exMessage);
+  static void appendSetDiffCommand(
+      uint8_t diffExp,
+      const std::vector<uint16_t> &sessionIds,
+      std::string &exMessage);
+  size_t getNumMiners() const { return sessionIds_.size(); }
 
 protected:
+  struct MinerSlot {
+    std::unique_ptr<StratumMiner> miner_;
+    uint32_t index_; // in sessionIds_
+    uint8_t diffExp_; // log2 of the difficulty the agent knows
+  };
+
   IStratumSession &session_;
   std::unique_ptr<DiffController> diffController_;
   uint64_t curDiff_;
-  std::map<uint16_t, std::unique_ptr<StratumMiner>> miners_;
+  // Indexed by session id and grown to the largest one, the ids of the
+  // registered miners are kept densely in sessionIds_ to walk them.
+  std::vector<MinerSlot> miners_;
+  std::vector<uint16_t> sessionIds_;
+  // The miners whose difficulty moved with a job, by the new log2
+  // difficulty, and the message telling the agent. Kept for the next job.
+  std::vector<uint16_t> diffChanges_[64];
+  std::string setDiffMessage_;
+  // the vardiff slots of the miners, recalculated together with a job
+  std::vector<uint32_t> vardiffSlots_;
 };
 
 #endif // #ifndef STRATUM_MESSAGE_DISPATCHER_H
@@ -26,6 +26,7 @@
 #include "StratumSession.h"
 #include "StratumServer.h"
 #include "DiffController.h"
+#include "VardiffEngine.h"
 #include "StratumMessageDispatcher.h"
 
 #include <boost/algorithm/string.hpp>
@@ -39,7 +40,8 @@ StratumMiner::StratumMiner(
     const string &workerName,
     int64_t workerId)
   : session_(session)
-  , diffController_(new DiffController(diffController))
+  , vardiff_(diffController.getVardiffEngine())
+  , vardiffSlot_(vardiff_->add())
   , curDiff_(0)
   , clientAgent_(clientAgent)
   , isNiceHashClient_(isNiceHashAgent(clientAgent))
@@ -48,19 +50,27 @@ StratumMiner::StratumMiner(
   , invalidSharesCounter_(INVALID_SHARE_SLIDING_WINDOWS_SIZE) {
 }
 
+StratumMiner::~StratumMiner() {
+  vardiff_->remove(vardiffSlot_);
+}
+
 void StratumMiner::setMinDiff(uint64_t minDiff) {
-  diffController_->setMinDiff(minDiff);
+  vardiff_->setMinDiff(vardiffSlot_, minDiff);
 }
 
 void StratumMiner::resetCurDiff(uint64_t curDiff) {
-  diffController_->resetCurDiff(curDiff);
+  vardiff_->resetCurDiff(vardiffSlot_, curDiff);
 }
 
 uint64_t StratumMiner::calcCurDiff() {
-  curDiff_ = diffController_->calcCurDiff();
+  curDiff_ = vardiff_->calcCurDiff(vardiffSlot_, time(nullptr));
   return curDiff_;
 }
 
+void StratumMiner::addAcceptedShare(uint64_t shareDiff) {
+  vardiff_->addAcceptedShare(vardiffSlot_, shareDiff, time(nullptr));
+}
+
 bool StratumMiner::handleShare(
     const std::string &idStr,
     int32_t status,
@@ -70,7 +80,7 @@ bool StratumMiner::handleShare(
   auto &dispatcher = session_.getDispatcher();
   bool accepted = StratumStatus::isAccepted(status);
   if (accepted) {
-    diffController_->addAcceptedShare(shareDiff);
+    addAcceptedShare(shareDiff);
   }
   if (accepted && (session_.acceptStale() || !StratumStatus::isStale(status))) {
     if (StratumStatus::isStale(status)) {
@@ -24,14 +24,17 @@
 #ifndef STRATUM_MINER_H_
 #define STRATUM_MINER_H_
 
+#include "InternedString.h"
 #include "Statistics.h"
 #include "utilities_js.hpp"
 
 #include <cstdint>
-#include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 
 class DiffController;
+class VardiffEngine;
 struct LocalJob;
 class IStratumSession;
 
@@ -52,7 +55,7 @@ public:
   static const size_t kExtraNonce1Size_ = 4;
   static const size_t kExtraNonce2Size_ = 8;
 
-  virtual ~StratumMiner() = default;
+  virtual ~StratumMiner();
   virtual void handleRequest(
       const std::string &idStr,
       const std::string &method,
@@ -64,12 +67,15 @@ public:
   void resetCurDiff(uint64_t curDiff);
   uint64_t getCurDiff() const { return curDiff_; };
   uint64_t calcCurDiff();
+  // the vardiff state of the miner, shared with the other miners
+  VardiffEngine &getVardiffEngine() const { return *vardiff_; }
+  uint32_t getVardiffSlot() const { return vardiffSlot_; }
   virtual uint64_t addLocalJob(LocalJob &localJob) = 0;
   virtual void removeLocalJob(LocalJob &localJob) = 0;
 
   const int64_t workerId() { return workerId_; }
   const std::string &workerName() { return workerName_; }
-  const std::string &clientAgent() { return clientAgent_; }
+  const std::string &clientAgent() { return clientAgent_.str(); }
 
 protected:
   bool handleShare(
@@ -77,11 +83,13 @@ protected:
       int32_t status,
       uint64_t shareDiff,
       size_t chainId);
+  void addAcceptedShare(uint64_t shareDiff);
 
   IStratumSession &session_;
-  std::unique_ptr<DiffController> diffController_;
+  std::shared_ptr<VardiffEngine> vardiff_;
+  uint32_t vardiffSlot_;
   uint64_t curDiff_;
-  std::string clientAgent_;
+  InternedString clientAgent_;
   bool isNiceHashClient_;
   std::string workerName_;
   int64_t workerId_;
@@ -89,6 +97,66 @@ protected:
   StatsWindow<int64_t> invalidSharesCounter_;
 };
 
+//////////////////////////////// LocalJobDiffs ////////////////////////////////
+//
+// The difficulties of a miner for the local jobs of its session. Jobs come
+// and go in the order of the session, so a flat vector (oldest first) is
+// enough and much smaller than a map of 256 nodes per miner.
+//
+template <typename V>
+class LocalJobDiffs {
+public:
+  using Entry = std::pair<const LocalJob *, V>;
+
+  // end() is nullptr
+  Entry *find(const LocalJob *localJob) {
+    for (size_t i = entries_.size(); i > head_; --i) {
+      if (entries_[i - 1].first == localJob) {
+        return &entries_[i - 1];
+      }
+    }
+    return end();
+  }
+  Entry *end() { return nullptr; }
+  size_t size() const { return entries_.size() - head_; }
+
+  V &operator[](const LocalJob *localJob) {
+    auto entry = find(localJob);
+    if (entry != end()) {
+      return entry->second;
+    }
+    // reuse the space of the removed jobs before the vector grows
+    if (head_ > 0 && entries_.size() == entries_.capacity()) {
+      entries_.erase(entries_.begin(), entries_.begin() + head_);
+      head_ = 0;
+    }
+    entries_.emplace_back(localJob, V());
+    return entries_.back().second;
+  }
+
+  void erase(const LocalJob *localJob) {
+    auto entry = find(localJob);
+    if (entry == end()) {
+      return;
+    }
+    size_t index = entry - entries_.data();
+    if (index == head_) {
+      // the oldest one, as usual
+      entries_[head_++] = Entry(nullptr, V());
+    } else {
+      entries_.erase(entries_.begin() + index);
+    }
+    if (head_ == entries_.size()) {
+      entries_.clear();
+      head_ = 0;
+    }
+  }
+
+private:
+  std::vector<Entry> entries_;
+  size_t head_ = 0; // entries before it are removed
+};
+
 template <typename StratumTraits>
 class StratumMinerBase : public StratumMiner {
   using SessionType = typename StratumTraits::SessionType;
@@ -124,7 +192,7 @@ public:
   }
 
 protected:
-  std::map<const LocalJob *, JobDiffType> jobDiffs_;
+  LocalJobDiffs<JobDiffType> jobDiffs_;
 };
 
 #endif // #define STRATUM_MINER_H_
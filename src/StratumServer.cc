@@ -33,6 +33,7 @@
 #include "ssl/SSLUtils.h"
 
 #include <netinet/tcp.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -47,56 +48,139 @@ SessionIDManagerT<IBITS>::SessionIDManagerT(const uint8_t serverId)
   , allocIdx_(0)
   , allocInterval_(0) {
   static_assert(IBITS <= 24, "IBITS cannot large than 24");
-  sessionIds_.reset();
+
+  uint64_t bits = (uint64_t)kSessionIdMask + 1;
+  for (int level = 0; level < kLevels; level++) {
+    const uint64_t words = (bits + 63) / 64;
+    levelBits_[level] = bits;
+    levels_[level].reset(new std::atomic<uint64_t>[words]);
+    for (uint64_t i = 0; i < words; i++) {
+      levels_[level][i].store(0);
+    }
+    // the bits past the end are never free
+    if (bits % 64 != 0) {
+      levels_[level][words - 1].store(~0ull << (bits % 64));
+    }
+    bits = words;
+  }
+  assert(bits == 1);
 }
 
 template <uint8_t IBITS>
 bool SessionIDManagerT<IBITS>::ifFull() {
-  ScopeLock sl(lock_);
-  return _ifFull();
+  return count_.load() > kSessionIdMask;
 }
 
 template <uint8_t IBITS>
-bool SessionIDManagerT<IBITS>::_ifFull() {
-  if (count_ > kSessionIdMask) {
-    return true;
+void SessionIDManagerT<IBITS>::setAllocInterval(uint32_t interval) {
+  allocInterval_.store(interval);
+}
+
+// The first clear bit of a level at or after pos, or kNotFound.
+template <uint8_t IBITS>
+int64_t SessionIDManagerT<IBITS>::findFree(int level, uint64_t pos) const {
+  if (pos >= levelBits_[level]) {
+    return kNotFound;
+  }
+  const uint64_t word = pos / 64;
+  const uint64_t freeBits =
+      ~levels_[level][word].load() & (~0ull << (pos % 64));
+  if (freeBits != 0) {
+    return word * 64 + __builtin_ctzll(freeBits);
+  }
+  if (level + 1 == kLevels) {
+    return kNotFound;
   }
-  return false;
+  // the next word that is not full, a stale hint just moves us on
+  const int64_t next = findFree(level + 1, word + 1);
+  if (next == kNotFound) {
+    return kNotFound;
+  }
+  return findFree(level, next * 64);
 }
 
+// The word idx of level - 1 became full.
 template <uint8_t IBITS>
-void SessionIDManagerT<IBITS>::setAllocInterval(uint32_t interval) {
-  allocInterval_ = interval;
+void SessionIDManagerT<IBITS>::markFull(int level, uint64_t idx) {
+  if (level == kLevels) {
+    return;
+  }
+  const uint64_t bit = 1ull << (idx % 64);
+  const uint64_t old = levels_[level][idx / 64].fetch_or(bit);
+  // an id of the word may have been freed meanwhile
+  if (levels_[level - 1][idx].load() != ~0ull) {
+    markNotFull(level, idx);
+    return;
+  }
+  if ((old | bit) == ~0ull) {
+    markFull(level + 1, idx / 64);
+  }
 }
 
+// The word idx of level - 1 is not full anymore.
 template <uint8_t IBITS>
-bool SessionIDManagerT<IBITS>::allocSessionId(uint32_t *sessionID) {
-  ScopeLock sl(lock_);
+void SessionIDManagerT<IBITS>::markNotFull(int level, uint64_t idx) {
+  if (level == kLevels) {
+    return;
+  }
+  const uint64_t bit = 1ull << (idx % 64);
+  const uint64_t old = levels_[level][idx / 64].fetch_and(~bit);
+  if (old == ~0ull) {
+    markNotFull(level + 1, idx / 64);
+  }
+}
 
-  if (_ifFull())
+template <uint8_t IBITS>
+bool SessionIDManagerT<IBITS>::allocSessionId(uint32_t *sessionID) {
+  // reserve an id first, so there is a free bit to find
+  if (count_.fetch_add(1) > kSessionIdMask) {
+    count_.fetch_sub(1);
     return false;
-
-  // find an empty bit
-  while (sessionIds_.test(allocIdx_) == true) {
-    allocIdx_ = (allocIdx_ + 1) & kSessionIdMask;
   }
 
-  // set to true
-  sessionIds_.set(allocIdx_, true);
-  count_++;
+  // find an empty bit from allocIdx_, roll back to the beginning if none
+  int64_t idx = allocIdx_.load();
+  for (;;) {
+    idx = findFree(0, idx);
+    if (idx == kNotFound) {
+      idx = findFree(0, 0);
+      if (idx == kNotFound) {
+        // all taken by the hints of other threads, they are updating them
+        std::this_thread::yield();
+        idx = 0;
+        continue;
+      }
+    }
+
+    const uint64_t bit = 1ull << (idx % 64);
+    const uint64_t old = levels_[0][idx / 64].fetch_or(bit);
+    if ((old & bit) == 0) {
+      if ((old | bit) == ~0ull) {
+        markFull(1, idx / 64);
+      }
+      break;
+    }
+    // another thread took it
+  }
 
-  *sessionID = (((uint32_t)serverId_ << IBITS) | allocIdx_);
-  allocIdx_ = (allocIdx_ + allocInterval_) & kSessionIdMask;
+  *sessionID = (((uint32_t)serverId_ << IBITS) | (uint32_t)idx);
+  allocIdx_.store((idx + allocInterval_.load()) & kSessionIdMask);
   return true;
 }
 
 template <uint8_t IBITS>
 void SessionIDManagerT<IBITS>::freeSessionId(uint32_t sessionId) {
-  ScopeLock sl(lock_);
-
   const uint32_t idx = (sessionId & kSessionIdMask);
-  sessionIds_.set(idx, false);
-  count_--;
+  const uint64_t bit = 1ull << (idx % 64);
+  const uint64_t old = levels_[0][idx / 64].fetch_and(~bit);
+  if ((old & bit) == 0) {
+    LOG(ERROR) << "free an unused session id: " << sessionId;
+    return;
+  }
+  if (old == ~0ull) {
+    markNotFull(1, idx / 64);
+  }
+  count_.fetch_sub(1);
 }
 
 // Class template instantiation
@@ -129,6 +213,8 @@ JobRepository::JobRepository(
 JobRepository::~JobRepository() {
   if (threadConsume_.joinable())
     threadConsume_.join();
+  if (threadConsumeShm_.joinable())
+    threadConsumeShm_.join();
 }
 
 void JobRepository::setMaxJobLifeTime(const time_t maxJobLifeTime) {
@@ -141,6 +227,15 @@ void JobRepository::setMiningNotifyInterval(time_t miningNotifyInterval) {
   kMiningNotifyInterval_ = miningNotifyInterval;
 }
 
+void JobRepository::setShmJobBus(const string &busName) {
+  if (busName.empty()) {
+    return;
+  }
+  LOG(INFO) << "consume stratum jobs from shm job bus " << busName
+            << " in addition to kafka";
+  shmJobBus_ = std::make_unique<ShmJobBusReader>(busName);
+}
+
 shared_ptr<StratumJobEx> JobRepository::getStratumJobEx(const uint64_t jobId) {
   auto itr = exJobs_.find(jobId);
   if (itr != exJobs_.end()) {
@@ -166,6 +261,9 @@ void JobRepository::stop() {
   if (threadConsume_.joinable()) {
     threadConsume_.join();
   }
+  if (threadConsumeShm_.joinable()) {
+    threadConsumeShm_.join();
+  }
 }
 
 bool JobRepository::setupThreadConsume() {
@@ -186,6 +284,10 @@ bool JobRepository::setupThreadConsume() {
   }
 
   threadConsume_ = std::thread(&JobRepository::runThreadConsume, this);
+  if (shmJobBus_) {
+    threadConsumeShm_ =
+        std::thread(&JobRepository::runThreadConsumeShm, this);
+  }
   return true;
 }
 
@@ -230,6 +332,22 @@ void JobRepository::runThreadConsume() {
   LOG(INFO) << "stop job repository consume thread";
 }
 
+void JobRepository::runThreadConsumeShm() {
+  LOG(INFO) << "start job repository shm consume thread";
+
+  // The scheduled notify and job cleaning are still driven by the kafka
+  // consume thread, this thread only receives jobs.
+  const int32_t kTimeoutMs = 1000;
+  string msg;
+  while (running_) {
+    if (shmJobBus_->read(msg, kTimeoutMs)) {
+      consumeStratumJob(msg.data(), msg.size());
+    }
+  }
+
+  LOG(INFO) << "stop job repository shm consume thread";
+}
+
 void JobRepository::consumeStratumJob(rd_kafka_message_t *rkmessage) {
   // check error
   if (rkmessage->err) {
@@ -256,9 +374,12 @@ void JobRepository::consumeStratumJob(rd_kafka_message_t *rkmessage) {
     return;
   }
 
+  consumeStratumJob((const char *)rkmessage->payload, rkmessage->len);
+}
+
+void JobRepository::consumeStratumJob(const char *data, size_t len) {
   shared_ptr<StratumJob> sjob = createStratumJob();
-  bool res = sjob->unserializeFromJson(
-      (const char *)rkmessage->payload, rkmessage->len);
+  bool res = sjob->unserializeFromJson(data, len);
   if (res == false) {
     LOG(ERROR) << "unserialize stratum job fail";
     return;
@@ -278,7 +399,14 @@ void JobRepository::consumeStratumJob(rd_kafka_message_t *rkmessage) {
     // that everyone is using this Map readonly now
     auto existingJob = getStratumJobEx(sjob->jobId_);
     if (existingJob != nullptr) {
-      LOG(ERROR) << "jobId already existed";
+      // With the shm job bus every job arrives twice, the later one
+      // (usually from kafka) is expected to be dropped here.
+      if (shmJobBus_) {
+        LOG(INFO) << "jobId already existed: " << sjob->jobId_
+                  << ", received from both the shm job bus and kafka";
+      } else {
+        LOG(ERROR) << "jobId already existed: " << sjob->jobId_;
+      }
       return;
     }
 
@@ -374,9 +502,13 @@ SSL_CTX *StratumServer::getSSLCTX(const libconfig::Config &config) {
 
 StratumServer::StratumServer()
   : enableTLS_(false)
+  , enableKTLS_(false)
   , base_(nullptr)
   , listener_(nullptr)
+  , reapEvent_(nullptr)
   , tcpReadTimeout_(600)
+  , connectionsAccepted_(0)
+  , connectionsClosed_(0)
   , acceptStale_(true)
   , isEnableSimulator_(false)
   , isSubmitInvalidBlock_(false)
@@ -391,7 +523,11 @@ StratumServer::StratumServer()
 
 StratumServer::~StratumServer() {
   // Destroy connections before event base
+  deadConnections_.clear();
   connections_.clear();
+  if (reapEvent_ != nullptr) {
+    event_free(reapEvent_);
+  }
 
   if (statsExporter_) {
     if (statsExporter_) {
@@ -549,7 +685,8 @@ bool StratumServer::setup(const libconfig::Config &config) {
                           const string &solvedShareTopic,
                           const string &commonEventsTopic,
                           const string &jobTopic,
-                          const string &fileLastMiningNotifyTime) {
+                          const string &fileLastMiningNotifyTime,
+                          const string &shmJobBus) {
     size_t chainId = chains_.size();
 
     chains_.push_back(
@@ -569,6 +706,8 @@ bool StratumServer::setup(const libconfig::Config &config) {
              kafkaBrokers.c_str(),
              jobTopic.c_str(),
              fileLastMiningNotifyTime)});
+
+    chains_.back().jobRepository_->setShmJobBus(shmJobBus);
   };
 
   bool multiChains = false;
@@ -579,6 +718,8 @@ bool StratumServer::setup(const libconfig::Config &config) {
     for (int i = 0; i < chains.getLength(); i++) {
       string fileLastMiningNotifyTime; // optional
       chains.lookupValue("file_last_notify_time", fileLastMiningNotifyTime);
+      string shmJobBus; // optional
+      chains[i].lookupValue("shm_job_bus", shmJobBus);
 
       addChainVars(
           chains[i].lookup("name"),
@@ -587,7 +728,8 @@ bool StratumServer::setup(const libconfig::Config &config) {
           chains[i].lookup("solved_share_topic"),
           chains[i].lookup("common_events_topic"),
           chains[i].lookup("job_topic"),
-          fileLastMiningNotifyTime);
+          fileLastMiningNotifyTime,
+          shmJobBus);
     }
     if (chains_.empty()) {
       LOG(FATAL) << "sserver.multi_chains enabled but chains empty!";
@@ -596,6 +738,8 @@ bool StratumServer::setup(const libconfig::Config &config) {
     string fileLastMiningNotifyTime; // optional
     config.lookupValue(
         "sserver.file_last_notify_time", fileLastMiningNotifyTime);
+    string shmJobBus; // optional
+    config.lookupValue("sserver.shm_job_bus", shmJobBus);
 
     addChainVars(
         "default",
@@ -604,7 +748,8 @@ bool StratumServer::setup(const libconfig::Config &config) {
         config.lookup("sserver.solved_share_topic"),
         config.lookup("sserver.common_events_topic"),
         config.lookup("sserver.job_topic"),
-        fileLastMiningNotifyTime);
+        fileLastMiningNotifyTime,
+        shmJobBus);
   }
 
   // ------------------- user info -------------------
@@ -715,9 +860,10 @@ bool StratumServer::setup(const libconfig::Config &config) {
 
   // ------------------- TCP Listen -------------------
 
-  // Enable multithreading and flag BEV_OPT_THREADSAFE.
-  // Without it, bufferevent_socket_new() will return NULL with flag
-  // BEV_OPT_THREADSAFE.
+  // The base must be lock-enabled, dispatch() activates events on it from
+  // other threads. Sessions and their bufferevents are only touched by the
+  // loop thread (everything else goes through dispatch()), so bufferevents
+  // are created without BEV_OPT_THREADSAFE and take no locks.
   evthread_use_pthreads();
 
   base_ = event_base_new();
@@ -725,6 +871,7 @@ bool StratumServer::setup(const libconfig::Config &config) {
     LOG(ERROR) << "server: cannot create base";
     return false;
   }
+  reapEvent_ = event_new(base_, -1, 0, StratumServer::reapCallback, this);
 
   memset(&sin_, 0, sizeof(sin_));
   sin_.sin_family = AF_INET;
@@ -756,6 +903,24 @@ bool StratumServer::setup(const libconfig::Config &config) {
     // try get SSL CTX (load SSL cert and key)
     // any error will abort the process
     sslCTX_ = getSSLCTX(config);
+
+    // sessions of sservers sharing the ticket key file can be resumed on
+    // each other, e.g. after a failover
+    string ticketKeyFile;
+    int tlsSessionTimeout = 3600;
+    config.lookupValue("sserver.tls_ticket_key_file", ticketKeyFile);
+    config.lookupValue("sserver.tls_session_timeout", tlsSessionTimeout);
+    if (!setup_server_SSL_CTX_resumption(
+            sslCTX_, ticketKeyFile, tlsSessionTimeout)) {
+      return false;
+    }
+
+    config.lookupValue("sserver.enable_ktls", enableKTLS_);
+    if (enableKTLS_ && !enable_SSL_CTX_ktls(sslCTX_)) {
+      LOG(WARNING) << "OpenSSL is built without kTLS, enable_ktls ignored";
+      enableKTLS_ = false;
+    }
+    LOG_IF(INFO, enableKTLS_) << "kTLS enabled";
   }
 
   // setup promethues exporter
@@ -787,6 +952,7 @@ bool StratumServer::setup(const libconfig::Config &config) {
 
 void StratumServer::run() {
   LOG(INFO) << "stratum server running";
+  loopThread_ = std::this_thread::get_id();
   if (base_ != NULL) {
     //    event_base_loop(base_, EVLOOP_NONBLOCK);
     event_base_dispatch(base_);
@@ -855,34 +1021,21 @@ size_t StratumServer::autoRegCallback(const string &userName) {
 }
 
 void StratumServer::sendMiningNotifyToAll(shared_ptr<StratumJobEx> exJobPtr) {
-  //
-  // http://www.sgi.com/tech/stl/Map.html
-  //
-  // Map has the important property that inserting a new element into a map
-  // does not invalidate iterators that point to existing elements. Erasing
-  // an element from a map also does not invalidate any iterators, except,
-  // of course, for iterators that actually point to the element that is
-  // being erased.
-  //
-  auto itr = connections_.begin();
-  while (itr != connections_.end()) {
-    auto &conn = *itr;
-    if (conn->isDead()) {
-#ifndef WORK_WITH_STRATUM_SWITCHER
-      sessionIDManager_->freeSessionId(conn->getSessionId());
-#endif
-      itr = connections_.erase(itr);
-    } else {
-      if (conn->getChainId() == exJobPtr->chainId_) {
-        conn->sendMiningNotify(exJobPtr);
-      }
-      ++itr;
+  prometheus::HistogramTimer timer(
+      *chains_[exJobPtr->chainId_].jobNotifySeconds_);
+  // Sessions are never freed while we are iterating: a session closed by a
+  // failed write is only marked as dead here and reaped later.
+  for (auto &conn : connections_) {
+    if (!conn->isDead() && conn->getChainId() == exJobPtr->chainId_) {
+      conn->sendMiningNotify(exJobPtr);
     }
   }
 }
 
 void StratumServer::addConnection(unique_ptr<StratumSession> connection) {
-  connections_.insert(move(connection));
+  connectionsAccepted_++;
+  connection->setConnectionIdx(connections_.size());
+  connections_.push_back(move(connection));
 }
 
 void StratumServer::removeConnection(StratumSession &connection) {
@@ -890,7 +1043,37 @@ void StratumServer::removeConnection(StratumSession &connection) {
   // if we are here, means the related evbuffer has already been locked.
   // don't lock connsLock_ in this function, it will cause deadlock.
   //
+  if (connection.isDead()) {
+    return;
+  }
   connection.markAsDead();
+  connectionsClosed_++;
+
+  // The session can't be freed inside the callbacks of its bufferevent,
+  // it is freed as soon as they return.
+  deadConnections_.push_back(&connection);
+  event_active(reapEvent_, EV_TIMEOUT, 0);
+}
+
+void StratumServer::reapCallback(evutil_socket_t, short, void *server) {
+  static_cast<StratumServer *>(server)->reapConnections();
+}
+
+void StratumServer::reapConnections() {
+  std::vector<StratumSession *> deadConnections;
+  deadConnections.swap(deadConnections_);
+
+  for (auto conn : deadConnections) {
+#ifndef WORK_WITH_STRATUM_SWITCHER
+    sessionIDManager_->freeSessionId(conn->getSessionId());
+#endif
+    uint32_t idx = conn->getConnectionIdx();
+    if (idx + 1 != connections_.size()) {
+      connections_[idx] = move(connections_.back());
+      connections_[idx]->setConnectionIdx(idx);
+    }
+    connections_.pop_back();
+  }
 }
 
 void StratumServer::listenerCallback(
@@ -926,21 +1109,13 @@ void StratumServer::listenerCallback(
     }
 
     bev = bufferevent_openssl_socket_new(
-        base,
-        fd,
-        ssl,
-        BUFFEREVENT_SSL_ACCEPTING,
-        BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
+        base, fd, ssl, BUFFEREVENT_SSL_ACCEPTING, BEV_OPT_CLOSE_ON_FREE);
   } else {
-    bev = bufferevent_socket_new(
-        base, fd, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
+    bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE);
   }
 
-  // If it was NULL with flag BEV_OPT_THREADSAFE,
-  // please call evthread_use_pthreads() before you call event_base_new().
   if (bev == nullptr) {
-    LOG(ERROR) << "Error constructing bufferevent! Maybe you forgot call "
-                  "evthread_use_pthreads() before event_base_new().";
+    LOG(ERROR) << "Error constructing bufferevent!";
     server->stop();
     return;
   }
@@ -948,6 +1123,9 @@ void StratumServer::listenerCallback(
   // create stratum session
   auto conn = server->createConnection(bev, saddr, sessionID);
   if (!conn->initialize()) {
+#ifndef WORK_WITH_STRATUM_SWITCHER
+    server->sessionIDManager_->freeSessionId(sessionID);
+#endif
     return;
   }
   // set callback functions
@@ -976,6 +1154,9 @@ void StratumServer::eventCallback(
   if (conn->getServer().enableTLS_) {
     if (events & BEV_EVENT_CONNECTED) {
       DLOG(INFO) << "TLS connected";
+      if (conn->getServer().enableKTLS_) {
+        conn->getServer().switchToKernelTLS(*conn, bev);
+      }
       return;
     }
   } else {
@@ -999,8 +1180,50 @@ void StratumServer::eventCallback(
   conn->getServer().removeConnection(*conn);
 }
 
+void StratumServer::switchToKernelTLS(
+    StratumSession &connection, struct bufferevent *bev) {
+  // OpenSSL has handed the keys to the kernel right after the handshake if
+  // it could (the tls module is loaded and the cipher is supported). The
+  // kernel encrypts and decrypts the records then, so the session can go on
+  // with a plain socket bufferevent, without OpenSSL and its BIO copies.
+  SSL *ssl = bufferevent_openssl_get_ssl(bev);
+  if (ssl == nullptr || !is_SSL_ktls_active(ssl)) {
+    DLOG(INFO) << "kTLS is not available for the session";
+    return;
+  }
+  // nothing may be left behind in the buffers of the bufferevent either
+  if (evbuffer_get_length(bufferevent_get_input(bev)) > 0 ||
+      evbuffer_get_length(bufferevent_get_output(bev)) > 0) {
+    return;
+  }
+
+  // the SSL bufferevent closes its fd when it is freed
+  evutil_socket_t fd = dup(bufferevent_getfd(bev));
+  if (fd < 0) {
+    LOG(ERROR) << "dup() failed: " << strerror(errno);
+    return;
+  }
+  struct bufferevent *plainBev =
+      bufferevent_socket_new(base_, fd, BEV_OPT_CLOSE_ON_FREE);
+  if (plainBev == nullptr) {
+    LOG(ERROR) << "Error constructing bufferevent for kTLS";
+    close(fd);
+    return;
+  }
+
+  connection.replaceBufferEvent(plainBev);
+  bufferevent_setcb(
+      plainBev,
+      StratumServer::readCallback,
+      nullptr,
+      StratumServer::eventCallback,
+      &connection);
+  bufferevent_enable(plainBev, EV_READ | EV_WRITE);
+}
+
 void StratumServer::sendShare2Kafka(
     size_t chainId, const char *data, size_t len) {
+  prometheus::HistogramTimer timer(*chains_[chainId].shareProduceSeconds_);
   chains_[chainId].kafkaProducerShareLog_->produce(data, len);
 }
 
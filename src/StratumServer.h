@@ -27,16 +27,16 @@
 #include "Common.h"
 
 #include "Kafka.h"
+#include "ShmJobBus.h"
 #include "Stratum.h"
 #include "Zookeeper.h"
 #include "UserInfo.h"
 
 #include "prometheus/Exporter.h"
 #include "prometheus/Collector.h"
+#include "prometheus/Histogram.h"
 #include "prometheus/Metric.h"
 
-#include <bitset>
-
 #include <openssl/ssl.h>
 #include <event2/bufferevent.h>
 #include <event2/listener.h>
@@ -75,7 +75,7 @@ public:
   virtual void freeSessionId(uint32_t sessionId) = 0;
 };
 
-// thread-safe
+// thread-safe, lock-free
 // template IBITS: index bits
 template <uint8_t IBITS>
 class SessionIDManagerT : public SessionIDManager {
@@ -91,15 +91,29 @@ class SessionIDManagerT : public SessionIDManager {
   const static uint32_t kSessionIdMask =
       (1 << IBITS) - 1; // example: 0x00FFFFFF;
 
+  //
+  // A hierarchical bitmap: level 0 has a bit per session id, a bit of
+  // level n + 1 is set if the word of level n under it is full. A free id
+  // is found with a few ctz() instead of a scan, e.g. 4 levels of 262144,
+  // 4096, 64 and 1 words for 24 bits.
+  //
+  // Only the bits of level 0 decide who owns an id, the upper levels are
+  // hints that may be stale for a moment while another thread updates them.
+  //
+  static const int kLevels = (IBITS + 5) / 6;
+  static const int64_t kNotFound = -1;
+
   uint8_t serverId_;
-  std::bitset<kSessionIdMask + 1> sessionIds_;
+  std::unique_ptr<std::atomic<uint64_t>[]> levels_[kLevels];
+  uint64_t levelBits_[kLevels]; // number of valid bits of each level
 
-  uint32_t count_; // how many ids are used now
-  uint32_t allocIdx_;
-  uint32_t allocInterval_;
-  mutex lock_;
+  std::atomic<uint32_t> count_; // how many ids are used now
+  std::atomic<uint32_t> allocIdx_;
+  std::atomic<uint32_t> allocInterval_;
 
-  bool _ifFull();
+  int64_t findFree(int level, uint64_t pos) const;
+  void markFull(int level, uint64_t idx);
+  void markNotFull(int level, uint64_t idx);
 
 public:
   SessionIDManagerT(const uint8_t serverId);
@@ -122,6 +136,9 @@ protected:
   KafkaConsumer kafkaConsumer_; // consume topic: 'StratumJob'
   StratumServer *server_; // call server to send new job
 
+  // optional local transport, jobs from the jobmaker on the same host
+  unique_ptr<ShmJobBusReader> shmJobBus_;
+
   string fileLastNotifyTime_;
 
   time_t kMaxJobsLifeTime_;
@@ -132,11 +149,14 @@ protected:
   uint64_t lastJobHeight_;
 
   thread threadConsume_;
+  thread threadConsumeShm_;
   friend class StratumServerStats;
 
 private:
   void runThreadConsume();
+  void runThreadConsumeShm();
   void consumeStratumJob(rd_kafka_message_t *rkmessage);
+  void consumeStratumJob(const char *data, size_t len);
   void tryCleanExpiredJobs();
   void checkAndSendMiningNotify();
 
@@ -155,6 +175,8 @@ public:
 
   void setMaxJobLifeTime(const time_t maxJobLifeTime);
   void setMiningNotifyInterval(time_t miningNotifyInterval);
+  // should be called before setupThreadConsume()
+  void setShmJobBus(const string &busName);
   void sendMiningNotify(shared_ptr<StratumJobEx> exJob);
   shared_ptr<StratumJobEx> getStratumJobEx(const uint64_t jobId);
   shared_ptr<StratumJobEx> getLatestStratumJobEx();
@@ -208,12 +230,22 @@ public:
 class StratumServer {
   // NetIO
   bool enableTLS_;
+  bool enableKTLS_;
   SSL_CTX *sslCTX_;
   struct sockaddr_in sin_;
   struct event_base *base_;
   struct evconnlistener *listener_;
-  std::set<unique_ptr<StratumSession>> connections_;
+  // A session knows its slot, so it is removed by moving the last one there.
+  std::vector<unique_ptr<StratumSession>> connections_;
+  // Sessions closed in this round of the loop, reapEvent_ frees them and
+  // their session ids right after the callbacks that closed them.
+  std::vector<StratumSession *> deadConnections_;
+  struct event *reapEvent_;
+  std::thread::id loopThread_; // set by run()
   uint32_t tcpReadTimeout_; // seconds
+  // since start, only touched by the loop thread like the rest of the stats
+  uint64_t connectionsAccepted_;
+  uint64_t connectionsClosed_;
 
 public:
   struct ChainVars {
@@ -226,6 +258,23 @@ public:
 
     JobRepository *jobRepository_;
     std::map<int32_t, size_t> shareStats_;
+    // shares since start, shareStats_ is added up on each scrape
+    std::map<int32_t, uint64_t> shareTotals_;
+    // messages sent to the sessions and the writes it took, see
+    // StratumSession::outputCallback()
+    size_t messagesSent_;
+    size_t writes_;
+
+    // latencies in seconds
+    std::shared_ptr<prometheus::Histogram> shareCheckSeconds_ =
+        std::make_shared<prometheus::Histogram>(
+            prometheus::Histogram::LatencyBounds());
+    std::shared_ptr<prometheus::Histogram> jobNotifySeconds_ =
+        std::make_shared<prometheus::Histogram>(
+            prometheus::Histogram::LatencyBounds());
+    std::shared_ptr<prometheus::Histogram> shareProduceSeconds_ =
+        std::make_shared<prometheus::Histogram>(
+            prometheus::Histogram::LatencyBounds());
   };
 
   bool acceptStale_;
@@ -275,6 +324,12 @@ public:
 
   // Dispatch the task to the libevent loop
   void dispatch(std::function<void()> task);
+  // Sessions may only be used here, other threads must dispatch().
+  // Always true before run(), e.g. in tests.
+  bool isLoopThread() const {
+    return loopThread_ == std::thread::id() ||
+        loopThread_ == std::this_thread::get_id();
+  }
 
   shared_ptr<Zookeeper> getZookeeper(const libconfig::Config &config) {
     initZookeeper(config);
@@ -292,6 +347,8 @@ public:
 
   void addConnection(unique_ptr<StratumSession> connection);
   void removeConnection(StratumSession &connection);
+  static void reapCallback(evutil_socket_t, short, void *server);
+  void reapConnections();
 
   static void listenerCallback(
       struct evconnlistener *listener,
@@ -301,6 +358,7 @@ public:
       void *server);
   static void readCallback(struct bufferevent *, void *connection);
   static void eventCallback(struct bufferevent *, short, void *connection);
+  void switchToKernelTLS(StratumSession &connection, struct bufferevent *bev);
 
   void sendShare2Kafka(size_t chainId, const char *data, size_t len);
   void sendSolvedShare2Kafka(size_t chainId, const char *data, size_t len);
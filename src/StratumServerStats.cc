@@ -54,6 +54,19 @@ static const char *FormatSessionStatus(int status) {
   }
 }
 
+static const char *FormatSessionType(const StratumSession &session) {
+  if (session.isAgentClient()) {
+    return "agent";
+  }
+  if (session.isNiceHashClient()) {
+    return "nicehash";
+  }
+  return "miner";
+}
+
+// a session this far behind is not reading what it gets
+static const size_t kSlowSessionOutputBytes = 64 * 1024;
+
 StratumServerStats::StratumServerStats(StratumServer &server)
   : server_{server}
   , lastScrape_{std::chrono::steady_clock::now()} {
@@ -79,6 +92,43 @@ StratumServerStats::StratumServerStats(StratumServer &server)
         "Block height of last sserver job broadcast",
         {{"chain", chain.name_}},
         [&chain]() { return chain.jobRepository_->lastJobHeight_; }));
+    metrics_.push_back(prometheus::CreateMetricFn(
+        "sserver_kafka_share_log_queue_length",
+        prometheus::Metric::Type::Gauge,
+        "Share logs waiting in the kafka producer",
+        {{"chain", chain.name_}},
+        [&chain]() { return chain.kafkaProducerShareLog_->getQueueLength(); }));
+    metrics_.push_back(prometheus::CreateMetricFn(
+        "sserver_kafka_solved_share_queue_length",
+        prometheus::Metric::Type::Gauge,
+        "Solved shares waiting in the kafka producer",
+        {{"chain", chain.name_}},
+        [&chain]() {
+          return chain.kafkaProducerSolvedShare_->getQueueLength();
+        }));
+    metrics_.push_back(prometheus::CreateMetricFn(
+        "sserver_kafka_common_events_queue_length",
+        prometheus::Metric::Type::Gauge,
+        "Common events waiting in the kafka producer",
+        {{"chain", chain.name_}},
+        [&chain]() {
+          return chain.kafkaProducerCommonEvents_->getQueueLength();
+        }));
+    metrics_.push_back(prometheus::CreateMetricHistogram(
+        "sserver_share_check_seconds",
+        "Time to check a share in seconds",
+        {{"chain", chain.name_}},
+        chain.shareCheckSeconds_));
+    metrics_.push_back(prometheus::CreateMetricHistogram(
+        "sserver_job_notify_seconds",
+        "Time to send a job to all the sessions in seconds",
+        {{"chain", chain.name_}},
+        chain.jobNotifySeconds_));
+    metrics_.push_back(prometheus::CreateMetricHistogram(
+        "sserver_share_produce_seconds",
+        "Time to produce a share to kafka in seconds",
+        {{"chain", chain.name_}},
+        chain.shareProduceSeconds_));
   }
 }
 
@@ -100,13 +150,117 @@ StratumServerStats::collectMetrics() {
           {{"chain", chain.name_}, {"status", FormatStratumStatus(p.first)}},
           static_cast<double>(p.second) / duration));
     }
+
+    // the writes (send() calls) it takes to answer a share, responses to
+    // the same session in one round of the loop go out with one write
+    size_t shares = 0;
+    for (auto p : chain.shareStats_) {
+      shares += p.second;
+    }
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_messages_sent_per_second_since_last_scrape",
+        prometheus::Metric::Type::Gauge,
+        "Messages sent by sserver per second since last scrape",
+        {{"chain", chain.name_}},
+        static_cast<double>(chain.messagesSent_) / duration));
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_writes_per_second_since_last_scrape",
+        prometheus::Metric::Type::Gauge,
+        "Socket writes of sserver per second since last scrape",
+        {{"chain", chain.name_}},
+        static_cast<double>(chain.writes_) / duration));
+    if (shares > 0) {
+      metrics.push_back(prometheus::CreateMetricValue(
+          "sserver_writes_per_share_since_last_scrape",
+          prometheus::Metric::Type::Gauge,
+          "Socket writes of sserver per share since last scrape",
+          {{"chain", chain.name_}},
+          static_cast<double>(chain.writes_) / shares));
+    }
+
+    for (auto p : chain.shareStats_) {
+      chain.shareTotals_[p.first] += p.second;
+    }
+    for (auto p : chain.shareTotals_) {
+      metrics.push_back(prometheus::CreateMetricValue(
+          "sserver_shares_total",
+          prometheus::Metric::Type::Counter,
+          "Shares processed by sserver",
+          {{"chain", chain.name_}, {"status", FormatStratumStatus(p.first)}},
+          p.second));
+    }
+
     chain.shareStats_.clear();
+    chain.messagesSent_ = 0;
+    chain.writes_ = 0;
   }
 
   std::map<std::pair<size_t, StratumSession::State>, size_t> sessions_;
+  std::map<std::pair<size_t, const char *>, size_t> sessionTypes;
+  size_t outputBytes = 0;
+  size_t maxOutputBytes = 0;
+  size_t slowSessions = 0;
+  size_t localJobsBytes = 0;
   for (auto &session : server_.connections_) {
+    if (session->isDead()) {
+      continue;
+    }
     ++sessions_[{session->getChainId(), session->getState()}];
+    ++sessionTypes[{session->getChainId(), FormatSessionType(*session)}];
+
+    size_t output = session->getOutputLength();
+    outputBytes += output;
+    maxOutputBytes = std::max(maxOutputBytes, output);
+    if (output >= kSlowSessionOutputBytes) {
+      slowSessions++;
+    }
+    localJobsBytes += session->getLocalJobsBytes();
   }
+  for (auto &s : sessionTypes) {
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_sessions_by_type",
+        prometheus::Metric::Type::Gauge,
+        "The number of sserver sessions per chain and client type",
+        {{"chain", server_.chains_[s.first.first].name_},
+         {"type", s.first.second}},
+        s.second));
+  }
+  metrics.push_back(prometheus::CreateMetricValue(
+      "sserver_output_pending_bytes",
+      prometheus::Metric::Type::Gauge,
+      "Bytes sserver has written and the clients have not taken yet",
+      {},
+      outputBytes));
+  metrics.push_back(prometheus::CreateMetricValue(
+      "sserver_output_pending_max_bytes",
+      prometheus::Metric::Type::Gauge,
+      "Most bytes pending on a single sserver session",
+      {},
+      maxOutputBytes));
+  metrics.push_back(prometheus::CreateMetricValue(
+      "sserver_slow_sessions",
+      prometheus::Metric::Type::Gauge,
+      "Sessions with at least 64 KiB pending output",
+      {},
+      slowSessions));
+  metrics.push_back(prometheus::CreateMetricValue(
+      "sserver_local_jobs_bytes",
+      prometheus::Metric::Type::Gauge,
+      "Heap taken by the local jobs of all sserver sessions",
+      {},
+      localJobsBytes));
+  metrics.push_back(prometheus::CreateMetricValue(
+      "sserver_connections_accepted_total",
+      prometheus::Metric::Type::Counter,
+      "Connections accepted by sserver",
+      {},
+      server_.connectionsAccepted_));
+  metrics.push_back(prometheus::CreateMetricValue(
+      "sserver_connections_closed_total",
+      prometheus::Metric::Type::Counter,
+      "Connections closed by sserver or the clients",
+      {},
+      server_.connectionsClosed_));
   for (auto &s : sessions_) {
     metrics.push_back(prometheus::CreateMetricValue(
         "sserver_sessions_total",
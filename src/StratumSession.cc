@@ -40,6 +40,9 @@ using namespace std;
 
 static const uint32_t ReadTimeout = 15;
 static const uint32_t WriteTimeout = 120;
+// A BTCAgent session carries many miners, the more of their shares are read
+// at once, the more of the responses go out with one write.
+static const size_t AgentMaxSingleRead = 65536;
 static const string PoolWatcherAgent = "__PoolWatcher__";
 static const string BtccomAgentPrefix = "btccom-agent/";
 
@@ -51,42 +54,65 @@ StratumSession::StratumSession(
   : server_(server)
   , bev_(bev)
   , sessionId_(sessionId)
-  , buffer_(evbuffer_new())
+  , connectionIdx_(0)
   , clientAgent_("unknown")
+  , state_(CONNECTED)
   , isAgentClient_(false)
   , isNiceHashClient_(false)
-  , state_(CONNECTED)
-  , worker_(server.chains_.size())
-  , isDead_(false)
   , isLongTimeout_(false)
-  , savedAuthorizeInfo_(nullptr) {
+  , isDead_(false)
+  , worker_(server.chains_.size()) {
   assert(saddr->sa_family == AF_INET);
   auto ipv4 = reinterpret_cast<struct sockaddr_in *>(saddr);
   clientIpInt_ = ipv4->sin_addr.s_addr;
-  clientIp_.resize(INET_ADDRSTRLEN);
-  evutil_inet_ntop(
-      AF_INET, &ipv4->sin_addr, &clientIp_.front(), INET_ADDRSTRLEN);
-  // remove the padding bytes
-  clientIp_ = clientIp_.c_str();
 
   // make a null dispatcher here to guard against invalid access
   dispatcher_ = std::make_unique<StratumMessageNullDispatcher>();
 
   setup();
-  LOG(INFO) << "client connect, ip: " << clientIp_;
+  LOG(INFO) << "client connect, ip: " << getClientIpStr();
 }
 
 StratumSession::~StratumSession() {
   LOG_IF(INFO, state_ != CONNECTED)
-      << "close stratum session, ip: " << clientIp_ << ", name: \""
+      << "close stratum session, ip: " << getClientIpStr() << ", name: \""
       << worker_.fullName_ << "\""
       << ", agent: \"" << clientAgent_ << "\"";
-  evbuffer_free(buffer_);
   bufferevent_free(bev_);
 }
 
+string StratumSession::getClientIpStr() const {
+  char ip[INET_ADDRSTRLEN] = {0};
+  struct in_addr addr;
+  addr.s_addr = clientIpInt_;
+  evutil_inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+  return ip;
+}
+
+void StratumSession::replaceBufferEvent(struct bufferevent *bev) {
+  bufferevent_free(bev_);
+  bev_ = bev;
+  setup();
+}
+
 void StratumSession::setup() {
   setReadTimeout(ReadTimeout);
+  evbuffer_add_cb(bufferevent_get_output(bev_), outputCallback, this);
+}
+
+size_t StratumSession::getOutputLength() const {
+  return evbuffer_get_length(bufferevent_get_output(bev_));
+}
+
+void StratumSession::outputCallback(
+    struct evbuffer *buf, const struct evbuffer_cb_info *info, void *session) {
+  // Responses are only appended to the output by sendData(), the loop
+  // writes all of them at once when it gets to the write event (one
+  // writev(), or one SSL_write() per chunk with TLS) and drains them here.
+  if (info->n_deleted > 0) {
+    auto conn = static_cast<StratumSession *>(session);
+    conn->server_.chains_[conn->getChainId()].writes_++;
+  }
 }
 
 void StratumSession::setReadTimeout(int32_t readTimeout) {
@@ -99,18 +125,18 @@ void StratumSession::setReadTimeout(int32_t readTimeout) {
   bufferevent_set_timeouts(bev_, &rtv, &wtv);
 }
 
-bool StratumSession::handleMessage() {
+bool StratumSession::handleMessage(struct evbuffer *buf) {
   //
   // handle ex-message
   //
-  const size_t evBufLen = evbuffer_get_length(buffer_);
+  const size_t evBufLen = evbuffer_get_length(buf);
 
   // no matter what kind of messages, length should at least 4 bytes
   if (evBufLen < 4)
     return false;
 
   StratumMessageEx exMessageHeader;
-  evbuffer_copyout(buffer_, &exMessageHeader, 4);
+  evbuffer_copyout(buf, &exMessageHeader, 4);
 
   // handle ex-message
   if (exMessageHeader.magic.value() == StratumMessageEx::CMD_MAGIC_NUMBER) {
@@ -138,7 +164,7 @@ bool StratumSession::handleMessage() {
     // into the memory at data
     string exMessage;
     exMessage.resize(len);
-    evbuffer_remove(buffer_, &exMessage.front(), exMessage.size());
+    evbuffer_remove(buf, &exMessage.front(), exMessage.size());
     if (dispatcher_) {
       dispatcher_->handleExMessage(exMessage);
     }
@@ -149,7 +175,7 @@ bool StratumSession::handleMessage() {
   // handle stratum message
   //
   string line;
-  if (tryReadLine(line)) {
+  if (tryReadLine(buf, line)) {
     handleLine(line);
     return true;
   }
@@ -157,12 +183,12 @@ bool StratumSession::handleMessage() {
   return false; // read message failure
 }
 
-bool StratumSession::tryReadLine(std::string &line) {
+bool StratumSession::tryReadLine(struct evbuffer *buf, std::string &line) {
   line.clear();
 
   // find eol
   struct evbuffer_ptr loc;
-  loc = evbuffer_search_eol(buffer_, nullptr, nullptr, EVBUFFER_EOL_LF);
+  loc = evbuffer_search_eol(buf, nullptr, nullptr, EVBUFFER_EOL_LF);
   if (loc.pos < 0) {
     return false; // not found
   }
@@ -170,7 +196,7 @@ bool StratumSession::tryReadLine(std::string &line) {
   // copies and removes the first datlen bytes from the front of buf
   // into the memory at data
   line.resize(loc.pos + 1); // containing "\n"
-  evbuffer_remove(buffer_, &line.front(), line.size());
+  evbuffer_remove(buf, &line.front(), line.size());
   return true;
 }
 
@@ -208,13 +234,13 @@ void StratumSession::logAuthorizeResult(bool success, const string &password) {
               << ", wokerHashId: " << worker_.workerHashId_
               << ", workerName: " << worker_.fullName_
               << ", password: " << password << ", clientAgent: " << clientAgent_
-              << ", clientIp: " << clientIp_
+              << ", clientIp: " << getClientIpStr()
               << ", chain: " << getServer().chainName(worker_.chainId_);
   } else {
     LOG(WARNING) << "authorize failed, workerName:" << worker_.fullName_
                  << ", password: " << password
                  << ", clientAgent: " << clientAgent_
-                 << ", clientIp: " << clientIp_;
+                 << ", clientIp: " << getClientIpStr();
   }
 }
 
@@ -241,11 +267,11 @@ string StratumSession::getMinerInfoJson(
       date("%F %T"),
       action,
       worker_.userId(),
-      worker_.userName_,
+      worker_.userName_.str(),
       workerId,
       workerName,
       minerAgent,
-      clientIp_,
+      getClientIpStr(),
       sessionId_,
       desc);
 }
@@ -298,8 +324,8 @@ void StratumSession::checkUserAndPwd(
     if (!isAutoRegCallback && server_.userInfo_->autoRegEnabled()) {
       DLOG(INFO) << "try auto registing user " << worker_.userName_;
 
-      savedAuthorizeInfo_ = shared_ptr<AuthorizeInfo>(
-          new AuthorizeInfo({idStr, worker_.userName_, fullName, password}));
+      savedAuthorizeInfo_ = std::make_unique<AuthorizeInfo>(
+          AuthorizeInfo{idStr, worker_.userName_, fullName, password});
       // try auto registing
       if (server_.userInfo_->tryAutoReg(
               worker_.userName_, sessionId_, worker_.fullName_)) {
@@ -424,7 +450,11 @@ void StratumSession::setClientAgent(const string &clientAgent) {
   isNiceHashClient_ = isNiceHashAgent(clientAgent_);
   isAgentClient_ =
       (0 ==
-       clientAgent_.compare(0, BtccomAgentPrefix.size(), BtccomAgentPrefix));
+       clientAgent_.str().compare(
+           0, BtccomAgentPrefix.size(), BtccomAgentPrefix));
+  if (isAgentClient_) {
+    bufferevent_set_max_single_read(bev_, AgentMaxSingleRead);
+  }
   isLongTimeout_ =
       (isAgentClient_ || isNiceHashClient_ || clientAgent_ == PoolWatcherAgent);
 }
@@ -497,16 +527,17 @@ void StratumSession::markAsDead() {
 
 void StratumSession::sendData(const char *data, size_t len) {
   // add data to a bufferevent’s output buffer
-  // it is automatically locked so we don't need to lock
+  // it is not locked, only the loop thread may write
+  assert(server_.isLoopThread());
   bufferevent_write(bev_, data, len);
+  server_.chains_[getChainId()].messagesSent_++;
   DLOG(INFO) << "send(" << len << ") to " << worker_.fullName_ << " : " << data;
 }
 
 void StratumSession::readBuf(struct evbuffer *buf) {
-  // moves all data from src to the end of dst
-  evbuffer_add_buffer(buffer_, buf);
-
-  while (handleMessage()) {
+  // Messages are parsed right from the input buffer of the bufferevent, an
+  // incomplete one stays there until the rest arrives.
+  while (handleMessage(buf)) {
   }
 }
 
@@ -31,6 +31,7 @@
 
 #include <boost/endian/buffers.hpp>
 
+#include <event2/buffer.h>
 #include <event2/bufferevent.h>
 
 #include <functional>
@@ -38,6 +39,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <type_traits>
 
 class DiffController;
 class StratumServer;
@@ -117,20 +119,18 @@ protected:
   StratumServer &server_;
   struct bufferevent *bev_;
   uint32_t sessionId_;
-  struct evbuffer *buffer_;
+  uint32_t clientIpInt_; // formatted for logs only, see getClientIpStr()
+  uint32_t connectionIdx_; // slot in StratumServer::connections_
 
-  uint32_t clientIpInt_;
-  std::string clientIp_;
-
-  std::string clientAgent_; // eg. bfgminer/4.4.0-32-gac4e9b3
-  bool isAgentClient_;
-  bool isNiceHashClient_;
+  InternedString clientAgent_; // eg. bfgminer/4.4.0-32-gac4e9b3
   std::unique_ptr<StratumMessageDispatcher> dispatcher_;
 
   State state_;
-  StratumWorker worker_;
-  std::atomic<bool> isDead_;
+  bool isAgentClient_;
+  bool isNiceHashClient_;
   bool isLongTimeout_;
+  std::atomic<bool> isDead_;
+  StratumWorker worker_;
 
   struct AuthorizeInfo {
     string idStr_;
@@ -139,13 +139,17 @@ protected:
     string password_;
   };
 
-  shared_ptr<AuthorizeInfo> savedAuthorizeInfo_;
+  // only set while the user is being registered
+  unique_ptr<AuthorizeInfo> savedAuthorizeInfo_;
 
   void setup();
   void setReadTimeout(int32_t readTimeout);
+  static void outputCallback(
+      struct evbuffer *buf, const struct evbuffer_cb_info *info, void *session);
 
-  bool handleMessage(); // handle all messages: ex-message and stratum message
-  bool tryReadLine(std::string &line);
+  // handle all messages: ex-message and stratum message
+  bool handleMessage(struct evbuffer *buf);
+  bool tryReadLine(struct evbuffer *buf, std::string &line);
   void handleLine(const std::string &line);
   virtual void handleRequest(
       const std::string &idStr,
@@ -187,14 +191,26 @@ public:
     return StratumMessageEx::AGENT_MAX_SESSION_ID;
   };
   bool acceptStale() const override;
+  // Go on with another bufferevent of the same connection (e.g. after the
+  // TLS records are handed to the kernel), the old one is freed.
+  void replaceBufferEvent(struct bufferevent *bev);
 
   StratumServer &getServer() { return server_; }
   StratumWorker &getWorker() { return worker_; }
   StratumMessageDispatcher &getDispatcher() override { return *dispatcher_; }
   uint32_t getClientIp() const { return clientIpInt_; };
+  string getClientIpStr() const;
   uint32_t getSessionId() const { return sessionId_; }
+  uint32_t getConnectionIdx() const { return connectionIdx_; }
+  void setConnectionIdx(uint32_t idx) { connectionIdx_ = idx; }
   size_t getChainId() const { return worker_.chainId_; }
   State getState() const { return state_; }
+  bool isAgentClient() const { return isAgentClient_; }
+  bool isNiceHashClient() const { return isNiceHashClient_; }
+  // bytes not taken by the client yet
+  size_t getOutputLength() const;
+  // heap taken by the local jobs
+  virtual size_t getLocalJobsBytes() const { return 0; }
   string getUserName() const { return worker_.userName_; }
 
   bool isDead() const;
@@ -236,6 +252,120 @@ public:
   void reportShare(size_t chainId, int32_t status, uint64_t shareDiff) override;
 };
 
+//////////////////////////////// LocalJobRing /////////////////////////////////
+//
+// The local jobs of a session, at most N of them. Jobs are added to the back
+// and evicted from the front. Slots live in chunks that are allocated when
+// first used and kept, so a new session costs nothing, sliding the window
+// allocates nothing and a job never moves (miners keep pointers to them).
+//
+template <typename T, size_t N, size_t ChunkSize = 16>
+class LocalJobRing {
+  static_assert(N % ChunkSize == 0, "N must be a multiple of ChunkSize");
+
+  using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+  struct Chunk {
+    Slot slots_[ChunkSize];
+  };
+
+public:
+  template <typename Ring, typename Value>
+  class Iterator {
+  public:
+    Iterator(Ring &ring, size_t pos)
+      : ring_(&ring)
+      , pos_(pos) {}
+
+    Value &operator*() const { return (*ring_)[pos_]; }
+    Value *operator->() const { return &(*ring_)[pos_]; }
+    Iterator &operator++() {
+      ++pos_;
+      return *this;
+    }
+    bool operator==(const Iterator &r) const { return pos_ == r.pos_; }
+    bool operator!=(const Iterator &r) const { return pos_ != r.pos_; }
+
+  private:
+    Ring *ring_;
+    size_t pos_;
+  };
+  using iterator = Iterator<LocalJobRing, T>;
+  using const_iterator = Iterator<const LocalJobRing, const T>;
+
+  LocalJobRing()
+    : head_(0)
+    , size_(0) {}
+  LocalJobRing(const LocalJobRing &) = delete;
+  LocalJobRing &operator=(const LocalJobRing &) = delete;
+  ~LocalJobRing() {
+    while (size_ > 0) {
+      pop_front();
+    }
+  }
+
+  static constexpr size_t capacity() { return N; }
+  size_t allocatedBytes() const {
+    if (!chunks_) {
+      return 0;
+    }
+    size_t bytes = sizeof(std::unique_ptr<Chunk>) * (N / ChunkSize);
+    for (size_t i = 0; i < N / ChunkSize; i++) {
+      if (chunks_[i]) {
+        bytes += sizeof(Chunk);
+      }
+    }
+    return bytes;
+  }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // pos 0 is the oldest job
+  T &operator[](size_t pos) { return *slot((head_ + pos) % N); }
+  const T &operator[](size_t pos) const {
+    return *const_cast<LocalJobRing *>(this)->slot((head_ + pos) % N);
+  }
+  T &front() { return (*this)[0]; }
+  T &back() { return (*this)[size_ - 1]; }
+
+  iterator begin() { return iterator(*this, 0); }
+  iterator end() { return iterator(*this, size_); }
+  const_iterator begin() const { return const_iterator(*this, 0); }
+  const_iterator end() const { return const_iterator(*this, size_); }
+
+  // The ring must not be full.
+  template <typename... Args>
+  T &emplace_back(Args &&... args) {
+    assert(size_ < N);
+    T *job = slot((head_ + size_) % N);
+    new (job) T(std::forward<Args>(args)...);
+    ++size_;
+    return *job;
+  }
+
+  void pop_front() {
+    assert(size_ > 0);
+    front().~T();
+    head_ = (head_ + 1) % N;
+    --size_;
+  }
+
+private:
+  T *slot(size_t index) {
+    if (!chunks_) {
+      chunks_.reset(new std::unique_ptr<Chunk>[N / ChunkSize]);
+    }
+    auto &chunk = chunks_[index / ChunkSize];
+    if (!chunk) {
+      chunk.reset(new Chunk);
+    }
+    return reinterpret_cast<T *>(&chunk->slots_[index % ChunkSize]);
+  }
+
+  std::unique_ptr<std::unique_ptr<Chunk>[]> chunks_;
+  uint32_t head_;
+  uint32_t size_;
+};
+
 //  This base class is to help type safety of accessing server_ member variable.
 //  Avoid manual casting. And by templating a minimum class declaration, we
 //  avoid bloating the code too much.
@@ -248,26 +378,26 @@ protected:
       struct bufferevent *bev,
       struct sockaddr *saddr,
       uint32_t sessionId)
-    : StratumSession(server, bev, saddr, sessionId)
-    , kMaxNumLocalJobs_(256) {}
+    : StratumSession(server, bev, saddr, sessionId) {}
 
   using LocalJobType = typename StratumTraits::LocalJobType;
   static_assert(
       std::is_base_of<LocalJob, LocalJobType>::value,
       "Local job type is not derived from LocalJob");
-  std::deque<LocalJobType> localJobs_;
-  size_t kMaxNumLocalJobs_;
+  static constexpr size_t kMaxNumLocalJobs_ = 256;
+  using LocalJobs = LocalJobRing<LocalJobType, kMaxNumLocalJobs_>;
+  LocalJobs localJobs_;
 
 public:
   size_t maxNumLocalJobs() const { return kMaxNumLocalJobs_; }
 
   template <typename Key>
   LocalJobType *findLocalJob(const Key &key) {
-    auto iter = localJobs_.rbegin();
-    auto iend = localJobs_.rend();
-    for (; iter != iend; ++iter) {
-      if (*iter == key) {
-        return &(*iter);
+    // the newest job is the most likely one
+    for (size_t i = localJobs_.size(); i > 0; --i) {
+      auto &localJob = localJobs_[i - 1];
+      if (localJob == key) {
+        return &localJob;
       }
     }
     return nullptr;
@@ -275,8 +405,13 @@ public:
 
   template <typename... Args>
   LocalJobType &addLocalJob(size_t chainId, uint64_t jobId, Args &&... args) {
-    localJobs_.emplace_back(chainId, jobId, std::forward<Args>(args)...);
-    auto &localJob = localJobs_.back();
+    // make room if the caller did not clear the old jobs
+    if (localJobs_.size() >= kMaxNumLocalJobs_) {
+      dispatcher_->removeLocalJob(localJobs_.front());
+      localJobs_.pop_front();
+    }
+    auto &localJob =
+        localJobs_.emplace_back(chainId, jobId, std::forward<Args>(args)...);
     dispatcher_->addLocalJob(localJob);
     return localJob;
   }
@@ -288,11 +423,22 @@ public:
     }
   }
 
-  std::deque<LocalJobType> &getLocalJobs() { return localJobs_; }
+  LocalJobs &getLocalJobs() { return localJobs_; }
+
+  size_t getLocalJobsBytes() const override {
+    size_t bytes = localJobs_.allocatedBytes();
+    for (auto &localJob : localJobs_) {
+      bytes += localJob.submitShares_.capacity() * sizeof(LocalShare);
+    }
+    return bytes;
+  }
 
   inline ServerType &getServer() const {
     return static_cast<ServerType &>(server_);
   }
 };
 
+template <typename StratumTraits>
+constexpr size_t StratumSessionBase<StratumTraits>::kMaxNumLocalJobs_;
+
 #endif // #ifndef STRATUM_SESSION_H_
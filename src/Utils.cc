@@ -22,12 +22,12 @@
  THE SOFTWARE.
 */
 #include "Utils.h"
+#include "HttpClient.h"
 #include "utilities_js.hpp"
 
 #include <stdarg.h>
 #include <sys/stat.h>
 
-#include <curl/curl.h>
 #include <glog/logging.h>
 
 static const char _hexchars[] = "0123456789abcdef";
@@ -110,6 +110,22 @@ bool Hex2Bin(const char *in, vector<char> &out) {
   return true;
 }
 
+bool Hex2BinFixed(const char *in, uint8_t *out, size_t outSize) {
+  for (size_t i = 0; i < outSize; i++) {
+    // checked one by one, don't read beyond a NUL
+    int h = _hex2bin_char(in[i * 2]);
+    if (h < 0) {
+      return false;
+    }
+    int l = _hex2bin_char(in[i * 2 + 1]);
+    if (l < 0) {
+      return false;
+    }
+    out[i] = (uint8_t)((h << 4) | l);
+  }
+  return true;
+}
+
 void Bin2Hex(const uint8_t *in, size_t len, string &str) {
   str.clear();
   const uint8_t *p = in;
@@ -167,30 +183,6 @@ bool s_sendmore(zmq::socket_t &socket, const std::string &string) {
   return (rc);
 }
 
-struct CurlChunk {
-  char *memory;
-  size_t size;
-};
-
-static size_t
-CurlWriteChunkCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-  size_t realsize = size * nmemb;
-  struct CurlChunk *mem = (struct CurlChunk *)userp;
-
-  mem->memory = (char *)realloc(mem->memory, mem->size + realsize + 1);
-  if (mem->memory == NULL) {
-    /* out of memory! */
-    printf("not enough memory (realloc returned NULL)\n");
-    return 0;
-  }
-
-  memcpy(&(mem->memory[mem->size]), contents, realsize);
-  mem->size += realsize;
-  mem->memory[mem->size] = 0;
-
-  return realsize;
-}
-
 // This may be ugly but I really do not want to modify every places calling HTTP
 // methods...
 static bool sslVerifyPeer = true;
@@ -217,79 +209,24 @@ bool httpPOSTImpl(
     long timeoutMs,
     const char *mineType,
     const char *agent) {
-  struct curl_slist *headers = NULL;
-  CURLcode status;
-  long code;
-  CURL *curl = curl_easy_init();
-  struct CurlChunk chunk;
-  if (!curl) {
-    return false;
+  // Runs on the shared client so that the connection to the node is kept
+  // alive and reused by the next call.
+  HttpRequest request;
+  request.url_ = url;
+  if (userpwd != nullptr) {
+    request.userpwd_ = userpwd;
   }
-
-  chunk.memory =
-      (char *)malloc(1); /* will be grown as needed by the realloc above */
-  chunk.size = 0; /* no data at this point */
-
-  // RSK doesn't support 'Expect: 100-Continue' in 'HTTP/1.1'.
-  // So switch to 'HTTP/1.0'.
-  curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
-
-  if (mineType != nullptr) {
-    string mineHeader = string("Content-Type: ") + string(mineType);
-    headers = curl_slist_append(headers, mineHeader.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-  }
-
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-
   if (postData != nullptr) {
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, len);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData);
-  }
-
-  if (userpwd != nullptr)
-    curl_easy_setopt(curl, CURLOPT_USERPWD, userpwd);
-
-  curl_easy_setopt(curl, CURLOPT_USE_SSL, CURLUSESSL_TRY);
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, sslVerifyPeer);
-  curl_easy_setopt(curl, CURLOPT_USERAGENT, agent);
-
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutMs);
-
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWriteChunkCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
-
-  status = curl_easy_perform(curl);
-  if (status != 0) {
-    LOG(ERROR) << "unable to request data from: " << url
-               << ", error: " << curl_easy_strerror(status);
-    goto error;
+    request.body_ = std::make_shared<const string>(postData, len);
   }
-
-  if (chunk.size > 0)
-    response.assign(chunk.memory, chunk.size);
-
-  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
-  // status code 200 - 208 indicates ok
-  // sia returns 204 as success
-  if (code < 200 || code > 208) {
-    LOG(ERROR) << "server responded with code: " << code;
-    goto error;
+  if (mineType != nullptr) {
+    request.contentType_ = mineType;
   }
+  request.agent_ = agent;
+  request.timeoutMs_ = timeoutMs;
+  request.sslVerifyPeer_ = sslVerifyPeer;
 
-  curl_easy_cleanup(curl);
-  curl_slist_free_all(headers);
-  free(chunk.memory);
-  return true;
-
-error:
-  if (curl)
-    curl_easy_cleanup(curl);
-  if (headers)
-    curl_slist_free_all(headers);
-
-  free(chunk.memory);
-  return false;
+  return AsyncHttpClient::shared().requestSync(request, response);
 }
 
 bool httpPOST(
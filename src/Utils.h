@@ -46,6 +46,9 @@ using libconfig::Setting;
 bool Hex2BinReverse(const char *in, size_t size, vector<char> &out);
 bool Hex2Bin(const char *in, size_t size, vector<char> &out);
 bool Hex2Bin(const char *in, vector<char> &out);
+// Decode 2 * outSize hex digits into out[0..outSize), no prefix or spaces.
+// Returns false on a non-hex digit.
+bool Hex2BinFixed(const char *in, uint8_t *out, size_t outSize);
 void Bin2Hex(const uint8_t *in, size_t len, string &str);
 void Bin2Hex(const vector<uint8_t> &in, string &str);
 void Bin2Hex(const vector<char> &in, string &str);
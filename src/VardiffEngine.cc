@@ -0,0 +1,369 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#include "VardiffEngine.h"
+
+#include "DiffController.h"
+
+#include <algorithm>
+#include <cmath>
+
+const uint32_t VardiffEngine::kNoRow;
+
+VardiffEngine::VardiffEngine(const DiffController &prototype)
+  : kMaxDiff_(prototype.kMaxDiff_)
+  , kMinDiff_(prototype.kMinDiff_)
+  , kDiffWindow_(prototype.kDiffWindow_)
+  , kRecordSeconds_(prototype.kRecordSeconds_)
+  , kWindowSize_(prototype.kDiffWindow_ / prototype.kRecordSeconds_)
+  , defaultMinDiff_(prototype.minDiff_)
+  , defaultCurDiff_(prototype.curDiff_)
+  , defaultHashRateLevel_(prototype.curHashRateLevel_) {
+}
+
+uint32_t VardiffEngine::add() {
+  uint32_t slot;
+  if (!freeSlots_.empty()) {
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+  } else {
+    slot = curDiff_.size();
+    curDiff_.push_back(0);
+    minDiff_.push_back(0);
+    startTime_.push_back(0);
+    hashRateLevel_.push_back(0);
+    pendingDiff_.push_back(0);
+    maxRingIdx_.push_back(0);
+    expiredRingIdx_.push_back(0);
+    sharesNumSum_.push_back(0);
+    sharesSum_.push_back(0);
+    row_.push_back(kNoRow);
+  }
+
+  // as the copy constructor of DiffController
+  curDiff_[slot] = defaultCurDiff_;
+  minDiff_[slot] = defaultMinDiff_;
+  startTime_[slot] = 0;
+  hashRateLevel_[slot] = defaultHashRateLevel_;
+  pendingDiff_[slot] = 0;
+  maxRingIdx_[slot] = -1;
+  expiredRingIdx_[slot] = -1;
+  sharesNumSum_[slot] = 0;
+  sharesSum_[slot] = 0;
+  return slot;
+}
+
+void VardiffEngine::remove(uint32_t slot) {
+  if (row_[slot] != kNoRow) {
+    freeRows_.push_back(row_[slot]);
+    row_[slot] = kNoRow;
+  }
+  freeSlots_.push_back(slot);
+}
+
+size_t VardiffEngine::getMemoryUsage() const {
+  return curDiff_.capacity() * sizeof(uint64_t) +
+      minDiff_.capacity() * sizeof(uint64_t) +
+      startTime_.capacity() * sizeof(time_t) +
+      hashRateLevel_.capacity() * sizeof(int32_t) +
+      pendingDiff_.capacity() * sizeof(uint64_t) +
+      maxRingIdx_.capacity() * sizeof(int64_t) +
+      expiredRingIdx_.capacity() * sizeof(int64_t) +
+      sharesNumSum_.capacity() * sizeof(double) +
+      sharesSum_.capacity() * sizeof(uint64_t) +
+      row_.capacity() * sizeof(uint32_t) +
+      sharesNumRows_.capacity() * sizeof(double) +
+      sharesRows_.capacity() * sizeof(uint64_t) +
+      freeSlots_.capacity() * sizeof(uint32_t) +
+      freeRows_.capacity() * sizeof(uint32_t);
+}
+
+void VardiffEngine::addAcceptedShare(
+    uint32_t slot, uint64_t share, time_t now) {
+  pendingDiff_[slot] = 0;
+  insert(slot, now / kRecordSeconds_, share);
+}
+
+void VardiffEngine::setMinDiff(uint32_t slot, uint64_t minDiff) {
+  pendingDiff_[slot] = 0;
+  if (minDiff < kMinDiff_) {
+    minDiff = kMinDiff_;
+  } else if (minDiff > kMaxDiff_) {
+    minDiff = kMaxDiff_;
+  }
+  minDiff_[slot] = minDiff;
+}
+
+void VardiffEngine::setCurDiff(uint32_t slot, uint64_t curDiff) {
+  if (curDiff < kMinDiff_) {
+    curDiff = kMinDiff_;
+  } else if (curDiff > kMaxDiff_) {
+    curDiff = kMaxDiff_;
+  }
+  curDiff_[slot] = curDiff;
+}
+
+void VardiffEngine::resetCurDiff(uint32_t slot, uint64_t curDiff) {
+  pendingDiff_[slot] = 0;
+  setCurDiff(slot, curDiff);
+  clearShares(slot);
+}
+
+uint64_t VardiffEngine::calcCurDiff(uint32_t slot, time_t now) {
+  uint64_t diff = pendingDiff_[slot];
+  if (diff != 0) {
+    pendingDiff_[slot] = 0;
+    return diff;
+  }
+  return calcCurDiffInternal(slot, now);
+}
+
+void VardiffEngine::calcCurDiffs(
+    const uint32_t *slots, size_t count, time_t now) {
+  for (size_t i = 0; i < count; i++) {
+    pendingDiff_[slots[i]] = calcCurDiffInternal(slots[i], now);
+  }
+}
+
+uint64_t VardiffEngine::calcCurDiffInternal(uint32_t slot, time_t now) {
+  uint64_t diff = _calcCurDiff(slot, now);
+  if (diff < minDiff_[slot]) {
+    diff = minDiff_[slot];
+  }
+  return diff;
+}
+
+// DiffController::_calcCurDiff() on a slot
+uint64_t VardiffEngine::_calcCurDiff(uint32_t slot, time_t now) {
+  const int64_t k = now / kRecordSeconds_;
+  const double sharesCount = sumSharesNum(slot, k);
+  if (startTime_[slot] == 0) {
+    startTime_[slot] = now;
+  }
+
+  const double kRateHigh = 1.40;
+  const double kRateLow = 0.40;
+  double expectedCount = round(kDiffWindow_ / (double)kRecordSeconds_);
+
+  if (isFullWindow(slot, now)) {
+    expectedCount *= minerCoefficient(slot, now, k);
+  }
+  if (expectedCount > kDiffWindow_) {
+    expectedCount = kDiffWindow_;
+  }
+
+  uint64_t &curDiff = curDiff_[slot];
+  const uint64_t minDiff = minDiff_[slot];
+  if (!isFullWindow(slot, now) && now >= startTime_[slot] + 60 &&
+      sharesCount <= (int32_t)((now - startTime_[slot]) / 60.0) &&
+      curDiff >= minDiff * 2) {
+    setCurDiff(slot, curDiff / 2);
+    mapMultiplySharesNum(slot, 2.0);
+    return curDiff;
+  }
+
+  if (sharesCount > expectedCount * kRateHigh) {
+    while (sumSharesNum(slot, k) > expectedCount && curDiff < kMaxDiff_) {
+      setCurDiff(slot, curDiff * 2);
+      mapDivideSharesNum(slot, 2.0);
+    }
+    return curDiff;
+  }
+
+  if (isFullWindow(slot, now) && curDiff >= minDiff * 2) {
+    while (sumSharesNum(slot, k) < expectedCount * kRateLow &&
+           curDiff >= minDiff * 2) {
+      setCurDiff(slot, curDiff / 2);
+      mapMultiplySharesNum(slot, 2.0);
+    }
+    assert(curDiff >= minDiff);
+    return curDiff;
+  }
+
+  return curDiff;
+}
+
+double VardiffEngine::minerCoefficient(uint32_t slot, time_t now, int64_t idx) {
+  if (now <= startTime_[slot]) {
+    return 1.0;
+  }
+  uint64_t shares = sumShares(slot, idx);
+  time_t shareWindow =
+      isFullWindow(slot, now) ? kDiffWindow_ : (now - startTime_[slot]);
+  double hashRateT = (double)shares * pow(2, 32) / shareWindow / pow(10, 12);
+  hashRateLevel_[slot] =
+      DiffController::AdjustHashRateLevel(hashRateLevel_[slot], hashRateT);
+  return DiffController::HashRateLevelCoefficient(hashRateLevel_[slot]);
+}
+
+// StatsWindow::insert() on both windows
+void VardiffEngine::insert(uint32_t slot, int64_t ringIdx, uint64_t share) {
+  int64_t &maxRingIdx = maxRingIdx_[slot];
+  if (maxRingIdx > ringIdx + kWindowSize_) { // too small index, drop it
+    return;
+  }
+
+  if (maxRingIdx == -1 || ringIdx - maxRingIdx > kWindowSize_) {
+    if (row_[slot] == kNoRow) {
+      if (!freeRows_.empty()) {
+        row_[slot] = freeRows_.back();
+        freeRows_.pop_back();
+      } else {
+        row_[slot] = sharesNumRows_.size() / kWindowSize_;
+        sharesNumRows_.resize(sharesNumRows_.size() + kWindowSize_);
+        sharesRows_.resize(sharesRows_.size() + kWindowSize_);
+      }
+    }
+    clearShares(slot);
+    maxRingIdx = ringIdx;
+    expiredRingIdx_[slot] = ringIdx - kWindowSize_;
+  }
+
+  advance(slot, ringIdx);
+
+  size_t pos = (size_t)row_[slot] * kWindowSize_ + ringIdx % kWindowSize_;
+  sharesNumRows_[pos] += 1.0;
+  sharesRows_[pos] += share;
+  // the record at this position, an index right at the bottom of the window
+  // adds to the top one like StatsWindow does
+  int64_t idx = ringIdx > maxRingIdx - kWindowSize_ ? ringIdx
+                                                    : ringIdx + kWindowSize_;
+  if (idx > expiredRingIdx_[slot]) {
+    sharesNumSum_[slot] += 1.0;
+    sharesSum_[slot] += share;
+  }
+}
+
+// move the top of the window up, the records it drops leave the sums
+void VardiffEngine::advance(uint32_t slot, int64_t ringIdx) {
+  int64_t &maxRingIdx = maxRingIdx_[slot];
+  size_t row = (size_t)row_[slot] * kWindowSize_;
+  while (maxRingIdx < ringIdx) {
+    maxRingIdx++;
+    size_t pos = row + maxRingIdx % kWindowSize_;
+    if (maxRingIdx - kWindowSize_ > expiredRingIdx_[slot]) {
+      sharesNumSum_[slot] -= sharesNumRows_[pos];
+      sharesSum_[slot] -= sharesRows_[pos];
+    }
+    sharesNumRows_[pos] = 0;
+    sharesRows_[pos] = 0;
+  }
+}
+
+// take the records up to ringIdx out of the sums, they stay in the window
+// until it moves on
+void VardiffEngine::expire(uint32_t slot, int64_t ringIdx) {
+  const int64_t maxRingIdx = maxRingIdx_[slot];
+  int64_t &expired = expiredRingIdx_[slot];
+  size_t row = (size_t)row_[slot] * kWindowSize_;
+  int64_t idx = std::max(expired, maxRingIdx - kWindowSize_) + 1;
+  for (; idx <= ringIdx && idx <= maxRingIdx; idx++) {
+    size_t pos = row + idx % kWindowSize_;
+    sharesNumSum_[slot] -= sharesNumRows_[pos];
+    sharesSum_[slot] -= sharesRows_[pos];
+  }
+  expired = std::max(expired, ringIdx);
+}
+
+// StatsWindow::sum(beginRingIdx) of sharesNum_
+double VardiffEngine::sumSharesNum(uint32_t slot, int64_t beginRingIdx) {
+  const int64_t maxRingIdx = maxRingIdx_[slot];
+  if (row_[slot] == kNoRow || beginRingIdx - kWindowSize_ >= maxRingIdx) {
+    return 0;
+  }
+  int64_t endRingIdx = beginRingIdx - kWindowSize_;
+  if (beginRingIdx >= maxRingIdx && endRingIdx >= expiredRingIdx_[slot]) {
+    expire(slot, endRingIdx);
+    return sharesNumSum_[slot];
+  }
+
+  // the clock went back, add them up as StatsWindow does
+  double sum = 0;
+  size_t row = (size_t)row_[slot] * kWindowSize_;
+  if (beginRingIdx > maxRingIdx) {
+    beginRingIdx = maxRingIdx;
+  }
+  while (beginRingIdx > endRingIdx) {
+    sum += sharesNumRows_[row + beginRingIdx % kWindowSize_];
+    beginRingIdx--;
+  }
+  return sum;
+}
+
+// StatsWindow::sum(beginRingIdx) of shares_
+uint64_t VardiffEngine::sumShares(uint32_t slot, int64_t beginRingIdx) {
+  const int64_t maxRingIdx = maxRingIdx_[slot];
+  if (row_[slot] == kNoRow || beginRingIdx - kWindowSize_ >= maxRingIdx) {
+    return 0;
+  }
+  int64_t endRingIdx = beginRingIdx - kWindowSize_;
+  if (beginRingIdx >= maxRingIdx && endRingIdx >= expiredRingIdx_[slot]) {
+    expire(slot, endRingIdx);
+    return sharesSum_[slot];
+  }
+
+  uint64_t sum = 0;
+  size_t row = (size_t)row_[slot] * kWindowSize_;
+  if (beginRingIdx > maxRingIdx) {
+    beginRingIdx = maxRingIdx;
+  }
+  while (beginRingIdx > endRingIdx) {
+    sum += sharesRows_[row + beginRingIdx % kWindowSize_];
+    beginRingIdx--;
+  }
+  return sum;
+}
+
+void VardiffEngine::mapMultiplySharesNum(uint32_t slot, double val) {
+  if (row_[slot] == kNoRow) {
+    return;
+  }
+  auto row = &sharesNumRows_[(size_t)row_[slot] * kWindowSize_];
+  for (int32_t i = 0; i < kWindowSize_; i++) {
+    row[i] *= val;
+  }
+  sharesNumSum_[slot] *= val;
+}
+
+void VardiffEngine::mapDivideSharesNum(uint32_t slot, double val) {
+  if (row_[slot] == kNoRow) {
+    return;
+  }
+  auto row = &sharesNumRows_[(size_t)row_[slot] * kWindowSize_];
+  for (int32_t i = 0; i < kWindowSize_; i++) {
+    row[i] /= val;
+  }
+  sharesNumSum_[slot] /= val;
+}
+
+// mapMultiply(0) of both windows
+void VardiffEngine::clearShares(uint32_t slot) {
+  sharesNumSum_[slot] = 0;
+  sharesSum_[slot] = 0;
+  if (row_[slot] == kNoRow) {
+    return;
+  }
+  size_t row = (size_t)row_[slot] * kWindowSize_;
+  std::fill_n(sharesNumRows_.begin() + row, kWindowSize_, 0.0);
+  std::fill_n(sharesRows_.begin() + row, kWindowSize_, 0);
+}
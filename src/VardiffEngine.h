@@ -0,0 +1,115 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#ifndef VARDIFF_ENGINE_H_
+#define VARDIFF_ENGINE_H_
+
+#include "Common.h"
+
+class DiffController;
+
+/////////////////////////////// VardiffEngine ///////////////////////////////
+//
+// The DiffController state of many miners, one array per field. A miner is
+// a slot in it. The two share windows of a slot keep running sums, so a
+// difficulty is recalculated without adding up the window, and shares are
+// kept in rows that are only allocated once a miner has a share.
+//
+// The difficulties are the same as a DiffController copied from the one
+// the engine is made of would calculate at the same times. Not thread safe.
+//
+class VardiffEngine {
+public:
+  explicit VardiffEngine(const DiffController &prototype);
+
+  // a miner with the min and current difficulty of the prototype
+  uint32_t add();
+  void remove(uint32_t slot);
+
+  void addAcceptedShare(uint32_t slot, uint64_t share, time_t now);
+  void setMinDiff(uint32_t slot, uint64_t minDiff);
+  void resetCurDiff(uint32_t slot, uint64_t curDiff);
+  uint64_t calcCurDiff(uint32_t slot, time_t now);
+
+  // Recalculate the difficulties of the miners getting a job in one pass.
+  // The next calcCurDiff() of each slot returns its result, unless the
+  // miner changes in between.
+  void calcCurDiffs(const uint32_t *slots, size_t count, time_t now);
+
+  size_t size() const { return curDiff_.size() - freeSlots_.size(); }
+  size_t getMemoryUsage() const;
+
+private:
+  static const uint32_t kNoRow = UINT32_MAX;
+
+  uint64_t calcCurDiffInternal(uint32_t slot, time_t now);
+  uint64_t _calcCurDiff(uint32_t slot, time_t now);
+  double minerCoefficient(uint32_t slot, time_t now, int64_t idx);
+  void setCurDiff(uint32_t slot, uint64_t curDiff);
+  bool isFullWindow(uint32_t slot, time_t now) const {
+    return now >= startTime_[slot] + kDiffWindow_;
+  }
+
+  // the StatsWindow operations on both windows of a slot
+  void insert(uint32_t slot, int64_t ringIdx, uint64_t share);
+  void advance(uint32_t slot, int64_t ringIdx);
+  void expire(uint32_t slot, int64_t ringIdx);
+  double sumSharesNum(uint32_t slot, int64_t ringIdx);
+  uint64_t sumShares(uint32_t slot, int64_t ringIdx);
+  void mapMultiplySharesNum(uint32_t slot, double val);
+  void mapDivideSharesNum(uint32_t slot, double val);
+  void clearShares(uint32_t slot);
+
+  const uint64_t kMaxDiff_;
+  const uint64_t kMinDiff_;
+  const time_t kDiffWindow_;
+  const time_t kRecordSeconds_;
+  const int32_t kWindowSize_; // records per window
+  const uint64_t defaultMinDiff_;
+  const uint64_t defaultCurDiff_;
+  const int32_t defaultHashRateLevel_;
+
+  std::vector<uint64_t> curDiff_;
+  std::vector<uint64_t> minDiff_;
+  std::vector<time_t> startTime_;
+  std::vector<int32_t> hashRateLevel_;
+  std::vector<uint64_t> pendingDiff_; // of calcCurDiffs(), 0 if none
+
+  // Both windows are inserted together, so they share the ring indexes.
+  // The sums are of the records in (max(expired, maxRingIdx - size),
+  // maxRingIdx], like StatsWindow::sum() at the last time asked.
+  std::vector<int64_t> maxRingIdx_;
+  std::vector<int64_t> expiredRingIdx_;
+  std::vector<double> sharesNumSum_;
+  std::vector<uint64_t> sharesSum_;
+  std::vector<uint32_t> row_;
+
+  // kWindowSize_ records per row
+  std::vector<double> sharesNumRows_;
+  std::vector<uint64_t> sharesRows_;
+
+  std::vector<uint32_t> freeSlots_;
+  std::vector<uint32_t> freeRows_;
+};
+
+#endif // #ifndef VARDIFF_ENGINE_H_
@@ -0,0 +1,102 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "VerifierPool.h"
+
+#include "StratumServer.h"
+
+#include <glog/logging.h>
+#include <libconfig.h++>
+
+// Jobs taken by a worker at most at once.
+static const size_t kMaxBatchSize = 64;
+
+VerifierPool::VerifierPool(StratumServer &server, size_t threads)
+  : server_(server)
+  , threadsNum_(threads) {
+  for (size_t i = 0; i < threads; i++) {
+    threads_.emplace_back(&VerifierPool::run, this);
+  }
+  LOG(INFO) << "verifier pool started, threads: " << threads;
+}
+
+unique_ptr<VerifierPool>
+VerifierPool::create(StratumServer &server, const libconfig::Config &config) {
+  uint32_t threads = std::thread::hardware_concurrency();
+  config.lookupValue("sserver.verify_threads", threads);
+  if (threads == 0) {
+    return nullptr;
+  }
+  return std::make_unique<VerifierPool>(server, threads);
+}
+
+VerifierPool::~VerifierPool() {
+  {
+    ScopeLock sl(lock_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  for (auto &t : threads_) {
+    t.join();
+  }
+}
+
+void VerifierPool::submit(
+    std::function<void()> verify, std::function<void()> done) {
+  {
+    ScopeLock sl(lock_);
+    queue_.push_back({std::move(verify), std::move(done)});
+  }
+  cv_.notify_one();
+}
+
+void VerifierPool::run() {
+  while (true) {
+    auto batch = std::make_shared<vector<Job>>();
+    {
+      unique_lock<mutex> l(lock_);
+      cv_.wait(l, [this] { return !running_ || !queue_.empty(); });
+      if (!running_) {
+        return;
+      }
+      // share the queue with the other workers
+      size_t n = (queue_.size() + threadsNum_ - 1) / threadsNum_;
+      n = std::min(n, kMaxBatchSize);
+      batch->reserve(n);
+      for (size_t i = 0; i < n; i++) {
+        batch->push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+    }
+
+    for (auto &job : *batch) {
+      job.verify_();
+    }
+
+    server_.dispatch([batch]() {
+      for (auto &job : *batch) {
+        job.done_();
+      }
+    });
+  }
+}
@@ -0,0 +1,77 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#ifndef VERIFIER_POOL_H_
+#define VERIFIER_POOL_H_
+
+#include "Common.h"
+
+namespace libconfig {
+class Config;
+}
+
+class StratumServer;
+
+////////////////////////////////// VerifierPool ////////////////////////////////
+//
+// Runs CPU heavy share checks (e.g. proof of work) on worker threads, so that
+// the event loop only parses shares and sends responses.
+//
+// verify() runs on a worker, done() on the event loop afterwards. The workers
+// take the queued jobs in batches and hand every finished batch back to the
+// event loop with one StratumServer::dispatch().
+//
+// All chains with slow share checks (Equihash, Cuckoo Cycle, Tensority) use
+// it, configured by `sserver.verify_threads`.
+//
+class VerifierPool {
+public:
+  VerifierPool(StratumServer &server, size_t threads);
+  ~VerifierPool();
+
+  // `sserver.verify_threads` workers, the number of CPU cores by default.
+  // Returns nullptr if it is 0, the shares are checked on the event loop then.
+  static unique_ptr<VerifierPool>
+  create(StratumServer &server, const libconfig::Config &config);
+
+  void submit(std::function<void()> verify, std::function<void()> done);
+
+private:
+  struct Job {
+    std::function<void()> verify_;
+    std::function<void()> done_;
+  };
+
+  void run();
+
+  StratumServer &server_;
+  const size_t threadsNum_;
+
+  mutex lock_;
+  condition_variable cv_;
+  std::deque<Job> queue_;
+  bool running_ = true;
+  vector<thread> threads_;
+};
+
+#endif // VERIFIER_POOL_H_
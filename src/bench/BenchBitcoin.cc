@@ -0,0 +1,337 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include "StratumMiner.h"
+#include "ShareLogger.h"
+#include "Utils.h"
+#include "bitcoin/BitcoinUtils.h"
+#include "bitcoin/StratumBitcoin.h"
+#include "bitcoin/StratumServerBitcoin.h"
+#include "bitcoin/StatisticsBitcoin.h"
+#include "bitcoin/MempoolMirror.h"
+
+// a share of the block 558201
+static ShareBitcoin makeShare() {
+  ShareBitcoin share;
+  share.set_jobid(6645522065066147329ull);
+  share.set_workerhashid(0x1234567890abcdefll);
+  share.set_userid(10086);
+  share.set_status(StratumStatus::ACCEPT);
+  share.set_timestamp(1547281171);
+  share.set_ip("10.0.0.1");
+  share.set_sharediff(0x4000);
+  share.set_blkbits(389159077);
+  share.set_height(558201);
+  share.set_nonce(0x07ba7929u);
+  share.set_sessionid(0xfe0000c3u);
+  share.set_versionmask(0x00013f00u);
+  return share;
+}
+
+#ifndef CHAIN_TYPE_ZEC
+
+// the job and the share of the StratumServerBitcoin.CheckShare unit test
+static const char kJobJson[] = R"EOF(
+  {
+    "jobId": 6645522065066147329,
+    "gbtHash": "d349be274f007c2e1ee773b33bd21ef43d2615c089b7c5460b66584881a10683",
+    "prevHash": "00000000000000000019d1d9c84df0ecc23e549b86644ad47cb92570a26b12a5",
+    "prevHashBeStr": "a26b12a57cb9257086644ad4c23e549bc84df0ec0019d1d90000000000000000",
+    "height": 558201,
+    "coinbase1": "02000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4b03798408041ba3395c612f4254432e434f4d2ffabe6d6dc807e51bd76025d65ccad2ba8ba1e9fba5f09118b6b55a348638cc17b14e3909080000005fb54ad0",
+    "coinbase2": "ffffffff036734ec4a0000000016001497cfc76442fe717f2a3f0cc9c175f7561b6619970000000000000000266a24aa21a9ed40cbdaa98da815640f815b938df95bffe0775d8078771bc47ed4f43ac4e30b0600000000000000002952534b424c4f434b3a9ad45fdcc194d788895f3ad389b583ea327f826353f7edf6b168db038372cb2700000000",
+    "merkleBranch": "53146311555e15816f4549a893ff2eb50e60741ecccb2996bafddcf4ee008d5ac504967e375b2522af2be8411b1b032dda0e700c2e8913d869533256ff30caccea4ba404b68e625cfd3237e07e8deddb342690b08314d2638b5272b74ab12fa3b3812908cd6bef999dea979875ba2730615be08b480e4b6f7b878000510a778c557f44bc3f21813d138d25530df85a89a38e2d2827f758ebc68a62e8225933a5af086e72d9a65fd9be526648e8bcf74271308d9d273425b47bd12db075e841ba703f4c8a20be62d036958278b16f214d7fcd35c46a9f9fb1910618fa9e029d3f96518aae34efbdabfbfbc055bffe891d93edbc7539ae9c0a22a35e87d5ccb033b89976cbb624af024b53c6a02309cb838eb285ecf675b801f1dd7f2d5c924cb1491731c28bea800b12b94bb4f70502a40559c8edb5f73b906ba8e814f10e852ef87365a49346c4b7361b75e38f1d9b96f028880227b7186a0b114e170b170b47",
+    "nVersion": 536870912,
+    "nBits": 389159077,
+    "nTime": 1547281171,
+    "minTime": 1547277926,
+    "coinbaseValue": 1256993895,
+    "witnessCommitment": "6a24aa21a9ed40cbdaa98da815640f815b938df95bffe0775d8078771bc47ed4f43ac4e30b06",
+    "nmcBlockHash": "c807e51bd76025d65ccad2ba8ba1e9fba5f09118b6b55a348638cc17b14e3909",
+    "nmcBits": 402868319,
+    "nmcHeight": 433937,
+    "nmcRpcAddr": "http://127.0.0.1:8999",
+    "nmcRpcUserpass": "user:pass",
+    "rskBlockHashForMergedMining": "0x9ad45fdcc194d788895f3ad389b583ea327f826353f7edf6b168db038372cb27",
+    "rskNetworkTarget": "0x00000000000000001386e3444eba74f8a750a71a75ed0b7fecdfd282a8cef091",
+    "rskFeesForMiner": "0",
+    "rskdRpcAddress": "http://127.0.0.1:4444",
+    "rskdRpcUserPwd": "user:pass",
+    "isRskCleanJob": true
+  }
+)EOF";
+
+static const uint32_t kExtraNonce1 = 0xfe0000c3u;
+static const char kExtraNonce2[] = "260103fe60004690";
+static const uint32_t kTime = 0x5c39a313u;
+static const uint32_t kNonce = 0x07ba7929u;
+static const uint32_t kVersionMask = 0x00013f00u;
+
+static shared_ptr<StratumJobBitcoin> makeJob() {
+  auto sjob = std::make_shared<StratumJobBitcoin>();
+  CHECK(sjob->unserializeFromJson(kJobJson, sizeof(kJobJson) - 1));
+  return sjob;
+}
+
+///////////////////////////////// checkShare ///////////////////////////////////
+// A server with one chain and the job, without kafka and the network.
+class BenchJobRepositoryBitcoin : public JobRepositoryBitcoin {
+public:
+  using JobRepositoryBitcoin::JobRepositoryBitcoin;
+
+  void addJob(shared_ptr<StratumJobEx> exJob) {
+    exJobs_[exJob->sjob_->jobId_] = exJob;
+  }
+};
+
+class BenchServerBitcoin : public ServerBitcoin {
+public:
+  BenchServerBitcoin(shared_ptr<StratumJobBitcoin> sjob) {
+    versionMask_ = 0x1fffe000u;
+
+    auto repository =
+        new BenchJobRepositoryBitcoin(0, this, "127.0.0.1:9092", "BtcJob", "");
+    repository->addJob(repository->createStratumJobEx(sjob, true));
+
+    ChainVars chain;
+    chain.name_ = "bench";
+    chain.kafkaProducerShareLog_ = nullptr;
+    chain.kafkaProducerSolvedShare_ = nullptr;
+    chain.kafkaProducerCommonEvents_ = nullptr;
+    chain.jobRepository_ = repository;
+    chains_.push_back(chain);
+  }
+};
+
+static void BM_ServerBitcoinCheckShare(benchmark::State &state) {
+  auto sjob = makeJob();
+  BenchServerBitcoin server(sjob);
+  ShareBitcoin share = makeShare();
+  BitcoinNonceType nonce = kNonce;
+  uint256 jobTarget = ArithToUint256(~arith_uint256());
+  string workFullName = "bench.worker";
+
+  for (auto _ : state) {
+    int status = server.checkShare(
+        0,
+        share,
+        kExtraNonce1,
+        kExtraNonce2,
+        kTime,
+        nonce,
+        kVersionMask,
+        jobTarget,
+        workFullName);
+    benchmark::DoNotOptimize(status);
+  }
+}
+BENCHMARK(BM_ServerBitcoinCheckShare);
+
+static void BM_StratumJobExBitcoinGenerateBlockHeader(benchmark::State &state) {
+  auto sjob = makeJob();
+  StratumJobExBitcoin exjob(0, sjob, true, StratumMiner::kExtraNonce2Size_);
+  BitcoinNonceType nonce = kNonce;
+
+  for (auto _ : state) {
+    CBlockHeader header;
+    std::vector<char> coinbaseBin;
+    exjob.generateBlockHeader(
+        &header,
+        &coinbaseBin,
+        kExtraNonce1,
+        kExtraNonce2,
+        sjob->merkleBranch_,
+        sjob->prevHash_,
+        sjob->nBits_,
+        sjob->nVersion_,
+        kTime,
+        nonce,
+        kVersionMask);
+    benchmark::DoNotOptimize(header);
+  }
+}
+BENCHMARK(BM_StratumJobExBitcoinGenerateBlockHeader);
+
+/////////////////////////////// StratumJobBitcoin //////////////////////////////
+static void BM_StratumJobBitcoinSerializeToJson(benchmark::State &state) {
+  auto sjob = makeJob();
+
+  for (auto _ : state) {
+    string json = sjob->serializeToJson();
+    benchmark::DoNotOptimize(json);
+  }
+}
+BENCHMARK(BM_StratumJobBitcoinSerializeToJson);
+
+static void BM_StratumJobBitcoinUnserializeFromJson(benchmark::State &state) {
+  const string json = makeJob()->serializeToJson();
+
+  for (auto _ : state) {
+    StratumJobBitcoin sjob;
+    bool ok = sjob.unserializeFromJson(json.data(), json.size());
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_StratumJobBitcoinUnserializeFromJson);
+
+#endif // #ifndef CHAIN_TYPE_ZEC
+
+///////////////////////////////// ShareBitcoin /////////////////////////////////
+static void BM_ShareBitcoinSerialize(benchmark::State &state) {
+  ShareBitcoin share = makeShare();
+  string data;
+  uint32_t size = 0;
+
+  for (auto _ : state) {
+    bool ok = share.SerializeToBuffer(data, size);
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_ShareBitcoinSerialize);
+
+static void BM_ShareBitcoinParse(benchmark::State &state) {
+  string data;
+  uint32_t size = 0;
+  makeShare().SerializeToBuffer(data, size);
+
+  for (auto _ : state) {
+    ShareBitcoin share;
+    bool ok = share.ParseFromArray(data.data(), size);
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_ShareBitcoinParse);
+
+///////////////////////////////// ShareStatsDay ////////////////////////////////
+static void BM_ShareStatsDayProcessShare(benchmark::State &state) {
+  ShareStatsDay<ShareBitcoin> stats;
+  ShareBitcoin share = makeShare();
+  uint32_t hourIdx = 0;
+
+  for (auto _ : state) {
+    stats.processShare(hourIdx, share, false);
+    hourIdx = (hourIdx + 1) % 24;
+  }
+}
+BENCHMARK(BM_ShareStatsDayProcessShare);
+
+/////////////////////////////////// ShareLog ///////////////////////////////////
+// Writes batches of state.range(0) shares to a sharelog in /dev/shm, so the
+// time is spent on serializing and compressing rather than on the disk.
+static void BM_ShareLogWriterFlushToDisk(benchmark::State &state) {
+  char dataDir[] = "/dev/shm/btcpool-bench-XXXXXX";
+  if (mkdtemp(dataDir) == nullptr) {
+    state.SkipWithError("mkdtemp() failed");
+    return;
+  }
+
+  {
+    ShareLogWriterBase<ShareBitcoin> writer("BTC", dataDir);
+    ShareBitcoin share = makeShare();
+
+    for (auto _ : state) {
+      state.PauseTiming();
+      for (int64_t i = 0; i < state.range(0); i++) {
+        share.set_nonce(i);
+        writer.addShare(ShareBitcoin(share));
+      }
+      state.ResumeTiming();
+
+      bool ok = writer.flushToDisk();
+      benchmark::DoNotOptimize(ok);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+  }
+
+  string path = getStatsFilePath("BTC", dataDir, makeShare().timestamp());
+  unlink(path.c_str());
+  rmdir(dataDir);
+}
+BENCHMARK(BM_ShareLogWriterFlushToDisk)->Arg(100)->Arg(10000);
+
+#ifdef CHAIN_TYPE_BTC
+#include <arith_uint256.h>
+#include <consensus/consensus.h>
+#include <streams.h>
+#include <version.h>
+
+// A mempool of `size` transactions, every fourth one a child paying for
+// the previous one, fed as the zmq messages of a node.
+static void MakeMempool(MempoolMirror &mempool, int64_t size) {
+  uint256 parent;
+  for (int64_t i = 0; i < size; i++) {
+    CMutableTransaction tx;
+    if (i % 4 == 3) {
+      tx.vin.emplace_back(COutPoint(parent, 0));
+    } else {
+      tx.vin.emplace_back(COutPoint(ArithToUint256(arith_uint256(i + 1)), 0));
+    }
+    tx.vout.emplace_back(
+        1000, CScript() << OP_0 << vector<unsigned char>(20, i & 0xff));
+    tx.nLockTime = i;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << tx;
+    const string raw(stream.begin(), stream.end());
+    mempool.handleZmqMessage("rawtx", raw.data(), raw.size());
+
+    const uint256 txid = tx.GetHash();
+    vector<uint256> depends;
+    if (i % 4 == 3) {
+      depends.push_back(parent);
+    }
+    mempool.setFee(txid, 100 + (i * 7919) % 10000, std::move(depends));
+    parent = txid;
+  }
+}
+
+static void BM_MempoolMirrorAddRawTx(benchmark::State &state) {
+  for (auto _ : state) {
+    MempoolMirror mempool;
+    MakeMempool(mempool, state.range(0));
+    benchmark::DoNotOptimize(mempool.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MempoolMirrorAddRawTx)->Arg(1000)->Arg(20000);
+
+static void BM_MempoolMirrorAssemble(benchmark::State &state) {
+  MempoolMirror mempool;
+  MakeMempool(mempool, state.range(0));
+  // about a third of the mempool fits
+  const int64_t maxWeight = state.range(0) * 110;
+
+  for (auto _ : state) {
+    auto t = mempool.assemble(maxWeight, MAX_BLOCK_SIGOPS_COST);
+    benchmark::DoNotOptimize(t.fees_);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MempoolMirrorAssemble)->Arg(1000)->Arg(20000);
+#endif // CHAIN_TYPE_BTC
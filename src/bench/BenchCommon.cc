@@ -0,0 +1,105 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "Statistics.h"
+#include "Stratum.h"
+#include "utilities_js.hpp"
+#include "eth/StatisticsEth.h"
+
+/////////////////////////////////// JsonNode ///////////////////////////////////
+static void BM_JsonNodeParseMiningSubmit(benchmark::State &state) {
+  const string line =
+      "{\"params\":[\"bench.worker\",\"5c39a3134a2b\",\"260103fe60004690\","
+      "\"5c39a313\",\"07ba7929\",\"00013f00\"],\"id\":4,"
+      "\"method\":\"mining.submit\"}\n";
+
+  for (auto _ : state) {
+    JsonNode jnode;
+    bool ok = JsonNode::parse(line.data(), line.data() + line.size(), jnode);
+    benchmark::DoNotOptimize(ok);
+    benchmark::DoNotOptimize(jnode["params"].array()[2].str());
+  }
+}
+BENCHMARK(BM_JsonNodeParseMiningSubmit);
+
+////////////////////////////////// StatsWindow /////////////////////////////////
+// One insert per second into the 15 minutes window of statshttpd.
+static void BM_StatsWindowInsert(benchmark::State &state) {
+  StatsWindow<uint64_t> window(900);
+  int64_t ringIdx = 0;
+
+  for (auto _ : state) {
+    window.insert(ringIdx++, 0x4000);
+  }
+}
+BENCHMARK(BM_StatsWindowInsert);
+
+static void BM_StatsWindowSum(benchmark::State &state) {
+  StatsWindow<uint64_t> window(900);
+  for (int64_t i = 0; i < 900; i++) {
+    window.insert(i, 0x4000);
+  }
+
+  for (auto _ : state) {
+    uint64_t sum = window.sum(899, state.range(0));
+    benchmark::DoNotOptimize(sum);
+  }
+}
+BENCHMARK(BM_StatsWindowSum)->Arg(60)->Arg(900);
+
+/////////////////////////////////// LocalJob ///////////////////////////////////
+// The shares of one job of a session, range(0) of them: a few for a miner,
+// thousands for the miners behind an agent.
+static void BM_LocalJobAddLocalShare(benchmark::State &state) {
+  const uint32_t shares = state.range(0);
+  for (auto _ : state) {
+    LocalJob job(0, 0);
+    for (uint32_t i = 0; i < shares; i++) {
+      bool added = job.addLocalShare(
+          LocalShare(0x260103fe60004690ull + i * 7919, i * 2654435761u, 0));
+      benchmark::DoNotOptimize(added);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * shares);
+}
+BENCHMARK(BM_LocalJobAddLocalShare)->Arg(16)->Arg(1000)->Arg(50000);
+
+///////////////////////////// DuplicateShareChecker ////////////////////////////
+// New shares only, spread over the tracked heights.
+static void BM_DuplicateShareCheckerAddShare(benchmark::State &state) {
+  DuplicateShareCheckerEth checker(3);
+  ShareEth share;
+  share.set_headerhash(0x729a374000523423ull);
+  uint64_t nonce = 0;
+
+  for (auto _ : state) {
+    share.set_height(7000000 + nonce / 100000);
+    share.set_nonce(nonce++);
+    bool added = checker.addShare(share);
+    benchmark::DoNotOptimize(added);
+  }
+}
+BENCHMARK(BM_DuplicateShareCheckerAddShare);
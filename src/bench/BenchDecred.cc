@@ -0,0 +1,81 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include <string.h>
+
+#include <benchmark/benchmark.h>
+
+#include "decred/CommonDecred.h"
+
+static BlockHeaderDecred makeHeader() {
+  BlockHeaderDecred header;
+  memset(&header, 0, sizeof(header));
+  header.version = 6;
+  header.nBits = 0x1b01ffff;
+  header.height = 300000;
+  header.timestamp = 1547281171;
+  return header;
+}
+
+/////////////////////////////// BlockHeaderDecred //////////////////////////////
+static void BM_BlockHeaderDecredGetHash(benchmark::State &state) {
+  BlockHeaderDecred header = makeHeader();
+  uint32_t nonce = 0;
+
+  for (auto _ : state) {
+    header.nonce = nonce++;
+    uint256 hash = header.getHash();
+    benchmark::DoNotOptimize(hash);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BlockHeaderDecredGetHash);
+
+static void BM_BlockHeaderHasherDecredGetHash(benchmark::State &state) {
+  BlockHeaderDecred header = makeHeader();
+  BlockHeaderHasherDecred hasher(header);
+  uint32_t nonce = 0;
+
+  for (auto _ : state) {
+    header.nonce = nonce++;
+    uint256 hash = hasher.getHash(header);
+    benchmark::DoNotOptimize(hash);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BlockHeaderHasherDecredGetHash);
+
+static void BM_BlockHeaderHasherDecredGetHashScalar(benchmark::State &state) {
+  BlockHeaderDecred header = makeHeader();
+  BlockHeaderHasherDecred hasher(header);
+  uint32_t nonce = 0;
+
+  for (auto _ : state) {
+    header.nonce = nonce++;
+    uint256 hash = hasher.getHashScalar(header);
+    benchmark::DoNotOptimize(hash);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BlockHeaderHasherDecredGetHashScalar);
@@ -0,0 +1,83 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+// Microbenchmarks of the hot paths of the pool.
+//
+// run all:      ./bench
+// run some:     ./bench --benchmark_filter=Bitcoin
+// save results: ./bench --benchmark_out=bench.json --benchmark_out_format=json
+//
+// The json files of two builds can be diffed with compare.py of
+// google-benchmark.
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "BenchUtils.h"
+#include "config/bpool-version.h"
+
+// every allocation of the binary goes through here
+static std::atomic<uint64_t> gAllocations{0};
+
+void *operator new(size_t size) {
+  gAllocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size > 0 ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+uint64_t AllocationCount() {
+  return gAllocations.load(std::memory_order_relaxed);
+}
+
+int main(int argc, char **argv) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = true;
+  // the benchmarked code logs found blocks and high diff shares
+  FLAGS_minloglevel = google::GLOG_WARNING;
+
+  fprintf(stderr, "%s", BIN_VERSION_STRING("bench"));
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
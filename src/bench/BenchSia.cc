@@ -0,0 +1,105 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "BenchUtils.h"
+#include "Utils.h"
+#include "sia/StratumSia.h"
+
+#include <arith_uint256.h>
+
+#include <algorithm>
+
+// the header of the StratumSia.JobHashShare unit test
+static const char kHeader[] =
+    "00000000000000021f3e8ede65495c4311ef59e5b7a4338542e573819f5979e9"
+    "82719d0366014155e935aa5a00000000201929782a8fe3209b152520c51d2a82"
+    "dc364e4a3eb6fb8131439835e278ff8b";
+
+///////////////////////////////// StratumJobSia ////////////////////////////////
+// What StratumMinerSia does with the header of a mining.submit, before the
+// share is built. Only this stage is allocation-free; building and
+// serializing the share still allocates (see BM_ShareSiaSerialize).
+static void BM_StratumJobSiaHashShare(benchmark::State &state) {
+  const string json = Strings::Format(
+      "{\"created_at_ts\":1521169869,\"jobId\":1"
+      ",\"target\":\"%064x\",\"hHash\":\"%s\"}",
+      1,
+      kHeader);
+  StratumJobSia sjob;
+  if (!sjob.unserializeFromJson(json.c_str(), json.size())) {
+    state.SkipWithError("unserializeFromJson() failed");
+    return;
+  }
+  const arith_uint256 networkTarget = UintToArith256(sjob.networkTarget_);
+
+  const uint64_t allocations = AllocationCount();
+  for (auto _ : state) {
+    uint8_t nonce[StratumJobSia::kNonceSize];
+    bool ok = Hex2BinFixed(
+        kHeader + StratumJobSia::kNonceOffset * 2, nonce, sizeof(nonce));
+    benchmark::DoNotOptimize(ok);
+
+    uint8_t header[StratumJobSia::kHeaderSize];
+    uint256 hash;
+    sjob.hashShare(nonce, header, hash);
+    std::reverse(hash.begin(), hash.end());
+    bool solved = UintToArith256(hash) < networkTarget;
+    benchmark::DoNotOptimize(solved);
+  }
+  SetAllocationsCounter(state, allocations);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StratumJobSiaHashShare);
+
+/////////////////////////////////// ShareSia ///////////////////////////////////
+// The rest of StratumMinerSia::handleRequest_Submit: the share is built and
+// serialized for sendShare2Kafka(). ip.toString(), the protobuf string field
+// and the serialized message each allocate. The kafka producer is left out.
+static void BM_ShareSiaSerialize(benchmark::State &state) {
+  IpAddress ip;
+  ip.fromIpv4Int(0x0100007f);
+
+  const uint64_t allocations = AllocationCount();
+  for (auto _ : state) {
+    ShareSia share;
+    share.set_jobid(1);
+    share.set_workerhashid(2);
+    share.set_ip(ip.toString());
+    share.set_userid(3);
+    share.set_sharediff(1024);
+    share.set_timestamp(1521169869);
+    share.set_status(StratumStatus::REJECT_NO_REASON);
+
+    std::string message;
+    uint32_t size = 0;
+    bool ok = share.SerializeToArrayWithVersion(message, size);
+    benchmark::DoNotOptimize(ok);
+    benchmark::DoNotOptimize(message.data());
+  }
+  SetAllocationsCounter(state, allocations);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShareSiaSerialize);
@@ -0,0 +1,42 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#ifndef BENCH_UTILS_H_
+#define BENCH_UTILS_H_
+
+#include <stdint.h>
+
+#include <benchmark/benchmark.h>
+
+// The number of calls of operator new so far, counted by BenchMain.cc.
+uint64_t AllocationCount();
+
+// Reports the allocations per iteration of `state` since `start`, which is
+// AllocationCount() before the loop.
+inline void SetAllocationsCounter(benchmark::State &state, uint64_t start) {
+  state.counters["allocs"] = benchmark::Counter(
+      AllocationCount() - start, benchmark::Counter::kAvgIterations);
+}
+
+#endif // BENCH_UTILS_H_
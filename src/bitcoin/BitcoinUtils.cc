@@ -382,29 +382,59 @@ int32_t getSolutionVintSize() {
   return 3; // default size
 }
 
+void DecodeEquihashSolution(
+    const std::string &hex, std::vector<unsigned char> &solution) {
+  solution.clear();
+
+  size_t prefixSize = getSolutionVintSize() * 2;
+  if (hex.size() < prefixSize) {
+    return;
+  }
+
+  // the same rules as ParseHex(): skip spaces, stop at a non-hex digit
+  const char *psz = hex.c_str() + prefixSize;
+  while (true) {
+    while (isspace(*psz)) {
+      psz++;
+    }
+    signed char c = HexDigit(*psz++);
+    if (c == (signed char)-1) {
+      break;
+    }
+    unsigned char n = (c << 4);
+    c = HexDigit(*psz++);
+    if (c == (signed char)-1) {
+      break;
+    }
+    n |= c;
+    solution.push_back(n);
+  }
+}
+
 bool CheckEquihashSolution(
     const CBlockHeader *pblock, const CChainParams &params) {
   unsigned int n = params.EquihashN();
   unsigned int k = params.EquihashK();
 
-  // Hash state
-  crypto_generichash_blake2b_state state;
-  EhZecInitialiseState(n, k, state);
+  // The shares of a job only differ in nonce and solution, so the hash
+  // states after I are shared between them. Params are fixed per process.
+  static equihash_zcash::EhHeaderStateCache stateCache(n, k);
 
   // I = the block header minus nonce and solution.
   CEquihashInput I{*pblock};
-  // I||V
   CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
   ss << I;
-  ss << pblock->nNonce;
 
-  // H(I||V||...
-  crypto_generichash_blake2b_update(&state, (unsigned char *)&ss[0], ss.size());
+  // H(I||...
+  crypto_generichash_blake2b_state state;
+  stateCache.GetState((const unsigned char *)&ss[0], ss.size(), state);
 
-  bool isValid = false;
-  EhZecIsValidSolution(n, k, state, pblock->nSolution, isValid);
+  // H(I||V||...
+  crypto_generichash_blake2b_update(
+      &state, pblock->nNonce.begin(), pblock->nNonce.size());
 
-  return isValid;
+  return equihash_zcash::EhIsValidSolution(
+      n, k, state, pblock->nSolution.data(), pblock->nSolution.size());
 }
 #endif
 
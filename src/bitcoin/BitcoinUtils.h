@@ -102,6 +102,10 @@ inline CTxDestination DecodeDestination(const std::string &str) {
 int32_t getSolutionVintSize();
 bool CheckEquihashSolution(
     const CBlockHeader *pblock, const CChainParams &params);
+// Decode the hex solution of a share (with its vint length prefix) into
+// `solution` like ParseHex(), reusing the capacity of `solution`.
+void DecodeEquihashSolution(
+    const std::string &hex, std::vector<unsigned char> &solution);
 #endif
 
 #if defined(CHAIN_TYPE_BCH) || defined(CHAIN_TYPE_ZEC)
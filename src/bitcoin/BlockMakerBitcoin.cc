@@ -26,6 +26,7 @@
 #include "StratumBitcoin.h"
 
 #include "BitcoinUtils.h"
+#include "HttpClient.h"
 
 #include "rsk/RskSolvedShareData.h"
 
@@ -199,9 +200,12 @@ void BlockMakerBitcoin::addRawgbt(const char *str, size_t len) {
   }
 
   const uint256 gbtHash = uint256S(r["gbthash"].str());
-  if (rawGbtMap_.find(gbtHash) != rawGbtMap_.end()) {
-    LOG(ERROR) << "already exist raw gbt, ignore: " << gbtHash.ToString();
-    return;
+  {
+    ScopeLock ls(rawGbtLock_);
+    if (rawGbtBodyMap_.find(gbtHash) != rawGbtBodyMap_.end()) {
+      LOG(ERROR) << "already exist raw gbt, ignore: " << gbtHash.ToString();
+      return;
+    }
   }
 
   const string gbt = DecodeBase64(r["block_template_base64"].str());
@@ -225,44 +229,62 @@ void BlockMakerBitcoin::addRawgbt(const char *str, size_t len) {
   }
 #endif // CHAIN_TYPE_BCH
   // transaction without coinbase_tx
-  shared_ptr<vector<CTransactionRef>> vtxs =
-      std::make_shared<vector<CTransactionRef>>();
-  for (JsonNode &node : jgbt["transactions"].array()) {
+  auto body = std::make_shared<RawGbtBody>();
+  auto &txs = jgbt["transactions"].array();
+
+  size_t txsHexSize = 0;
+  for (JsonNode &node : txs) {
+    txsHexSize += node["data"].size();
+  }
+  body->txsHex_.reserve(txsHexSize);
+  body->txids_.reserve(txs.size());
+
+  for (JsonNode &node : txs) {
+    // the `data` field is already the wire format of the tx
+    const string txHex = node["data"].str();
+    body->txsHex_ += txHex;
 #ifdef CHAIN_TYPE_ZEC
     CTransaction tx;
-    DecodeHexTx(tx, node["data"].str());
-    vtxs->push_back(MakeTransactionRef(tx));
 #else
     CMutableTransaction tx;
-    DecodeHexTx(tx, node["data"].str());
-    vtxs->push_back(MakeTransactionRef(std::move(tx)));
 #endif
+    DecodeHexTx(tx, txHex);
+    body->txids_.push_back(tx.GetHash());
+  }
+
+  {
+    CDataStream ssCount(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ssCount, body->txids_.size() + 1 /* coinbase tx */);
+    body->txCountHex_ = HexStr(ssCount.begin(), ssCount.end());
   }
 
   LOG(INFO) << "insert rawgbt: " << gbtHash.ToString()
-            << ", txs: " << vtxs->size();
-  insertRawGbt(gbtHash, vtxs);
+            << ", txs: " << body->txids_.size();
+  insertRawGbt(gbtHash, body);
 }
 
 void BlockMakerBitcoin::insertRawGbt(
-    const uint256 &gbtHash, shared_ptr<vector<CTransactionRef>> vtxs) {
+    const uint256 &gbtHash, shared_ptr<const RawGbtBody> body) {
   ScopeLock ls(rawGbtLock_);
 
   // insert rawgbt
-  rawGbtMap_[gbtHash] = vtxs;
+  rawGbtBodyMap_[gbtHash] = body;
   rawGbtQ_.push_back(gbtHash);
 
   // remove rawgbt if need
   while (rawGbtQ_.size() > kMaxRawGbtNum_) {
     const uint256 h = *rawGbtQ_.begin();
 
-    rawGbtMap_.erase(h); // delete from map
+    rawGbtBodyMap_.erase(h); // delete from map
     rawGbtQ_.pop_front(); // delete from Q
   }
 }
 
 #ifndef CHAIN_TYPE_ZEC
-static string _buildAuxPow(const CBlock *block) {
+static string _buildAuxPow(
+    const vector<char> &coinbaseTxBin,
+    const CBlockHeader &header,
+    const vector<uint256> &vtxhashes) {
   //
   // see: https://en.bitcoin.it/wiki/Merged_mining_specification
   //
@@ -273,21 +295,22 @@ static string _buildAuxPow(const CBlock *block) {
   //
   // 1. coinbase hex
   {
-    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-    ssTx << block->vtx[0];
-    auxPow += HexStr(ssTx.begin(), ssTx.end());
+    string hex;
+    Bin2Hex(coinbaseTxBin, hex);
+    auxPow += hex;
   }
 
   // 2. block_hash
 #ifdef CHAIN_TYPE_LTC
-  auxPow += block->GetPoWHash().GetHex();
+  auxPow += header.GetPoWHash().GetHex();
 #else
-  auxPow += block->GetHash().GetHex();
+  auxPow += header.GetHash().GetHex();
 #endif
 
   // 3. coinbase_branch, Merkle branch
   {
-    vector<uint256> merkleBranch = BlockMerkleBranch(*block, 0 /* position */);
+    vector<uint256> merkleBranch =
+        ComputeMerkleBranch(vtxhashes, 0 /* position */);
 
     // Number of links in branch
     // should be Variable integer, but can't over than 0xfd, so we just print
@@ -317,7 +340,7 @@ static string _buildAuxPow(const CBlock *block) {
   // 5. Parent Block Header
   {
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block->GetBlockHeader();
+    ssBlock << header;
     auxPow += HexStr(ssBlock.begin(), ssBlock.end());
   }
 
@@ -400,9 +423,9 @@ void BlockMakerBitcoin::consumeNamecoinSolvedShare(
   // coinbase tx, hex -> bin
   Hex2Bin(coinbaseTxHex.c_str(), coinbaseTxHex.length(), coinbaseTxBin);
 
-  // get gbtHash and rawgbt (vtxs)
+  // get gbtHash and rawgbt body
   uint256 gbtHash;
-  shared_ptr<vector<CTransactionRef>> vtxs;
+  shared_ptr<const RawGbtBody> body;
   {
     ScopeLock sl(jobIdMapLock_);
     if (jobId2GbtHash_.find(jobId) != jobId2GbtHash_.end()) {
@@ -412,41 +435,36 @@ void BlockMakerBitcoin::consumeNamecoinSolvedShare(
 
   {
     ScopeLock ls(rawGbtLock_);
-    if (rawGbtMap_.find(gbtHash) == rawGbtMap_.end()) {
-      LOG(ERROR) << "can't find this gbthash in rawGbtMap_: "
+    auto itr = rawGbtBodyMap_.find(gbtHash);
+    if (itr == rawGbtBodyMap_.end()) {
+      LOG(ERROR) << "can't find this gbthash in rawGbtBodyMap_: "
                  << gbtHash.ToString();
       return;
     }
-    vtxs = rawGbtMap_[gbtHash];
-    assert(vtxs.get() != nullptr);
+    body = itr->second;
+    assert(body.get() != nullptr);
   }
 
   //
-  // build new block
+  // tx hashes of the new block: coinbase + gbt txs
   //
-  CBlock newblk(blkHeader);
   vector<uint256> vtxhashes;
-  vtxhashes.resize(1 + vtxs->size()); // coinbase + gbt txs
+  vtxhashes.reserve(1 + body->txids_.size());
 
-  // put coinbase tx
+  // put coinbase tx hash
   {
     CSerializeData sdata;
     sdata.insert(sdata.end(), coinbaseTxBin.begin(), coinbaseTxBin.end());
-    newblk.vtx.push_back(MakeTransactionRef());
+
+    CMutableTransaction tx;
     CDataStream c(sdata, SER_NETWORK, PROTOCOL_VERSION);
-    c >> newblk.vtx[newblk.vtx.size() - 1];
-    vtxhashes[0] = newblk.vtx[newblk.vtx.size() - 1]->GetHash();
-  }
+    c >> tx;
 
-  // put other txs
-  if (vtxs && vtxs->size()) {
-    newblk.vtx.insert(newblk.vtx.end(), vtxs->begin(), vtxs->end());
+    vtxhashes.push_back(tx.GetHash());
   }
 
-  for (size_t i = 0; i < vtxs->size(); i++) {
-    vtxhashes[i + 1] =
-        (*vtxs)[i]->GetHash(); // vtxs is a shared_ptr<vector<CTransactionRef>>
-  }
+  // put other tx hashes
+  vtxhashes.insert(vtxhashes.end(), body->txids_.begin(), body->txids_.end());
 
   bool issupportvcashmergemining = false;
   // if the jobid is not exist , need submit to nmc
@@ -475,13 +493,13 @@ void BlockMakerBitcoin::consumeNamecoinSolvedShare(
     //
     // build aux POW
     //
-    const string auxPow = _buildAuxPow(&newblk);
+    const string auxPow = _buildAuxPow(coinbaseTxBin, blkHeader, vtxhashes);
 
     // submit to namecoind
     submitNamecoinBlockNonBlocking(
         auxBlockHash,
         auxPow,
-        newblk.GetHash().ToString(),
+        blkHeader.GetHash().ToString(),
         rpcAddr,
         rpcUserpass);
   }
@@ -663,19 +681,21 @@ void BlockMakerBitcoin::_submitNamecoinBlockThread(
 #endif
 
 void BlockMakerBitcoin::processSolvedShare(rd_kafka_message_t *rkmessage) {
+  const auto solvedTime = std::chrono::steady_clock::now();
+
   //
   // solved share message:  FoundBlock + coinbase_Tx
   //
   FoundBlock foundBlock;
   CBlockHeader blkHeader;
-  vector<char> coinbaseTxBin;
+  const uint8_t *coinbaseTxBin = nullptr;
+  size_t coinbaseTxSize = 0;
 
   {
     if (rkmessage->len <= sizeof(FoundBlock)) {
       LOG(ERROR) << "invalid SolvedShare length: " << rkmessage->len;
       return;
     }
-    coinbaseTxBin.resize(rkmessage->len - sizeof(FoundBlock));
 
     // foundBlock
     memcpy(
@@ -683,18 +703,17 @@ void BlockMakerBitcoin::processSolvedShare(rd_kafka_message_t *rkmessage) {
         (const uint8_t *)rkmessage->payload,
         sizeof(FoundBlock));
 
-    // coinbase tx
-    memcpy(
-        (uint8_t *)coinbaseTxBin.data(),
-        (const uint8_t *)rkmessage->payload + sizeof(FoundBlock),
-        coinbaseTxBin.size());
+    // coinbase tx, referenced in place
+    coinbaseTxBin = (const uint8_t *)rkmessage->payload + sizeof(FoundBlock);
+    coinbaseTxSize = rkmessage->len - sizeof(FoundBlock);
+
     // copy header
     foundBlock.headerData_.get(blkHeader);
   }
 
-  // get gbtHash and rawgbt (vtxs)
+  // get gbtHash and the pre-serialized body of rawgbt
   uint256 gbtHash;
-  shared_ptr<vector<CTransactionRef>> vtxs;
+  shared_ptr<const RawGbtBody> body;
   {
     ScopeLock sl(jobIdMapLock_);
     if (jobId2GbtHash_.find(foundBlock.jobId_) != jobId2GbtHash_.end()) {
@@ -712,77 +731,119 @@ void BlockMakerBitcoin::processSolvedShare(rd_kafka_message_t *rkmessage) {
     }
   }
   bool lightVersion = !gbtlightJobId.empty();
-  if (!lightVersion)
+  if (lightVersion) {
+    // the node keeps the txs of a light template, only the coinbase tx is sent
+    static const auto lightBody = std::make_shared<const RawGbtBody>(
+        RawGbtBody{"01" /* compact size: 1 tx */, ""});
+    body = lightBody;
+  } else
 #endif // CHAIN_TYPE_BCH
   {
     ScopeLock ls(rawGbtLock_);
-    if (rawGbtMap_.find(gbtHash) == rawGbtMap_.end()) {
-      LOG(ERROR) << "can't find this gbthash in rawGbtMap_: "
+    auto itr = rawGbtBodyMap_.find(gbtHash);
+    if (itr == rawGbtBodyMap_.end()) {
+      LOG(ERROR) << "can't find this gbthash in rawGbtBodyMap_: "
                  << gbtHash.ToString();
       return;
     }
-    vtxs = rawGbtMap_[gbtHash];
-    assert(vtxs.get() != nullptr);
+    body = itr->second;
+    assert(body.get() != nullptr);
   }
 
   //
-  // build new block
+  // build submitblock request: header + tx count + coinbase tx + body
   //
-  CBlock newblk(blkHeader);
-
-  // put coinbase tx
+  string headerHex;
   {
-    CSerializeData sdata;
-    sdata.insert(sdata.end(), coinbaseTxBin.begin(), coinbaseTxBin.end());
-#ifdef CHAIN_TYPE_ZEC
-    newblk.vtx.push_back(CTransaction());
-#else
-    newblk.vtx.push_back(MakeTransactionRef());
-#endif
-    CDataStream c(sdata, SER_NETWORK, PROTOCOL_VERSION);
-    c >> newblk.vtx[newblk.vtx.size() - 1];
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    ssHeader << blkHeader;
+    headerHex = HexStr(ssHeader.begin(), ssHeader.end());
   }
 
-  // put other txs
-  if (vtxs && vtxs->size()) {
-#ifdef CHAIN_TYPE_ZEC
-    for (size_t i = 0; i < vtxs->size(); ++i) {
-      newblk.vtx.push_back(*vtxs->at(i));
-    }
+#ifdef CHAIN_TYPE_BCH
+  const char *method = lightVersion ? "submitblocklight" : "submitblock";
 #else
-    newblk.vtx.insert(newblk.vtx.end(), vtxs->begin(), vtxs->end());
+  const char *method = "submitblock";
 #endif
+  const size_t blockHexSize = headerHex.size() + body->txCountHex_.size() +
+      coinbaseTxSize * 2 + body->txsHex_.size();
+
+  auto request = std::make_shared<string>();
+  request->reserve(blockHexSize + 128);
+  *request += "{\"jsonrpc\":\"1.0\",\"id\":\"1\",\"method\":\"";
+  *request += method;
+  *request += "\",\"params\":[\"";
+  *request += headerHex;
+  *request += body->txCountHex_;
+  string coinbaseTxHex;
+  Bin2Hex(coinbaseTxBin, coinbaseTxSize, coinbaseTxHex);
+  *request += coinbaseTxHex;
+  *request += body->txsHex_;
+  *request += "\"";
+#ifdef CHAIN_TYPE_BCH
+  if (lightVersion) {
+    *request += ", \"";
+    *request += gbtlightJobId;
+    *request += "\"";
   }
+#endif // CHAIN_TYPE_BCH
+  *request += "]}";
 
   // submit to bitcoind
-  const string blockHex = EncodeHexBlock(newblk);
+  SubmitBlockTask task;
+  task.request_ = request;
+  task.blockHash_ = blkHeader.GetHash().ToString();
+  task.solvedTime_ = solvedTime;
+
 #ifdef CHAIN_TYPE_BCH
   if (lightVersion) {
-    LOG(INFO) << "submit block light: " << newblk.GetHash().ToString()
+    LOG(INFO) << "submit block light: " << task.blockHash_
               << " with job_id: " << gbtlightJobId.c_str();
-    submitBlockLightNonBlocking(blockHex, gbtlightJobId);
   } else
 #endif // CHAIN_TYPE_BCH
   {
 #ifdef CHAIN_TYPE_LTC
-    LOG(INFO) << "submit block pow: " << newblk.GetPoWHash().ToString();
+    LOG(INFO) << "submit block pow: " << blkHeader.GetPoWHash().ToString();
 #endif
-    LOG(INFO) << "submit block: " << newblk.GetHash().ToString();
-    submitBlockNonBlocking(blockHex); // using thread
-  }
-
+    LOG(INFO) << "submit block: " << task.blockHash_;
+  }
+  submitBlockNonBlocking(task); // async, using the shared http client
+
+  // the share's time in kafka (ms) shows the delay before blkmaker got it
+  const int64_t kafkaTimestampMs =
+      rd_kafka_message_timestamp(rkmessage, nullptr);
+  const int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+  LOG(INFO) << "block " << task.blockHash_ << " built in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - solvedTime)
+                   .count()
+            << " us, kafka delay: "
+            << (kafkaTimestampMs > 0 ? nowMs - kafkaTimestampMs : -1) << " ms";
+
+  // the coinbase tx is only deserialized for its value
+  uint64_t coinbaseValue = 0;
+  {
+    CSerializeData sdata(coinbaseTxBin, coinbaseTxBin + coinbaseTxSize);
+    CDataStream c(sdata, SER_NETWORK, PROTOCOL_VERSION);
 #ifdef CHAIN_TYPE_ZEC
-  uint64_t coinbaseValue = AMOUNT_SATOSHIS(newblk.vtx[0].GetValueOut());
+    CTransaction coinbaseTx;
+    c >> coinbaseTx;
+    coinbaseValue = AMOUNT_SATOSHIS(coinbaseTx.GetValueOut());
 #else
-  uint64_t coinbaseValue = AMOUNT_SATOSHIS(newblk.vtx[0]->GetValueOut());
+    CTransactionRef coinbaseTx = MakeTransactionRef();
+    c >> coinbaseTx;
+    coinbaseValue = AMOUNT_SATOSHIS(coinbaseTx->GetValueOut());
 #endif
+  }
 
   // save to DB, using thread
   saveBlockToDBNonBlocking(
       foundBlock,
       blkHeader,
       coinbaseValue, // coinbase value
-      blockHex.length() / 2);
+      blockHexSize / 2);
 }
 
 void BlockMakerBitcoin::saveBlockToDBNonBlocking(
@@ -857,93 +918,54 @@ bool BlockMakerBitcoin::checkBitcoinds() {
   return true;
 }
 
-void BlockMakerBitcoin::submitBlockNonBlocking(const string &blockHex) {
-  for (const auto &itr : def()->nodes) {
-    // use thread to submit
-    std::thread t(std::bind(
-        &BlockMakerBitcoin::_submitBlockThread,
-        this,
-        itr.rpcAddr_,
-        itr.rpcUserPwd_,
-        blockHex));
-    t.detach();
+void BlockMakerBitcoin::submitBlockNonBlocking(const SubmitBlockTask &task) {
+  const auto submitTime = std::chrono::steady_clock::now();
+  for (const auto &node : def()->nodes) {
+    LOG(INFO) << "submit block to: " << node.rpcAddr_;
+    submitBlockToNode(node, task, submitTime, 0);
   }
 }
 
-void BlockMakerBitcoin::_submitBlockThread(
-    const string &rpcAddress,
-    const string &rpcUserpass,
-    const string &blockHex) {
-  string request =
-      "{\"jsonrpc\":\"1.0\",\"id\":\"1\",\"method\":\"submitblock\",\"params\":"
-      "[\"";
-  request += blockHex + "\"]}";
-
-  LOG(INFO) << "submit block to: " << rpcAddress;
-  DLOG(INFO) << "submitblock request: " << request;
-  // try N times
-  for (size_t i = 0; i < 3; i++) {
-    string response;
-    bool res = blockchainNodeRpcCall(
-        rpcAddress.c_str(), rpcUserpass.c_str(), request.c_str(), response);
-
-    // success
-    if (res == true) {
-      LOG(INFO) << "rpc call success, submit block response: " << response;
-      break;
-    }
-
-    // failure
-    LOG(ERROR) << "rpc call fail: " << response;
-  }
+void BlockMakerBitcoin::submitBlockToNode(
+    const NodeDefinition &node,
+    const SubmitBlockTask &task,
+    std::chrono::steady_clock::time_point submitTime,
+    size_t retry) {
+  DLOG(INFO) << "submitblock request: " << *task.request_;
+
+  // The callback may outlive the block maker, so it holds copies only.
+  AsyncHttpClient::shared().rpcCall(
+      node.rpcAddr_,
+      node.rpcUserPwd_,
+      task.request_,
+      [node, task, submitTime, retry](
+          bool ok, const string &response) {
+        if (ok) {
+          LOG(INFO) << "rpc call success, submit block response: "
+                    << response;
+        } else {
+          LOG(ERROR) << "rpc call fail: " << response;
+          // try N times
+          if (retry + 1 < 3) {
+            submitBlockToNode(node, task, submitTime, retry + 1);
+            return;
+          }
+        }
+
+        const auto doneTime = std::chrono::steady_clock::now();
+        LOG(INFO) << "block " << task.blockHash_ << " submitted to "
+                  << node.rpcAddr_ << ", solve-to-submit: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(
+                         submitTime - task.solvedTime_)
+                         .count()
+                  << " us, submit rpc: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(
+                         doneTime - submitTime)
+                         .count()
+                  << " us";
+      });
 }
 
-#ifdef CHAIN_TYPE_BCH
-void BlockMakerBitcoin::submitBlockLightNonBlocking(
-    const string &blockHex, const string &job_id) {
-  for (const auto &itr : def()->nodes) {
-    // use thread to submit
-    std::thread t(std::bind(
-        &BlockMakerBitcoin::_submitBlockLightThread,
-        this,
-        itr.rpcAddr_,
-        itr.rpcUserPwd_,
-        job_id,
-        blockHex));
-    t.detach();
-  }
-}
-void BlockMakerBitcoin::_submitBlockLightThread(
-    const string &rpcAddress,
-    const string &rpcUserpass,
-    const string &job_id,
-    const string &blockHex) {
-
-  string request =
-      "{\"jsonrpc\":\"1.0\",\"id\":\"1\",\"method\":\"submitblocklight\","
-      "\"params\":[\"";
-  request += blockHex + "\", \"";
-  request += job_id + "\"";
-  request += "]}";
-  LOG(INFO) << "submit block light to: " << rpcAddress;
-  DLOG(INFO) << "submitblock request: " << request;
-  // try N times
-  for (size_t i = 0; i < 3; i++) {
-    string response;
-    bool res = blockchainNodeRpcCall(
-        rpcAddress.c_str(), rpcUserpass.c_str(), request.c_str(), response);
-    // success
-    if (res == true) {
-      LOG(INFO) << "rpc call success, submit block light response: "
-                << response;
-      break;
-    }
-    // failure
-    LOG(ERROR) << "rpc call fail: " << response;
-  }
-}
-#endif // CHAIN_TYPE_BCH
-
 void BlockMakerBitcoin::consumeStratumJob(rd_kafka_message_t *rkmessage) {
   // check error
   if (rkmessage->err) {
@@ -1215,9 +1237,9 @@ void BlockMakerBitcoin::consumeRskSolvedShare(rd_kafka_message_t *rkmessage) {
 
   LOG(INFO) << "submit RSK block: " << blkHeader.GetHash().ToString();
 
-  // get gbtHash and rawgbt (vtxs)
+  // get gbtHash and rawgbt body
   uint256 gbtHash;
-  shared_ptr<vector<CTransactionRef>> vtxs;
+  shared_ptr<const RawGbtBody> body;
   {
     ScopeLock sl(jobIdMapLock_);
     if (jobId2GbtHash_.find(shareData.jobId_) != jobId2GbtHash_.end()) {
@@ -1226,17 +1248,18 @@ void BlockMakerBitcoin::consumeRskSolvedShare(rd_kafka_message_t *rkmessage) {
   }
   {
     ScopeLock ls(rawGbtLock_);
-    if (rawGbtMap_.find(gbtHash) == rawGbtMap_.end()) {
-      LOG(ERROR) << "can't find this gbthash in rawGbtMap_: "
+    auto itr = rawGbtBodyMap_.find(gbtHash);
+    if (itr == rawGbtBodyMap_.end()) {
+      LOG(ERROR) << "can't find this gbthash in rawGbtBodyMap_: "
                  << gbtHash.ToString();
       return;
     }
-    vtxs = rawGbtMap_[gbtHash];
+    body = itr->second;
   }
-  assert(vtxs.get() != nullptr);
+  assert(body.get() != nullptr);
 
   vector<uint256> vtxhashes;
-  vtxhashes.resize(1 + vtxs->size()); // coinbase + gbt txs
+  vtxhashes.reserve(1 + body->txids_.size()); // coinbase + gbt txs
 
   // put coinbase tx hash
   {
@@ -1247,14 +1270,11 @@ void BlockMakerBitcoin::consumeRskSolvedShare(rd_kafka_message_t *rkmessage) {
     CDataStream c(sdata, SER_NETWORK, PROTOCOL_VERSION);
     c >> tx;
 
-    vtxhashes[0] = tx.GetHash();
+    vtxhashes.push_back(tx.GetHash());
   }
 
   // put other tx hashes
-  for (size_t i = 0; i < vtxs->size(); i++) {
-    vtxhashes[i + 1] =
-        (*vtxs)[i]->GetHash(); // vtxs is a shared_ptr<vector<CTransactionRef>>
-  }
+  vtxhashes.insert(vtxhashes.end(), body->txids_.begin(), body->txids_.end());
 
   string blockHashHex = blkHeader.GetHash().ToString();
   string blockHeaderHex = EncodeHexBlockHeader(blkHeader);
@@ -53,8 +53,18 @@ protected:
   size_t kMaxRawGbtNum_; // how many rawgbt should we keep
   // key: gbthash
   std::deque<uint256> rawGbtQ_;
-  // key: gbthash, value: block template json
-  std::map<uint256, shared_ptr<vector<CTransactionRef>>> rawGbtMap_;
+
+  // A rawgbt's transactions (without coinbase tx) pre-serialized in the hex
+  // wire format of `submitblock`. Submitting a solved block is then only
+  // header + tx count + coinbase tx + body, nothing is re-serialized.
+  // The txids are all the merged mining paths need for merkle branches.
+  struct RawGbtBody {
+    string txCountHex_; // compact size, the coinbase tx is included
+    string txsHex_;
+    vector<uint256> txids_;
+  };
+  // key: gbthash
+  std::map<uint256, shared_ptr<const RawGbtBody>> rawGbtBodyMap_;
 
   mutex jobIdMapLock_;
   size_t kMaxStratumJobNum_;
@@ -83,8 +93,17 @@ protected:
   mutex jobIdAuxBlockInfoLock_;
   std::map<uint64_t, shared_ptr<AuxBlockInfo>> jobId2AuxHash_;
 
-  void insertRawGbt(
-      const uint256 &gbtHash, shared_ptr<vector<CTransactionRef>> vtxs);
+  void
+  insertRawGbt(const uint256 &gbtHash, shared_ptr<const RawGbtBody> body);
+
+  // Blocks are submitted with the shared AsyncHttpClient, its connections
+  // to the nodes are kept alive, so a solved block neither waits for a new
+  // thread nor for a new TCP/TLS handshake.
+  struct SubmitBlockTask {
+    shared_ptr<const string> request_; // shared by all nodes
+    string blockHash_;
+    std::chrono::steady_clock::time_point solvedTime_;
+  };
 
   thread threadConsumeRawGbt_;
   thread threadConsumeStratumJob_;
@@ -123,21 +142,12 @@ protected:
       const CBlockHeader &header,
       const uint64_t coinbaseValue,
       const int32_t blksize);
-#ifdef CHAIN_TYPE_BCH
-  void
-  submitBlockLightNonBlocking(const string &blockHex, const string &job_id);
-  void _submitBlockLightThread(
-      const string &rpcAddress,
-      const string &rpcUserpass,
-      const string &job_id,
-      const string &blockHex);
-#endif // CHAIN_TYPE_BCH
-
-  void submitBlockNonBlocking(const string &blockHex);
-  void _submitBlockThread(
-      const string &rpcAddress,
-      const string &rpcUserpass,
-      const string &blockHex);
+  void submitBlockNonBlocking(const SubmitBlockTask &task);
+  static void submitBlockToNode(
+      const NodeDefinition &node,
+      const SubmitBlockTask &task,
+      std::chrono::steady_clock::time_point submitTime,
+      size_t retry);
   bool checkBitcoinds();
 
 #ifndef CHAIN_TYPE_ZEC
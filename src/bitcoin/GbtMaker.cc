@@ -33,11 +33,21 @@
 #include "utilities_js.hpp"
 #include "hash.h"
 
+#ifdef CHAIN_TYPE_BTC
+#include <consensus/consensus.h>
+#include <consensus/merkle.h>
+#endif
+
 //
 // bitcoind zmq pub msg type: "hashblock", "hashtx", "rawblock", "rawtx"
 //
 static const std::string BITCOIND_ZMQ_HASHBLOCK = "hashblock";
 static const std::string BITCOIND_ZMQ_HASHTX = "hashtx";
+static const std::string BITCOIND_ZMQ_RAWTX = "rawtx";
+static const std::string BITCOIND_ZMQ_SEQUENCE = "sequence";
+
+// transactions per batch of rpc calls when updating the mempool mirror
+static const size_t kMempoolRpcBatchSize = 1000;
 
 //
 // namecoind zmq pub msg type: "hashblock", "hashtx", "rawblock", "rawtx"
@@ -131,6 +141,89 @@ static void ListenToZmqPublisher(
   LOG(INFO) << "stop thread listen to bitcoind";
 }
 
+#ifdef CHAIN_TYPE_BTC
+// Like ListenToZmqPublisher(), for the messages that come with content and
+// too often to be logged, such as the transactions of the mempool.
+void ListenToZmqMessages(
+    zmq::context_t &context,
+    const std::string &address,
+    const std::vector<std::string> &msgTypes,
+    const std::atomic<bool> &running,
+    uint32_t timeout,
+    std::function<void(const string &type, const zmq::message_t &content)>
+        callback) {
+  int timeoutMs = timeout * 1000;
+  LOG_IF(FATAL, timeoutMs <= 0) << "zmq timeout has to be positive!";
+
+  while (running) {
+    zmq::socket_t subscriber(context, ZMQ_SUB);
+    subscriber.connect(address);
+    for (const auto &msgType : msgTypes) {
+      subscriber.setsockopt(ZMQ_SUBSCRIBE, msgType.c_str(), msgType.size());
+    }
+    subscriber.setsockopt(ZMQ_RCVTIMEO, &timeoutMs, sizeof(timeoutMs));
+
+    while (running) {
+      zmq::message_t zType, zContent;
+      try {
+        // use block mode with receive timeout
+        if (subscriber.recv(&zType) == false) {
+          LOG(WARNING) << "zmq recv timeout, reconnecting to " << address;
+          break;
+        }
+        if (!zType.more() || !subscriber.recv(&zContent)) {
+          continue;
+        }
+        // skip the sequence number of the message
+        bool more = zContent.more();
+        while (more) {
+          zmq::message_t zPart;
+          subscriber.recv(&zPart);
+          more = zPart.more();
+        }
+      } catch (zmq::error_t &e) {
+        LOG(ERROR) << address << " zmq recv exception: " << e.what();
+        break; // break big while
+      }
+
+      callback(
+          string(static_cast<char *>(zType.data()), zType.size()), zContent);
+    }
+
+    subscriber.close();
+  }
+  LOG(INFO) << "stop thread listen to " << address;
+}
+
+// The amounts of the rpcs are in BTC with 8 decimals.
+static int64_t AmountFromJson(const JsonNode &node) {
+  return std::llround(strtod(node.start(), nullptr) * COIN);
+}
+
+static string MakeBatchRequest(
+    const char *method,
+    const vector<uint256> &txids,
+    size_t begin,
+    size_t end,
+    const char *extraParams) {
+  string request = "[";
+  for (size_t i = begin; i < end; i++) {
+    const string txid = txids[i].ToString();
+    Strings::Append(
+        request,
+        "%s{\"jsonrpc\":\"1.0\",\"id\":\"%s\",\"method\":\"%s\","
+        "\"params\":[\"%s\"%s]}",
+        i > begin ? "," : "",
+        txid,
+        method,
+        txid,
+        extraParams);
+  }
+  request += "]";
+  return request;
+}
+#endif
+
 ///////////////////////////////////  GbtMaker  /////////////////////////////////
 GbtMaker::GbtMaker(
     const string &zmqBitcoindAddr,
@@ -162,6 +255,17 @@ GbtMaker::GbtMaker(
 GbtMaker::~GbtMaker() {
 }
 
+#ifdef CHAIN_TYPE_BTC
+void GbtMaker::enableMempoolMirror(
+    int64_t minFeeIncrease, uint32_t reconcileInterval) {
+  LOG(INFO) << "assemble templates from the mempool mirror when their fees "
+            << "increase by " << minFeeIncrease << " satoshis";
+  mempoolMirrorEnabled_ = true;
+  mempoolMinFeeIncrease_ = minFeeIncrease;
+  mempoolReconcileInterval_ = reconcileInterval;
+}
+#endif
+
 bool GbtMaker::init() {
   map<string, string> options;
   // set to 1 (0 is an illegal value here), deliver msg as soon as possible.
@@ -220,6 +324,14 @@ bool GbtMaker::bitcoindRpcGBT(string &response) {
 }
 
 string GbtMaker::makeRawGbtMsg() {
+#ifdef CHAIN_TYPE_BTC
+  uint64_t tipUpdates = 0;
+  if (mempoolMirrorEnabled_) {
+    ScopeLock sl(mempoolLock_);
+    tipUpdates = mempool_.tipUpdates();
+  }
+#endif
+
   string gbt;
   if (!bitcoindRpcGBT(gbt)) {
     return "";
@@ -265,6 +377,13 @@ string GbtMaker::makeRawGbtMsg() {
             << Strings::Format("%08x", r["result"]["version"].uint32())
             << ", gbthash: " << gbtHash.ToString();
 
+#ifdef CHAIN_TYPE_BTC
+  if (mempoolMirrorEnabled_) {
+    JsonNode result = r["result"];
+    updateTemplateBase(result, tipUpdates);
+  }
+#endif
+
   return Strings::Format(
       "{\"created_at_ts\":%u,"
       "\"block_template_base64\":\"%s\","
@@ -297,6 +416,338 @@ void GbtMaker::submitRawGbtMsg(bool checkTime) {
   kafkaProduceMsg(rawGbtMsg.data(), rawGbtMsg.size());
 }
 
+#ifdef CHAIN_TYPE_BTC
+void GbtMaker::updateTemplateBase(JsonNode &result, uint64_t tipUpdates) {
+  auto base = std::make_unique<TemplateBase>();
+  base->tipUpdates_ = tipUpdates;
+  base->previousBlockHash_ = result["previousblockhash"].str();
+  base->height_ = result["height"].uint32();
+  base->version_ = result["version"].uint32();
+  base->bits_ = result["bits"].str();
+  base->minTime_ = result["mintime"].uint32();
+  base->weightLimit_ = result["weightlimit"].type() == Utilities::JS::type::Int
+      ? result["weightlimit"].int64()
+      : MAX_BLOCK_WEIGHT;
+  base->sigOpLimit_ = result["sigoplimit"].type() == Utilities::JS::type::Int
+      ? result["sigoplimit"].int64()
+      : MAX_BLOCK_SIGOPS_COST;
+
+  if (result["transactions"].type() != Utilities::JS::type::Array) {
+    LOG(ERROR) << "gbt without transactions, mempool mirror not updated";
+    return;
+  }
+
+  // bitcoind knows the fees and the sigops of its transactions
+  vector<MempoolTx> txs;
+  int64_t fees = 0;
+  for (JsonNode &node : result["transactions"].array()) {
+    MempoolTx tx;
+    if (node["data"].type() != Utilities::JS::type::Str ||
+        node["fee"].type() != Utilities::JS::type::Int ||
+        node["sigops"].type() != Utilities::JS::type::Int ||
+        node["depends"].type() != Utilities::JS::type::Array ||
+        !tx.decodeHex(node["data"].str())) {
+      LOG(ERROR) << "decode gbt transaction failure, "
+                 << "mempool mirror not updated";
+      return;
+    }
+    tx.fee_ = node["fee"].int64();
+    tx.sigOpCost_ = node["sigops"].int64();
+    // 1-based indexes of the parents in the template
+    for (JsonNode &depend : node["depends"].array()) {
+      const size_t index = depend.uint32();
+      if (index >= 1 && index <= txs.size()) {
+        tx.depends_.push_back(txs[index - 1].txid_);
+      }
+    }
+    fees += tx.fee_;
+    txs.push_back(std::move(tx));
+  }
+  base->subsidy_ = result["coinbasevalue"].int64() - fees;
+  base->fees_ = fees;
+
+  ScopeLock sl(mempoolLock_);
+  if (tipUpdates != mempool_.tipUpdates()) {
+    // requested before a block was connected or disconnected, its
+    // transactions may be confirmed
+    LOG(INFO) << "gbt of the previous tip, mempool mirror not updated";
+    return;
+  }
+  if (!templateBase_ ||
+      templateBase_->previousBlockHash_ != base->previousBlockHash_) {
+    // remove the transactions of the new block first
+    mempool_.requestReconcile();
+  }
+  for (auto &tx : txs) {
+    mempool_.add(std::move(tx));
+  }
+  templateBase_ = std::move(base);
+}
+
+bool GbtMaker::bitcoindRpcCall(const string &request, string &response) {
+  if (!blockchainNodeRpcCall(
+          bitcoindRpcAddr_.c_str(),
+          bitcoindRpcUserpass_.c_str(),
+          request.c_str(),
+          response)) {
+    LOG(ERROR) << "bitcoind rpc failure";
+    return false;
+  }
+  return true;
+}
+
+void GbtMaker::updateMempoolMirror() {
+  bool reconcile = false;
+  uint64_t requests = 0;
+  uint64_t version = 0;
+  {
+    ScopeLock sl(mempoolLock_);
+    requests = mempool_.reconcileRequests();
+    version = mempool_.version();
+    reconcile = mempool_.needsReconcile() ||
+        lastReconcileTime_ + mempoolReconcileInterval_ <= time(nullptr);
+  }
+
+  if (reconcile) {
+    lastReconcileTime_ = time(nullptr);
+
+    // with the mempool sequence, so that the transactions notified by zmq
+    // while it was made are not removed
+    string response;
+    if (!bitcoindRpcCall(
+            "{\"jsonrpc\":\"1.0\",\"id\":\"1\",\"method\":\"getrawmempool\","
+            "\"params\":[false,true]}",
+            response)) {
+      return;
+    }
+    JsonNode r;
+    if (!JsonNode::parse(
+            response.c_str(), response.c_str() + response.size(), r) ||
+        r["result"]["txids"].type() != Utilities::JS::type::Array ||
+        r["result"]["mempool_sequence"].type() != Utilities::JS::type::Int) {
+      LOG(ERROR) << "decode getrawmempool failure";
+      return;
+    }
+    vector<uint256> txids;
+    txids.reserve(r["result"]["txids"].array().size());
+    for (JsonNode &node : r["result"]["txids"].array()) {
+      txids.push_back(uint256S(node.str()));
+    }
+    const uint64_t mempoolSequence = r["result"]["mempool_sequence"].uint64();
+
+    vector<uint256> missing;
+    {
+      ScopeLock sl(mempoolLock_);
+      missing = mempool_.reconcile(txids, mempoolSequence, requests, version);
+    }
+    DLOG(INFO) << "mempool: " << txids.size() << " transactions, "
+               << missing.size() << " missing";
+
+    for (size_t i = 0; i < missing.size() && running_;
+         i += kMempoolRpcBatchSize) {
+      const size_t end = std::min(i + kMempoolRpcBatchSize, missing.size());
+      if (!bitcoindRpcCall(
+              MakeBatchRequest(
+                  "getrawtransaction", missing, i, end, ",false"),
+              response)) {
+        break;
+      }
+      JsonNode responses;
+      if (!JsonNode::parse(
+              response.c_str(),
+              response.c_str() + response.size(),
+              responses) ||
+          responses.type() != Utilities::JS::type::Array) {
+        LOG(ERROR) << "decode getrawtransaction failure";
+        break;
+      }
+
+      vector<MempoolTx> txs;
+      for (JsonNode &node : responses.array()) {
+        // confirmed or removed since getrawmempool
+        if (node["result"].type() != Utilities::JS::type::Str) {
+          continue;
+        }
+        MempoolTx tx;
+        if (tx.decodeHex(node["result"].str())) {
+          txs.push_back(std::move(tx));
+        }
+      }
+      ScopeLock sl(mempoolLock_);
+      for (auto &tx : txs) {
+        mempool_.add(std::move(tx));
+      }
+    }
+  }
+
+  // the fees and the parents of the new transactions, the rounds are
+  // limited in case bitcoind does not answer some of them
+  for (size_t round = 0; round < 100 && running_; round++) {
+    vector<uint256> txids;
+    {
+      ScopeLock sl(mempoolLock_);
+      txids = mempool_.txidsWithoutFee(kMempoolRpcBatchSize);
+    }
+    if (txids.empty()) {
+      break;
+    }
+
+    string response;
+    if (!bitcoindRpcCall(
+            MakeBatchRequest("getmempoolentry", txids, 0, txids.size(), ""),
+            response)) {
+      break;
+    }
+    JsonNode responses;
+    if (!JsonNode::parse(
+            response.c_str(), response.c_str() + response.size(), responses) ||
+        responses.type() != Utilities::JS::type::Array) {
+      LOG(ERROR) << "decode getmempoolentry failure";
+      break;
+    }
+
+    ScopeLock sl(mempoolLock_);
+    for (JsonNode &node : responses.array()) {
+      if (node["id"].type() != Utilities::JS::type::Str) {
+        continue;
+      }
+      const uint256 txid = uint256S(node["id"].str());
+      JsonNode entry = node["result"];
+      if (entry.type() != Utilities::JS::type::Obj ||
+          entry["depends"].type() != Utilities::JS::type::Array) {
+        // not in the mempool any more
+        mempool_.remove(txid);
+        continue;
+      }
+
+      // `fee` is deprecated since bitcoind 0.17
+      const int64_t fee = entry["fees"].type() == Utilities::JS::type::Obj
+          ? AmountFromJson(entry["fees"]["base"])
+          : AmountFromJson(entry["fee"]);
+      vector<uint256> depends;
+      for (JsonNode &depend : entry["depends"].array()) {
+        depends.push_back(uint256S(depend.str()));
+      }
+      mempool_.setFee(txid, fee, std::move(depends));
+    }
+  }
+}
+
+string GbtMaker::makeLocalRawGbtMsg() {
+  ScopeLock sl(mempoolLock_);
+  // wait for the template of bitcoind for the new tip
+  if (!templateBase_ || templateBase_->tipUpdates_ != mempool_.tipUpdates() ||
+      mempool_.needsReconcile() ||
+      mempool_.version() == lastAssembledVersion_) {
+    return "";
+  }
+  lastAssembledVersion_ = mempool_.version();
+
+  // leave room for the coinbase like bitcoind
+  const MempoolMirror::Template t = mempool_.assemble(
+      templateBase_->weightLimit_ - 4000, templateBase_->sigOpLimit_ - 400);
+  if (t.fees_ < templateBase_->fees_ + mempoolMinFeeIncrease_) {
+    return "";
+  }
+
+  string txsJson;
+  // the witness merkle tree, with the coinbase as zero
+  vector<uint256> leaves = {uint256()};
+  std::map<uint256, size_t> positions;
+  for (size_t i = 0; i < t.txs_.size(); i++) {
+    const MempoolTx &tx = *t.txs_[i];
+
+    string depends;
+    for (const auto &parent : tx.depends_) {
+      Strings::Append(
+          depends, "%s%u", depends.empty() ? "" : ",", positions[parent]);
+    }
+    positions[tx.txid_] = i + 1;
+
+    Strings::Append(
+        txsJson,
+        "%s{\"data\":\"%s\",\"txid\":\"%s\",\"hash\":\"%s\","
+        "\"depends\":[%s],\"fee\":%d,\"sigops\":%d,\"weight\":%d}",
+        i > 0 ? "," : "",
+        tx.data_,
+        tx.txid_.ToString(),
+        tx.hash_.ToString(),
+        depends,
+        tx.fee_,
+        tx.sigOpCost_,
+        tx.weight_);
+    leaves.push_back(tx.hash_);
+  }
+
+  // BIP141: OP_RETURN 0xaa21a9ed + double SHA256 of the witness root and the
+  // witness reserved value (zeros)
+  uint8_t witness[64] = {0};
+  const uint256 witnessRoot = ComputeMerkleRoot(leaves);
+  memcpy(witness, witnessRoot.begin(), 32);
+  const uint256 commitment = Hash(witness, witness + sizeof(witness));
+  string commitmentHex;
+  Bin2Hex(commitment.begin(), 32, commitmentHex);
+
+  const TemplateBase &base = *templateBase_;
+  const string gbt = Strings::Format(
+      "{\"result\":{"
+      "\"capabilities\":[\"proposal\"],"
+      "\"version\":%u,"
+      "\"previousblockhash\":\"%s\","
+      "\"transactions\":[%s],"
+      "\"coinbasevalue\":%d,"
+      "\"mintime\":%u,"
+      "\"curtime\":%u,"
+      "\"bits\":\"%s\","
+      "\"height\":%u,"
+      "\"sigoplimit\":%d,"
+      "\"weightlimit\":%d,"
+      "\"default_witness_commitment\":\"6a24aa21a9ed%s\""
+      "},\"error\":null,\"id\":\"1\"}",
+      base.version_,
+      base.previousBlockHash_,
+      txsJson,
+      base.subsidy_ + t.fees_,
+      base.minTime_,
+      std::max((uint32_t)time(nullptr), base.minTime_),
+      base.bits_,
+      base.height_,
+      base.sigOpLimit_,
+      base.weightLimit_,
+      commitmentHex);
+  const uint256 gbtHash = Hash(gbt.begin(), gbt.end());
+
+  LOG(INFO) << "local gbt height: " << base.height_
+            << ", prev_hash: " << base.previousBlockHash_
+            << ", txs: " << t.txs_.size() << ", fees: " << t.fees_
+            << " (+" << t.fees_ - base.fees_ << ")"
+            << ", weight: " << t.weight_ << ", mempool: " << mempool_.size()
+            << ", gbthash: " << gbtHash.ToString();
+  templateBase_->fees_ = t.fees_;
+
+  return Strings::Format(
+      "{\"created_at_ts\":%u,"
+      "\"block_template_base64\":\"%s\","
+      "\"gbthash\":\"%s\"}",
+      (uint32_t)time(nullptr),
+      EncodeBase64(gbt),
+      gbtHash.ToString());
+}
+
+void GbtMaker::submitLocalRawGbtMsg() {
+  ScopeLock sl(lock_);
+
+  const string rawGbtMsg = makeLocalRawGbtMsg();
+  if (rawGbtMsg.length() == 0) {
+    return;
+  }
+
+  // submit to Kafka
+  LOG(INFO) << "sumbit to Kafka, msg len: " << rawGbtMsg.size();
+  kafkaProduceMsg(rawGbtMsg.data(), rawGbtMsg.size());
+}
+#endif // CHAIN_TYPE_BTC
+
 #ifdef CHAIN_TYPE_BCH
 bool GbtMaker::bitcoindRpcGBTLight(string &response) {
   string request =
@@ -394,6 +845,35 @@ void GbtMaker::threadListenBitcoind() {
       [this]() { submitRawGbtMsg(false); });
 }
 
+#ifdef CHAIN_TYPE_BTC
+void GbtMaker::threadListenMempool() {
+  ListenToZmqMessages(
+      *zmqContext_,
+      zmqBitcoindAddr_,
+      {BITCOIND_ZMQ_RAWTX, BITCOIND_ZMQ_SEQUENCE},
+      running_,
+      zmqTimeout_,
+      [this](const string &type, const zmq::message_t &content) {
+        ScopeLock sl(mempoolLock_);
+        if (!mempool_.handleZmqMessage(
+                type, static_cast<const char *>(content.data()),
+                content.size())) {
+          LOG(WARNING) << "unknown zmq message " << type
+                       << ", size: " << content.size();
+        }
+      });
+}
+
+void GbtMaker::threadUpdateMempool() {
+  // the rpcs may take seconds with a large mempool, they must not delay
+  // the templates of the run loop
+  while (running_) {
+    std::this_thread::sleep_for(1s);
+    updateMempoolMirror();
+  }
+}
+#endif
+
 #ifdef CHAIN_TYPE_BCH
 void GbtMaker::runLightGbt() {
   auto threadListenBitcoind =
@@ -412,14 +892,33 @@ void GbtMaker::runLightGbt() {
 void GbtMaker::run() {
   auto threadListenBitcoind =
       std::thread(&GbtMaker::threadListenBitcoind, this);
+#ifdef CHAIN_TYPE_BTC
+  std::thread threadListenMempool;
+  std::thread threadUpdateMempool;
+  if (mempoolMirrorEnabled_) {
+    threadListenMempool = std::thread(&GbtMaker::threadListenMempool, this);
+    threadUpdateMempool = std::thread(&GbtMaker::threadUpdateMempool, this);
+  }
+#endif
 
   while (running_) {
     std::this_thread::sleep_for(1s);
     submitRawGbtMsg(true);
+#ifdef CHAIN_TYPE_BTC
+    if (mempoolMirrorEnabled_) {
+      submitLocalRawGbtMsg();
+    }
+#endif
   }
 
   if (threadListenBitcoind.joinable())
     threadListenBitcoind.join();
+#ifdef CHAIN_TYPE_BTC
+  if (threadListenMempool.joinable())
+    threadListenMempool.join();
+  if (threadUpdateMempool.joinable())
+    threadUpdateMempool.join();
+#endif
 }
 
 //////////////////////////////// NMCAuxBlockMaker //////////////////////////////
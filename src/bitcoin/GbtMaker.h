@@ -26,9 +26,25 @@
 
 #include "Common.h"
 #include "Kafka.h"
+#include "MempoolMirror.h"
 
+#include "utilities_js.hpp"
 #include "zmq.hpp"
 
+#ifdef CHAIN_TYPE_BTC
+// Receives the messages of `msgTypes` from a zmq publisher of bitcoind (the
+// topic, the content and the sequence number) until `running` is false.
+// It reconnects after `timeout` seconds without a message.
+void ListenToZmqMessages(
+    zmq::context_t &context,
+    const std::string &address,
+    const std::vector<std::string> &msgTypes,
+    const std::atomic<bool> &running,
+    uint32_t timeout,
+    std::function<void(const string &type, const zmq::message_t &content)>
+        callback);
+#endif
+
 /////////////////////////////////// GbtMaker ///////////////////////////////////
 class GbtMaker {
   atomic<bool> running_;
@@ -51,9 +67,47 @@ class GbtMaker {
   KafkaProducer kafkaProducer_;
   bool isCheckZmq_;
 
+#ifdef CHAIN_TYPE_BTC
+  // Between the calls of getblocktemplate, the templates are assembled from
+  // a mirror of the mempool and sent if their fees are higher enough.
+  bool mempoolMirrorEnabled_ = false;
+  int64_t mempoolMinFeeIncrease_ = 0;
+  uint32_t mempoolReconcileInterval_ = 10;
+  mutex mempoolLock_;
+  MempoolMirror mempool_;
+  time_t lastReconcileTime_ = 0;
+  uint64_t lastAssembledVersion_ = 0;
+
+  // the fields of the last template of bitcoind, guarded by mempoolLock_
+  struct TemplateBase {
+    string previousBlockHash_;
+    uint32_t height_ = 0;
+    uint32_t version_ = 0;
+    string bits_;
+    uint32_t minTime_ = 0;
+    int64_t subsidy_ = 0;
+    int64_t weightLimit_ = 0;
+    int64_t sigOpLimit_ = 0;
+    // of the last template sent, from bitcoind or the mirror
+    int64_t fees_ = 0;
+    // MempoolMirror::tipUpdates() when getblocktemplate was called
+    uint64_t tipUpdates_ = 0;
+  };
+  unique_ptr<TemplateBase> templateBase_;
+#endif
+
   bool bitcoindRpcGBT(string &resp);
   string makeRawGbtMsg();
   void submitRawGbtMsg(bool checkTime);
+#ifdef CHAIN_TYPE_BTC
+  void updateTemplateBase(JsonNode &result, uint64_t tipUpdates);
+  bool bitcoindRpcCall(const string &request, string &response);
+  void updateMempoolMirror();
+  string makeLocalRawGbtMsg();
+  void submitLocalRawGbtMsg();
+  void threadListenMempool();
+  void threadUpdateMempool();
+#endif
 
 #ifdef CHAIN_TYPE_BCH
   bool bitcoindRpcGBTLight(string &resp);
@@ -77,6 +131,11 @@ public:
       bool isCheckZmq);
   ~GbtMaker();
 
+#ifdef CHAIN_TYPE_BTC
+  // should be called before init()
+  void enableMempoolMirror(int64_t minFeeIncrease, uint32_t reconcileInterval);
+#endif
+
   bool init();
   void stop();
 #ifdef CHAIN_TYPE_BCH
@@ -0,0 +1,587 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#include "MempoolMirror.h"
+
+#ifdef CHAIN_TYPE_BTC
+
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+
+#include <consensus/consensus.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <streams.h>
+#include <version.h>
+
+#include <glog/logging.h>
+
+#include "Utils.h"
+
+// The sigops in the last push of `script`, which is the redeem script of
+// P2SH inputs and the witness script of P2WSH inputs.
+static int64_t LastPushSigOpCount(const CScript &script) {
+  CScript::const_iterator pc = script.begin();
+  opcodetype opcode;
+  std::vector<unsigned char> data;
+  while (pc < script.end()) {
+    if (!script.GetOp(pc, opcode, data) || opcode > OP_16) {
+      return 0;
+    }
+  }
+  return CScript(data.begin(), data.end()).GetSigOpCount(true);
+}
+
+static int64_t LastItemSigOpCount(const std::vector<unsigned char> &item) {
+  return CScript(item.begin(), item.end()).GetSigOpCount(true);
+}
+
+/////////////////////////////////// MempoolTx //////////////////////////////////
+bool MempoolTx::decode(const char *data, size_t len) {
+  CMutableTransaction mtx;
+  int64_t strippedSize = 0;
+  try {
+    CDataStream ss(data, data + len, SER_NETWORK, PROTOCOL_VERSION);
+    ss >> mtx;
+    if (!ss.empty()) {
+      return false;
+    }
+
+    CDataStream stripped(
+        SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+    stripped << mtx;
+    strippedSize = stripped.size();
+  } catch (const std::exception &e) {
+    LOG(ERROR) << "decode transaction failure: " << e.what();
+    return false;
+  }
+
+  const CTransaction tx(mtx);
+  txid_ = tx.GetHash();
+  hash_ = tx.GetWitnessHash();
+  Bin2Hex((const uint8_t *)data, len, data_);
+  weight_ = strippedSize * (WITNESS_SCALE_FACTOR - 1) + len;
+
+  // Counted without the spent outputs, so every input may be P2SH and every
+  // witness may be a script. More than the node counts, never less.
+  int64_t legacySigOps = 0;
+  int64_t witnessSigOps = 0;
+  prevouts_.clear();
+  for (const CTxIn &in : tx.vin) {
+    prevouts_.emplace_back(in.prevout.hash, in.prevout.n);
+    legacySigOps += in.scriptSig.GetSigOpCount(false);
+    legacySigOps += LastPushSigOpCount(in.scriptSig);
+    const auto &stack = in.scriptWitness.stack;
+    if (!stack.empty()) {
+      witnessSigOps += std::max<int64_t>(1, LastItemSigOpCount(stack.back()));
+    }
+  }
+  for (const CTxOut &out : tx.vout) {
+    legacySigOps += out.scriptPubKey.GetSigOpCount(false);
+  }
+  sigOpCost_ = legacySigOps * WITNESS_SCALE_FACTOR + witnessSigOps;
+  outputs_ = tx.vout.size();
+
+  return true;
+}
+
+bool MempoolTx::decodeHex(const string &hex) {
+  vector<char> bin;
+  if (!Hex2Bin(hex.data(), hex.size(), bin)) {
+    return false;
+  }
+  return decode(bin.data(), bin.size());
+}
+
+////////////////////////////////// MempoolMirror ///////////////////////////////
+void MempoolMirror::add(MempoolTx &&tx) {
+  auto itr = txs_.find(tx.txid_);
+  if (itr != txs_.end()) {
+    // getblocktemplate knows the fee and the sigops
+    if (tx.hasFee()) {
+      MempoolTx &known = itr->second.tx_;
+      unlinkDepends(known);
+      known.fee_ = tx.fee_;
+      known.depends_ = std::move(tx.depends_);
+      known.sigOpCost_ = tx.sigOpCost_;
+      linkDepends(known);
+      version_++;
+      refresh(known.txid_);
+    }
+    return;
+  }
+
+  for (const auto &prevout : tx.prevouts_) {
+    auto spender = spenders_.find(prevout);
+    if (spender != spenders_.end()) {
+      DLOG(INFO) << "mempool: " << tx.txid_.ToString() << " replaces "
+                 << spender->second.ToString();
+      removeWithDescendants(spender->second);
+    }
+  }
+  for (const auto &prevout : tx.prevouts_) {
+    spenders_[prevout] = tx.txid_;
+  }
+
+  const uint256 txid = tx.txid_;
+  linkDepends(tx);
+  Entry &entry = txs_.emplace(txid, Entry(std::move(tx))).first->second;
+  entry.added_ = ++version_;
+  // it may be the missing parent of others
+  refresh(txid);
+}
+
+void MempoolMirror::linkDepends(const MempoolTx &tx) {
+  if (!tx.hasFee()) {
+    return;
+  }
+  for (const auto &parent : tx.depends_) {
+    dependents_[parent].push_back(tx.txid_);
+  }
+}
+
+void MempoolMirror::unlinkDepends(const MempoolTx &tx) {
+  if (!tx.hasFee()) {
+    return;
+  }
+  for (const auto &parent : tx.depends_) {
+    auto itr = dependents_.find(parent);
+    if (itr == dependents_.end()) {
+      continue;
+    }
+    auto &children = itr->second;
+    children.erase(
+        std::remove(children.begin(), children.end(), tx.txid_),
+        children.end());
+    if (children.empty()) {
+      dependents_.erase(itr);
+    }
+  }
+}
+
+void MempoolMirror::erase(const uint256 &txid) {
+  auto itr = txs_.find(txid);
+  if (itr == txs_.end()) {
+    return;
+  }
+  const MempoolTx &tx = itr->second.tx_;
+  unlinkDepends(tx);
+  for (const auto &prevout : tx.prevouts_) {
+    auto spender = spenders_.find(prevout);
+    if (spender != spenders_.end() && spender->second == txid) {
+      spenders_.erase(spender);
+    }
+  }
+  txs_.erase(itr);
+  version_++;
+  // its descendants must not point to it any more
+  refresh(txid);
+}
+
+void MempoolMirror::clearFee(Entry &entry) {
+  unlinkDepends(entry.tx_);
+  entry.tx_.fee_ = -1;
+  refresh(entry.tx_.txid_);
+}
+
+void MempoolMirror::remove(const uint256 &txid) {
+  auto itr = txs_.find(txid);
+  if (itr == txs_.end()) {
+    return;
+  }
+  for (uint32_t n = 0; n < itr->second.tx_.outputs_; n++) {
+    auto spender = spenders_.find(std::make_pair(txid, n));
+    if (spender != spenders_.end()) {
+      auto child = txs_.find(spender->second);
+      if (child != txs_.end()) {
+        clearFee(child->second);
+      }
+    }
+  }
+  erase(txid);
+}
+
+void MempoolMirror::removeWithDescendants(const uint256 &txid) {
+  vector<uint256> pending = {txid};
+  while (!pending.empty()) {
+    const uint256 current = pending.back();
+    pending.pop_back();
+
+    auto itr = txs_.find(current);
+    if (itr == txs_.end()) {
+      continue;
+    }
+    for (uint32_t n = 0; n < itr->second.tx_.outputs_; n++) {
+      auto spender = spenders_.find(std::make_pair(current, n));
+      if (spender != spenders_.end()) {
+        pending.push_back(spender->second);
+      }
+    }
+    erase(current);
+  }
+}
+
+bool MempoolMirror::setFee(
+    const uint256 &txid, int64_t fee, vector<uint256> &&depends) {
+  auto itr = txs_.find(txid);
+  if (itr == txs_.end()) {
+    return false;
+  }
+  MempoolTx &tx = itr->second.tx_;
+  unlinkDepends(tx);
+  tx.fee_ = fee;
+  tx.depends_ = std::move(depends);
+  linkDepends(tx);
+  version_++;
+  refresh(txid);
+  return true;
+}
+
+void MempoolMirror::refresh(const uint256 &txid) {
+  // most transactions have no descendants
+  if (dependents_.find(txid) == dependents_.end()) {
+    auto itr = txs_.find(txid);
+    if (itr != txs_.end()) {
+      itr->second.state_ = Entry::STALE;
+      resolve(itr->second);
+    }
+    return;
+  }
+
+  vector<Entry *> stale;
+  vector<uint256> pending = {txid};
+  std::unordered_set<uint256, TxidHasher> visited;
+  while (!pending.empty()) {
+    const uint256 current = pending.back();
+    pending.pop_back();
+    if (!visited.insert(current).second) {
+      continue;
+    }
+
+    auto itr = txs_.find(current);
+    if (itr != txs_.end()) {
+      itr->second.state_ = Entry::STALE;
+      stale.push_back(&itr->second);
+    }
+    auto children = dependents_.find(current);
+    if (children != dependents_.end()) {
+      pending.insert(
+          pending.end(), children->second.begin(), children->second.end());
+    }
+  }
+
+  for (Entry *entry : stale) {
+    resolve(*entry);
+  }
+}
+
+bool MempoolMirror::resolve(Entry &e) {
+  if (e.state_ == Entry::USABLE) {
+    return true;
+  }
+  if (e.state_ != Entry::STALE) {
+    return false;
+  }
+  e.state_ = Entry::RESOLVING;
+  e.parents_.clear();
+  e.ancestors_.clear();
+
+  // its fee and its parents are known and its parents are usable
+  bool usable = e.tx_.hasFee();
+  for (const auto &parent : e.tx_.depends_) {
+    auto itr = txs_.find(parent);
+    if (!usable || itr == txs_.end() || !resolve(itr->second)) {
+      usable = false;
+      break;
+    }
+    e.parents_.push_back(&itr->second);
+  }
+  if (!usable) {
+    e.parents_.clear();
+    e.state_ = Entry::UNUSABLE;
+    return false;
+  }
+
+  for (Entry *p : e.parents_) {
+    e.ancestors_.push_back(p);
+    e.ancestors_.insert(
+        e.ancestors_.end(), p->ancestors_.begin(), p->ancestors_.end());
+  }
+  std::sort(e.ancestors_.begin(), e.ancestors_.end());
+  e.ancestors_.erase(
+      std::unique(e.ancestors_.begin(), e.ancestors_.end()),
+      e.ancestors_.end());
+
+  e.packageFee_ = e.tx_.fee_;
+  e.packageWeight_ = e.tx_.weight_;
+  e.packageSigOpCost_ = e.tx_.sigOpCost_;
+  for (const Entry *a : e.ancestors_) {
+    e.packageFee_ += a->tx_.fee_;
+    e.packageWeight_ += a->tx_.weight_;
+    e.packageSigOpCost_ += a->tx_.sigOpCost_;
+  }
+  e.state_ = Entry::USABLE;
+  return true;
+}
+
+bool MempoolMirror::handleZmqMessage(
+    const string &type, const char *content, size_t contentLen) {
+  if (type == "rawtx") {
+    MempoolTx tx;
+    if (!tx.decode(content, contentLen)) {
+      return false;
+    }
+    add(std::move(tx));
+    return true;
+  }
+
+  if (type == "sequence") {
+    // <32 bytes hash><1 byte label>[<8 bytes mempool sequence>]
+    if (contentLen < 33) {
+      return false;
+    }
+    // the hash is sent in the byte order of the RPCs
+    uint256 hash;
+    std::reverse_copy(content, content + 32, (char *)hash.begin());
+
+    switch (content[32]) {
+    case 'A': { // rawtx has the transaction
+      if (contentLen < 41) {
+        return false;
+      }
+      auto itr = txs_.find(hash);
+      if (itr != txs_.end()) {
+        uint64_t sequence = 0;
+        for (int i = 7; i >= 0; i--) {
+          sequence = sequence << 8 | (uint8_t)content[33 + i];
+        }
+        itr->second.mempoolSequence_ = sequence;
+      }
+      return true;
+    }
+    case 'R':
+      remove(hash);
+      return true;
+    case 'C':
+    case 'D':
+      tipUpdates_++;
+      requestReconcile();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+vector<uint256> MempoolMirror::reconcile(
+    const vector<uint256> &mempool,
+    uint64_t mempoolSequence,
+    uint64_t requests,
+    uint64_t version) {
+  std::unordered_set<uint256, TxidHasher> inMempool(
+      mempool.begin(), mempool.end());
+
+  vector<uint256> gone;
+  for (const auto &itr : txs_) {
+    const Entry &e = itr.second;
+    const bool beforeSnapshot = e.mempoolSequence_ != 0
+        ? e.mempoolSequence_ <= mempoolSequence
+        : e.added_ <= version;
+    if (beforeSnapshot && inMempool.find(itr.first) == inMempool.end()) {
+      gone.push_back(itr.first);
+    }
+  }
+  for (const auto &txid : gone) {
+    remove(txid);
+  }
+
+  vector<uint256> missing;
+  for (const auto &txid : mempool) {
+    if (txs_.find(txid) == txs_.end()) {
+      missing.push_back(txid);
+    }
+  }
+
+  reconciledRequests_ = requests;
+  return missing;
+}
+
+vector<uint256> MempoolMirror::txidsWithoutFee(size_t max) const {
+  vector<uint256> txids;
+  for (const auto &itr : txs_) {
+    if (txids.size() >= max) {
+      break;
+    }
+    if (!itr.second.tx_.hasFee()) {
+      txids.push_back(itr.first);
+    }
+  }
+  return txids;
+}
+
+const MempoolTx *MempoolMirror::get(const uint256 &txid) const {
+  auto itr = txs_.find(txid);
+  return itr == txs_.end() ? nullptr : &itr->second.tx_;
+}
+
+MempoolMirror::Template
+MempoolMirror::assemble(int64_t maxWeight, int64_t maxSigOpCost) const {
+  // A package is a transaction with its unselected ancestors, the ancestors
+  // are known, only what was selected changes here.
+  struct Slot {
+    const Entry *entry_;
+    vector<uint32_t> children_;
+    // of the package
+    int64_t fee_;
+    int64_t weight_;
+    int64_t sigOpCost_;
+    uint32_t version_ = 0;
+    bool selected_ = false;
+    bool failed_ = false;
+  };
+
+  vector<Slot> slots;
+  slots.reserve(txs_.size());
+  for (const auto &itr : txs_) {
+    const Entry &e = itr.second;
+    if (e.state_ != Entry::USABLE) {
+      continue;
+    }
+    e.slot_ = slots.size();
+    slots.push_back(
+        {&e, {}, e.packageFee_, e.packageWeight_, e.packageSigOpCost_});
+  }
+  for (uint32_t i = 0; i < slots.size(); i++) {
+    for (const Entry *p : slots[i].entry_->parents_) {
+      slots[p->slot_].children_.push_back(i);
+    }
+  }
+
+  struct Candidate {
+    int64_t fee_;
+    int64_t weight_;
+    uint32_t index_;
+    uint32_t version_;
+
+    bool operator<(const Candidate &r) const {
+      // the lower fee rate is the lower priority
+      return (double)fee_ * r.weight_ < (double)r.fee_ * weight_;
+    }
+  };
+  vector<Candidate> candidates;
+  candidates.reserve(slots.size());
+  for (uint32_t i = 0; i < slots.size(); i++) {
+    candidates.push_back({slots[i].fee_, slots[i].weight_, i, 0});
+  }
+  std::priority_queue<Candidate> queue(
+      std::less<Candidate>(), std::move(candidates));
+
+  Template t;
+  size_t failures = 0;
+  vector<uint32_t> package;
+  vector<uint32_t> descendants;
+  vector<uint32_t> updated;
+  // marks the descendants already updated for a selected transaction
+  vector<uint32_t> stamps(slots.size(), 0);
+  uint32_t stamp = 0;
+
+  while (!queue.empty()) {
+    const Candidate c = queue.top();
+    queue.pop();
+    Slot &s = slots[c.index_];
+    if (s.selected_ || s.failed_ || c.version_ != s.version_) {
+      continue;
+    }
+
+    if (t.weight_ + s.weight_ > maxWeight ||
+        t.sigOpCost_ + s.sigOpCost_ > maxSigOpCost) {
+      s.failed_ = true;
+      // give up when the block is almost full, like bitcoind
+      if (++failures > 1000 && t.weight_ > maxWeight - 4000) {
+        break;
+      }
+      continue;
+    }
+
+    // a parent has fewer ancestors than its children
+    package.clear();
+    for (const Entry *a : s.entry_->ancestors_) {
+      if (!slots[a->slot_].selected_) {
+        package.push_back(a->slot_);
+      }
+    }
+    package.push_back(c.index_);
+    std::sort(package.begin(), package.end(), [&](uint32_t a, uint32_t b) {
+      return slots[a].entry_->ancestors_.size() <
+          slots[b].entry_->ancestors_.size();
+    });
+
+    updated.clear();
+    for (uint32_t i : package) {
+      Slot &selected = slots[i];
+      const MempoolTx &tx = selected.entry_->tx_;
+      selected.selected_ = true;
+      t.txs_.push_back(&tx);
+      t.fees_ += tx.fee_;
+      t.weight_ += tx.weight_;
+      t.sigOpCost_ += tx.sigOpCost_;
+
+      // the packages of the descendants do not have it any more
+      stamp++;
+      descendants.assign(selected.children_.begin(), selected.children_.end());
+      while (!descendants.empty()) {
+        const uint32_t d = descendants.back();
+        descendants.pop_back();
+        Slot &descendant = slots[d];
+        if (descendant.selected_ || stamps[d] == stamp) {
+          continue;
+        }
+        stamps[d] = stamp;
+        descendant.fee_ -= tx.fee_;
+        descendant.weight_ -= tx.weight_;
+        descendant.sigOpCost_ -= tx.sigOpCost_;
+        descendant.version_++;
+        updated.push_back(d);
+        descendants.insert(
+            descendants.end(),
+            descendant.children_.begin(),
+            descendant.children_.end());
+      }
+    }
+
+    std::sort(updated.begin(), updated.end());
+    updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+    for (uint32_t d : updated) {
+      Slot &descendant = slots[d];
+      if (!descendant.selected_) {
+        queue.push(
+            {descendant.fee_, descendant.weight_, d, descendant.version_});
+      }
+    }
+  }
+
+  return t;
+}
+
+#endif // #ifdef CHAIN_TYPE_BTC
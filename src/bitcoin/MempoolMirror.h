@@ -0,0 +1,195 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#ifndef MEMPOOL_MIRROR_H_
+#define MEMPOOL_MIRROR_H_
+
+// Bitcoin only. The templates of the other chains carry more than the
+// transactions (e.g. MWEB of Litecoin), gbtmaker always asks their nodes.
+#ifdef CHAIN_TYPE_BTC
+
+#include "Common.h"
+
+#include <uint256.h>
+
+#include <unordered_map>
+
+/////////////////////////////////// MempoolTx //////////////////////////////////
+struct MempoolTx {
+  uint256 txid_;
+  uint256 hash_; // wtxid
+  string data_; // hex of the wire format, the `data` of getblocktemplate
+  // The fee and the parents in the mempool need the spent outputs, which
+  // rawtx does not have, so they are unknown until getmempoolentry or
+  // getblocktemplate tell them.
+  int64_t fee_ = -1;
+  vector<uint256> depends_;
+  int64_t weight_ = 0;
+  // an upper bound unless it came from getblocktemplate
+  int64_t sigOpCost_ = 0;
+  vector<std::pair<uint256, uint32_t>> prevouts_;
+  uint32_t outputs_ = 0;
+
+  bool hasFee() const { return fee_ >= 0; }
+
+  // Decodes a transaction in the wire format, as sent by zmq rawtx.
+  bool decode(const char *data, size_t len);
+  bool decodeHex(const string &hex);
+};
+
+////////////////////////////////// MempoolMirror ///////////////////////////////
+//
+// A copy of the mempool of bitcoind, kept up to date by its zmq `rawtx` and
+// `sequence` notifications and by reconciling it with getrawmempool, so that
+// gbtmaker can assemble templates without calling getblocktemplate.
+//
+// The ancestors of every transaction and the totals of its package are
+// updated with each change, for the transaction and its descendants only,
+// so assemble() does not rebuild the graph of the mempool.
+//
+// Not thread safe, GbtMaker serializes the calls.
+//
+class MempoolMirror {
+public:
+  struct Template {
+    vector<const MempoolTx *> txs_; // parents before children
+    int64_t fees_ = 0;
+    int64_t weight_ = 0;
+    int64_t sigOpCost_ = 0;
+  };
+
+  // Adds the transaction, or sets the fee and the parents of a known one if
+  // `tx` has them. Transactions spending the same outputs are removed with
+  // their descendants, like the node does when replacing them, in case the
+  // notifications of their removal were lost.
+  void add(MempoolTx &&tx);
+  // Removes the transaction. Its children lose the fee until it is fetched
+  // again, the parent may have been removed by mistake.
+  void remove(const uint256 &txid);
+  bool setFee(const uint256 &txid, int64_t fee, vector<uint256> &&depends);
+
+  // Handles a zmq message of bitcoind: `rawtx` adds a transaction and
+  // `sequence` tells its mempool sequence, removes one or tells about a
+  // block. Returns false if the message is not understood.
+  bool handleZmqMessage(
+      const string &type, const char *content, size_t contentLen);
+
+  // Removes the transactions that are not in `mempool`, the txids of
+  // getrawmempool at `mempoolSequence`, and returns the txids that are
+  // missing here. `requests` and `version` are reconcileRequests() and
+  // version() before getrawmempool was called. Transactions added after
+  // the snapshot are kept: by their mempool sequence, or if it is unknown,
+  // because they were added here after the call.
+  vector<uint256> reconcile(
+      const vector<uint256> &mempool,
+      uint64_t mempoolSequence,
+      uint64_t requests,
+      uint64_t version);
+  // Requested by blocks, their transactions are only removed by reconcile().
+  void requestReconcile() { reconcileRequests_++; }
+  uint64_t reconcileRequests() const { return reconcileRequests_; }
+  bool needsReconcile() const {
+    return reconciledRequests_ != reconcileRequests_;
+  }
+  // bumped by every block connected or disconnected, a template requested
+  // before is for the previous tip
+  uint64_t tipUpdates() const { return tipUpdates_; }
+
+  // at most `max` txids of the transactions without a fee
+  vector<uint256> txidsWithoutFee(size_t max) const;
+
+  // Selects the transactions with the highest fee rate, counting the
+  // unselected ancestors of a transaction with it like bitcoind does.
+  // Transactions without a fee, and their descendants, are left out.
+  Template assemble(int64_t maxWeight, int64_t maxSigOpCost) const;
+
+  const MempoolTx *get(const uint256 &txid) const;
+  size_t size() const { return txs_.size(); }
+  // bumped by every change
+  uint64_t version() const { return version_; }
+
+private:
+  struct TxidHasher {
+    size_t operator()(const uint256 &txid) const {
+      size_t h;
+      memcpy(&h, txid.begin(), sizeof(h));
+      return h;
+    }
+  };
+  struct OutPointHasher {
+    size_t operator()(const std::pair<uint256, uint32_t> &o) const {
+      return TxidHasher()(o.first) ^ o.second;
+    }
+  };
+
+  // A transaction and its place in the graph of the mempool.
+  struct Entry {
+    enum State : uint8_t { STALE, RESOLVING, USABLE, UNUSABLE };
+
+    MempoolTx tx_;
+    // usable if the fees of the transaction and of all its ancestors are
+    // known
+    State state_ = STALE;
+    vector<Entry *> parents_;
+    vector<Entry *> ancestors_; // without itself
+    // of the transaction with its ancestors
+    int64_t packageFee_ = 0;
+    int64_t packageWeight_ = 0;
+    int64_t packageSigOpCost_ = 0;
+    // version() when it was added
+    uint64_t added_ = 0;
+    // of the `A` message of zmq sequence, 0 if unknown
+    uint64_t mempoolSequence_ = 0;
+    // scratch of assemble()
+    mutable uint32_t slot_ = 0;
+
+    explicit Entry(MempoolTx &&tx)
+      : tx_(std::move(tx)) {}
+  };
+
+  void removeWithDescendants(const uint256 &txid);
+  void erase(const uint256 &txid);
+  void clearFee(Entry &entry);
+  void linkDepends(const MempoolTx &tx);
+  void unlinkDepends(const MempoolTx &tx);
+  // Resolves the transaction and its descendants again after a change.
+  void refresh(const uint256 &txid);
+  bool resolve(Entry &entry);
+
+  std::unordered_map<uint256, Entry, TxidHasher> txs_;
+  // txid -> the transactions with a fee that depend on it, which may not be
+  // in the mirror (yet)
+  std::unordered_map<uint256, vector<uint256>, TxidHasher> dependents_;
+  // spent output -> txid of the spender
+  std::unordered_map<std::pair<uint256, uint32_t>, uint256, OutPointHasher>
+      spenders_;
+  uint64_t version_ = 0;
+  // the mirror starts empty
+  uint64_t reconcileRequests_ = 1;
+  uint64_t reconciledRequests_ = 0;
+  uint64_t tipUpdates_ = 0;
+};
+
+#endif
+
+#endif // MEMPOOL_MIRROR_H_
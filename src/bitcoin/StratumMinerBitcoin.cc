@@ -108,14 +108,19 @@ void StratumMinerBitcoin::handleRequest_Submit(
   //  params[4] = EQUIHASH_SOLUTION
   uint32_t nTime = SwapUint(jparams.children()->at(2).uint32_hex());
   string nonce2Str = jparams.children()->at(3).str();
-  if (nonce2Str.size() != 56) {
+
+  // nonce = sessionId (big-endian) || NONCE_2, in the order of the hex
+  const uint32_t sessionId = session.getSessionId();
+  uint8_t *noncePtr = nonce.nonce.begin();
+  noncePtr[0] = (uint8_t)(sessionId >> 24);
+  noncePtr[1] = (uint8_t)(sessionId >> 16);
+  noncePtr[2] = (uint8_t)(sessionId >> 8);
+  noncePtr[3] = (uint8_t)sessionId;
+  if (nonce2Str.size() != 56 ||
+      !Hex2BinFixed(nonce2Str.c_str(), noncePtr + 4, 28)) {
     session.responseError(idStr, StratumStatus::ILLEGAL_PARARMS);
+    return;
   }
-
-  nonce.nonce = SwapUint(uint256S(Strings::Format(
-      "%08x%s",
-      session.getSessionId(),
-      jparams.children()->at(3).str().c_str())));
   nonce.solution = jparams.children()->at(4).str();
 
   // ZCash's share doesn't have them
@@ -141,7 +146,7 @@ void StratumMinerBitcoin::handleRequest_Submit(
 #endif
 
   handleRequest_Submit(
-      idStr, shortJobId, extraNonce2, nonce, nTime, versionMask);
+      idStr, shortJobId, extraNonce2, std::move(nonce), nTime, versionMask);
 }
 
 void StratumMinerBitcoin::handleExMessage_SubmitShare(
@@ -296,10 +301,6 @@ void StratumMinerBitcoin::handleRequest_Submit(
   uint256 jobTarget;
   BitcoinDifficulty::DiffToTarget(share.sharediff(), jobTarget);
 
-  // we send share to kafka by default, but if there are lots of invalid
-  // shares in a short time, we just drop them.
-  bool isSendShareToKafka = true;
-
 #ifdef CHAIN_TYPE_ZEC
   LocalShare localShare(
       nonce.nonce.GetCheapHash(),
@@ -314,7 +315,37 @@ void StratumMinerBitcoin::handleRequest_Submit(
   if (!localJob->addLocalShare(localShare)) {
     share.set_status(StratumStatus::DUPLICATE_SHARE);
   } else {
+#ifdef CHAIN_TYPE_ZEC
+    // The equihash solution is checked on the verifier threads, the share is
+    // handled when the check is done.
+    std::weak_ptr<bool> alive = alive_;
+    const size_t chainId = localJob->chainId_;
+    const uint32_t clientIp = session.getClientIp();
+    server.checkShareAsync(
+        chainId,
+        share,
+        session.getSessionId(),
+        extraNonce2Hex,
+        nTime,
+        std::move(nonce),
+        versionMask,
+        jobTarget,
+        worker.fullName_,
+        [this, alive, &server, idStr, share, chainId, clientIp, versionMask](
+            int32_t status) mutable {
+          share.set_status(status);
+          if (alive.expired()) {
+            // the miner is gone, the share is still counted
+            sendShare2Kafka(server, chainId, share, clientIp);
+            return;
+          }
+          handleCheckedShare(idStr, share, chainId, versionMask);
+        });
+    return;
+#else
     // check block header
+    prometheus::HistogramTimer timer(
+        *server.chains_[localJob->chainId_].shareCheckSeconds_);
     share.set_status(server.checkShare(
         localJob->chainId_,
         share,
@@ -330,12 +361,28 @@ void StratumMinerBitcoin::handleRequest_Submit(
         &localJob->userCoinbaseInfo_
 #endif
         ));
+#endif
   }
 
+  handleCheckedShare(idStr, share, localJob->chainId_, versionMask);
+}
+
+void StratumMinerBitcoin::handleCheckedShare(
+    const string &idStr,
+    const ShareBitcoin &share,
+    size_t chainId,
+    uint32_t versionMask) {
+  auto &session = getSession();
+  auto &server = session.getServer();
+  auto &worker = session.getWorker();
+
+  // we send share to kafka by default, but if there are lots of invalid
+  // shares in a short time, we just drop them.
+  bool isSendShareToKafka = true;
+
   DLOG(INFO) << share.toString();
 
-  if (!handleShare(
-          idStr, share.status(), share.sharediff(), localJob->chainId_)) {
+  if (!handleShare(idStr, share.status(), share.sharediff(), chainId)) {
     // add invalid share to counter
     invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
 
@@ -358,29 +405,36 @@ void StratumMinerBitcoin::handleRequest_Submit(
   }
 
   if (isSendShareToKafka) {
-    if (server.useShareV1()) {
-      ShareBitcoinBytesV1 sharev1;
-      sharev1.jobId_ = share.jobid();
-      sharev1.workerHashId_ = share.workerhashid();
-      sharev1.ip_ = ip.toIpv4Int();
-      sharev1.userId_ = share.userid();
-      sharev1.shareDiff_ = share.sharediff();
-      sharev1.timestamp_ = share.timestamp();
-      sharev1.blkBits_ = share.blkbits();
-      sharev1.result_ = StratumStatus::isAccepted(share.status())
-          ? ShareBitcoinBytesV1::ACCEPT
-          : ShareBitcoinBytesV1::REJECT;
-
-      server.sendShare2Kafka(
-          localJob->chainId_, (char *)&sharev1, sizeof(sharev1));
-    } else {
-      std::string message;
-      uint32_t size = 0;
-      if (!share.SerializeToArrayWithVersion(message, size)) {
-        LOG(ERROR) << "share SerializeToBuffer failed!" << share.toString();
-        return;
-      }
-      server.sendShare2Kafka(localJob->chainId_, message.data(), size);
+    sendShare2Kafka(server, chainId, share, session.getClientIp());
+  }
+}
+
+void StratumMinerBitcoin::sendShare2Kafka(
+    ServerBitcoin &server,
+    size_t chainId,
+    const ShareBitcoin &share,
+    uint32_t clientIp) {
+  if (server.useShareV1()) {
+    ShareBitcoinBytesV1 sharev1;
+    sharev1.jobId_ = share.jobid();
+    sharev1.workerHashId_ = share.workerhashid();
+    sharev1.ip_ = clientIp;
+    sharev1.userId_ = share.userid();
+    sharev1.shareDiff_ = share.sharediff();
+    sharev1.timestamp_ = share.timestamp();
+    sharev1.blkBits_ = share.blkbits();
+    sharev1.result_ = StratumStatus::isAccepted(share.status())
+        ? ShareBitcoinBytesV1::ACCEPT
+        : ShareBitcoinBytesV1::REJECT;
+
+    server.sendShare2Kafka(chainId, (char *)&sharev1, sizeof(sharev1));
+  } else {
+    std::string message;
+    uint32_t size = 0;
+    if (!share.SerializeToArrayWithVersion(message, size)) {
+      LOG(ERROR) << "share SerializeToBuffer failed!" << share.toString();
+      return;
     }
+    server.sendShare2Kafka(chainId, message.data(), size);
   }
 }
@@ -60,6 +60,22 @@ private:
       BitcoinNonceType nonce,
       uint32_t nTime,
       uint32_t versionMask);
+  // responds to the miner and sends the checked share to kafka
+  void handleCheckedShare(
+      const std::string &idStr,
+      const ShareBitcoin &share,
+      size_t chainId,
+      uint32_t versionMask);
+  static void sendShare2Kafka(
+      ServerBitcoin &server,
+      size_t chainId,
+      const ShareBitcoin &share,
+      uint32_t clientIp);
+
+#ifdef CHAIN_TYPE_ZEC
+  // expires with the miner, the shares being checked hold weak references
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+#endif
 };
 
 #endif // #ifndef STRATUM_MINER_BITCOIN_H_
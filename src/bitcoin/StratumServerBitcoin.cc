@@ -27,6 +27,7 @@
 #include "StratumMiner.h"
 #include "StratumMinerBitcoin.h"
 #include "BitcoinUtils.h"
+#include "VerifierPool.h"
 
 #include "rsk/RskSolvedShareData.h"
 
@@ -291,7 +292,7 @@ void StratumJobExBitcoin::generateBlockHeader(
     const uint32_t nBits,
     const int32_t nVersion,
     const uint32_t nTime,
-    const BitcoinNonceType nonce,
+    const BitcoinNonceType &nonce,
     const uint32_t versionMask,
     string *userCoinbaseInfo) {
 
@@ -301,9 +302,8 @@ void StratumJobExBitcoin::generateBlockHeader(
   header->nTime = nTime;
 
 #ifdef CHAIN_TYPE_ZEC
+  // nSolution is decoded by the caller, see DecodeEquihashSolution()
   header->nNonce = nonce.nonce;
-  header->nSolution =
-      ParseHex(nonce.solution.substr(getSolutionVintSize() * 2));
 
   auto sjob = std::static_pointer_cast<StratumJobBitcoin>(sjob_);
 
@@ -416,6 +416,10 @@ bool ServerBitcoin::setupInternal(const libconfig::Config &config) {
     }
   }
 
+#ifdef CHAIN_TYPE_ZEC
+  verifierPool_ = VerifierPool::create(*this, config);
+#endif
+
   return true;
 }
 
@@ -454,17 +458,18 @@ void ServerBitcoin::sendSolvedShare2Kafka(
   ServerBase::sendSolvedShare2Kafka(chainId, buf.data(), buf.size());
 }
 
-int ServerBitcoin::checkShare(
+int ServerBitcoin::prepareShare(
     size_t chainId,
     const ShareBitcoin &share,
     const uint32_t extraNonce1,
     const string &extraNonce2Hex,
     const uint32_t nTime,
-    const BitcoinNonceType nonce,
+    const BitcoinNonceType &nonce,
     const uint32_t versionMask,
-    const uint256 &jobTarget,
-    const string &workFullName,
-    string *userCoinbaseInfo) {
+    string *userCoinbaseInfo,
+    shared_ptr<StratumJobBitcoin> &sjob,
+    CBlockHeader &header,
+    std::vector<char> &coinbaseBin) {
 
   auto exJobPtr = std::static_pointer_cast<StratumJobExBitcoin>(
       GetJobRepository(chainId)->getStratumJobEx(share.jobid()));
@@ -472,7 +477,7 @@ int ServerBitcoin::checkShare(
     return StratumStatus::JOB_NOT_FOUND;
   }
 
-  auto sjob = std::static_pointer_cast<StratumJobBitcoin>(exJobPtr->sjob_);
+  sjob = std::static_pointer_cast<StratumJobBitcoin>(exJobPtr->sjob_);
 
   if (nTime < sjob->minTime_) {
     return StratumStatus::TIME_TOO_OLD;
@@ -486,8 +491,6 @@ int ServerBitcoin::checkShare(
     return StratumStatus::ILLEGAL_VERMASK;
   }
 
-  CBlockHeader header;
-  std::vector<char> coinbaseBin;
   exJobPtr->generateBlockHeader(
       &header,
       &coinbaseBin,
@@ -502,14 +505,6 @@ int ServerBitcoin::checkShare(
       versionMask,
       userCoinbaseInfo);
 
-#ifdef CHAIN_TYPE_LTC
-  uint256 blkHash = header.GetPoWHash();
-#else
-  uint256 blkHash = header.GetHash();
-#endif
-  arith_uint256 bnBlockHash = UintToArith256(blkHash);
-  arith_uint256 bnNetworkTarget = UintToArith256(sjob->networkTarget_);
-
 #ifdef CHAIN_TYPE_ZEC
   DLOG(INFO) << Strings::Format(
       "CBlockHeader nVersion: %08x, hashPrevBlock: %s, hashMerkleRoot: %s, "
@@ -521,6 +516,44 @@ int ServerBitcoin::checkShare(
       header.nTime,
       header.nBits,
       header.nNonce.ToString().c_str());
+#endif
+
+  return StratumStatus::ACCEPT;
+}
+
+int ServerBitcoin::checkShare(
+    size_t chainId,
+    const ShareBitcoin &share,
+    const uint32_t extraNonce1,
+    const string &extraNonce2Hex,
+    const uint32_t nTime,
+    const BitcoinNonceType &nonce,
+    const uint32_t versionMask,
+    const uint256 &jobTarget,
+    const string &workFullName,
+    string *userCoinbaseInfo) {
+
+  shared_ptr<StratumJobBitcoin> sjob;
+  CBlockHeader header;
+  std::vector<char> coinbaseBin;
+  int status = prepareShare(
+      chainId,
+      share,
+      extraNonce1,
+      extraNonce2Hex,
+      nTime,
+      nonce,
+      versionMask,
+      userCoinbaseInfo,
+      sjob,
+      header,
+      coinbaseBin);
+  if (status != StratumStatus::ACCEPT) {
+    return status;
+  }
+
+#ifdef CHAIN_TYPE_ZEC
+  DecodeEquihashSolution(nonce.solution, header.nSolution);
 
   // check equihash solution
   if (isEnableSimulator_ == false &&
@@ -529,6 +562,117 @@ int ServerBitcoin::checkShare(
   }
 #endif
 
+#ifdef CHAIN_TYPE_LTC
+  uint256 blkHash = header.GetPoWHash();
+#else
+  uint256 blkHash = header.GetHash();
+#endif
+
+  return processShare(
+      chainId,
+      share,
+      *sjob,
+      header,
+      blkHash,
+      coinbaseBin,
+      jobTarget,
+      workFullName);
+}
+
+#ifdef CHAIN_TYPE_ZEC
+void ServerBitcoin::checkShareAsync(
+    size_t chainId,
+    const ShareBitcoin &share,
+    const uint32_t extraNonce1,
+    const string &extraNonce2Hex,
+    const uint32_t nTime,
+    BitcoinNonceType nonce,
+    const uint32_t versionMask,
+    const uint256 &jobTarget,
+    const string &workFullName,
+    std::function<void(int32_t status)> callback) {
+
+  if (!verifierPool_ || isEnableSimulator_) {
+    callback(checkShare(
+        chainId,
+        share,
+        extraNonce1,
+        extraNonce2Hex,
+        nTime,
+        nonce,
+        versionMask,
+        jobTarget,
+        workFullName));
+    return;
+  }
+
+  struct EquihashTask {
+    CBlockHeader header_;
+    std::vector<char> coinbaseBin_;
+    string solutionHex_; // decoded by the verifier thread
+    bool valid_ = false;
+    uint256 blkHash_;
+  };
+
+  auto task = std::make_shared<EquihashTask>();
+  shared_ptr<StratumJobBitcoin> sjob;
+  int status = prepareShare(
+      chainId,
+      share,
+      extraNonce1,
+      extraNonce2Hex,
+      nTime,
+      nonce,
+      versionMask,
+      nullptr,
+      sjob,
+      task->header_,
+      task->coinbaseBin_);
+  if (status != StratumStatus::ACCEPT) {
+    callback(status);
+    return;
+  }
+
+  task->solutionHex_.swap(nonce.solution);
+  verifierPool_->submit(
+      [task]() {
+        DecodeEquihashSolution(task->solutionHex_, task->header_.nSolution);
+        task->valid_ = CheckEquihashSolution(&task->header_, Params());
+        if (task->valid_) {
+          task->blkHash_ = task->header_.GetHash();
+        }
+      },
+      [this, chainId, share, sjob, jobTarget, workFullName, callback, task]() {
+        if (!task->valid_) {
+          callback(StratumStatus::INVALID_SOLUTION);
+          return;
+        }
+        callback(processShare(
+            chainId,
+            share,
+            *sjob,
+            task->header_,
+            task->blkHash_,
+            task->coinbaseBin_,
+            jobTarget,
+            workFullName));
+      });
+}
+#endif
+
+int ServerBitcoin::processShare(
+    size_t chainId,
+    const ShareBitcoin &share,
+    const StratumJobBitcoin &sjob,
+    const CBlockHeader &header,
+    const uint256 &blkHash,
+    const std::vector<char> &coinbaseBin,
+    const uint256 &jobTarget,
+    const string &workFullName) {
+
+  arith_uint256 bnBlockHash = UintToArith256(blkHash);
+  arith_uint256 bnNetworkTarget = UintToArith256(sjob.networkTarget_);
+
   //
   // found new block
   //
@@ -540,7 +684,7 @@ int ServerBitcoin::checkShare(
     foundBlock.jobId_ = share.jobid();
     foundBlock.workerId_ = share.workerhashid();
     foundBlock.userId_ = share.userid();
-    foundBlock.height_ = sjob->height_;
+    foundBlock.height_ = sjob.height_;
     foundBlock.headerData_.set(header);
     snprintf(
         foundBlock.workerFullName_,
@@ -551,7 +695,7 @@ int ServerBitcoin::checkShare(
     // send
     sendSolvedShare2Kafka(chainId, &foundBlock, coinbaseBin);
 
-    if (sjob->proxyJobDifficulty_ > 0) {
+    if (sjob.proxyJobDifficulty_ > 0) {
       LOG(INFO) << ">>>> solution found: " << blkHash.ToString()
                 << ", jobId: " << share.jobid()
                 << ", userId: " << share.userid() << ", by: " << workFullName
@@ -568,21 +712,21 @@ int ServerBitcoin::checkShare(
   }
 
   // print out high diff share, 2^10 = 1024
-  if (sjob->proxyJobDifficulty_ == 0 &&
+  if (sjob.proxyJobDifficulty_ == 0 &&
       (bnBlockHash >> 10) <= bnNetworkTarget) {
     LOG(INFO) << "high diff share, blkhash: " << blkHash.ToString()
               << ", diff: " << BitcoinDifficulty::TargetToDiff(blkHash)
               << ", networkDiff: "
-              << BitcoinDifficulty::TargetToDiff(sjob->networkTarget_)
+              << BitcoinDifficulty::TargetToDiff(sjob.networkTarget_)
               << ", by: " << workFullName;
   }
 
   //
   // found new RSK block
   //
-  if (!sjob->blockHashForMergedMining_.empty() &&
+  if (!sjob.blockHashForMergedMining_.empty() &&
       (isSubmitInvalidBlock_ == true ||
-       bnBlockHash <= UintToArith256(sjob->rskNetworkTarget_))) {
+       bnBlockHash <= UintToArith256(sjob.rskNetworkTarget_))) {
     //
     // build data needed to submit block to RSK
     //
@@ -591,22 +735,22 @@ int ServerBitcoin::checkShare(
     shareData.workerId_ = share.workerhashid();
     shareData.userId_ = share.userid();
     // height = matching bitcoin block height
-    shareData.height_ = sjob->height_;
+    shareData.height_ = sjob.height_;
     snprintf(
         shareData.feesForMiner_,
         sizeof(shareData.feesForMiner_),
         "%s",
-        sjob->feesForMiner_.c_str());
+        sjob.feesForMiner_.c_str());
     snprintf(
         shareData.rpcAddress_,
         sizeof(shareData.rpcAddress_),
         "%s",
-        sjob->rskdRpcAddress_.c_str());
+        sjob.rskdRpcAddress_.c_str());
     snprintf(
         shareData.rpcUserPwd_,
         sizeof(shareData.rpcUserPwd_),
         "%s",
-        sjob->rskdRpcUserPwd_.c_str());
+        sjob.rskdRpcUserPwd_.c_str());
     shareData.headerData_.set(header);
     snprintf(
         shareData.workerFullName_,
@@ -641,9 +785,9 @@ int ServerBitcoin::checkShare(
   //
   // found namecoin block
   //
-  if (sjob->nmcAuxBits_ != 0 &&
+  if (sjob.nmcAuxBits_ != 0 &&
       (isSubmitInvalidBlock_ == true ||
-       bnBlockHash <= UintToArith256(sjob->nmcNetworkTarget_))) {
+       bnBlockHash <= UintToArith256(sjob.nmcNetworkTarget_))) {
     //
     // build namecoin solved share message
     //
@@ -666,24 +810,24 @@ int ServerBitcoin::checkShare(
         "\"rpc_userpass\":\"%s\""
         "}",
         share.jobid(),
-        sjob->nmcAuxBlockHash_.ToString(),
+        sjob.nmcAuxBlockHash_.ToString(),
         blockHeaderHex,
         coinbaseTxHex,
-        sjob->nmcRpcAddr_,
-        sjob->nmcRpcUserpass_);
+        sjob.nmcRpcAddr_,
+        sjob.nmcRpcUserpass_);
     // send found merged mining aux block to kafka
     sendAuxSolvedShare2Kafka(
         chainId, auxSolvedShare.data(), auxSolvedShare.size());
 
-    LOG(INFO) << ">>>> found namecoin block: " << sjob->nmcHeight_ << ", "
-              << sjob->nmcAuxBlockHash_.ToString()
+    LOG(INFO) << ">>>> found namecoin block: " << sjob.nmcHeight_ << ", "
+              << sjob.nmcAuxBlockHash_.ToString()
               << ", jobId: " << share.jobid() << ", userId: " << share.userid()
               << ", by: " << workFullName << " <<<<";
   }
 
   DLOG(INFO) << "blkHash: " << blkHash.ToString()
              << ", jobTarget: " << jobTarget.ToString()
-             << ", networkTarget: " << sjob->networkTarget_.ToString();
+             << ", networkTarget: " << sjob.networkTarget_.ToString();
 
   // check share diff
   if (isEnableSimulator_ == false && bnBlockHash > UintToArith256(jobTarget)) {
@@ -33,6 +33,9 @@ class CBlockHeader;
 class FoundBlock;
 class JobRepositoryBitcoin;
 class ShareBitcoin;
+#ifdef CHAIN_TYPE_ZEC
+class VerifierPool;
+#endif
 
 class ServerBitcoin : public ServerBase<JobRepositoryBitcoin> {
 protected:
@@ -45,6 +48,9 @@ protected:
   uint32_t versionMask_ = 0;
   uint32_t extraNonce2Size_ = StratumMiner::kExtraNonce2Size_;
   bool useShareV1_ = false;
+#ifdef CHAIN_TYPE_ZEC
+  unique_ptr<VerifierPool> verifierPool_;
+#endif
 
 public:
   ServerBitcoin() = default;
@@ -71,13 +77,55 @@ public:
       const uint32_t extraNonce1,
       const string &extraNonce2Hex,
       const uint32_t nTime,
-      const BitcoinNonceType nonce,
+      const BitcoinNonceType &nonce,
       const uint32_t versionMask,
       const uint256 &jobTarget,
       const string &workFullName,
       string *userCoinbaseInfo = nullptr);
 
+#ifdef CHAIN_TYPE_ZEC
+  // The same as checkShare(), but the Equihash solution is checked on the
+  // verifier threads if they are enabled. `callback` gets the status on the
+  // event loop, it may be called before checkShareAsync() returns.
+  void checkShareAsync(
+      size_t chainId,
+      const ShareBitcoin &share,
+      const uint32_t extraNonce1,
+      const string &extraNonce2Hex,
+      const uint32_t nTime,
+      BitcoinNonceType nonce,
+      const uint32_t versionMask,
+      const uint256 &jobTarget,
+      const string &workFullName,
+      std::function<void(int32_t status)> callback);
+#endif
+
 protected:
+  // Checks the job and the time, then builds the block header.
+  // Returns StratumStatus::ACCEPT if the share should be checked further.
+  int prepareShare(
+      size_t chainId,
+      const ShareBitcoin &share,
+      const uint32_t extraNonce1,
+      const string &extraNonce2Hex,
+      const uint32_t nTime,
+      const BitcoinNonceType &nonce,
+      const uint32_t versionMask,
+      string *userCoinbaseInfo,
+      shared_ptr<StratumJobBitcoin> &sjob,
+      CBlockHeader &header,
+      std::vector<char> &coinbaseBin);
+  // Submits the found blocks and checks the share difficulty.
+  int processShare(
+      size_t chainId,
+      const ShareBitcoin &share,
+      const StratumJobBitcoin &sjob,
+      const CBlockHeader &header,
+      const uint256 &blkHash,
+      const std::vector<char> &coinbaseBin,
+      const uint256 &jobTarget,
+      const string &workFullName);
+
   JobRepository *createJobRepository(
       size_t chainId,
       const char *kafkaBrokers,
@@ -131,7 +179,7 @@ public:
       const uint32_t nBits,
       const int32_t nVersion,
       const uint32_t nTime,
-      const BitcoinNonceType nonce,
+      const BitcoinNonceType &nonce,
       const uint32_t versionMask,
       string *userCoinbaseInfo = nullptr);
   void init(uint32_t extraNonce2Size);
@@ -343,14 +343,7 @@ void StratumSessionBitcoin::handleRequest_Subscribe(
   // receive miner's IP from stratumSwitcher
   if (jparams.children()->size() >= 3) {
     clientIpInt_ = htonl(jparams.children()->at(2).uint32());
-
-    // ipv4
-    clientIp_.resize(INET_ADDRSTRLEN);
-    struct in_addr addr;
-    addr.s_addr = clientIpInt_;
-    clientIp_ = inet_ntop(
-        AF_INET, &addr, (char *)clientIp_.data(), (socklen_t)clientIp_.size());
-    LOG(INFO) << "client real IP: " << clientIp_;
+    LOG(INFO) << "client real IP: " << getClientIpStr();
   }
 
 #else
@@ -456,14 +449,14 @@ void StratumSessionBitcoin::logAuthorizeResult(
               << ", password: " << password
               << ", versionMask: " << Strings::Format("%08x", versionMask_)
               << ", clientAgent: " << clientAgent_
-              << ", clientIp: " << clientIp_
+              << ", clientIp: " << getClientIpStr()
               << ", chain: " << getServer().chainName(worker_.chainId_);
   } else {
     LOG(WARNING) << "authorize failed, workerName:" << worker_.fullName_
                  << ", password: " << password
                  << ", versionMask: " << Strings::Format("%08x", versionMask_)
                  << ", clientAgent: " << clientAgent_
-                 << ", clientIp: " << clientIp_;
+                 << ", clientIp: " << getClientIpStr();
   }
 }
 
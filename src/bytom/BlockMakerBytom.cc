@@ -23,6 +23,7 @@
  */
 #include "BlockMakerBytom.h"
 #include "BytomUtils.h"
+#include "HttpClient.h"
 
 #include "utilities_js.hpp"
 
@@ -74,35 +75,20 @@ void BlockMakerBytom::processSolvedShare(rd_kafka_message_t *rkmessage) {
 }
 
 void BlockMakerBytom::submitBlockNonBlocking(const string &request) {
+  auto body = std::make_shared<const string>(request);
   for (const auto &itr : def()->nodes) {
-    // use thread to submit
-    std::thread t(std::bind(
-        &BlockMakerBytom::_submitBlockThread,
-        this,
+    LOG(INFO) << "submitting block to " << itr.rpcAddr_
+              << " with request value: " << request;
+    AsyncHttpClient::shared().rpcCall(
         itr.rpcAddr_,
         itr.rpcUserPwd_,
-        request));
-    t.detach();
+        body,
+        [](bool ok, const string &response) {
+          LOG(INFO) << "submission result: " << response;
+        });
   }
 }
 
-void BlockMakerBytom::_submitBlockThread(
-    const string &rpcAddress,
-    const string &rpcUserpass,
-    const string &request) {
-  string response;
-  LOG(INFO) << "submitting block to " << rpcAddress
-            << " with request value: " << request;
-  rpcCall(
-      rpcAddress.c_str(),
-      rpcUserpass.c_str(),
-      request.c_str(),
-      request.length(),
-      response,
-      "curl");
-  LOG(INFO) << "submission result: " << response;
-}
-
 void BlockMakerBytom::saveBlockToDBNonBlocking(
     const string &header,
     const uint32_t height,
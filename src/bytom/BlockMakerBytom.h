@@ -37,10 +37,6 @@ public:
 
 private:
   void submitBlockNonBlocking(const string &request);
-  void _submitBlockThread(
-      const string &rpcAddress,
-      const string &rpcUserpass,
-      const string &request);
   void saveBlockToDBNonBlocking(
       const string &header,
       const uint32_t height,
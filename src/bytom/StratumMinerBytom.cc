@@ -28,12 +28,6 @@
 #include "StratumMessageDispatcher.h"
 #include "DiffController.h"
 
-#include "bytom/bh_shared.h"
-
-#ifndef NO_CUDA
-#include "cutil/src/GpuTs.h"
-#endif // NO_CUDA
-
 /////////////////////////////StratumMinerBytom////////////////////////////
 StratumMinerBytom::StratumMinerBytom(
     StratumSessionBytom &session,
@@ -67,52 +61,6 @@ void StratumMinerBytom::handleRequest_GetWork(
       false);
 }
 
-namespace BytomUtils {
-
-int checkProofOfWork(
-    EncodeBlockHeader_return encoded,
-    shared_ptr<StratumJobBytom> sJob,
-    uint64_t difficulty) {
-  DLOG(INFO) << "verify blockheader hash=" << encoded.r1
-             << ", seed=" << sJob->seed_;
-  vector<char> vHeader, vSeed;
-  Hex2Bin(encoded.r1, vHeader);
-  Hex2Bin(sJob->seed_.c_str(), sJob->seed_.length(), vSeed);
-
-#ifndef NO_CUDA
-  uint8_t *pTarget = GpuTs((uint8_t *)vHeader.data(), (uint8_t *)vSeed.data());
-#else
-  GoSlice hSlice = {
-      (void *)vHeader.data(), (int)vHeader.size(), (int)vHeader.size()};
-  GoSlice sSlice = {(void *)vSeed.data(), (int)vSeed.size(), (int)vSeed.size()};
-  uint8_t pTarget[32];
-  GoSlice hOut = {(void *)pTarget, 32, 32};
-  ProofOfWorkHashCPU(hSlice, sSlice, hOut);
-#endif
-
-  //  first job target first before checking solved share
-  string targetStr;
-  Bin2Hex(pTarget, 32, targetStr);
-  GoSlice text = {(void *)pTarget, 32, 32};
-  uint64_t localJobBits = Bytom_JobDifficultyToTargetCompact(difficulty);
-
-  bool powResultLocalJob = CheckProofOfWork(text, localJobBits);
-  if (powResultLocalJob) {
-    //  passed job target, now check the blockheader target
-    bool powResultBlock = CheckProofOfWork(text, sJob->blockHeader_.bits);
-    if (powResultBlock) {
-      return StratumStatus::SOLVED;
-    }
-    return StratumStatus::ACCEPT;
-  } else {
-    return StratumStatus::LOW_DIFFICULTY;
-  }
-
-  return StratumStatus::REJECT_NO_REASON;
-}
-
-} // namespace BytomUtils
-
 void StratumMinerBytom::handleRequest_Submit(
     const string &idStr, const JsonNode &jparams) {
   auto &session = getSession();
@@ -229,74 +177,92 @@ void StratumMinerBytom::handleRequest_Submit(
 
   if (exjob->isStale()) {
     share.set_status(StratumStatus::JOB_NOT_FOUND);
-    session.rpc2ResponseBoolean(idStr, false, "Block expired");
+    handleCheckedShare(idStr, share, localJob->chainId_, nonce, "");
+    return;
+  }
+
+  // The proof of work is checked on the verifier threads, the share is
+  // handled when the check is done.
+  std::weak_ptr<bool> alive = alive_;
+  const size_t chainId = localJob->chainId_;
+  const string workerFullName = worker.fullName_;
+  server.checkShareAsync(
+      chainId,
+      exjob,
+      nonce,
+      difficulty,
+      [this, alive, &server, idStr, chainId, share, nonce, workerFullName](
+          int32_t status, const string &header) mutable {
+        share.set_status(status);
+        if (alive.expired()) {
+          // the miner is gone, the share is still counted
+          if (status == StratumStatus::SOLVED) {
+            server.sendSolvedShare2Kafka(
+                chainId, share, nonce, header, workerFullName);
+            server.GetJobRepository(chainId)->markAllJobsAsStale();
+          }
+          sendShare2Kafka(server, chainId, share);
+          return;
+        }
+        handleCheckedShare(idStr, share, chainId, nonce, header);
+      });
+}
+
+void StratumMinerBytom::handleCheckedShare(
+    const string &idStr,
+    const ShareBytom &share,
+    size_t chainId,
+    uint64_t nonce,
+    const string &header) {
+  auto &session = getSession();
+  auto &server = session.getServer();
+  auto &worker = session.getWorker();
+
+  if (share.status() == StratumStatus::SOLVED) {
+    LOG(INFO) << "share solved";
+    server.sendSolvedShare2Kafka(
+        chainId, share, nonce, header, worker.fullName_);
+    server.GetJobRepository(chainId)->markAllJobsAsStale();
+    handleShare(idStr, share.status(), share.sharediff(), chainId);
+  } else if (share.status() == StratumStatus::ACCEPT) {
+    handleShare(idStr, share.status(), share.sharediff(), chainId);
   } else {
-    EncodeBlockHeader_return encoded = EncodeBlockHeader(
-        sJob->blockHeader_.version,
-        sJob->blockHeader_.height,
-        (char *)sJob->blockHeader_.previousBlockHash.c_str(),
-        sJob->blockHeader_.timestamp,
-        nonce,
-        sJob->blockHeader_.bits,
-        (char *)sJob->blockHeader_.transactionStatusHash.c_str(),
-        (char *)sJob->blockHeader_.transactionsMerkleRoot.c_str());
-    int powResult = BytomUtils::checkProofOfWork(encoded, sJob, difficulty);
-    share.set_status(powResult);
-    if (powResult == StratumStatus::SOLVED) {
-      std::cout << "share solved\n";
-      LOG(INFO) << "share solved";
-      server.sendSolvedShare2Kafka(
-          localJob->chainId_,
-          nonce,
-          encoded.r0,
-          share.height(),
-          Bytom_TargetCompactToDifficulty(sJob->blockHeader_.bits),
-          worker);
-      server.GetJobRepository(localJob->chainId_)->markAllJobsAsStale();
-      handleShare(idStr, share.status(), share.sharediff(), localJob->chainId_);
-    } else if (powResult == StratumStatus::ACCEPT) {
-      handleShare(idStr, share.status(), share.sharediff(), localJob->chainId_);
-    } else {
-      std::string failMessage = "Unknown reason";
-      switch (share.status()) {
-      case StratumStatus::LOW_DIFFICULTY:
-        failMessage = "Low difficulty share";
-        break;
-      }
-      session.rpc2ResponseBoolean(idStr, false, failMessage);
+    std::string failMessage = "Unknown reason";
+    switch (share.status()) {
+    case StratumStatus::LOW_DIFFICULTY:
+      failMessage = "Low difficulty share";
+      break;
+    case StratumStatus::JOB_NOT_FOUND:
+      failMessage = "Block expired";
+      break;
     }
-    free(encoded.r0);
-    free(encoded.r1);
+    session.rpc2ResponseBoolean(idStr, false, failMessage);
   }
 
-  bool isSendShareToKafka = true;
-  DLOG(INFO) << share.toString();
   // check if thers is invalid share spamming
   if (!StratumStatus::isAccepted(share.status())) {
     int64_t invalidSharesNum = invalidSharesCounter_.sum(
         time(nullptr), INVALID_SHARE_SLIDING_WINDOWS_SIZE);
     // too much invalid shares, don't send them to kafka
     if (invalidSharesNum >= INVALID_SHARE_SLIDING_WINDOWS_MAX_LIMIT) {
-      isSendShareToKafka = false;
       LOG(WARNING) << "invalid share spamming, worker: " << worker.fullName_
                    << ", " << share.toString();
+      return;
     }
   }
 
-  if (isSendShareToKafka) {
+  sendShare2Kafka(server, chainId, share);
+}
 
-    std::string message;
-    uint32_t size = 0;
-    if (!share.SerializeToArrayWithVersion(message, size)) {
-      LOG(ERROR) << "share SerializeToBuffer failed!" << share.toString();
-      return;
-    }
-    server.sendShare2Kafka(localJob->chainId_, message.data(), size);
+void StratumMinerBytom::sendShare2Kafka(
+    ServerBytom &server, size_t chainId, const ShareBytom &share) {
+  DLOG(INFO) << share.toString();
 
-    // string shareInHex;
-    // Bin2Hex((uint8_t *) &share, sizeof(ShareBytom), shareInHex);
-    // LOG(INFO) << "\nsendShare2Kafka ShareBytom:\n"
-    //           << "- size: " << sizeof(ShareBytom) << " bytes\n"
-    //           << "- hexvalue: " << shareInHex.c_str() << "\n";
+  std::string message;
+  uint32_t size = 0;
+  if (!share.SerializeToArrayWithVersion(message, size)) {
+    LOG(ERROR) << "share SerializeToBuffer failed!" << share.toString();
+    return;
   }
+  server.sendShare2Kafka(chainId, message.data(), size);
 }
@@ -45,6 +45,17 @@ public:
 private:
   void handleRequest_GetWork(const string &idStr, const JsonNode &jparams);
   void handleRequest_Submit(const string &idStr, const JsonNode &jparams);
+  void handleCheckedShare(
+      const std::string &idStr,
+      const ShareBytom &share,
+      size_t chainId,
+      uint64_t nonce,
+      const std::string &header);
+  static void
+  sendShare2Kafka(ServerBytom &server, size_t chainId, const ShareBytom &share);
+
+  // expires with the miner, the shares being checked hold weak references
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
 };
 
 #endif // #ifndef STRATUM_MINER_BYTOM_H_
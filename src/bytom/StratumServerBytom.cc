@@ -25,6 +25,13 @@
 
 #include "StratumSessionBytom.h"
 #include "DiffController.h"
+#include "VerifierPool.h"
+
+#include "bytom/bh_shared.h"
+
+#ifndef NO_CUDA
+#include "cutil/src/GpuTs.h"
+#endif // NO_CUDA
 
 using namespace std;
 
@@ -46,6 +53,15 @@ void JobRepositoryBytom::broadcastStratumJob(shared_ptr<StratumJob> sjobBase) {
               << sjob->blockHeader_.height
               << ", prevhash: " << sjob->blockHeader_.previousBlockHash.c_str();
   }
+
+#ifdef NO_CUDA
+  // build the matrices of a new seed before shares of it come in
+  if (sjob->seed_ != lastSeed_) {
+    lastSeed_ = sjob->seed_;
+    tensorityCalc_.buildMatListAsync(sjob->seed_);
+  }
+#endif
+
   shared_ptr<StratumJobEx> exJob(createStratumJobEx(sjob, isClean));
 
   if (isClean) {
@@ -64,6 +80,104 @@ void JobRepositoryBytom::broadcastStratumJob(shared_ptr<StratumJob> sjobBase) {
 }
 
 ///////////////////////////////ServerBytom///////////////////////////////
+ServerBytom::ServerBytom() = default;
+
+ServerBytom::~ServerBytom() = default;
+
+bool ServerBytom::setupInternal(const libconfig::Config &config) {
+  verifierPool_ = VerifierPool::create(*this, config);
+  return true;
+}
+
+static int32_t checkProofOfWork(
+    const char *headerHash,
+    const StratumJobBytom &sJob,
+    uint64_t difficulty,
+    JobRepositoryBytom *jobRepo) {
+  DLOG(INFO) << "verify blockheader hash=" << headerHash
+             << ", seed=" << sJob.seed_;
+  uint8_t header[32];
+  if (strlen(headerHash) != 64 || !Hex2BinFixed(headerHash, header, 32)) {
+    LOG(ERROR) << "invalid bytom header hash: " << headerHash;
+    return StratumStatus::REJECT_NO_REASON;
+  }
+
+  uint8_t pTarget[32];
+#ifndef NO_CUDA
+  // GpuTs() returns a global buffer, keep it until it is copied
+  static mutex gpuLock;
+  {
+    uint8_t seed[32];
+    Hex2BinFixed(sJob.seed_.c_str(), seed, 32);
+    ScopeLock sl(gpuLock);
+    memcpy(pTarget, GpuTs(header, seed), 32);
+  }
+#else
+  if (!jobRepo->computeTensority(header, sJob.seed_, pTarget)) {
+    return StratumStatus::REJECT_NO_REASON;
+  }
+#endif
+
+  //  first job target first before checking solved share
+  GoSlice text = {(void *)pTarget, 32, 32};
+  uint64_t localJobBits = Bytom_JobDifficultyToTargetCompact(difficulty);
+
+  bool powResultLocalJob = CheckProofOfWork(text, localJobBits);
+  if (powResultLocalJob) {
+    //  passed job target, now check the blockheader target
+    bool powResultBlock = CheckProofOfWork(text, sJob.blockHeader_.bits);
+    if (powResultBlock) {
+      return StratumStatus::SOLVED;
+    }
+    return StratumStatus::ACCEPT;
+  }
+  return StratumStatus::LOW_DIFFICULTY;
+}
+
+void ServerBytom::checkShareAsync(
+    size_t chainId,
+    shared_ptr<StratumJobEx> exjob,
+    uint64_t nonce,
+    uint64_t difficulty,
+    std::function<void(int32_t status, const string &header)> callback) {
+  struct Result {
+    int32_t status_ = StratumStatus::REJECT_NO_REASON;
+    string header_;
+  };
+  auto result = std::make_shared<Result>();
+  JobRepositoryBytom *jobRepo = GetJobRepository(chainId);
+
+  // everything the worker reads is owned by the job
+  auto check = [result, exjob, nonce, difficulty, jobRepo]() {
+    auto sJob = std::static_pointer_cast<StratumJobBytom>(exjob->sjob_);
+    auto &blockHeader = sJob->blockHeader_;
+    EncodeBlockHeader_return encoded = EncodeBlockHeader(
+        blockHeader.version,
+        blockHeader.height,
+        (char *)blockHeader.previousBlockHash.c_str(),
+        blockHeader.timestamp,
+        nonce,
+        blockHeader.bits,
+        (char *)blockHeader.transactionStatusHash.c_str(),
+        (char *)blockHeader.transactionsMerkleRoot.c_str());
+    result->status_ = checkProofOfWork(encoded.r1, *sJob, difficulty, jobRepo);
+    if (result->status_ == StratumStatus::SOLVED) {
+      result->header_ = encoded.r0;
+    }
+    free(encoded.r0);
+    free(encoded.r1);
+  };
+
+  if (!verifierPool_) {
+    check();
+    callback(result->status_, result->header_);
+    return;
+  }
+  verifierPool_->submit(check, [result, callback]() {
+    callback(result->status_, result->header_);
+  });
+}
+
 JobRepository *ServerBytom::createJobRepository(
     size_t chainId,
     const char *kafkaBrokers,
@@ -80,21 +194,20 @@ unique_ptr<StratumSession> ServerBytom::createConnection(
 
 void ServerBytom::sendSolvedShare2Kafka(
     size_t chainId,
+    const ShareBytom &share,
     uint64_t nonce,
     const string &strHeader,
-    uint64_t height,
-    uint64_t networkDiff,
-    const StratumWorker &worker) {
+    const string &workerFullName) {
   string msg = Strings::Format(
       "{\"nonce\":%u,\"header\":\"%s\","
       "\"height\":%u,\"networkDiff\":%u,\"userId\":%d,"
       "\"workerId\":%d,\"workerFullName\":\"%s\"}",
       nonce,
       strHeader,
-      height,
-      networkDiff,
-      worker.userId(chainId),
-      worker.workerHashId_,
-      filterWorkerName(worker.fullName_));
+      share.height(),
+      Bytom_TargetCompactToDifficulty(share.blkbits()),
+      share.userid(),
+      share.workerhashid(),
+      filterWorkerName(workerFullName));
   ServerBase::sendSolvedShare2Kafka(chainId, msg.data(), msg.size());
 }
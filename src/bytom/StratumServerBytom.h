@@ -26,11 +26,20 @@
 
 #include "StratumServer.h"
 #include "StratumBytom.h"
+#include "TensorityBytom.h"
 
 class JobRepositoryBytom;
+class VerifierPool;
 
 class ServerBytom : public ServerBase<JobRepositoryBytom> {
+  unique_ptr<VerifierPool> verifierPool_;
+
 public:
+  ServerBytom();
+  ~ServerBytom();
+
+  bool setupInternal(const libconfig::Config &config) override;
+
   JobRepository *createJobRepository(
       size_t chainId,
       const char *kafkaBrokers,
@@ -41,18 +50,31 @@ public:
       struct bufferevent *bev,
       struct sockaddr *saddr,
       const uint32_t sessionID) override;
+
+  // Checks the proof of work of the share on the verifier threads, the
+  // callback runs on the event loop with the share status and, if it is
+  // solved, the encoded block header.
+  void checkShareAsync(
+      size_t chainId,
+      shared_ptr<StratumJobEx> exjob,
+      uint64_t nonce,
+      uint64_t difficulty,
+      std::function<void(int32_t status, const string &header)> callback);
+
   void sendSolvedShare2Kafka(
       size_t chainId,
+      const ShareBytom &share,
       uint64_t nonce,
       const string &strHeader,
-      uint64_t height,
-      uint64_t networkDiff,
-      const StratumWorker &worker);
+      const string &workerFullName);
 };
 
 class JobRepositoryBytom : public JobRepositoryBase<ServerBytom> {
 private:
   uint32_t lastHeight_ = 0;
+  string lastSeed_;
+
+  TensorityCalculator tensorityCalc_;
 
 public:
   using JobRepositoryBase::JobRepositoryBase;
@@ -62,6 +84,11 @@ public:
   shared_ptr<StratumJobEx>
   createStratumJobEx(shared_ptr<StratumJob> sjob, bool isClean) override;
   void broadcastStratumJob(shared_ptr<StratumJob> sjob) override;
+
+  bool computeTensority(
+      const uint8_t header[32], const string &seedHex, uint8_t result[32]) {
+    return tensorityCalc_.compute(header, seedHex, result);
+  }
 };
 
 #endif // STRATUM_SERVER_BYTOM_H_
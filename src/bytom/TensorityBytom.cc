@@ -0,0 +1,378 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "TensorityBytom.h"
+
+#include "Utils.h"
+
+#include <algorithm>
+#include <future>
+
+#include <immintrin.h>
+
+#include "bytom/cutil/src/scrypt.h"
+#include "bytom/cutil/src/sha3-allInOne.h"
+#include "bytom/cutil/src/seed.h"
+
+static const uint32_t kFnvPrime = 0x01000193;
+
+static void sha3_256(const uint8_t *data, size_t len, uint8_t result[32]) {
+  sha3_ctx ctx;
+  rhash_sha3_256_init(&ctx);
+  rhash_sha3_update(&ctx, data, len);
+  rhash_sha3_final(&ctx, result);
+}
+
+// The int32 -> int8 conversion after each matrix multiplication,
+// the same as converInt32ToInt8_gpu() of cutil.
+static inline int16_t convertInt32ToInt8(int32_t x) {
+  return (int8_t)(((x & 0xFF) + ((x >> 8) & 0xFF)) & 0xFF);
+}
+
+// out = convert(a * m), a and out are 256x256 int16 (row-major, values fit
+// in int8), m is a matrix of TensorityMatList.
+static void mulMatrixScalar(const int16_t *a, const int16_t *m, int16_t *out) {
+  const size_t dim = TensorityMatList::kMatDim;
+  int32_t acc[dim];
+  for (size_t row = 0; row < dim; row++) {
+    std::fill(acc, acc + dim, 0);
+    const int16_t *aRow = a + row * dim;
+    for (size_t col = 0; col < dim; col += TensorityMatList::kPanelCols) {
+      const int16_t *mPairs = m + TensorityMatList::index(0, col);
+      for (size_t k = 0; k < dim; k += 2) {
+        const int32_t a0 = aRow[k];
+        const int32_t a1 = aRow[k + 1];
+        for (size_t c = 0; c < TensorityMatList::kPanelCols; c++) {
+          acc[col + c] += a0 * mPairs[2 * c] + a1 * mPairs[2 * c + 1];
+        }
+        mPairs += TensorityMatList::kPanelCols * 2;
+      }
+    }
+    for (size_t col = 0; col < dim; col++) {
+      out[row * dim + col] = convertInt32ToInt8(acc[col]);
+    }
+  }
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+convertInt32ToInt8Avx2(__m256i x) {
+  const __m256i mask = _mm256_set1_epi32(0xFF);
+  __m256i lo = _mm256_and_si256(x, mask);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi32(x, 8), mask);
+  __m256i sum = _mm256_add_epi32(lo, hi);
+  // sign-extend the low byte
+  return _mm256_srai_epi32(_mm256_slli_epi32(sum, 24), 24);
+}
+
+// The same as mulMatrixScalar(). A block of 2 rows x 32 columns is kept in
+// registers (unrolled by hand, GCC spills arrays of accumulators), vpmaddwd
+// multiplies and adds two rows of `m` at once.
+__attribute__((target("avx2"))) static inline void storeRowAvx2(
+    int16_t *out, __m256i c0, __m256i c1, __m256i c2, __m256i c3) {
+  // packs works in 128-bit lanes, permute the columns back in order
+  __m256i lo = _mm256_packs_epi32(
+      convertInt32ToInt8Avx2(c0), convertInt32ToInt8Avx2(c1));
+  __m256i hi = _mm256_packs_epi32(
+      convertInt32ToInt8Avx2(c2), convertInt32ToInt8Avx2(c3));
+  _mm256_storeu_si256(
+      (__m256i *)out, _mm256_permute4x64_epi64(lo, 0xD8));
+  _mm256_storeu_si256(
+      (__m256i *)(out + 16), _mm256_permute4x64_epi64(hi, 0xD8));
+}
+
+__attribute__((target("avx2"))) static void
+mulMatrixAvx2(const int16_t *a, const int16_t *m, int16_t *out) {
+  const size_t dim = TensorityMatList::kMatDim;
+  for (size_t row = 0; row < dim; row += 2) {
+    const int16_t *aRow0 = a + row * dim;
+    const int16_t *aRow1 = aRow0 + dim;
+    for (size_t col = 0; col < dim; col += 32) {
+      __m256i c00 = _mm256_setzero_si256(), c01 = c00, c02 = c00, c03 = c00;
+      __m256i c10 = c00, c11 = c00, c12 = c00, c13 = c00;
+      const __m256i *mPairs =
+          (const __m256i *)(m + TensorityMatList::index(0, col));
+      for (size_t k = 0; k < dim; k += 2, mPairs += 4) {
+        int32_t a0, a1;
+        memcpy(&a0, aRow0 + k, sizeof(a0));
+        memcpy(&a1, aRow1 + k, sizeof(a1));
+        const __m256i b0 = _mm256_set1_epi32(a0);
+        const __m256i b1 = _mm256_set1_epi32(a1);
+        const __m256i p0 = _mm256_loadu_si256(mPairs);
+        const __m256i p1 = _mm256_loadu_si256(mPairs + 1);
+        const __m256i p2 = _mm256_loadu_si256(mPairs + 2);
+        const __m256i p3 = _mm256_loadu_si256(mPairs + 3);
+        c00 = _mm256_add_epi32(c00, _mm256_madd_epi16(b0, p0));
+        c01 = _mm256_add_epi32(c01, _mm256_madd_epi16(b0, p1));
+        c02 = _mm256_add_epi32(c02, _mm256_madd_epi16(b0, p2));
+        c03 = _mm256_add_epi32(c03, _mm256_madd_epi16(b0, p3));
+        c10 = _mm256_add_epi32(c10, _mm256_madd_epi16(b1, p0));
+        c11 = _mm256_add_epi32(c11, _mm256_madd_epi16(b1, p1));
+        c12 = _mm256_add_epi32(c12, _mm256_madd_epi16(b1, p2));
+        c13 = _mm256_add_epi32(c13, _mm256_madd_epi16(b1, p3));
+      }
+      storeRowAvx2(out + row * dim + col, c00, c01, c02, c03);
+      storeRowAvx2(out + (row + 1) * dim + col, c10, c11, c12, c13);
+    }
+  }
+}
+
+static void mulMatrix(const int16_t *a, const int16_t *m, int16_t *out) {
+  static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+  if (hasAvx2) {
+    mulMatrixAvx2(a, m, out);
+  } else {
+    mulMatrixScalar(a, m, out);
+  }
+}
+
+// One of the four chains: the product of the 64 matrices picked by `seq`,
+// starting from the identity matrix.
+static void computeChain(
+    const TensorityMatList &matList, const uint8_t seq[32], int8_t *res) {
+  const size_t dim = TensorityMatList::kMatDim;
+  vector<int16_t> a(TensorityMatList::kMatSize, 0);
+  vector<int16_t> b(TensorityMatList::kMatSize);
+  for (size_t i = 0; i < dim; i++) {
+    a[i * dim + i] = 1;
+  }
+
+  for (int j = 0; j < 2; j++) {
+    for (int i = 0; i < 32; i++) {
+      mulMatrix(a.data(), matList.at(seq[i]), b.data());
+      a.swap(b);
+    }
+  }
+
+  for (size_t i = 0; i < TensorityMatList::kMatSize; i++) {
+    res[i] = (int8_t)a[i];
+  }
+}
+
+////////////////////////////// TensorityMatList ////////////////////////////////
+TensorityMatList::TensorityMatList(const uint8_t seed[32])
+  : pairs_(kMatNum * kMatSize) {
+  uint32_t exted[32];
+  extend(exted, const_cast<uint8_t *>(seed));
+
+  Words32 X;
+  init_seed(X, exted);
+
+  // 128 KB, too large for the stack
+  auto ltcMem = std::make_unique<LTCMemory>();
+
+  for (size_t i = 0; i < kMatNum / 2; i++) {
+    ltcMem->scrypt(X);
+
+    // The layout of BytomMatList8::init(): byte b of word w of the scrypt
+    // items goes to row w * 4 + b, items 4j, 4j + 2 (even matrix) or
+    // 4j + 1, 4j + 3 (odd matrix) go to column j.
+    for (size_t odd = 0; odd < 2; odd++) {
+      int16_t *mat = &pairs_[(2 * i + odd) * kMatSize];
+      for (size_t j = 0; j < kMatDim; j++) {
+        const Words32 &lo = ltcMem->get(j * 4 + odd);
+        const Words32 &hi = ltcMem->get(j * 4 + 2 + odd);
+        for (size_t w = 0; w < 64; w++) {
+          uint32_t word = (w < 32) ? lo.get(w) : hi.get(w - 32);
+          for (size_t b = 0; b < 4; b++) {
+            size_t row = w * 4 + b;
+            mat[index(row, j)] =
+                (int8_t)((word >> (b * 8)) & 0xFF);
+          }
+        }
+      }
+    }
+  }
+}
+
+///////////////////////////// TensorityCalculator //////////////////////////////
+TensorityCalculator::TensorityCalculator() {
+}
+
+TensorityCalculator::~TensorityCalculator() {
+  {
+    ScopeLock sl(taskLock_);
+    stopping_ = true;
+  }
+  taskCv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void TensorityCalculator::startWorkers() {
+  // the calling thread runs one of the four chains, at least one worker
+  // is needed for buildMatListAsync()
+  size_t cpus = std::thread::hardware_concurrency();
+  size_t workers = std::min<size_t>(3, cpus > 2 ? cpus - 1 : 1);
+  for (size_t i = 0; i < workers; i++) {
+    workers_.emplace_back(&TensorityCalculator::runWorker, this);
+  }
+}
+
+void TensorityCalculator::runWorker() {
+  for (;;) {
+    function<void()> task;
+    {
+      unique_lock<mutex> ul(taskLock_);
+      taskCv_.wait(ul, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+shared_ptr<const TensorityMatList>
+TensorityCalculator::getCachedMatList(const string &seedHex) {
+  ScopeLock sl(cacheLock_);
+  for (auto itr = cache_.begin(); itr != cache_.end(); itr++) {
+    if (itr->first == seedHex) {
+      cache_.splice(cache_.begin(), cache_, itr);
+      return cache_.front().second;
+    }
+  }
+  return nullptr;
+}
+
+shared_ptr<const TensorityMatList>
+TensorityCalculator::getMatList(const string &seedHex) {
+  auto matList = getCachedMatList(seedHex);
+  if (matList) {
+    return matList;
+  }
+
+  ScopeLock sl(buildLock_);
+  // it may be built by another thread while waiting for the lock
+  matList = getCachedMatList(seedHex);
+  if (matList) {
+    return matList;
+  }
+
+  vector<char> seed;
+  if (!Hex2Bin(seedHex.c_str(), seedHex.size(), seed) || seed.size() != 32) {
+    LOG(ERROR) << "invalid tensority seed: " << seedHex;
+    return nullptr;
+  }
+
+  LOG(INFO) << "building tensority matrices for seed " << seedHex;
+  auto start = std::chrono::steady_clock::now();
+  matList = std::make_shared<TensorityMatList>((const uint8_t *)seed.data());
+  LOG(INFO) << "tensority matrices built in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms";
+
+  ScopeLock cl(cacheLock_);
+  cache_.emplace_front(seedHex, matList);
+  while (cache_.size() > kMaxCacheSize_) {
+    cache_.pop_back();
+  }
+  return matList;
+}
+
+void TensorityCalculator::buildMatListAsync(const string &seedHex) {
+  std::call_once(workersStarted_, &TensorityCalculator::startWorkers, this);
+  {
+    ScopeLock sl(taskLock_);
+    tasks_.emplace_back([this, seedHex]() { getMatList(seedHex); });
+  }
+  taskCv_.notify_one();
+}
+
+bool TensorityCalculator::compute(
+    const uint8_t header[32], const string &seedHex, uint8_t result[32]) {
+  auto matList = getMatList(seedHex);
+  if (!matList) {
+    return false;
+  }
+  compute(header, *matList, result);
+  return true;
+}
+
+void TensorityCalculator::compute(
+    const uint8_t header[32],
+    const TensorityMatList &matList,
+    uint8_t result[32]) {
+  std::call_once(workersStarted_, &TensorityCalculator::startWorkers, this);
+
+  const size_t matSize = TensorityMatList::kMatSize;
+  uint8_t seq[4][32];
+  for (int k = 0; k < 4; k++) {
+    sha3_256(header + k * 8, 8, seq[k]);
+  }
+
+  vector<int8_t> res(4 * matSize);
+  std::future<void> chains[3];
+  if (!workers_.empty()) {
+    ScopeLock sl(taskLock_);
+    for (int k = 1; k < 4; k++) {
+      auto task = std::make_shared<std::packaged_task<void()>>(
+          [&matList, &seq, &res, k, matSize]() {
+            computeChain(matList, seq[k], &res[k * matSize]);
+          });
+      chains[k - 1] = task->get_future();
+      tasks_.emplace_back([task]() { (*task)(); });
+    }
+  }
+  taskCv_.notify_all();
+
+  computeChain(matList, seq[0], &res[0]);
+  for (int k = 1; k < 4; k++) {
+    if (chains[k - 1].valid()) {
+      chains[k - 1].get();
+    } else {
+      computeChain(matList, seq[k], &res[k * matSize]);
+    }
+  }
+
+  // the sum of the four chains, then the same reduction as Arr256x64i32
+  const size_t dim = TensorityMatList::kMatDim;
+  vector<uint32_t> arr(dim * 64);
+  for (size_t row = 0; row < dim; row++) {
+    for (size_t i = 0; i < 64; i++) {
+      uint32_t v = 0;
+      for (size_t b = 0; b < 4; b++) {
+        size_t pos = row * dim + i + b * 64;
+        uint8_t sum = res[pos] + res[matSize + pos] + res[2 * matSize + pos] +
+            res[3 * matSize + pos];
+        v |= (uint32_t)sum << (b * 8);
+      }
+      arr[row * 64 + i] = v;
+    }
+  }
+
+  for (size_t k = dim; k > 1; k /= 2) {
+    for (size_t row = 0; row < k / 2; row++) {
+      for (size_t i = 0; i < 64; i++) {
+        arr[row * 64 + i] =
+            (arr[row * 64 + i] * kFnvPrime) ^ arr[(row + k / 2) * 64 + i];
+      }
+    }
+  }
+
+  sha3_256((const uint8_t *)arr.data(), 64 * sizeof(uint32_t), result);
+}
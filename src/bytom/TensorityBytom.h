@@ -0,0 +1,112 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#ifndef TENSORITY_BYTOM_H_
+#define TENSORITY_BYTOM_H_
+
+#include "Common.h"
+
+#include <list>
+
+////////////////////////////// TensorityMatList ////////////////////////////////
+//
+// The 256 int8 matrices (256x256) that Tensority derives from a seed.
+//
+// They are kept sign-extended to int16 in panels of 32 columns, with rows k
+// and k+1 interleaved, so the matmul kernel can multiply-add two rows at once
+// and reads a panel (16 KB) contiguously:
+//   at(m)[index(k, col)] == M_m[k][col]
+//
+class TensorityMatList {
+public:
+  static const size_t kMatNum = 256;
+  static const size_t kMatDim = 256;
+  static const size_t kMatSize = kMatDim * kMatDim;
+
+  explicit TensorityMatList(const uint8_t seed[32]);
+
+  static const size_t kPanelCols = 32;
+
+  const int16_t *at(uint8_t i) const { return &pairs_[i * kMatSize]; }
+
+  static size_t index(size_t k, size_t col) {
+    return ((col / kPanelCols) * (kMatDim / 2) + k / 2) * kPanelCols * 2 +
+        (col % kPanelCols) * 2 + k % 2;
+  }
+
+private:
+  vector<int16_t> pairs_;
+};
+
+///////////////////////////// TensorityCalculator //////////////////////////////
+//
+// Native CPU Tensority (Bytom's PoW), gives the same result as
+// ProofOfWorkHashCPU() of bh_shared and GpuTs() of cutil.
+//
+// Building the matrices of a seed takes a while and they only change with
+// the seed, so the last kMaxCacheSize_ seeds are cached. The four matrix
+// chains of a hash are independent and run in parallel on the calculator's
+// workers.
+//
+class TensorityCalculator {
+public:
+  TensorityCalculator();
+  ~TensorityCalculator();
+
+  // returns the matrices of `seedHex`, builds them if they are not cached
+  shared_ptr<const TensorityMatList> getMatList(const string &seedHex);
+  // builds the matrices of `seedHex` on a worker, the destructor waits for it
+  void buildMatListAsync(const string &seedHex);
+
+  bool compute(
+      const uint8_t header[32], const string &seedHex, uint8_t result[32]);
+  void compute(
+      const uint8_t header[32],
+      const TensorityMatList &matList,
+      uint8_t result[32]);
+
+protected:
+  // current and previous seeds
+  static const size_t kMaxCacheSize_ = 2;
+
+  // most recently used first
+  std::list<pair<string, shared_ptr<const TensorityMatList>>> cache_;
+  mutex cacheLock_;
+  // held while building the matrices of a seed
+  mutex buildLock_;
+
+  shared_ptr<const TensorityMatList> getCachedMatList(const string &seedHex);
+
+  // workers are started on the first compute()
+  std::once_flag workersStarted_;
+  vector<thread> workers_;
+  deque<function<void()>> tasks_;
+  mutex taskLock_;
+  condition_variable taskCv_;
+  bool stopping_ = false;
+
+  void startWorkers();
+  void runWorker();
+};
+
+#endif // TENSORITY_BYTOM_H_
@@ -25,6 +25,7 @@
 #include "BlockMakerDecred.h"
 #include "StratumDecred.h"
 #include "DecredUtils.h"
+#include "HttpClient.h"
 
 BlockMakerDecred::BlockMakerDecred(
     shared_ptr<BlockMakerDefinition> def,
@@ -39,45 +40,45 @@ void BlockMakerDecred::processSolvedShare(rd_kafka_message_t *rkmessage) {
   }
   auto foundBlock = reinterpret_cast<FoundBlockDecred *>(rkmessage->payload);
 
-  // TODO: Think about a better way to do it asynchronously for all block
-  // makers...
+  // RPC call getwork with padded block header as data parameter is equivalent
+  // to submitbblock
+  auto &header = foundBlock->header_;
+  auto request = std::make_shared<string>(
+      "{\"jsonrpc\":\"1.0\",\"id\":\"1\",\"method\":\"getwork\",\"params\":[\"");
+  *request +=
+      HexStr(BEGIN(header), END(header)) + "8000000100000000000005a0\"]}";
+
   for (auto &node : def()->nodes) {
-    std::thread t(std::bind(
-        &BlockMakerDecred::submitBlockHeader, this, node, foundBlock->header_));
-    t.detach();
+    LOG(INFO) << "submit block to: " << node.rpcAddr_
+              << ", request: " << *request;
+    submitBlockHeader(node, request, 0);
   }
   std::thread d(std::bind(&BlockMakerDecred::saveBlockToDB, this, *foundBlock));
   d.detach();
 }
 
 void BlockMakerDecred::submitBlockHeader(
-    const NodeDefinition &node, const BlockHeaderDecred &header) {
-  // RPC call getwork with padded block header as data parameter is equivalent
-  // to submitbblock
-  string request =
-      "{\"jsonrpc\":\"1.0\",\"id\":\"1\",\"method\":\"getwork\",\"params\":[\"";
-  request +=
-      HexStr(BEGIN(header), END(header)) + "8000000100000000000005a0\"]}";
-
-  LOG(INFO) << "submit block to: " << node.rpcAddr_ << ", request: " << request;
-  // try N times
-  for (size_t i = 0; i < 3; i++) {
-    string response;
-    bool res = blockchainNodeRpcCall(
-        node.rpcAddr_.c_str(),
-        node.rpcUserPwd_.c_str(),
-        request.c_str(),
-        response);
-
-    // success
-    if (res == true) {
-      LOG(INFO) << "rpc call success, submit block response: " << response;
-      break;
-    }
-
-    // failure
-    LOG(ERROR) << "rpc call fail: " << response;
-  }
+    const NodeDefinition &node,
+    shared_ptr<const string> request,
+    size_t retry) {
+  AsyncHttpClient::shared().rpcCall(
+      node.rpcAddr_,
+      node.rpcUserPwd_,
+      request,
+      [node, request, retry](bool ok, const string &response) {
+        // success
+        if (ok) {
+          LOG(INFO) << "rpc call success, submit block response: "
+                    << response;
+          return;
+        }
+
+        // failure, try N times
+        LOG(ERROR) << "rpc call fail: " << response;
+        if (retry + 1 < 3) {
+          submitBlockHeader(node, request, retry + 1);
+        }
+      });
 }
 
 void BlockMakerDecred::saveBlockToDB(const FoundBlockDecred &foundBlock) {
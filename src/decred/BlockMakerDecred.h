@@ -39,8 +39,10 @@ protected:
   void processSolvedShare(rd_kafka_message_t *rkmessage) override;
 
 private:
-  void submitBlockHeader(
-      const NodeDefinition &node, const BlockHeaderDecred &header);
+  static void submitBlockHeader(
+      const NodeDefinition &node,
+      shared_ptr<const string> request,
+      size_t retry);
   void saveBlockToDB(const FoundBlockDecred &foundBlock);
 };
 
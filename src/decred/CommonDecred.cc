@@ -24,10 +24,7 @@
 
 #include "CommonDecred.h"
 
-extern "C" {
-
-#include "libsph/sph_blake.h"
-}
+#include <immintrin.h>
 
 uint256 BlockHeaderDecred::getHash() const {
   uint256 hash;
@@ -38,6 +35,162 @@ uint256 BlockHeaderDecred::getHash() const {
   return hash;
 }
 
+BlockHeaderHasherDecred::BlockHeaderHasherDecred() {
+  sph_blake256_init(&midstate_);
+}
+
+BlockHeaderHasherDecred::BlockHeaderHasherDecred(
+    const BlockHeaderDecred &header) {
+  sph_blake256_init(&midstate_);
+  sph_blake256(&midstate_, &header, kMidstateSize);
+}
+
+// BLAKE-256 of the last block of a header with SSE4.1, the rows of the state
+// in four registers. The portable version is the one of libsph.
+static const uint32_t kBlake256C[16] = {
+    0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344, 0xA4093822, 0x299F31D0,
+    0x082EFA98, 0xEC4E6C89, 0x452821E6, 0x38D01377, 0xBE5466CF, 0x34E90C6C,
+    0xC0AC29B7, 0xC97C50DD, 0x3F84D5B5, 0xB5470917};
+
+static const uint8_t kBlake256Sigma[10][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0}};
+
+// G on the four columns (or diagonals) at once, a row of the state in each
+// register.
+#define BLAKE256_G4(s, i0, i1, i2, i3)                                       \
+  do {                                                                       \
+    row1 = _mm_add_epi32(                                                    \
+        _mm_add_epi32(row1, row2),                                           \
+        _mm_set_epi32(                                                       \
+            m[s[2 * i3]] ^ kBlake256C[s[2 * i3 + 1]],                        \
+            m[s[2 * i2]] ^ kBlake256C[s[2 * i2 + 1]],                        \
+            m[s[2 * i1]] ^ kBlake256C[s[2 * i1 + 1]],                        \
+            m[s[2 * i0]] ^ kBlake256C[s[2 * i0 + 1]]));                      \
+    row4 = _mm_shuffle_epi8(_mm_xor_si128(row4, row1), rot16);               \
+    row3 = _mm_add_epi32(row3, row4);                                        \
+    row2 = _mm_xor_si128(row2, row3);                                        \
+    row2 = _mm_or_si128(_mm_srli_epi32(row2, 12), _mm_slli_epi32(row2, 20)); \
+    row1 = _mm_add_epi32(                                                    \
+        _mm_add_epi32(row1, row2),                                           \
+        _mm_set_epi32(                                                       \
+            m[s[2 * i3 + 1]] ^ kBlake256C[s[2 * i3]],                        \
+            m[s[2 * i2 + 1]] ^ kBlake256C[s[2 * i2]],                        \
+            m[s[2 * i1 + 1]] ^ kBlake256C[s[2 * i1]],                        \
+            m[s[2 * i0 + 1]] ^ kBlake256C[s[2 * i0]]));                      \
+    row4 = _mm_shuffle_epi8(_mm_xor_si128(row4, row1), rot8);                \
+    row3 = _mm_add_epi32(row3, row4);                                        \
+    row2 = _mm_xor_si128(row2, row3);                                        \
+    row2 = _mm_or_si128(_mm_srli_epi32(row2, 7), _mm_slli_epi32(row2, 25));  \
+  } while (0)
+
+// A round on the columns, then on the diagonals. The rounds are written out
+// so that the permutation of the message is known at compile time.
+#define BLAKE256_ROUND(r)                                                   \
+  do {                                                                      \
+    BLAKE256_G4(kBlake256Sigma[r], 0, 1, 2, 3);                             \
+    row2 = _mm_shuffle_epi32(row2, _MM_SHUFFLE(0, 3, 2, 1));                \
+    row3 = _mm_shuffle_epi32(row3, _MM_SHUFFLE(1, 0, 3, 2));                \
+    row4 = _mm_shuffle_epi32(row4, _MM_SHUFFLE(2, 1, 0, 3));                \
+    BLAKE256_G4(kBlake256Sigma[r], 4, 5, 6, 7);                             \
+    row2 = _mm_shuffle_epi32(row2, _MM_SHUFFLE(2, 1, 0, 3));                \
+    row3 = _mm_shuffle_epi32(row3, _MM_SHUFFLE(1, 0, 3, 2));                \
+    row4 = _mm_shuffle_epi32(row4, _MM_SHUFFLE(0, 3, 2, 1));                \
+  } while (0)
+
+// The last block of BLAKE-256: compresses the big endian words `m` into
+// `h` with the bit counter t and writes the digest (no salt).
+__attribute__((target("sse4.1"))) static void blake256LastBlockSse41(
+    const uint32_t h[8], const uint32_t m[16], uint32_t t, uint8_t digest[32]) {
+  const __m128i rot16 =
+      _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+  const __m128i rot8 =
+      _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+
+  const __m128i h0 = _mm_loadu_si128((const __m128i *)h);
+  const __m128i h1 = _mm_loadu_si128((const __m128i *)(h + 4));
+  __m128i row1 = h0;
+  __m128i row2 = h1;
+  __m128i row3 = _mm_loadu_si128((const __m128i *)kBlake256C);
+  __m128i row4 = _mm_xor_si128(
+      _mm_loadu_si128((const __m128i *)(kBlake256C + 4)),
+      _mm_set_epi32(0, 0, t, t));
+
+  BLAKE256_ROUND(0);
+  BLAKE256_ROUND(1);
+  BLAKE256_ROUND(2);
+  BLAKE256_ROUND(3);
+  BLAKE256_ROUND(4);
+  BLAKE256_ROUND(5);
+  BLAKE256_ROUND(6);
+  BLAKE256_ROUND(7);
+  BLAKE256_ROUND(8);
+  BLAKE256_ROUND(9);
+  BLAKE256_ROUND(0);
+  BLAKE256_ROUND(1);
+  BLAKE256_ROUND(2);
+  BLAKE256_ROUND(3);
+
+  const __m128i bswap =
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  _mm_storeu_si128(
+      (__m128i *)digest,
+      _mm_shuffle_epi8(_mm_xor_si128(h0, _mm_xor_si128(row1, row3)), bswap));
+  _mm_storeu_si128(
+      (__m128i *)(digest + 16),
+      _mm_shuffle_epi8(_mm_xor_si128(h1, _mm_xor_si128(row2, row4)), bswap));
+}
+
+uint256
+BlockHeaderHasherDecred::getHash(const BlockHeaderDecred &header) const {
+  static const bool hasSse41 = __builtin_cpu_supports("sse4.1");
+  return hasSse41 ? getHashSse41(header) : getHashScalar(header);
+}
+
+uint256
+BlockHeaderHasherDecred::getHashSse41(const BlockHeaderDecred &header) const {
+  const size_t tailSize = sizeof(BlockHeaderDecred) - kMidstateSize;
+  const uint8_t *tail = reinterpret_cast<const uint8_t *>(&header) +
+      kMidstateSize;
+  // the rest of the header and the padding: 0x80, zeros, 0x01 and the
+  // length in bits
+  uint8_t block[64] = {0};
+  memcpy(block, tail, tailSize);
+  block[tailSize] = 0x80;
+  block[55] |= 0x01;
+  uint32_t m[16];
+  for (size_t i = 0; i < 14; i++) {
+    m[i] = sph_dec32be(block + 4 * i);
+  }
+  const uint32_t bits = sizeof(BlockHeaderDecred) * 8;
+  m[14] = 0;
+  m[15] = bits;
+
+  uint256 hash;
+  blake256LastBlockSse41(midstate_.H, m, bits, hash.begin());
+  return hash;
+}
+
+uint256
+BlockHeaderHasherDecred::getHashScalar(const BlockHeaderDecred &header) const {
+  uint256 hash;
+  sph_blake256_context ctx = midstate_;
+  sph_blake256(
+      &ctx,
+      reinterpret_cast<const uint8_t *>(&header) + kMidstateSize,
+      sizeof(BlockHeaderDecred) - kMidstateSize);
+  sph_blake256_close(&ctx, &hash);
+  return hash;
+}
+
 const NetworkParamsDecred &NetworkParamsDecred::get(NetworkDecred network) {
   static NetworkParamsDecred mainnetParams{
       arith_uint256{}.SetCompact(0x1d00ffff),
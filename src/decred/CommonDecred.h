@@ -28,8 +28,14 @@
 #include <boost/endian/buffers.hpp>
 #include <arith_uint256.h>
 #include <uint256.h>
+#include <cstddef>
 #include <string>
 
+extern "C" {
+
+#include "libsph/sph_blake.h"
+}
+
 // Decred block header
 // (https://docs.decred.org/advanced/block-header-specifications/) Byte arrays
 // are used so that the members are packed
@@ -59,6 +65,34 @@ struct BlockHeaderDecred {
 static_assert(
     sizeof(BlockHeaderDecred) == 180, "Decred block header type is invalid");
 
+// BLAKE-256 of the headers of a job. The first 128 bytes of a header (up to
+// the height) are the same for all its shares, so their state is computed once
+// and the hash of a share only compresses the last block.
+class BlockHeaderHasherDecred {
+public:
+  static const size_t kMidstateSize = 128;
+
+  BlockHeaderHasherDecred();
+  explicit BlockHeaderHasherDecred(const BlockHeaderDecred &header);
+
+  // `header` must have the first kMidstateSize bytes of the constructor's
+  uint256 getHash(const BlockHeaderDecred &header) const;
+  // getHash() picks one of them, the SSE4.1 one if the CPU has it
+  uint256 getHashScalar(const BlockHeaderDecred &header) const;
+  uint256 getHashSse41(const BlockHeaderDecred &header) const;
+
+private:
+  sph_blake256_context midstate_;
+};
+
+static_assert(
+    offsetof(BlockHeaderDecred, height) ==
+        BlockHeaderHasherDecred::kMidstateSize,
+    "the share fields of Decred block headers have to be in the last block");
+static_assert(
+    sizeof(BlockHeaderDecred) - BlockHeaderHasherDecred::kMidstateSize <= 55,
+    "the last block of Decred block headers has to hold the padding");
+
 // CMD_MAGIC_NUMBER number from the network type
 enum class NetworkDecred : uint32_t {
   MainNet = 0xd9b400f9,
@@ -32,6 +32,7 @@
 class GwMakerHandlerDecred : public GwMakerHandlerJson {
   bool checkFields(JsonNode &r) override;
   string constructRawMsg(JsonNode &r) override;
+  string getWorkIdField() override { return "data"; }
   string getRequestData() override {
     return "[{\"jsonrpc\": \"2.0\", \"method\": \"getcurrentnet\", \"params\": "
            "[], \"id\": 0}"
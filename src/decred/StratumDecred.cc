@@ -91,6 +91,7 @@ bool StratumJobDecred::unserializeFromJson(const char *s, size_t len) {
   UNSERIALIZE_SJOB_FIELD(target, target_.begin());
 #undef UNSERIALIZE_SJOB_FIELD
 
+  hasher_ = BlockHeaderHasherDecred(header_);
   return true;
 }
 
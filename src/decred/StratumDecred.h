@@ -320,6 +320,8 @@ public:
   BlockHeaderDecred header_;
   uint256 target_;
   NetworkDecred network_;
+  // set by unserializeFromJson()
+  BlockHeaderHasherDecred hasher_;
 
   StratumJobDecred();
   string serializeToJson() const override;
@@ -32,6 +32,14 @@
 
 #include <boost/endian/conversion.hpp>
 
+// IsHex() of a string param, without copying it
+static bool IsHexParam(const JsonNode &n) {
+  return n.type() == Utilities::JS::type::Str && n.size() > 0 &&
+      n.size() % 2 == 0 && std::all_of(n.start(), n.end(), [](char c) {
+        return HexDigit(c) >= 0;
+      });
+}
+
 StratumMinerDecred::StratumMinerDecred(
     StratumSessionDecred &session,
     const DiffController &diffController,
@@ -73,14 +81,13 @@ void StratumMinerDecred::handleRequest_Submit(
       std::any_of(
           std::next(jparams.children()->begin()),
           jparams.children()->end(),
-          [](const JsonNode &n) {
-            return n.type() != Utilities::JS::type::Str || !IsHex(n.str());
-          })) {
+          [](const JsonNode &n) { return !IsHexParam(n); })) {
     handleShare(idStr, StratumStatus::ILLEGAL_PARARMS, 0, session.getChainId());
     return;
   }
 
-  auto extraNonce2 = ParseHex(jparams.children()->at(2).str());
+  // stops at the closing quote of the param
+  auto extraNonce2 = ParseHex(jparams.children()->at(2).start());
   if (extraNonce2.size() != kExtraNonce2Size_ &&
       extraNonce2.size() != 12) { // Extra nonce size
     handleShare(idStr, StratumStatus::ILLEGAL_PARARMS, 0, session.getChainId());
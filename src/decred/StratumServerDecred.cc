@@ -199,19 +199,13 @@ int ServerDecred::checkShare(
     return StratumStatus::TIME_TOO_NEW;
   }
 
-  FoundBlockDecred foundBlock(
-      share.jobid(),
-      share.workerhashid(),
-      share.userid(),
-      workerFullName,
-      sjob->header_,
-      sjob->network_);
-  auto &header = foundBlock.header_;
+  // only the last block of the header is hashed for the share
+  BlockHeaderDecred header = sjob->header_;
   header.timestamp = ntime;
   header.nonce = nonce;
   protocol_->setExtraNonces(header, share.sessionid(), extraNonce2);
 
-  uint256 blkHash = header.getHash();
+  uint256 blkHash = sjob->hasher_.getHash(header);
   auto bnBlockHash = UintToArith256(blkHash);
   auto bnNetworkTarget = UintToArith256(sjob->target_);
 
@@ -219,6 +213,14 @@ int ServerDecred::checkShare(
   // found new block
   //
   if (isSubmitInvalidBlock_ == true || bnBlockHash <= bnNetworkTarget) {
+    FoundBlockDecred foundBlock(
+        share.jobid(),
+        share.workerhashid(),
+        share.userid(),
+        workerFullName,
+        header,
+        sjob->network_);
+
     // send
     sendSolvedShare2Kafka(
         exJobPtr->chainId_, (const char *)&foundBlock, sizeof(foundBlock));
@@ -166,14 +166,7 @@ void StratumSessionDecred::handleRequest_Subscribe(
   // receive miner's IP from stratumSwitcher
   if (jparams.children()->size() >= 3) {
     clientIpInt_ = htonl(jparams.children()->at(2).uint32());
-
-    // ipv4
-    clientIp_.resize(INET_ADDRSTRLEN);
-    struct in_addr addr;
-    addr.s_addr = clientIpInt_;
-    clientIp_ = inet_ntop(
-        AF_INET, &addr, (char *)clientIp_.data(), (socklen_t)clientIp_.size());
-    LOG(INFO) << "client real IP: " << clientIp_;
+    LOG(INFO) << "client real IP: " << getClientIpStr();
   }
 
 #else
@@ -86,6 +86,7 @@ void StratumClientEth::handleLine(const string &line) {
     }
     return;
   }
+  responseReceived();
 
   if (state_ == AUTHENTICATED) {
     //
@@ -108,6 +109,7 @@ void StratumClientEth::handleLine(const string &line) {
         "\"params\": [\"\%s\", \"%s\"]}\n",
         workerFullName_,
         workerPasswd_);
+    requestSent(StratumClientLatencies::AUTHORIZE);
     sendData(s);
     return;
   }
@@ -28,7 +28,9 @@
 
 #include <boost/thread.hpp>
 
-#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "CommonEth.h"
 #include "libethash/ethash.h"
@@ -40,149 +42,99 @@ using namespace std;
 
 ///////////////////////////// EthashCalculator ////////////////////////////////
 
-EthashCalculator::EthashCalculator(const string &cacheFile)
-  : cacheFile_(cacheFile) {
-  if (!cacheFile_.empty()) {
-    loadCacheFromFile(cacheFile_);
-  }
+EthashCalculator::EthashCalculator(const string &cacheFilePrefix)
+  : cacheFilePrefix_(cacheFilePrefix) {
 }
 
-EthashCalculator::~EthashCalculator() {
-  if (!cacheFile_.empty()) {
-    saveCacheToFile(cacheFile_);
-  }
-
-  ScopeLock sl(lock_);
-  for (auto itr : lightCaches_) {
-    ethash_light_delete(itr.second);
-  }
+string EthashCalculator::getCacheFilePath(uint64_t epoch) {
+  return Strings::Format("%s-epoch%u.dat", cacheFilePrefix_, epoch);
 }
 
-size_t EthashCalculator::saveCacheToFile(const string &cacheFile) {
-  ScopeLock sl(lock_);
-  size_t loadedNum = 0;
-
-  if (lightCaches_.empty()) {
-    LOG(INFO) << "DAG cache was empty";
-    return 0;
-  }
-
-  std::ofstream f(cacheFile, std::ios::binary | std::ios::trunc);
-  if (!f) {
-    LOG(ERROR) << "create DAG cache file " << cacheFile << " failed";
-    return 0;
-  }
-
-  for (auto itr : lightCaches_) {
-    saveCacheToFile(itr.second, f);
-    loadedNum++;
-  }
+bool EthashCalculator::saveCacheToFile(const LightCache &light) {
+  const uint64_t epoch = light->block_number / ETHASH_EPOCH_LENGTH;
+  const string path = getCacheFilePath(epoch);
+  const string tmpPath = path + ".tmp";
 
-  f.close();
-  LOG(INFO) << "saved " << loadedNum << " DAG caches to file " << cacheFile;
-  return loadedNum;
-}
-
-void EthashCalculator::saveCacheToFile(
-    const ethash_light_t &light, std::ofstream &f) {
   LightCacheHeader header;
   header.blockNumber_ = light->block_number;
   header.cacheSize_ = light->cache_size;
   header.checksum_ =
       computeCacheChecksum(header, (const uint8_t *)light->cache);
 
-  f.write((const char *)&header, sizeof(header));
-  f.write((const char *)light->cache, header.cacheSize_);
-  f.flush();
-}
-
-size_t EthashCalculator::loadCacheFromFile(const string &cacheFile) {
-  ScopeLock sl(lock_);
-  size_t loadedNum = 0;
-
-  std::ifstream f(cacheFile, std::ios::binary);
-  if (!f) {
-    LOG(WARNING) << "cannot read DAG cache file " << cacheFile;
-    return 0;
+  FILE *f = fopen(tmpPath.c_str(), "wb");
+  if (f == nullptr) {
+    LOG(ERROR) << "create DAG cache file " << tmpPath
+               << " failed: " << strerror(errno);
+    return false;
   }
 
-  ethash_light_t light;
-  while (nullptr != (light = loadCacheFromFile(f))) {
-    uint64_t epoch = light->block_number / ETHASH_EPOCH_LENGTH;
-    lightCaches_[epoch] = light;
-    lightEpochs_.push(epoch);
-    loadedNum++;
+  vector<char> padding(kCacheFileDataOffset_ - sizeof(header), 0);
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+      fwrite(padding.data(), padding.size(), 1, f) == 1 &&
+      fwrite(light->cache, header.cacheSize_, 1, f) == 1;
+  ok = (fclose(f) == 0) && ok;
+
+  // the file is complete or absent, even if the process crashes
+  if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+    LOG(ERROR) << "write DAG cache file " << path
+               << " failed: " << strerror(errno);
+    unlink(tmpPath.c_str());
+    return false;
   }
 
-  f.close();
-  LOG(INFO) << "loaded " << loadedNum << " DAG caches from file " << cacheFile;
-  return loadedNum;
+  LOG(INFO) << "saved DAG cache of epoch " << epoch << " to file " << path;
+  return true;
 }
 
-ethash_light_t EthashCalculator::loadCacheFromFile(std::ifstream &f) {
-  LightCacheHeader header;
-  uint64_t checksum;
-  struct ethash_light *ret;
+EthashCalculator::LightCache
+EthashCalculator::mapCacheFromFile(uint64_t epoch) {
+  const string path = getCacheFilePath(epoch);
 
-  f.read((char *)&header, sizeof(header));
-  if (f.gcount() == 0) {
-    // file EOF reached
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
     return nullptr;
   }
-  if (f.gcount() != sizeof(header)) {
-    LOG(WARNING) << "cannot load DAG cache: header should be " << sizeof(header)
-                 << " bytes but read only " << f.gcount() << " bytes";
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 ||
+      (size_t)st.st_size < kCacheFileDataOffset_ + sizeof(node)) {
+    LOG(WARNING) << "cannot load DAG cache: file " << path << " too small";
+    close(fd);
     return nullptr;
   }
 
-  // ethash_light_delete() will use free() to release the memory.
-  // So malloc() and calloc() should used for memory allocation.
-  // The basic logic and codes copied from ethash_light_new_internal().
-  ret = (ethash_light *)calloc(sizeof(*ret), 1);
-  if (!ret) {
-    LOG(WARNING) << "cannot load DAG cache: calloc " << sizeof(*ret)
-                 << " bytes failed";
+  const size_t mapSize = st.st_size;
+  void *mem = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    LOG(WARNING) << "cannot load DAG cache: mmap " << path
+                 << " failed: " << strerror(errno);
     return nullptr;
   }
-#if defined(__MIC__)
-  ret->cache = _mm_malloc((size_t)header.cacheSize_, 64);
-#else
-  ret->cache = malloc((size_t)header.cacheSize_);
-#endif
-  if (!ret->cache) {
-    LOG(WARNING) << "cannot load DAG cache: malloc " << header.cacheSize_
-                 << " bytes failed";
-    goto fail_free_light;
-  }
 
-  f.read((char *)ret->cache, header.cacheSize_);
-  if (f.gcount() != (std::streamsize)header.cacheSize_) {
-    LOG(WARNING) << "cannot load DAG cache: cache should be "
-                 << header.cacheSize_ << " bytes but read only " << f.gcount()
-                 << " bytes";
-    goto fail_free_cache_mem;
-  }
+  const LightCacheHeader &header = *(const LightCacheHeader *)mem;
+  const uint8_t *data = (const uint8_t *)mem + kCacheFileDataOffset_;
 
-  checksum = computeCacheChecksum(header, (const uint8_t *)ret->cache);
-  if (checksum != header.checksum_) {
-    LOG(WARNING) << "cannot load DAG light: checksum mis-matched, it should be "
-                 << header.checksum_ << " but is " << checksum;
-    goto fail_free_cache_mem;
+  if (header.blockNumber_ / ETHASH_EPOCH_LENGTH != epoch ||
+      header.cacheSize_ != ethash_get_cachesize(header.blockNumber_) ||
+      kCacheFileDataOffset_ + header.cacheSize_ != mapSize ||
+      computeCacheChecksum(header, data) != header.checksum_) {
+    LOG(WARNING) << "cannot load DAG cache: file " << path << " mismatched";
+    munmap(mem, mapSize);
+    return nullptr;
   }
 
-  ret->block_number = header.blockNumber_;
-  ret->cache_size = header.cacheSize_;
-  return ret;
+  // ethash_light_compute() only reads the cache, it can use the mapping
+  LightCache light(new ethash_light, [mem, mapSize](ethash_light *light) {
+    munmap(mem, mapSize);
+    delete light;
+  });
+  light->cache = (void *)data;
+  light->cache_size = header.cacheSize_;
+  light->block_number = header.blockNumber_;
 
-fail_free_cache_mem:
-#if defined(__MIC__)
-  _mm_free(ret->cache);
-#else
-  free(ret->cache);
-#endif
-fail_free_light:
-  free(ret);
-  return nullptr;
+  LOG(INFO) << "loaded DAG cache of epoch " << epoch << " from file " << path;
+  return light;
 }
 
 uint64_t EthashCalculator::computeCacheChecksum(
@@ -203,125 +155,261 @@ uint64_t EthashCalculator::computeCacheChecksum(
   return checksum.u64;
 }
 
-void EthashCalculator::buildDagCacheWithoutLock(uint64_t height) {
-  uint64_t epoch = height / ETHASH_EPOCH_LENGTH;
-  if (lightCaches_[epoch] != nullptr) {
-    return;
+EthashCalculator::LightCache EthashCalculator::getLightCache(uint64_t epoch) {
+  LightCache light = std::atomic_load(&lightCaches_[epoch % kMaxCacheSize_]);
+  if (light && light->block_number / ETHASH_EPOCH_LENGTH == epoch) {
+    return light;
   }
+  light = std::atomic_load(&outdatedLightCache_);
+  if (light && light->block_number / ETHASH_EPOCH_LENGTH == epoch) {
+    return light;
+  }
+  return nullptr;
+}
+
+EthashCalculator::LightCache EthashCalculator::newLightCache(uint64_t epoch) {
+  const uint64_t height = epoch * ETHASH_EPOCH_LENGTH;
 
   LOG(INFO) << "building DAG cache for block height " << height << " (epoch "
             << epoch << ")";
   time_t beginTime = time(nullptr);
 
-  lightCaches_[epoch] = ethash_light_new(height);
-  lightEpochs_.push(epoch);
+  ethash_light_t light = ethash_light_new(height);
+  if (light == nullptr) {
+    LOG(ERROR) << "building DAG cache for epoch " << epoch << " failed";
+    return nullptr;
+  }
 
-  // Note: The performance of ethash_light_new() difference between Debug and
-  // Release builds is very large. The Release build may complete in 5 seconds,
-  // while the Debug build takes more than 60 seconds.
   LOG(INFO) << "DAG cache for block height " << height << " (epoch " << epoch
             << ") built within " << (time(nullptr) - beginTime) << " seconds";
+  return LightCache(light, ethash_light_delete);
 }
 
-ethash_light_t EthashCalculator::getDagCacheWithoutLock(uint64_t height) {
-  uint64_t epoch = height / ETHASH_EPOCH_LENGTH;
-  if (lightCaches_[epoch] == nullptr) {
-    buildDagCacheWithoutLock(height);
+void EthashCalculator::publishLightCacheWithoutLock(const LightCache &light) {
+  const uint64_t epoch = light->block_number / ETHASH_EPOCH_LENGTH;
+  LightCache &slot = lightCaches_[epoch % kMaxCacheSize_];
+
+  LightCache old = std::atomic_load(&slot);
+  if (old) {
+    const uint64_t oldEpoch = old->block_number / ETHASH_EPOCH_LENGTH;
+    if (oldEpoch > epoch) {
+      // A share of an outdated epoch, don't evict a newer cache for it.
+      // Keep it aside so that the next shares of the epoch don't build it
+      // again under buildLock_.
+      std::atomic_store(&outdatedLightCache_, light);
+      return;
+    }
+    if (oldEpoch != epoch) {
+      LOG(INFO) << "remove redundant DAG cache: epoch " << oldEpoch;
+      if (!cacheFilePrefix_.empty()) {
+        unlink(getCacheFilePath(oldEpoch).c_str());
+      }
+    }
   }
-  return lightCaches_[epoch];
-}
 
-void EthashCalculator::buildDagCache(uint64_t height) {
-  uint64_t epoch = height / ETHASH_EPOCH_LENGTH;
+  // verifications using the old cache keep it until they are done
+  std::atomic_store(&slot, light);
+}
 
-  bool currentEpochExists = false;
-  bool nextEpochExists = false;
-  {
-    ScopeLock sl(lock_);
-    currentEpochExists = lightCaches_[epoch] != nullptr;
-    nextEpochExists = lightCaches_[epoch + 1] != nullptr;
+EthashCalculator::LightCache
+EthashCalculator::getOrBuildLightCache(uint64_t epoch) {
+  LightCache light = getLightCache(epoch);
+  if (light) {
+    return light;
   }
 
-  if (currentEpochExists && nextEpochExists) {
-    return;
+  // Only one cache is built at a time, the others wait for it and may get
+  // their cache built by the same call.
+  ScopeLock sl(buildLock_);
+  light = getLightCache(epoch);
+  if (light) {
+    return light;
   }
 
-  auto buildLightWithLock = [this](uint64_t height, uint64_t epoch) {
-    {
-      ScopeLock sl(lock_);
-      if (buildingLightCaches_.find(epoch) != buildingLightCaches_.end()) {
-        return;
-      }
-      buildingLightCaches_.insert(epoch);
+  if (!cacheFilePrefix_.empty()) {
+    light = mapCacheFromFile(epoch);
+  }
+  if (!light) {
+    light = newLightCache(epoch);
+    if (!light) {
+      return nullptr;
+    }
+    if (!cacheFilePrefix_.empty()) {
+      saveCacheToFile(light);
     }
+  }
 
-    LOG(INFO) << "building DAG cache for block height " << height << " (epoch "
-              << epoch << ")";
-    time_t beginTime = time(nullptr);
+  publishLightCacheWithoutLock(light);
+  return light;
+}
 
-    ethash_light_t light = ethash_light_new(height);
+void EthashCalculator::buildDagCache(uint64_t height) {
+  uint64_t epoch = height / ETHASH_EPOCH_LENGTH;
 
-    // Note: The performance of ethash_light_new() difference between Debug and
-    // Release builds is very large. The Release build may complete in 5
-    // seconds, while the Debug build takes more than 60 seconds.
-    LOG(INFO) << "DAG cache for block height " << height << " (epoch " << epoch
-              << ") built within " << (time(nullptr) - beginTime) << " seconds";
+  // the current epoch, then the next one in advance
+  getOrBuildLightCache(epoch);
+  getOrBuildLightCache(epoch + 1);
 
-    ScopeLock sl(lock_);
-    buildingLightCaches_.erase(epoch);
+  if (fullDagThreads_ > 0) {
+    buildFullDag(epoch);
+  }
+}
 
-    if (lightCaches_[epoch] != nullptr) {
-      // Other threads have added the same light.
-      ethash_light_delete(light);
-      return;
-    }
+void EthashCalculator::rebuildDagCache(uint64_t height) {
+  uint64_t epoch = height / ETHASH_EPOCH_LENGTH;
 
-    lightCaches_[epoch] = light;
-    lightEpochs_.push(epoch);
-  };
+  LOG(INFO) << "rebuilding DAG cache for block height " << height;
 
-  if (!currentEpochExists) {
-    buildLightWithLock(height, epoch);
+  // don't trust the file, it may be the broken one
+  LightCache light = newLightCache(epoch);
+  if (!light) {
+    return;
   }
 
-  if (!nextEpochExists) {
-    buildLightWithLock(height + ETHASH_EPOCH_LENGTH, epoch + 1);
+  ScopeLock sl(buildLock_);
+  if (!getLightCache(epoch)) {
+    LOG(ERROR) << "EthashCalculator::rebuildDagCache(" << height
+               << "): the old DAG cache should not be empty";
+  }
+  if (!cacheFilePrefix_.empty()) {
+    saveCacheToFile(light);
   }
+  publishLightCacheWithoutLock(light);
+}
 
-  // remove redundant caches
-  ScopeLock sl(lock_);
-  while (lightEpochs_.size() > kMaxCacheSize_) {
-    uint64_t epoch = lightEpochs_.front();
-    ethash_light_delete(lightCaches_[epoch]);
+void EthashCalculator::enableFullDag(size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  fullDagThreads_ = threads;
+  LOG(INFO) << "ethash full DAG mode enabled, " << threads
+            << " threads generating DAG";
+}
 
-    lightCaches_.erase(epoch);
-    lightEpochs_.pop();
+// The DAG size grows with the epoch, it tells which epoch a full DAG is of.
+static uint64_t getFullDagSize(uint64_t epoch) {
+  return ethash_get_datasize(epoch * ETHASH_EPOCH_LENGTH);
+}
 
-    LOG(INFO) << "remove redundant DAG cache: epoch " << epoch;
+EthashCalculator::FullDag EthashCalculator::getFullDag(uint64_t epoch) {
+  FullDag full = std::atomic_load(&fullDag_);
+  if (full && full->file_size == getFullDagSize(epoch)) {
+    return full;
   }
-  assert(lightCaches_.size() == lightEpochs_.size());
+  return nullptr;
 }
 
-void EthashCalculator::rebuildDagCache(uint64_t height) {
-  uint64_t epoch = height / ETHASH_EPOCH_LENGTH;
+EthashCalculator::FullDag
+EthashCalculator::newFullDag(const LightCache &light) {
+  const uint64_t epoch = light->block_number / ETHASH_EPOCH_LENGTH;
+  const uint64_t fullSize = ethash_get_datasize(light->block_number);
+
+  // Hugepages (vm.nr_hugepages) if there are enough of them, otherwise ask
+  // for transparent hugepages. The DAG is read randomly, so 4K pages would
+  // cost a TLB miss for almost every access.
+  const size_t kHugePageSize = 2 * 1024 * 1024;
+  size_t mapSize =
+      (fullSize + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  void *mem = mmap(
+      nullptr,
+      mapSize,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+      -1,
+      0);
+  if (mem == MAP_FAILED) {
+    LOG(INFO) << "no hugepages for the full DAG (" << strerror(errno)
+              << "), fall back to transparent hugepages";
+    mapSize = fullSize;
+    mem = mmap(
+        nullptr,
+        mapSize,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (mem == MAP_FAILED) {
+      LOG(ERROR) << "cannot allocate " << fullSize
+                 << " bytes for the full DAG: " << strerror(errno);
+      return nullptr;
+    }
+    madvise(mem, mapSize, MADV_HUGEPAGE);
+  }
 
-  LOG(INFO) << "rebuilding DAG cache for block height " << height;
+  LOG(INFO) << "building full DAG for epoch " << epoch << " (" << fullSize
+            << " bytes) with " << fullDagThreads_ << " threads";
   time_t beginTime = time(nullptr);
 
-  ethash_light_t light = ethash_light_new(height);
+  // the items are independent, threads take chunks of them in turn
+  node *nodes = (node *)mem;
+  const uint32_t nodeNum = (uint32_t)(fullSize / sizeof(node));
+  const uint32_t kChunkSize = 4096;
+  std::atomic<uint32_t> nextChunk(0);
+  auto generate = [&]() {
+    for (;;) {
+      uint32_t begin = nextChunk.fetch_add(kChunkSize);
+      if (begin >= nodeNum) {
+        break;
+      }
+      uint32_t end = std::min(begin + kChunkSize, nodeNum);
+      for (uint32_t n = begin; n < end; n++) {
+        ethash_calculate_dag_item(&nodes[n], n, light.get());
+      }
+    }
+  };
+  vector<thread> threads;
+  for (size_t i = 1; i < fullDagThreads_; i++) {
+    threads.emplace_back(generate);
+  }
+  generate();
+  for (auto &t : threads) {
+    t.join();
+  }
 
-  LOG(INFO) << "DAG cache for block height " << height << " rebuilt within "
+  LOG(INFO) << "full DAG for epoch " << epoch << " built within "
             << (time(nullptr) - beginTime) << " seconds";
 
-  ScopeLock sl(lock_);
-  if (lightCaches_[epoch] != nullptr) {
-    ethash_light_delete(lightCaches_[epoch]);
-  } else {
-    LOG(ERROR) << "EthashCalculator::rebuildDagCache(" << height
-               << "): the old DAG cache should not be empty";
-    lightEpochs_.push(epoch);
+  FullDag full(new ethash_full, [mem, mapSize](ethash_full *full) {
+    munmap(mem, mapSize);
+    delete full;
+  });
+  full->file = nullptr;
+  full->file_size = fullSize;
+  full->data = nodes;
+  return full;
+}
+
+void EthashCalculator::buildFullDag(uint64_t epoch) {
+  if (getFullDag(epoch)) {
+    return;
+  }
+
+  // it takes minutes, don't queue up behind the running one
+  unique_lock<mutex> ul(fullDagBuildLock_, std::try_to_lock);
+  if (!ul.owns_lock() || getFullDag(epoch)) {
+    return;
+  }
+
+  FullDag old = std::atomic_load(&fullDag_);
+  if (old && old->file_size > getFullDagSize(epoch)) {
+    // a job of an outdated epoch
+    return;
+  }
+
+  LightCache light = getOrBuildLightCache(epoch);
+  if (!light) {
+    return;
+  }
+
+  // Release the DAG of the last epoch first, two of them may not fit in the
+  // memory. Verifications using it keep it until they are done.
+  std::atomic_store(&fullDag_, FullDag());
+  old.reset();
+
+  FullDag full = newFullDag(light);
+  if (full) {
+    std::atomic_store(&fullDag_, full);
   }
-  lightCaches_[epoch] = light;
 }
 
 bool EthashCalculator::compute(
@@ -329,8 +417,20 @@ bool EthashCalculator::compute(
     const ethash_h256_t &header,
     uint64_t nonce,
     ethash_return_value_t &r) {
-  ScopeLock sl(lock_);
-  r = ethash_light_compute(getDagCacheWithoutLock(height), header, nonce);
+  if (fullDagThreads_ > 0) {
+    FullDag full = getFullDag(height / ETHASH_EPOCH_LENGTH);
+    if (full) {
+      r = ethash_full_compute(full.get(), header, nonce);
+      return r.success;
+    }
+  }
+
+  LightCache light = getOrBuildLightCache(height / ETHASH_EPOCH_LENGTH);
+  if (!light) {
+    r.success = false;
+    return false;
+  }
+  r = ethash_light_compute(light.get(), header, nonce);
   return r.success;
 }
 
@@ -451,6 +551,16 @@ bool ServerEth::setupInternal(const libconfig::Config &config) {
   sessionIDManager_->setAllocInterval(256);
 #endif
 
+  bool fullDag = false;
+  config.lookupValue("sserver.full_dag", fullDag);
+  if (fullDag) {
+    unsigned int fullDagThreads = 0;
+    config.lookupValue("sserver.full_dag_threads", fullDagThreads);
+    for (size_t chainId = 0; chainId < chains_.size(); chainId++) {
+      GetJobRepository(chainId)->enableFullDag(fullDagThreads);
+    }
+  }
+
   return true;
 }
 
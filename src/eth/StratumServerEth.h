@@ -70,43 +70,75 @@ public:
 
 class EthashCalculator {
 protected:
-  const size_t kMaxCacheSize_ = 3;
+  // epochs N-1, N and N+1
+  static const size_t kMaxCacheSize_ = 3;
 
-  std::mutex lock_;
-  std::map<uint64_t /*epoch*/, ethash_light_t> lightCaches_;
-  std::set<uint64_t /*epoch*/> buildingLightCaches_;
-  std::queue<uint64_t> lightEpochs_;
-  string cacheFile_;
+  // An immutable DAG cache, released when the last user drops it.
+  using LightCache = shared_ptr<struct ethash_light>;
 
-  // save ethash_light_t to file
-  struct LightCacheHeader {
-    uint64_t checksum_;
-    uint64_t blockNumber_;
-    uint64_t cacheSize_;
-  };
+  // The cache of `epoch` lives in lightCaches_[epoch % kMaxCacheSize_].
+  // Slots are accessed with std::atomic_load()/std::atomic_store(), so
+  // compute() never takes a lock unless the cache is missing.
+  LightCache lightCaches_[kMaxCacheSize_];
+  // the last cache built for an epoch older than its slot's one
+  LightCache outdatedLightCache_;
+  // held while building / publishing a cache
+  std::mutex buildLock_;
 
   // Creating a new ethash_light_t (DAG cache) is so slow (in Debug build),
   // it may need more than 120 seconds for current Ethereum mainnet.
-  // So save it to a file before exiting and load it back at next time
-  // to reduce the computation time required after a restart.
+  // So save it to "<cacheFilePrefix_>-epoch<N>.dat" as soon as it is built,
+  // and mmap() it back after a restart.
   //
   // Note: The performance of ethash_light_new() difference between Debug and
   // Release builds is very large. The Release build may complete in 5 seconds,
   // while the Debug build takes more than 60 seconds.
-  size_t /*saved num*/ saveCacheToFile(const string &cacheFile);
-  void saveCacheToFile(const ethash_light_t &light, std::ofstream &f);
-  size_t /*loaded num*/ loadCacheFromFile(const string &cacheFile);
-  ethash_light_t loadCacheFromFile(std::ifstream &f);
+  string cacheFilePrefix_;
+
+  struct LightCacheHeader {
+    uint64_t checksum_;
+    uint64_t blockNumber_;
+    uint64_t cacheSize_;
+  };
+  // the cache data is page aligned in the file
+  static const size_t kCacheFileDataOffset_ = 4096;
+
+  string getCacheFilePath(uint64_t epoch);
+  bool saveCacheToFile(const LightCache &light);
+  LightCache mapCacheFromFile(uint64_t epoch);
   uint64_t
   computeCacheChecksum(const LightCacheHeader &header, const uint8_t *data);
 
-  void buildDagCacheWithoutLock(uint64_t height);
-  ethash_light_t getDagCacheWithoutLock(uint64_t height);
+  LightCache getLightCache(uint64_t epoch);
+  LightCache newLightCache(uint64_t epoch);
+  // returns the cache of `epoch`, loads or builds it if it's missing
+  LightCache getOrBuildLightCache(uint64_t epoch);
+  void publishLightCacheWithoutLock(const LightCache &light);
+
+  // Full DAG mode (optional): the whole dataset of the current epoch is kept
+  // in memory, so a verification reads 128 DAG items instead of computing
+  // them from the light cache (256 cache reads and 2 Keccak each).
+  // It needs several GB per chain. Shares of other epochs, and shares that
+  // come in while the DAG of a new epoch is being built, use the light cache.
+  using FullDag = shared_ptr<struct ethash_full>;
+
+  // accessed with std::atomic_load()/std::atomic_store()
+  FullDag fullDag_;
+  // threads generating the full DAG, 0 if the mode is disabled
+  size_t fullDagThreads_ = 0;
+  // held while building a full DAG, the other callers don't wait for it
+  std::mutex fullDagBuildLock_;
+
+  FullDag getFullDag(uint64_t epoch);
+  FullDag newFullDag(const LightCache &light);
+  void buildFullDag(uint64_t epoch);
 
 public:
   EthashCalculator() {}
-  EthashCalculator(const string &cacheFile);
-  ~EthashCalculator();
+  EthashCalculator(const string &cacheFilePrefix);
+
+  // threads: 0 for all CPU cores
+  void enableFullDag(size_t threads);
 
   void buildDagCache(uint64_t height);
   void rebuildDagCache(uint64_t height);
@@ -141,12 +173,13 @@ public:
   void broadcastStratumJob(shared_ptr<StratumJob> sjob) override;
 
   void rebuildDagCacheNonBlocking(uint64_t height);
+  void enableFullDag(size_t threads) { ethashCalc_.enableFullDag(threads); }
 
 protected:
   void buildDagCacheNonBlocking(uint64_t height);
 
   // TODO: move to configuration file
-  const char *kLightCacheFilePathFormat = "./sserver-eth%u-dagcache.dat";
+  const char *kLightCacheFilePathFormat = "./sserver-eth%u-dagcache";
 
   EthashCalculator ethashCalc_;
   uint32_t lastHeight_ = 0;
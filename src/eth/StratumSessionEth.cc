@@ -295,14 +295,7 @@ void StratumSessionEth::handleRequest_Subscribe(
   // receive miner's IP from stratumSwitcher
   if (params->size() >= 4) {
     clientIpInt_ = htonl(params->at(3).uint32());
-
-    // ipv4
-    clientIp_.resize(INET_ADDRSTRLEN);
-    struct in_addr addr;
-    addr.s_addr = clientIpInt_;
-    clientIp_ = inet_ntop(
-        AF_INET, &addr, (char *)clientIp_.data(), (socklen_t)clientIp_.size());
-    LOG(INFO) << "client real IP: " << clientIp_;
+    LOG(INFO) << "client real IP: " << getClientIpStr();
   }
 #endif // WORK_WITH_STRATUM_SWITCHER
 
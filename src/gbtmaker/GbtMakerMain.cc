@@ -136,6 +136,19 @@ int main(int argc, char **argv) {
         rpcCallInterval,
         isCheckZmq);
 
+#ifdef CHAIN_TYPE_BTC
+    bool mempoolMirror = false;
+    cfg.lookupValue("gbtmaker.mempool_mirror", mempoolMirror);
+    if (mempoolMirror) {
+      uint32_t minFeeIncrease = 10000;
+      uint32_t reconcileInterval = 10;
+      cfg.lookupValue("gbtmaker.mempool_min_fee_increase", minFeeIncrease);
+      cfg.lookupValue(
+          "gbtmaker.mempool_reconcile_interval", reconcileInterval);
+      gGbtMaker->enableMempoolMirror(minFeeIncrease, reconcileInterval);
+    }
+#endif
+
     if (!gGbtMaker->init()) {
       LOG(FATAL) << "gbtmaker init failure";
     } else {
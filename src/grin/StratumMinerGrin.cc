@@ -146,15 +146,46 @@ void StratumMinerGrin::handleRequest_Submit(
     return;
   }
 
-  uint256 blockHash;
-  server.checkAndUpdateShare(
-      localJob->chainId_,
+  // The cuckoo cycle is checked on the verifier threads, the share is
+  // handled when the check is done.
+  std::weak_ptr<bool> alive = alive_;
+  const size_t chainId = localJob->chainId_;
+  const string workerFullName = worker.fullName_;
+  auto proofsPtr = std::make_shared<const vector<uint64_t>>(std::move(proofs));
+  server.checkAndUpdateShareAsync(
+      chainId,
       share,
       exjob,
-      proofs,
+      proofsPtr,
       jobDiff.jobDiffs_,
-      worker.fullName_,
-      blockHash);
+      workerFullName,
+      [this, alive, &server, idStr, chainId, exjob, proofsPtr, workerFullName](
+          ShareGrin &share, const uint256 &blockHash) {
+        if (alive.expired()) {
+          // the miner is gone, the share is still counted
+          if (StratumStatus::isSolved(share.status())) {
+            server.sendSolvedShare2Kafka(
+                chainId, share, exjob, *proofsPtr, workerFullName, blockHash);
+            server.GetJobRepository(chainId)->markAllJobsAsStale();
+          }
+          sendShare2Kafka(server, chainId, share);
+          return;
+        }
+        handleCheckedShare(
+            idStr, share, chainId, exjob, *proofsPtr, blockHash);
+      });
+}
+
+void StratumMinerGrin::handleCheckedShare(
+    const string &idStr,
+    const ShareGrin &share,
+    size_t chainId,
+    shared_ptr<StratumJobEx> exjob,
+    const vector<uint64_t> &proofs,
+    const uint256 &blockHash) {
+  auto &session = getSession();
+  auto &server = session.getServer();
+  auto &worker = session.getWorker();
 
   if (StratumStatus::isAccepted(share.status())) {
     DLOG(INFO) << "share reached the diff: " << share.scaledShareDiff();
@@ -164,13 +195,12 @@ void StratumMinerGrin::handleRequest_Submit(
 
   // we send share to kafka by default, but if there are lots of invalid
   // shares in a short time, we just drop them.
-  if (handleShare(
-          idStr, share.status(), share.sharediff(), localJob->chainId_)) {
+  if (handleShare(idStr, share.status(), share.sharediff(), chainId)) {
     if (StratumStatus::isSolved(share.status())) {
       server.sendSolvedShare2Kafka(
-          localJob->chainId_, share, exjob, proofs, worker, blockHash);
+          chainId, share, exjob, proofs, worker.fullName_, blockHash);
       // mark jobs as stale
-      server.GetJobRepository(localJob->chainId_)->markAllJobsAsStale();
+      server.GetJobRepository(chainId)->markAllJobsAsStale();
     }
   } else {
     // check if there is invalid share spamming
@@ -184,6 +214,11 @@ void StratumMinerGrin::handleRequest_Submit(
     }
   }
 
+  sendShare2Kafka(server, chainId, share);
+}
+
+void StratumMinerGrin::sendShare2Kafka(
+    StratumServerGrin &server, size_t chainId, const ShareGrin &share) {
   DLOG(INFO) << share.toString();
 
   std::string message;
@@ -192,5 +227,5 @@ void StratumMinerGrin::handleRequest_Submit(
     LOG(ERROR) << "share SerializeToBuffer failed!" << share.toString();
     return;
   }
-  server.sendShare2Kafka(localJob->chainId_, message.data(), size);
+  server.sendShare2Kafka(chainId, message.data(), size);
 }
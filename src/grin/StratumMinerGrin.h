@@ -28,6 +28,8 @@
 
 #include "StratumMiner.h"
 
+class StratumJobEx;
+
 class StratumMinerGrin : public StratumMinerBase<StratumTraitsGrin> {
 public:
   StratumMinerGrin(
@@ -45,4 +47,16 @@ public:
 
 private:
   void handleRequest_Submit(const string &idStr, const JsonNode &jparams);
+  void handleCheckedShare(
+      const std::string &idStr,
+      const ShareGrin &share,
+      size_t chainId,
+      shared_ptr<StratumJobEx> exjob,
+      const vector<uint64_t> &proofs,
+      const uint256 &blockHash);
+  static void sendShare2Kafka(
+      StratumServerGrin &server, size_t chainId, const ShareGrin &share);
+
+  // expires with the miner, the shares being checked hold weak references
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
 };
\ No newline at end of file
@@ -26,9 +26,19 @@
 
 #include "StratumSessionGrin.h"
 #include "CommonGrin.h"
+#include "VerifierPool.h"
 
 #include <algorithm>
 
+StratumServerGrin::StratumServerGrin() = default;
+
+StratumServerGrin::~StratumServerGrin() = default;
+
+bool StratumServerGrin::setupInternal(const libconfig::Config &config) {
+  verifierPool_ = VerifierPool::create(*this, config);
+  return true;
+}
+
 unique_ptr<StratumSession> StratumServerGrin::createConnection(
     struct bufferevent *bev, struct sockaddr *saddr, uint32_t sessionID) {
   return std::make_unique<StratumSessionGrin>(*this, bev, saddr, sessionID);
@@ -112,12 +122,57 @@ void StratumServerGrin::checkAndUpdateShare(
   return;
 }
 
+void StratumServerGrin::checkAndUpdateShareAsync(
+    size_t chainId,
+    const ShareGrin &share,
+    shared_ptr<StratumJobEx> exjob,
+    shared_ptr<const vector<uint64_t>> proofs,
+    const std::set<uint64_t> &jobDiffs,
+    const string &workFullName,
+    std::function<void(ShareGrin &share, const uint256 &blockHash)>
+        callback) {
+  struct Result {
+    ShareGrin share_;
+    uint256 blockHash_;
+  };
+  auto result = std::make_shared<Result>();
+  result->share_ = share;
+
+  if (!verifierPool_) {
+    checkAndUpdateShare(
+        chainId,
+        result->share_,
+        exjob,
+        *proofs,
+        jobDiffs,
+        workFullName,
+        result->blockHash_);
+    callback(result->share_, result->blockHash_);
+    return;
+  }
+
+  // everything the worker reads is owned by the job: the miner's job
+  // difficulties may change and the session may close meanwhile
+  verifierPool_->submit(
+      [this, chainId, result, exjob, proofs, jobDiffs, workFullName]() {
+        checkAndUpdateShare(
+            chainId,
+            result->share_,
+            exjob,
+            *proofs,
+            jobDiffs,
+            workFullName,
+            result->blockHash_);
+      },
+      [result, callback]() { callback(result->share_, result->blockHash_); });
+}
+
 void StratumServerGrin::sendSolvedShare2Kafka(
     size_t chainId,
     const ShareGrin &share,
     shared_ptr<StratumJobEx> exjob,
     const vector<uint64_t> &proofs,
-    const StratumWorker &worker,
+    const string &workerFullName,
     const uint256 &blockHash) {
   string proofArray;
   if (!proofs.empty()) {
@@ -144,9 +199,9 @@ void StratumServerGrin::sendSolvedShare2Kafka(
       share.edgebits(),
       share.nonce(),
       proofArray,
-      worker.userId(chainId),
-      worker.workerHashId_,
-      filterWorkerName(worker.fullName_),
+      share.userid(),
+      share.workerhashid(),
+      filterWorkerName(workerFullName),
       blockHashStr);
   ServerBase::sendSolvedShare2Kafka(chainId, msg.data(), msg.size());
 }
@@ -30,9 +30,15 @@
 
 class JobRepositoryGrin;
 class ShareGrin;
+class VerifierPool;
 
 class StratumServerGrin : public ServerBase<JobRepositoryGrin> {
 public:
+  StratumServerGrin();
+  ~StratumServerGrin();
+
+  bool setupInternal(const libconfig::Config &config) override;
+
   unique_ptr<StratumSession> createConnection(
       struct bufferevent *bev,
       struct sockaddr *saddr,
@@ -46,12 +52,23 @@ public:
       const std::set<uint64_t> &jobDiffs,
       const string &workFullName,
       uint256 &blockHash);
+  // Runs checkAndUpdateShare() on the verifier pool if there is one,
+  // the callback is called on the event loop.
+  void checkAndUpdateShareAsync(
+      size_t chainId,
+      const ShareGrin &share,
+      shared_ptr<StratumJobEx> exjob,
+      shared_ptr<const vector<uint64_t>> proofs,
+      const std::set<uint64_t> &jobDiffs,
+      const string &workFullName,
+      std::function<void(ShareGrin &share, const uint256 &blockHash)>
+          callback);
   void sendSolvedShare2Kafka(
       size_t chainId,
       const ShareGrin &share,
       shared_ptr<StratumJobEx> exjob,
       const vector<uint64_t> &proofs,
-      const StratumWorker &worker,
+      const string &workerFullName,
       const uint256 &blockHash);
 
 protected:
@@ -60,6 +77,9 @@ protected:
       const char *kafkaBrokers,
       const char *consumerTopic,
       const string &fileLastNotifyTime) override;
+
+private:
+  unique_ptr<VerifierPool> verifierPool_;
 };
 
 class JobRepositoryGrin : public JobRepositoryBase<StratumServerGrin> {
@@ -95,8 +95,19 @@ GwMakerDefinition createGwMakerDefinition(const Setting &setting) {
   readFromSetting(setting, "rpc_userpwd", def.rpcUserPwd_);
   readFromSetting(setting, "rawgw_topic", def.rawGwTopic_);
   readFromSetting(setting, "rpc_interval", def.rpcInterval_);
+  def.rpcIntervalMax_ = def.rpcInterval_;
+  readFromSetting(setting, "rpc_interval_max", def.rpcIntervalMax_, true);
+  def.rpcIntervalMax_ = std::max(def.rpcIntervalMax_, def.rpcInterval_);
+  def.workRefreshInterval_ = 15000;
+  readFromSetting(
+      setting, "work_refresh_interval", def.workRefreshInterval_, true);
+
   readFromSetting(setting, "parity_notify_host", def.notifyHost_, true);
   readFromSetting(setting, "parity_notify_port", def.notifyPort_, true);
+  readFromSetting(setting, "notify_host", def.notifyHost_, true);
+  readFromSetting(setting, "notify_port", def.notifyPort_, true);
+  readFromSetting(setting, "zmq_addr", def.zmqAddr_, true);
+  readFromSetting(setting, "zmq_topic", def.zmqTopic_, true);
 
   def.enabled_ = false;
   readFromSetting(setting, "enabled", def.enabled_, true);
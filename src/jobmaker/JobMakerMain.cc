@@ -142,6 +142,7 @@ createGwJobMakerDefinition(const Setting &setting) {
 
   readFromSetting(setting, "zookeeper_lock_path", def->zookeeperLockPath_);
   readFromSetting(setting, "file_last_job_time", def->fileLastJobTime_, true);
+  readFromSetting(setting, "shm_job_bus", def->shmJobBus_, true);
   readFromSetting(setting, "id", def->serverId_);
 
   def->enabled_ = false;
@@ -195,6 +196,7 @@ createGbtJobMakerDefinition(const Setting &setting) {
 
   readFromSetting(setting, "zookeeper_lock_path", def->zookeeperLockPath_);
   readFromSetting(setting, "file_last_job_time", def->fileLastJobTime_, true);
+  readFromSetting(setting, "shm_job_bus", def->shmJobBus_, true);
   readFromSetting(setting, "id", def->serverId_);
 
   def->enabled_ = false;
@@ -0,0 +1,101 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+// Times prometheus::Histogram::observe(), alone and with threads observing
+// the same histogram at once, like the share checking threads of sserver.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "config/bpool-version.h"
+#include "prometheus/Histogram.h"
+
+using namespace std;
+
+void bench(size_t numThreads, size_t rounds) {
+  prometheus::Histogram histogram(prometheus::Histogram::LatencyBounds());
+  std::atomic<int64_t> totalNs{0};
+
+  vector<thread> threads;
+  for (size_t i = 0; i < numThreads; i++) {
+    threads.emplace_back([&histogram, &totalNs, rounds, i]() {
+      // spread the values over the buckets
+      double value = 0.00001 * (i + 1);
+      auto begin = std::chrono::steady_clock::now();
+      for (size_t j = 0; j < rounds; j++) {
+        histogram.observe(value);
+        value = value < 1 ? value * 1.5 : 0.00001;
+      }
+      totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - begin)
+                     .count();
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  printf(
+      "%2zu threads: %.1f ns per observe, %lu observed\n",
+      numThreads,
+      (double)totalNs / (numThreads * rounds),
+      (unsigned long)histogram.snapshot().count);
+}
+
+void usage() {
+  fprintf(stderr, BIN_VERSION_STRING("metricsbench"));
+  fprintf(stderr, "Usage:\tmetricsbench [-t <max threads>] [-n <rounds>]\n");
+}
+
+int main(int argc, char **argv) {
+  size_t maxThreads = std::thread::hardware_concurrency();
+  size_t rounds = 10000000;
+  int c;
+
+  while ((c = getopt(argc, argv, "t:n:h")) != -1) {
+    switch (c) {
+    case 't':
+      maxThreads = strtoul(optarg, nullptr, 10);
+      break;
+    case 'n':
+      rounds = strtoul(optarg, nullptr, 10);
+      break;
+    case 'h':
+    default:
+      usage();
+      exit(0);
+    }
+  }
+
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    bench(threads, rounds);
+  }
+  return 0;
+}
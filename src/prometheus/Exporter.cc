@@ -25,6 +25,7 @@
 #include "Exporter.h"
 
 #include "Collector.h"
+#include "Histogram.h"
 #include "Metric.h"
 
 #include <fmt/format.h>
@@ -46,11 +47,35 @@ static std::string FormatMetricType(Metric::Type t) {
     return "counter";
   case Metric::Type::Gauge:
     return "gauge";
+  case Metric::Type::Histogram:
+    return "histogram";
   default:
     return "untyped";
   }
 }
 
+template <typename Out, typename T>
+static void FormatSample(
+    Out &out,
+    const std::string &name,
+    const char *suffix,
+    const std::map<std::string, std::string> &labels,
+    const std::string &le,
+    const T &value) {
+  fmt::format_to(out, "{}{}", name, suffix);
+  if (!labels.empty() || !le.empty()) {
+    fmt::format_to(out, "{{");
+    for (auto &label : labels) {
+      fmt::format_to(out, "{}=\"{}\",", label.first, label.second);
+    }
+    if (!le.empty()) {
+      fmt::format_to(out, "le=\"{}\",", le);
+    }
+    fmt::format_to(out, "}}");
+  }
+  fmt::format_to(out, " {}\n", value);
+}
+
 } // namespace
 
 class Exporter : public IExporter {
@@ -147,16 +172,26 @@ std::string Exporter::exportMetrics() {
       }
       fmt::format_to(
           out, "# TYPE {} {}\n", name, FormatMetricType(metric->getType()));
-      fmt::format_to(out, "{}", name);
       auto &labels = metric->getLabels();
-      if (!labels.empty()) {
-        fmt::format_to(out, "{{");
-        for (auto &label : labels) {
-          fmt::format_to(out, "{}=\"{}\",", label.first, label.second);
-        }
-        fmt::format_to(out, "}}");
+      auto histogram = metric->getHistogram();
+      if (histogram == nullptr) {
+        FormatSample(out, name, "", labels, "", metric->getValue());
+        continue;
+      }
+
+      auto snapshot = histogram->snapshot();
+      for (size_t i = 0; i < snapshot.bounds.size(); i++) {
+        FormatSample(
+            out,
+            name,
+            "_bucket",
+            labels,
+            fmt::format("{}", snapshot.bounds[i]),
+            snapshot.buckets[i]);
       }
-      fmt::format_to(out, " {}\n", metric->getValue());
+      FormatSample(out, name, "_bucket", labels, "+Inf", snapshot.count);
+      FormatSample(out, name, "_sum", labels, "", snapshot.sum);
+      FormatSample(out, name, "_count", labels, "", snapshot.count);
     }
   }
   return text;
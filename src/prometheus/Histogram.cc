@@ -0,0 +1,155 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include "Histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace prometheus {
+
+namespace {
+
+std::atomic<size_t> nextThread{0};
+
+size_t threadShard() {
+  static thread_local size_t shard = nextThread++ % Histogram::kShards;
+  return shard;
+}
+
+double bitsToDouble(uint64_t bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint64_t doubleToBits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+} // namespace
+
+constexpr size_t Histogram::kShards;
+constexpr size_t Histogram::kCacheLine;
+
+void Histogram::FreeCounters::operator()(
+    std::atomic<uint64_t> *counters) const {
+  free(counters);
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+  : bounds_{std::move(bounds)} {
+  // the threads of two shards never share a cache line: the shards are
+  // padded to whole lines and the first one starts on a line, new[] only
+  // aligns to 16 bytes
+  constexpr size_t perLine = kCacheLine / sizeof(std::atomic<uint64_t>);
+  stride_ = (bounds_.size() + 2 + perLine - 1) / perLine * perLine;
+  size_t size = kShards * stride_ * sizeof(std::atomic<uint64_t>);
+  auto counters =
+      static_cast<std::atomic<uint64_t> *>(aligned_alloc(kCacheLine, size));
+  if (counters == nullptr) {
+    throw std::bad_alloc();
+  }
+  for (size_t i = 0; i < kShards * stride_; i++) {
+    new (&counters[i]) std::atomic<uint64_t>(0);
+  }
+  counters_.reset(counters);
+}
+
+void Histogram::observe(double value) {
+  size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) -
+      bounds_.begin();
+  auto shard = counters_.get() + threadShard() * stride_;
+  shard[1 + bucket].fetch_add(1, std::memory_order_relaxed);
+
+  // only contended if more than kShards threads observe at the same time
+  auto &sum = shard[0];
+  uint64_t bits = sum.load(std::memory_order_relaxed);
+  while (!sum.compare_exchange_weak(
+      bits,
+      doubleToBits(bitsToDouble(bits) + value),
+      std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot snapshot;
+  snapshot.bounds = bounds_;
+  snapshot.buckets.assign(bounds_.size() + 1, 0);
+  snapshot.sum = 0;
+  for (size_t i = 0; i < kShards; i++) {
+    auto shard = this->shard(i);
+    snapshot.sum += bitsToDouble(shard[0].load(std::memory_order_relaxed));
+    for (size_t j = 0; j < snapshot.buckets.size(); j++) {
+      snapshot.buckets[j] += shard[1 + j].load(std::memory_order_relaxed);
+    }
+  }
+  for (size_t j = 1; j < snapshot.buckets.size(); j++) {
+    snapshot.buckets[j] += snapshot.buckets[j - 1];
+  }
+  snapshot.count = snapshot.buckets.back();
+  return snapshot;
+}
+
+double Histogram::Snapshot::quantile(double q) const {
+  if (count == 0 || bounds.empty()) {
+    return 0;
+  }
+  uint64_t rank = std::max<uint64_t>(1, std::ceil(q * count));
+  size_t bucket =
+      std::lower_bound(buckets.begin(), buckets.end(), rank) - buckets.begin();
+  return bounds[std::min(bucket, bounds.size() - 1)];
+}
+
+Histogram::Snapshot
+Histogram::Snapshot::since(const Snapshot &earlier) const {
+  Snapshot snapshot = *this;
+  for (size_t j = 0; j < buckets.size() && j < earlier.buckets.size(); j++) {
+    snapshot.buckets[j] -= earlier.buckets[j];
+  }
+  snapshot.sum -= earlier.sum;
+  snapshot.count -= earlier.count;
+  return snapshot;
+}
+
+std::vector<double>
+Histogram::ExponentialBounds(double start, double factor, size_t count) {
+  std::vector<double> bounds;
+  for (size_t i = 0; i < count; i++) {
+    bounds.push_back(start);
+    start *= factor;
+  }
+  return bounds;
+}
+
+std::vector<double> Histogram::LatencyBounds() {
+  return ExponentialBounds(0.00001, 2, 20);
+}
+
+} // namespace prometheus
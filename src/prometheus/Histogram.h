@@ -0,0 +1,133 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "Metric.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace prometheus {
+
+// A histogram observed from any thread without locks. Every thread adds to
+// its own shard of bucket counters, the shards are summed up on a scrape.
+class Histogram {
+public:
+  static constexpr size_t kShards = 16;
+
+  struct Snapshot {
+    std::vector<double> bounds;
+    // cumulative counts of the bounds, then the one of +Inf
+    std::vector<uint64_t> buckets;
+    double sum;
+    uint64_t count;
+
+    // the bound of the bucket holding the q quantile, the last bound if it
+    // is in +Inf and 0 if nothing was observed
+    double quantile(double q) const;
+    // what was observed after an earlier snapshot of the same histogram
+    Snapshot since(const Snapshot &earlier) const;
+  };
+
+  // bounds are the upper bounds of the buckets, in increasing order
+  explicit Histogram(std::vector<double> bounds);
+
+  void observe(double value);
+  Snapshot snapshot() const;
+
+  // the counters of a shard: the sum (bits of a double), then one counter
+  // per bucket. Each shard starts on its own cache line.
+  const std::atomic<uint64_t> *shard(size_t i) const {
+    return counters_.get() + i * stride_;
+  }
+
+  // count bounds from start, each factor times the previous one
+  static std::vector<double>
+  ExponentialBounds(double start, double factor, size_t count);
+  // 10us to about 5s, for latencies in seconds
+  static std::vector<double> LatencyBounds();
+
+  static constexpr size_t kCacheLine = 64;
+
+private:
+  struct FreeCounters {
+    void operator()(std::atomic<uint64_t> *counters) const;
+  };
+
+  std::vector<double> bounds_;
+  // counters per shard, padded to a cache line
+  size_t stride_;
+  std::unique_ptr<std::atomic<uint64_t>, FreeCounters> counters_;
+};
+
+// Observes the seconds elapsed in its scope.
+class HistogramTimer {
+public:
+  explicit HistogramTimer(Histogram &histogram)
+    : histogram_(histogram)
+    , start_(std::chrono::steady_clock::now()) {}
+  ~HistogramTimer() {
+    histogram_.observe(std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start_)
+                           .count());
+  }
+
+private:
+  Histogram &histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+class MetricHistogram : public MetricBase {
+public:
+  MetricHistogram(
+      const std::string &name,
+      const std::string &help,
+      const std::map<std::string, std::string> &labels,
+      std::shared_ptr<Histogram> histogram)
+    : MetricBase{name, Metric::Type::Histogram, help, labels}
+    , histogram_{std::move(histogram)} {}
+
+  std::string getValue() const override {
+    return fmt::format("{}", histogram_->snapshot().count);
+  }
+  const Histogram *getHistogram() const override { return histogram_.get(); }
+
+private:
+  std::shared_ptr<Histogram> histogram_;
+};
+
+inline std::shared_ptr<Metric> CreateMetricHistogram(
+    const std::string &name,
+    const std::string &help,
+    const std::map<std::string, std::string> &labels,
+    std::shared_ptr<Histogram> histogram) {
+  return std::make_shared<MetricHistogram>(
+      name, help, labels, std::move(histogram));
+}
+
+} // namespace prometheus
@@ -31,11 +31,14 @@
 
 namespace prometheus {
 
+class Histogram;
+
 class Metric {
 public:
   enum class Type {
     Counter,
     Gauge,
+    Histogram,
   };
   virtual ~Metric() = default;
   virtual const std::string &getName() const = 0;
@@ -43,6 +46,8 @@ public:
   virtual std::string getValue() const = 0;
   virtual const std::string &getHelp() const = 0;
   virtual const std::map<std::string, std::string> &getLabels() const = 0;
+  // the buckets of a Histogram metric, null for the other types
+  virtual const prometheus::Histogram *getHistogram() const { return nullptr; }
 };
 
 } // namespace prometheus
@@ -44,6 +44,7 @@
 class GwMakerHandlerRsk : public GwMakerHandlerJson {
   bool checkFields(JsonNode &r) override;
   string constructRawMsg(JsonNode &r) override;
+  string getWorkIdField() override { return "blockHashForMergedMining"; }
   string getRequestData() override {
     return "{\"jsonrpc\": \"2.0\", \"method\": \"mnr_getWork\", \"params\": "
            "[], \"id\": 1}";
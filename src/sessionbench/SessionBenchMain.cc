@@ -0,0 +1,327 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+// Opens synthetic bitcoin sessions (a miner, a window of local jobs with a
+// few shares each) on socketpairs and reports the heap bytes per session.
+// With -w it also times the bufferevent calls of a share message with and
+// without BEV_OPT_THREADSAFE, with -a it times new jobs on a BTCAgent
+// session with that many miners.
+// No sserver, kafka or zookeeper is needed, the loop is never run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <glog/logging.h>
+#include <event2/event.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/thread.h>
+
+#include <chrono>
+
+#include "config/bpool-version.h"
+#include "DiffController.h"
+#include "StratumMessageDispatcher.h"
+#include "bitcoin/StratumServerBitcoin.h"
+#include "bitcoin/StratumSessionBitcoin.h"
+#include "bitcoin/StratumMinerBitcoin.h"
+
+using namespace std;
+
+class BenchServer : public ServerBitcoin {
+public:
+  BenchServer() {
+    ChainVars chain{};
+    chain.name_ = "bench";
+    chains_.push_back(chain);
+    defaultDifficultyController_ = make_shared<DiffController>(
+        0x4000, 0x4000000000000000, 0x40, 10, 900);
+  }
+};
+
+class BenchSession : public StratumSessionBitcoin {
+public:
+  using StratumSessionBitcoin::StratumSessionBitcoin;
+
+  // what subscribe and authorize leave behind, without the round trips
+  void authorize(
+      const string &clientAgent,
+      const string &fullName,
+      size_t numJobs,
+      size_t numShares) {
+    setClientAgent(clientAgent);
+    worker_.setNames(fullName);
+    worker_.setChainIdAndUserId(0, 1);
+    dispatcher_ = createDispatcher();
+    state_ = AUTHENTICATED;
+
+    for (size_t i = 0; i < numJobs; i++) {
+      clearLocalJobs();
+      auto &localJob = addLocalJob(0, i, (uint8_t)i, 0x17148edf);
+      for (size_t j = 0; j < numShares; j++) {
+        localJob.addLocalShare(LocalShare(j, (uint32_t)j, time(nullptr)));
+      }
+    }
+  }
+
+  // there is no kafka for the miner events
+  void addWorker(const string &, const string &, int64_t) override {}
+  void removeWorker(const string &, const string &, int64_t) override {}
+};
+
+static size_t heapInUse() {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+  return mallinfo2().uordblks;
+#else
+  return (unsigned int)mallinfo().uordblks;
+#endif
+}
+
+// The bufferevent calls of a share: the request is parsed from the input
+// as StratumSession::handleMessage() does and the response is written.
+// Only libevent is involved, no session, so the result does not depend on
+// the session layout measured above.
+// Returns nanoseconds per message.
+static double timeMessages(struct event_base *base, int options, size_t n) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    LOG(ERROR) << "socketpair failed: " << strerror(errno);
+    return 0;
+  }
+  close(fds[1]);
+  auto bev = bufferevent_socket_new(base, fds[0], options);
+  auto input = bufferevent_get_input(bev);
+  auto output = bufferevent_get_output(bev);
+  // the loop reads from the socket into it, we add to it ourselves
+  evbuffer_unfreeze(input, 0);
+
+  const string request =
+      "{\"id\":4,\"method\":\"mining.submit\",\"params\":[\"user.worker\","
+      "\"6a\",\"0000000000000001\",\"5c7f5a2d\",\"1e2f3a4b\"]}\n";
+  const string response = "{\"id\":4,\"result\":true,\"error\":null}\n";
+  string line;
+
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; i++) {
+    evbuffer_add(input, request.data(), request.size());
+    if (evbuffer_get_length(input) < 4) {
+      break;
+    }
+    auto loc = evbuffer_search_eol(input, nullptr, nullptr, EVBUFFER_EOL_LF);
+    line.resize(loc.pos + 1);
+    evbuffer_remove(input, &line.front(), line.size());
+
+    bufferevent_write(bev, response.data(), response.size());
+    // as if the loop wrote it to the socket
+    evbuffer_drain(output, evbuffer_get_length(output));
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+
+  bufferevent_free(bev);
+  return (double)ns / n;
+}
+
+// A new job on a BTCAgent session: every miner behind it gets the job and
+// its difficulty, the moved ones are told in one set-difficulty message.
+// Returns nanoseconds per job.
+static double timeAgentJobs(
+    BenchServer &server,
+    struct event_base *base,
+    struct sockaddr *saddr,
+    size_t numMiners,
+    size_t numJobs) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    LOG(ERROR) << "socketpair failed: " << strerror(errno);
+    return 0;
+  }
+  close(fds[1]);
+  auto bev = bufferevent_socket_new(base, fds[0], BEV_OPT_CLOSE_ON_FREE);
+  BenchSession session(server, bev, saddr, 0);
+  session.authorize("btccom-agent/0.3.0", "user.agent", 0, 0);
+
+  auto &agent =
+      static_cast<StratumMessageAgentDispatcher &>(session.getDispatcher());
+  for (size_t i = 0; i < numMiners; i++) {
+    agent.registerWorker(
+        (uint16_t)i, "cgminer/4.10.0", "worker" + std::to_string(i), i + 1);
+  }
+
+  auto output = bufferevent_get_output(bev);
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < numJobs; i++) {
+    session.clearLocalJobs();
+    session.addLocalJob(0, i, (uint8_t)i, 0x17148edf);
+    // as if the loop wrote it to the socket
+    evbuffer_drain(output, evbuffer_get_length(output));
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+  return (double)ns / numJobs;
+}
+
+void usage() {
+  fprintf(stderr, BIN_VERSION_STRING("sessionbench"));
+  fprintf(
+      stderr,
+      "Usage:\tsessionbench [-n <sessions>] [-j <jobs per session>] "
+      "[-s <shares per job>] [-u <users>] [-w <messages>] "
+      "[-a <agent miners>]\n");
+}
+
+int main(int argc, char **argv) {
+  size_t numSessions = 10000;
+  size_t numJobs = 16;
+  size_t numShares = 4;
+  size_t numUsers = 100;
+  size_t numMessages = 0;
+  size_t numAgentMiners = 0;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:j:s:u:w:a:h")) != -1) {
+    switch (c) {
+    case 'n':
+      numSessions = strtoul(optarg, nullptr, 10);
+      break;
+    case 'j':
+      numJobs = strtoul(optarg, nullptr, 10);
+      break;
+    case 's':
+      numShares = strtoul(optarg, nullptr, 10);
+      break;
+    case 'u':
+      numUsers = std::max(strtoul(optarg, nullptr, 10), 1ul);
+      break;
+    case 'w':
+      numMessages = strtoul(optarg, nullptr, 10);
+      break;
+    case 'a':
+      numAgentMiners = std::min(
+          strtoul(optarg, nullptr, 10),
+          (unsigned long)StratumMessageEx::AGENT_MAX_SESSION_ID + 1);
+      break;
+    case 'h':
+    default:
+      usage();
+      exit(0);
+    }
+  }
+
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 2; // ERROR, one INFO line per session is too many
+
+  const char *agents[] = {
+      "cgminer/4.10.0", "bmminer/2.0.0", "btccom-agent/0.3.0"};
+  struct sockaddr_in saddr;
+  memset(&saddr, 0, sizeof(saddr));
+  saddr.sin_family = AF_INET;
+  saddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  // as sserver does
+  evthread_use_pthreads();
+
+  BenchServer server;
+  struct event_base *base = event_base_new();
+  vector<unique_ptr<BenchSession>> sessions;
+  sessions.reserve(numSessions);
+
+  size_t heapBefore = heapInUse();
+  for (size_t i = 0; i < numSessions; i++) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      LOG(ERROR) << "socketpair failed after " << i
+                 << " sessions, raise ulimit -n: " << strerror(errno);
+      break;
+    }
+    // the peer is not needed, the loop is never run
+    close(fds[1]);
+    evutil_make_socket_nonblocking(fds[0]);
+
+    auto bev = bufferevent_socket_new(base, fds[0], BEV_OPT_CLOSE_ON_FREE);
+    auto session = std::make_unique<BenchSession>(
+        server, bev, (struct sockaddr *)&saddr, (uint32_t)i);
+    session->authorize(
+        agents[i % 3],
+        "user" + std::to_string(i % numUsers) + ".worker" + std::to_string(i),
+        numJobs,
+        numShares);
+    sessions.push_back(std::move(session));
+  }
+  size_t heapAfter = heapInUse();
+
+  if (!sessions.empty()) {
+    printf(
+        "sessions: %zu, jobs/session: %zu, shares/job: %zu, users: %zu\n",
+        sessions.size(),
+        numJobs,
+        numShares,
+        numUsers);
+    printf(
+        "sizeof(StratumSessionBitcoin): %zu, sizeof(StratumMinerBitcoin): "
+        "%zu\n",
+        sizeof(StratumSessionBitcoin),
+        sizeof(StratumMinerBitcoin));
+    printf(
+        "heap: %zu bytes, %.1f bytes/session\n",
+        heapAfter - heapBefore,
+        (double)(heapAfter - heapBefore) / sessions.size());
+  }
+
+  sessions.clear();
+
+  if (numMessages > 0) {
+    printf(
+        "messages: %zu, %.1f ns/message with BEV_OPT_THREADSAFE, %.1f "
+        "ns/message without\n",
+        numMessages,
+        timeMessages(
+            base, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE, numMessages),
+        timeMessages(base, BEV_OPT_CLOSE_ON_FREE, numMessages));
+  }
+
+  if (numAgentMiners > 0) {
+    double ns = timeAgentJobs(
+        server, base, (struct sockaddr *)&saddr, numAgentMiners, numJobs);
+    printf(
+        "agent miners: %zu, %.3f ms/job, %.1f ns/miner\n",
+        numAgentMiners,
+        ns / 1000000,
+        ns / numAgentMiners);
+  }
+
+  event_base_free(base);
+  google::ShutdownGoogleLogging();
+  return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+// Times SessionIDManagerT at a given occupancy: the ids are filled up to
+// it, then a random id is freed and a new one allocated, like sessions
+// coming and going on a busy sserver.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include <glog/logging.h>
+
+#include "config/bpool-version.h"
+#include "StratumServer.h"
+
+using namespace std;
+
+template <uint8_t IBITS>
+void bench(double occupancy, size_t rounds, uint32_t interval) {
+  const uint32_t numIds = 1u << IBITS;
+  const uint32_t numUsed = (uint32_t)(numIds * occupancy);
+  std::mt19937 rng(1);
+
+  SessionIDManagerT<IBITS> manager(1);
+  manager.setAllocInterval(interval);
+
+  // fill all, then free at random down to the occupancy
+  vector<uint32_t> ids(numIds);
+  for (auto &id : ids) {
+    manager.allocSessionId(&id);
+  }
+  std::shuffle(ids.begin(), ids.end(), rng);
+  for (uint32_t i = numUsed; i < numIds; i++) {
+    manager.freeSessionId(ids[i]);
+  }
+  ids.resize(numUsed);
+
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; i++) {
+    auto &id = ids[rng() % ids.size()];
+    manager.freeSessionId(id);
+    manager.allocSessionId(&id);
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+
+  printf(
+      "%2d bits, %.0f%% used, interval %u: %.1f ns per free + alloc\n",
+      IBITS,
+      occupancy * 100,
+      interval,
+      (double)ns / rounds);
+
+  // the worst case: all used but the id right before the cursor, it is
+  // found after a round over all ids
+  uint32_t last = 0;
+  for (uint32_t i = numUsed; i < numIds; i++) {
+    manager.allocSessionId(&last);
+  }
+  const size_t worstRounds = 100;
+  begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < worstRounds; i++) {
+    const uint32_t behind = (last + interval - 1) & (numIds - 1);
+    manager.freeSessionId((1u << IBITS) | behind);
+    manager.allocSessionId(&last);
+  }
+  ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now() - begin)
+           .count();
+
+  printf(
+      "%2d bits, 100%% used, interval %u: %.1f ns per free + alloc\n",
+      IBITS,
+      interval,
+      (double)ns / worstRounds);
+}
+
+void usage() {
+  fprintf(stderr, BIN_VERSION_STRING("sessionidbench"));
+  fprintf(
+      stderr,
+      "Usage:\tsessionidbench [-o <occupancy, 0.9>] [-n <rounds>] "
+      "[-i <alloc interval>]\n");
+}
+
+int main(int argc, char **argv) {
+  double occupancy = 0.9;
+  size_t rounds = 1000000;
+  uint32_t interval = 0;
+  int c;
+
+  while ((c = getopt(argc, argv, "o:n:i:h")) != -1) {
+    switch (c) {
+    case 'o':
+      occupancy = atof(optarg);
+      break;
+    case 'n':
+      rounds = strtoul(optarg, nullptr, 10);
+      break;
+    case 'i':
+      interval = strtoul(optarg, nullptr, 10);
+      break;
+    case 'h':
+    default:
+      usage();
+      exit(0);
+    }
+  }
+  if (occupancy <= 0 || occupancy >= 1) {
+    usage();
+    return 1;
+  }
+
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = 1;
+
+  bench<16>(occupancy, rounds, interval);
+  bench<24>(occupancy, rounds, interval);
+
+  google::ShutdownGoogleLogging();
+  return 0;
+}
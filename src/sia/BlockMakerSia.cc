@@ -22,6 +22,7 @@
  THE SOFTWARE.
  */
 #include "BlockMakerSia.h"
+#include "HttpClient.h"
 
 #include <boost/thread.hpp>
 
@@ -39,17 +40,18 @@ void BlockMakerSia::processSolvedShare(rd_kafka_message_t *rkmessage) {
     return;
   }
 
-  char buf[80] = {0};
-  memcpy(buf, rkmessage->payload, 80);
+  auto header =
+      std::make_shared<const string>((const char *)rkmessage->payload, 80);
   for (const auto &itr : def()->nodes) {
-    string response;
-    rpcCall(
-        itr.rpcAddr_.c_str(),
-        itr.rpcUserPwd_.c_str(),
-        buf,
-        80,
-        response,
-        "Sia-Agent");
-    LOG(INFO) << "submission result: " << response;
+    HttpRequest request;
+    request.url_ = itr.rpcAddr_;
+    request.userpwd_ = itr.rpcUserPwd_;
+    request.body_ = header;
+    request.contentType_ = "application/json";
+    request.agent_ = "Sia-Agent";
+    AsyncHttpClient::shared().request(
+        std::move(request), [](bool ok, const string &response) {
+          LOG(INFO) << "submission result: " << response;
+        });
   }
 }
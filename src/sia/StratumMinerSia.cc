@@ -28,10 +28,12 @@
 #include "DiffController.h"
 
 #include "StratumSia.h"
-#include "libblake2/blake2.h"
+#include "Utils.h"
 
 #include <arith_uint256.h>
 
+#include <algorithm>
+
 ///////////////////////////////// StratumSessionSia
 ///////////////////////////////////
 StratumMinerSia::StratumMinerSia(
@@ -67,49 +69,28 @@ void StratumMinerSia::handleRequest_Submit(
     return;
   }
 
-  auto params = (const_cast<JsonNode &>(jparams)).array();
+  const auto &params = jparams.array();
   if (params.size() != 3) {
     session.responseError(idStr, StratumStatus::ILLEGAL_PARARMS);
     LOG(ERROR) << "illegal header size: " << params.size();
     return;
   }
 
-  string header = params[2].str();
-  // string header =
-  // "00000000000000021f3e8ede65495c4311ef59e5b7a4338542e573819f5979e982719d0366014155e935aa5a00000000201929782a8fe3209b152520c51d2a82dc364e4a3eb6fb8131439835e278ff8b";
-  if (162 == header.length())
-    header = header.substr(2, 160);
-  if (header.length() != 160) {
+  // the header of the job with the nonce of the miner, e.g.
+  // 00000000000000021f3e8ede65495c4311ef59e5b7a4338542e573819f5979e982719d0366014155e935aa5a00000000201929782a8fe3209b152520c51d2a82dc364e4a3eb6fb8131439835e278ff8b
+  const char *header = params[2].start();
+  size_t headerSize = params[2].size();
+  if (headerSize == StratumJobSia::kHeaderSize * 2 + 2) {
+    header += 2; // 0x
+    headerSize -= 2;
+  }
+  if (headerSize != StratumJobSia::kHeaderSize * 2) {
     session.responseError(idStr, StratumStatus::ILLEGAL_PARARMS);
     LOG(ERROR) << "illegal header" << params[2].str();
     return;
   }
 
-  uint8_t bHeader[80] = {0};
-  for (int i = 0; i < 80; ++i)
-    bHeader[i] = strtol(header.substr(i * 2, 2).c_str(), 0, 16);
-  // uint64_t nonce = strtoull(header.substr(64, 16).c_str(), nullptr, 16);
-  // uint64_t timestamp = strtoull(header.substr(80, 16).c_str(), nullptr, 16);
-  // DLOG(INFO) << "nonce=" << std::hex << nonce << ", timestamp=" << std::hex
-  // << timestamp;
-  // //memcpy(bHeader + 32, &nonce, 8);
-  // memcpy(bHeader + 40, &timestamp, 8);
-  // for (int i = 48; i < 80; ++i)
-  //   bHeader[i] = strtol(header.substr(i * 2, 2).c_str(), 0, 16);
-  string str;
-  for (int i = 0; i < 80; ++i)
-    str += Strings::Format("%02x", bHeader[i]);
-  DLOG(INFO) << str;
-
-  uint8_t out[32] = {0};
-  int ret = blake2b(out, 32, bHeader, 80, nullptr, 0);
-  DLOG(INFO) << "blake2b return=" << ret;
-  // str = "";
-  for (int i = 0; i < 32; ++i)
-    str += Strings::Format("%02x", out[i]);
-  DLOG(INFO) << str;
-
-  uint8_t shortJobId = (uint8_t)atoi(params[1].str());
+  uint8_t shortJobId = (uint8_t)params[1].uint32();
   LocalJob *localJob = session.findLocalJob(shortJobId);
   if (nullptr == localJob) {
     session.responseError(idStr, StratumStatus::JOB_NOT_FOUND);
@@ -134,7 +115,26 @@ void StratumMinerSia::handleRequest_Submit(
     return;
   }
 
-  uint64_t nonce = *((uint64_t *)(bHeader + 32));
+  // only the nonce is taken from the miner
+  uint8_t bNonce[StratumJobSia::kNonceSize];
+  if (!Hex2BinFixed(
+          header + StratumJobSia::kNonceOffset * 2, bNonce, sizeof(bNonce))) {
+    session.responseError(idStr, StratumStatus::ILLEGAL_PARARMS);
+    LOG(ERROR) << "illegal header" << params[2].str();
+    return;
+  }
+
+  uint8_t bHeader[StratumJobSia::kHeaderSize];
+  uint256 hash;
+  sjob->hashShare(bNonce, bHeader, hash);
+  if (VLOG_IS_ON(1)) {
+    string headerHex, hashHex;
+    Bin2Hex(bHeader, sizeof(bHeader), headerHex);
+    Bin2Hex(hash.begin(), sizeof(hash), hashHex);
+    VLOG(1) << "header: " << headerHex << ", hash: " << hashHex;
+  }
+
+  uint64_t nonce = *((uint64_t *)(bHeader + StratumJobSia::kNonceOffset));
   LocalShare localShare(nonce, 0, 0);
   if (!server.isEnableSimulator_ && !localJob->addLocalShare(localShare)) {
     session.responseError(idStr, StratumStatus::DUPLICATE_SHARE);
@@ -166,14 +166,16 @@ void StratumMinerSia::handleRequest_Submit(
   share.set_timestamp((uint32_t)time(nullptr));
   share.set_status(StratumStatus::REJECT_NO_REASON);
 
-  arith_uint256 shareTarget(str);
+  // the hash is compared as a big-endian number
+  std::reverse(hash.begin(), hash.end());
+  arith_uint256 shareTarget = UintToArith256(hash);
   arith_uint256 networkTarget = UintToArith256(sjob->networkTarget_);
 
   if (shareTarget < networkTarget) {
     // valid share
     // submit share
     server.sendSolvedShare2Kafka(localJob->chainId_, (const char *)bHeader, 80);
-    diffController_->addAcceptedShare(share.sharediff());
+    addAcceptedShare(share.sharediff());
     // mark jobs as stale
     server.GetJobRepository(localJob->chainId_)->markAllJobsAsStale();
 
@@ -25,11 +25,13 @@
 
 #include "Utils.h"
 #include "utilities_js.hpp"
+#include "libblake2/blake2.h"
 
 #include <glog/logging.h>
 
 StratumJobSia::StratumJobSia()
   : nTime_(0U) {
+  memset(header_, 0, sizeof(header_));
 }
 
 StratumJobSia::~StratumJobSia() {
@@ -67,5 +69,30 @@ bool StratumJobSia::unserializeFromJson(const char *s, size_t len) {
   networkTarget_ = uint256S(j["target"].str());
   blockHashForMergedMining_ = j["hHash"].str();
 
+  if (blockHashForMergedMining_.size() != kHeaderSize * 2 ||
+      !Hex2BinFixed(
+          blockHashForMergedMining_.c_str(), header_, sizeof(header_))) {
+    LOG(ERROR) << "invalid sia header: " << blockHashForMergedMining_;
+    return false;
+  }
+
   return true;
 }
+
+void StratumJobSia::hashShare(
+    const uint8_t *nonce, uint8_t *header, uint256 &hash) const {
+  // the state after blake2b_init() is the same for all the headers, it is
+  // copied instead of being set up again
+  static const blake2b_state initState = []() {
+    blake2b_state state;
+    blake2b_init(&state, sizeof(uint256));
+    return state;
+  }();
+
+  memcpy(header, header_, kHeaderSize);
+  memcpy(header + kNonceOffset, nonce, kNonceSize);
+
+  blake2b_state state = initState;
+  blake2b_update(&state, header, kHeaderSize);
+  blake2b_final(&state, hash.begin(), sizeof(hash));
+}
@@ -241,9 +241,16 @@ public:
 
 class StratumJobSia : public StratumJob {
 public:
+  static const size_t kHeaderSize = 80;
+  static const size_t kNonceOffset = 32;
+  static const size_t kNonceSize = 8;
+
   uint32_t nTime_;
-  string blockHashForMergedMining_;
+  string blockHashForMergedMining_; // hex of the header
   uint256 networkTarget_;
+  // decoded from blockHashForMergedMining_ by unserializeFromJson(), the
+  // shares only change the nonce
+  uint8_t header_[kHeaderSize];
 
 public:
   StratumJobSia();
@@ -252,6 +259,10 @@ public:
   bool unserializeFromJson(const char *s, size_t len) override;
   uint64_t height() const override { return 0; }
   uint32_t jobTime() const override { return nTime_; }
+
+  // Writes header_ with the nonce (kNonceSize bytes) of a share to `header`
+  // (kHeaderSize bytes) and its blake2b-256 to `hash`.
+  void hashShare(const uint8_t *nonce, uint8_t *header, uint256 &hash) const;
 };
 
 class ServerSia;
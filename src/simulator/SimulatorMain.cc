@@ -135,6 +135,7 @@ int main(int argc, char **argv) {
     // register stratum client factories
     StratumClient::registerFactory<StratumClient>("BTC");
     StratumClient::registerFactory<StratumClient>("DCR");
+    StratumClient::registerFactoryWithConfig<StratumClientAgent>("BTCAgent");
     StratumClient::registerFactory<StratumClientEth>("ETH");
     StratumClient::registerFactory<StratumClientBeam>("BEAM");
     StratumClient::registerFactoryWithConfig<StratumClientGrin>("GRIN");
@@ -0,0 +1,629 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+// Replays a bitcoin sharelog against a local sserver. Every worker of the
+// log gets a stratum connection, opened look_ahead seconds before its first
+// share with the difficulty of that share, and closed after idle_timeout
+// seconds of log time without a share. Shares are submitted at the times of
+// the log (the shares of one second spread evenly over it), -x times as
+// fast, so the same file always gives the same load.
+// Throughput, round-trip latencies and the CPU time per share of slreplay
+// and of sserver (-p) are reported periodically and at the end.
+//
+// A sharelog only keeps the hash of a worker name, so the workers are named
+// <username>.<minername_prefix><user id>-<worker hash id>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#include <glog/logging.h>
+#include <libconfig.h++>
+#include <event2/event.h>
+#include <event2/thread.h>
+
+#include "config/bpool-version.h"
+#include "zlibstream/zstr.hpp"
+#include "Statistics.h"
+#include "StratumClient.h"
+#include "Utils.h"
+#include "bitcoin/StratumBitcoin.h"
+
+using namespace std;
+using namespace libconfig;
+using std::chrono::steady_clock;
+
+// A ShareBitcoin takes about 100 bytes, a larger length is a corrupt log.
+static const uint32_t kMaxShareSize = 4096;
+
+void usage() {
+  fprintf(stderr, BIN_VERSION_STRING("slreplay"));
+  fprintf(
+      stderr,
+      "Usage:\tslreplay -c \"slreplay.cfg\" -f \"<sharelog.bin>\" "
+      "[-x <speed>] [-p <sserver pid>] [-l <log_dir|stderr>]\n");
+}
+
+// user + system seconds of a process, from /proc/<pid>/stat
+static double processCpuSeconds(pid_t pid) {
+  std::ifstream stat(Strings::Format("/proc/%d/stat", pid));
+  string line;
+  if (!std::getline(stat, line)) {
+    return 0;
+  }
+  // the command may have spaces, the fields after it don't
+  auto pos = line.rfind(')');
+  if (pos == string::npos || pos + 2 > line.size()) {
+    return 0;
+  }
+  std::istringstream fields(line.substr(pos + 2));
+  string field;
+  uint64_t utime = 0, stime = 0;
+  // state is field 3, utime and stime are 14 and 15
+  for (int i = 3; i <= 15 && fields >> field; i++) {
+    if (i == 14) {
+      utime = strtoull(field.c_str(), nullptr, 10);
+    } else if (i == 15) {
+      stime = strtoull(field.c_str(), nullptr, 10);
+    }
+  }
+  return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static double selfCpuSeconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+/////////////////////////////// ShareLogReplayer ///////////////////////////////
+class ShareLogReplayer {
+public:
+  ShareLogReplayer(
+      const libconfig::Config &config,
+      const string &file,
+      double speed,
+      pid_t serverPid);
+  ~ShareLogReplayer();
+
+  bool run();
+
+private:
+  struct Share {
+    WorkerKey key_;
+    uint32_t timestamp_;
+    uint64_t shareDiff_;
+  };
+
+  struct Worker {
+    unique_ptr<StratumClient> client_;
+    uint32_t lastShareTime_; // of the log
+  };
+
+  static void tickCallback(evutil_socket_t fd, short event, void *ptr);
+  static void reportCallback(evutil_socket_t fd, short event, void *ptr);
+  static void signalCallback(evutil_socket_t fd, short event, void *ptr);
+
+  bool readShare(Share &share);
+  void addPending(Share share);
+  void readAhead(uint32_t until);
+  void tick();
+  void closeIdleWorkers(uint32_t now);
+  void report(bool final);
+  void stop();
+
+  string host_;
+  uint16_t port_;
+  bool enableTLS_;
+  string userName_;
+  string minerNamePrefix_;
+  uint32_t lookAhead_; // log seconds a worker connects before its share
+  uint32_t idleTimeout_; // log seconds
+  uint32_t reportInterval_;
+  string file_;
+  double speed_;
+  pid_t serverPid_;
+
+  zstr::ifstream in_;
+  string buf_;
+  bool eof_;
+  uint64_t invalid_;
+
+  struct event_base *base_;
+  struct event *tickTimer_;
+  struct event *reportTimer_;
+  struct event *sigterm_;
+  struct event *sigint_;
+
+  // shares read and not submitted yet, in the order of the log
+  std::deque<Share> pending_;
+  std::unordered_map<WorkerKey, Worker> workers_;
+  StratumClientLatencies latencies_;
+
+  uint32_t firstShareTime_; // submitted at startTime_
+  uint32_t currentSecond_; // of the log, being submitted
+  size_t currentSecondShares_;
+  size_t currentSecondSubmitted_;
+  uint32_t lastIdleCheck_;
+  steady_clock::time_point startTime_;
+
+  uint64_t submitted_;
+  uint64_t dropped_; // the worker was not authenticated yet
+  uint64_t connections_;
+  double maxLagSeconds_; // behind the schedule of the log
+
+  steady_clock::time_point lastReportTime_;
+  uint64_t lastSubmitted_;
+  double lastServerCpu_;
+  double lastSelfCpu_;
+  // at startTime_
+  double startServerCpu_;
+  double startSelfCpu_;
+  std::vector<prometheus::Histogram::Snapshot> lastLatencies_;
+};
+
+ShareLogReplayer::ShareLogReplayer(
+    const libconfig::Config &config,
+    const string &file,
+    double speed,
+    pid_t serverPid)
+  : port_(3333)
+  , enableTLS_(false)
+  , lookAhead_(5)
+  , idleTimeout_(900)
+  , reportInterval_(10)
+  , file_(file)
+  , speed_(speed)
+  , serverPid_(serverPid)
+  , in_(file, std::ios::binary)
+  , eof_(false)
+  , invalid_(0)
+  , base_(event_base_new())
+  , tickTimer_(nullptr)
+  , reportTimer_(nullptr)
+  , sigterm_(nullptr)
+  , sigint_(nullptr)
+  , firstShareTime_(0)
+  , currentSecond_(0)
+  , currentSecondShares_(0)
+  , currentSecondSubmitted_(0)
+  , lastIdleCheck_(0)
+  , submitted_(0)
+  , dropped_(0)
+  , connections_(0)
+  , maxLagSeconds_(0)
+  , lastSubmitted_(0)
+  , lastServerCpu_(0)
+  , lastSelfCpu_(0)
+  , startServerCpu_(0)
+  , startSelfCpu_(0) {
+  host_ = config.lookup("slreplay.ss_ip").c_str();
+  int32_t port = port_;
+  config.lookupValue("slreplay.ss_port", port);
+  port_ = port;
+  config.lookupValue("slreplay.enable_tls", enableTLS_);
+  userName_ = config.lookup("slreplay.username").c_str();
+  config.lookupValue("slreplay.minername_prefix", minerNamePrefix_);
+  config.lookupValue("slreplay.look_ahead", lookAhead_);
+  config.lookupValue("slreplay.idle_timeout", idleTimeout_);
+  config.lookupValue("slreplay.report_interval", reportInterval_);
+}
+
+ShareLogReplayer::~ShareLogReplayer() {
+  if (sigint_)
+    event_free(sigint_);
+  if (sigterm_)
+    event_free(sigterm_);
+  if (reportTimer_)
+    event_free(reportTimer_);
+  if (tickTimer_)
+    event_free(tickTimer_);
+
+  // It has to be cleared here to free client events before event base
+  workers_.clear();
+
+  event_base_free(base_);
+}
+
+bool ShareLogReplayer::readShare(Share &share) {
+  // | length (uint32_t) | ShareBitcoin | ...
+  while (!eof_) {
+    uint32_t len = 0;
+    in_.read((char *)&len, sizeof(len));
+    if (in_.gcount() != sizeof(len)) {
+      eof_ = true;
+      break;
+    }
+    if (len > kMaxShareSize) {
+      LOG(ERROR) << "share of " << len << " bytes in " << file_
+                 << ", the rest of the log is skipped";
+      invalid_++;
+      eof_ = true;
+      break;
+    }
+    buf_.resize(len);
+    in_.read((char *)buf_.data(), len);
+    if ((uint32_t)in_.gcount() != len) {
+      LOG(WARNING) << "incomplete share at the end of " << file_;
+      eof_ = true;
+      break;
+    }
+
+    ShareBitcoin bshare;
+    if (!bshare.ParseFromArray(buf_.data(), len) || !bshare.isValid()) {
+      invalid_++;
+      continue;
+    }
+    share.key_ = WorkerKey(bshare.userid(), bshare.workerhashid());
+    share.timestamp_ = bshare.timestamp();
+    share.shareDiff_ = bshare.sharediff();
+    return true;
+  }
+  return false;
+}
+
+void ShareLogReplayer::addPending(Share share) {
+  // shares are logged in the order they arrive, not quite sorted
+  if (!pending_.empty() && share.timestamp_ < pending_.back().timestamp_) {
+    share.timestamp_ = pending_.back().timestamp_;
+  }
+  pending_.push_back(share);
+
+  // a new worker connects now, before its first share
+  auto &worker = workers_[share.key_];
+  worker.lastShareTime_ = share.timestamp_;
+  if (worker.client_) {
+    return;
+  }
+  string fullName = Strings::Format(
+      "%s.%s%d-%d",
+      userName_,
+      minerNamePrefix_,
+      share.key_.userId_,
+      share.key_.workerId_);
+  worker.client_ = std::make_unique<StratumClient>(
+      enableTLS_, base_, fullName, Strings::Format("d=%u", share.shareDiff_));
+  worker.client_->setLatencies(&latencies_);
+  if (!worker.client_->connect(host_, port_)) {
+    LOG(ERROR) << "client connnect failure: " << fullName;
+  }
+  connections_++;
+}
+
+void ShareLogReplayer::readAhead(uint32_t until) {
+  Share share{WorkerKey(0, 0), 0, 0};
+  while ((pending_.empty() || pending_.back().timestamp_ <= until) &&
+         readShare(share)) {
+    addPending(share);
+  }
+}
+
+void ShareLogReplayer::tick() {
+  double logSeconds =
+      std::chrono::duration<double>(steady_clock::now() - startTime_).count() *
+      speed_;
+  uint32_t logNow = firstShareTime_ + (uint32_t)logSeconds;
+  readAhead(logNow + lookAhead_);
+
+  while (!pending_.empty()) {
+    auto &share = pending_.front();
+    if (share.timestamp_ != currentSecond_) {
+      // the shares of a second go evenly over it
+      currentSecond_ = share.timestamp_;
+      currentSecondShares_ = 0;
+      currentSecondSubmitted_ = 0;
+      for (auto &s : pending_) {
+        if (s.timestamp_ != currentSecond_) {
+          break;
+        }
+        currentSecondShares_++;
+      }
+    }
+    double due = (currentSecond_ - firstShareTime_) +
+        (double)currentSecondSubmitted_ / currentSecondShares_;
+    if (due > logSeconds) {
+      break;
+    }
+    maxLagSeconds_ = std::max(maxLagSeconds_, (logSeconds - due) / speed_);
+
+    auto itr = workers_.find(share.key_);
+    if (itr != workers_.end() &&
+        itr->second.client_->state_ == StratumClient::AUTHENTICATED) {
+      itr->second.client_->submitShare();
+      submitted_++;
+    } else {
+      dropped_++;
+    }
+    currentSecondSubmitted_++;
+    pending_.pop_front();
+  }
+
+  if (logNow >= lastIdleCheck_ + 60) {
+    closeIdleWorkers(logNow);
+    lastIdleCheck_ = logNow;
+  }
+
+  if (eof_ && pending_.empty()) {
+    LOG(INFO) << "end of " << file_;
+    event_del(tickTimer_);
+    // wait for the responses of the last shares
+    struct timeval wait {
+      1, 0
+    };
+    event_base_loopexit(base_, &wait);
+  }
+}
+
+void ShareLogReplayer::closeIdleWorkers(uint32_t now) {
+  for (auto itr = workers_.begin(); itr != workers_.end();) {
+    if (itr->second.lastShareTime_ + idleTimeout_ < now) {
+      itr = workers_.erase(itr);
+    } else {
+      ++itr;
+    }
+  }
+}
+
+void ShareLogReplayer::report(bool final) {
+  auto now = steady_clock::now();
+  double seconds = std::chrono::duration<double>(
+                       now - (final ? startTime_ : lastReportTime_))
+                       .count();
+  uint64_t shares = submitted_ - (final ? 0 : lastSubmitted_);
+  double selfCpu = selfCpuSeconds();
+  double serverCpu = serverPid_ > 0 ? processCpuSeconds(serverPid_) : 0;
+
+  LOG(INFO) << Strings::Format(
+      "%s %.1fs: %u shares, %.1f/s, %u dropped, %u invalid, %u connections, "
+      "%u open, max lag %.3fs",
+      final ? "total" : "last",
+      seconds,
+      shares,
+      shares / seconds,
+      dropped_,
+      invalid_,
+      connections_,
+      workers_.size(),
+      maxLagSeconds_);
+  if (shares > 0) {
+    string cpu = Strings::Format(
+        "  cpu per share: slreplay %.2fus",
+        (selfCpu - (final ? startSelfCpu_ : lastSelfCpu_)) / shares * 1000000);
+    if (serverPid_ > 0) {
+      Strings::Append(
+          cpu,
+          ", sserver %.2fus",
+          (serverCpu - (final ? startServerCpu_ : lastServerCpu_)) / shares *
+              1000000);
+    }
+    LOG(INFO) << cpu;
+  }
+
+  for (size_t i = 0; i < StratumClientLatencies::NUM_REQUESTS; i++) {
+    auto snapshot = latencies_.histograms_[i].snapshot();
+    auto interval = final ? snapshot : snapshot.since(lastLatencies_[i]);
+    lastLatencies_[i] = snapshot;
+    if (interval.count == 0) {
+      continue;
+    }
+    LOG(INFO) << Strings::Format(
+        "  %-9s %9u, mean %8.3fms, p50 %8.3fms, p90 %8.3fms, p99 %8.3fms, "
+        "p99.9 %8.3fms",
+        StratumClientLatencies::Name((StratumClientLatencies::Request)i),
+        interval.count,
+        interval.sum / interval.count * 1000,
+        interval.quantile(0.5) * 1000,
+        interval.quantile(0.9) * 1000,
+        interval.quantile(0.99) * 1000,
+        interval.quantile(0.999) * 1000);
+  }
+
+  lastReportTime_ = now;
+  lastSubmitted_ = submitted_;
+  lastSelfCpu_ = selfCpu;
+  lastServerCpu_ = serverCpu;
+}
+
+void ShareLogReplayer::stop() {
+  LOG(INFO) << "stop replaying...";
+  event_base_loopexit(base_, nullptr);
+}
+
+void ShareLogReplayer::tickCallback(
+    evutil_socket_t fd, short event, void *ptr) {
+  static_cast<ShareLogReplayer *>(ptr)->tick();
+}
+
+void ShareLogReplayer::reportCallback(
+    evutil_socket_t fd, short event, void *ptr) {
+  static_cast<ShareLogReplayer *>(ptr)->report(false);
+}
+
+void ShareLogReplayer::signalCallback(
+    evutil_socket_t fd, short event, void *ptr) {
+  static_cast<ShareLogReplayer *>(ptr)->stop();
+}
+
+bool ShareLogReplayer::run() {
+  if (!in_) {
+    LOG(ERROR) << "open file fail: " << file_;
+    return false;
+  }
+  Share first{WorkerKey(0, 0), 0, 0};
+  if (!readShare(first)) {
+    LOG(ERROR) << "no share in " << file_;
+    return false;
+  }
+  firstShareTime_ = lastIdleCheck_ = first.timestamp_;
+  currentSecond_ = first.timestamp_ - 1;
+  LOG(INFO) << "replaying " << file_ << " from "
+            << date("%F %T", firstShareTime_) << " at " << speed_ << "x";
+
+  sigterm_ = event_new(
+      base_,
+      SIGTERM,
+      EV_SIGNAL | EV_PERSIST,
+      ShareLogReplayer::signalCallback,
+      this);
+  event_add(sigterm_, nullptr);
+  sigint_ = event_new(
+      base_,
+      SIGINT,
+      EV_SIGNAL | EV_PERSIST,
+      ShareLogReplayer::signalCallback,
+      this);
+  event_add(sigint_, nullptr);
+
+  // the workers of the first seconds connect before the clock starts
+  addPending(first);
+  readAhead(firstShareTime_ + lookAhead_);
+  struct timeval wait {
+    (time_t)lookAhead_, 0
+  };
+  event_base_loopexit(base_, &wait);
+  event_base_dispatch(base_);
+
+  startTime_ = lastReportTime_ = steady_clock::now();
+  startSelfCpu_ = lastSelfCpu_ = selfCpuSeconds();
+  if (serverPid_ > 0) {
+    startServerCpu_ = lastServerCpu_ = processCpuSeconds(serverPid_);
+  }
+  for (size_t i = 0; i < StratumClientLatencies::NUM_REQUESTS; i++) {
+    lastLatencies_.push_back(latencies_.histograms_[i].snapshot());
+  }
+
+  tickTimer_ =
+      event_new(base_, -1, EV_PERSIST, ShareLogReplayer::tickCallback, this);
+  struct timeval tick {
+    0, 1000
+  };
+  event_add(tickTimer_, &tick);
+
+  if (reportInterval_ > 0) {
+    reportTimer_ = event_new(
+        base_, -1, EV_PERSIST, ShareLogReplayer::reportCallback, this);
+    struct timeval interval {
+      (time_t)reportInterval_, 0
+    };
+    event_add(reportTimer_, &interval);
+  }
+
+  event_base_dispatch(base_);
+  report(true);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  char *optLogDir = NULL;
+  char *optConf = NULL;
+  char *optFile = NULL;
+  double speed = 1;
+  pid_t serverPid = 0;
+  int c;
+
+  if (argc <= 1) {
+    usage();
+    return 1;
+  }
+  while ((c = getopt(argc, argv, "c:f:x:p:l:h")) != -1) {
+    switch (c) {
+    case 'c':
+      optConf = optarg;
+      break;
+    case 'f':
+      optFile = optarg;
+      break;
+    case 'x':
+      speed = strtod(optarg, nullptr);
+      break;
+    case 'p':
+      serverPid = atoi(optarg);
+      break;
+    case 'l':
+      optLogDir = optarg;
+      break;
+    case 'h':
+    default:
+      usage();
+      exit(0);
+    }
+  }
+  if (optConf == NULL || optFile == NULL || speed <= 0) {
+    usage();
+    return 1;
+  }
+
+  // Initialize Google's logging library.
+  google::InitGoogleLogging(argv[0]);
+  if (optLogDir == NULL || strcmp(optLogDir, "stderr") == 0) {
+    FLAGS_logtostderr = 1;
+  } else {
+    FLAGS_log_dir = string(optLogDir);
+  }
+  FLAGS_logbuflevel = -1; // don't buffer logs
+
+  LOG(INFO) << BIN_VERSION_STRING("slreplay");
+
+  // Read the file. If there is an error, report it and exit.
+  libconfig::Config cfg;
+  try {
+    cfg.readFile(optConf);
+  } catch (const FileIOException &fioex) {
+    std::cerr << "I/O error while reading file." << std::endl;
+    return (EXIT_FAILURE);
+  } catch (const ParseException &pex) {
+    std::cerr << "Parse error at " << pex.getFile() << ":" << pex.getLine()
+              << " - " << pex.getError() << std::endl;
+    return (EXIT_FAILURE);
+  }
+
+  // ignore SIGPIPE, avoiding process be killed
+  signal(SIGPIPE, SIG_IGN);
+
+  bool ok = false;
+  try {
+    evthread_use_pthreads();
+    ShareLogReplayer replayer(cfg, optFile, speed, serverPid);
+    ok = replayer.run();
+  } catch (const SettingException &e) {
+    LOG(FATAL) << "config missing: " << e.getPath();
+    return 1;
+  } catch (const std::exception &e) {
+    LOG(FATAL) << "exception: " << e.what();
+    return 1;
+  }
+
+  google::ShutdownGoogleLogging();
+  return ok ? 0 : 1;
+}
@@ -33,6 +33,9 @@
 #include <openssl/rand.h>
 #include <glog/logging.h>
 
+#include <fstream>
+#include <vector>
+
 #include "SSLUtils.h"
 
 /*
@@ -178,3 +181,63 @@ get_server_SSL_CTX(const std::string &certFile, const std::string &keyFile) {
 
   return sslCTX;
 }
+
+bool enable_SSL_CTX_ktls(SSL_CTX *sslCTX) {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+  SSL_CTX_set_options(sslCTX, SSL_OP_ENABLE_KTLS);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool is_SSL_ktls_active(SSL *ssl) {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+  return BIO_get_ktls_send(SSL_get_wbio(ssl)) &&
+      BIO_get_ktls_recv(SSL_get_rbio(ssl)) && !SSL_has_pending(ssl);
+#else
+  return false;
+#endif
+}
+
+bool setup_server_SSL_CTX_resumption(
+    SSL_CTX *sslCTX, const std::string &ticketKeyFile, long timeout) {
+  static const unsigned char sessionIdContext[] = "btcpool-sserver";
+
+  SSL_CTX_set_session_cache_mode(sslCTX, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_set_timeout(sslCTX, timeout);
+  if (!SSL_CTX_set_session_id_context(
+          sslCTX, sessionIdContext, sizeof(sessionIdContext) - 1)) {
+    LOG(ERROR) << "SSL_CTX_set_session_id_context failed: "
+               << get_ssl_err_string();
+    return false;
+  }
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  // a reconnecting client uses one ticket, don't make every handshake
+  // encrypt two of them
+  SSL_CTX_set_num_tickets(sslCTX, 1);
+#endif
+
+  if (ticketKeyFile.empty()) {
+    // OpenSSL uses random keys, valid until the process exits
+    return true;
+  }
+
+  // 48 bytes before OpenSSL 1.1, 80 bytes after
+  long keyLen = SSL_CTX_get_tlsext_ticket_keys(sslCTX, nullptr, 0);
+  std::vector<char> keys(keyLen + 1);
+  std::ifstream file(ticketKeyFile, std::ios::binary);
+  file.read(keys.data(), keys.size());
+  if (file.gcount() != keyLen) {
+    LOG(ERROR) << "TLS ticket key file '" << ticketKeyFile << "' should have "
+               << keyLen << " bytes, generate it with: openssl rand " << keyLen
+               << " > " << ticketKeyFile;
+    return false;
+  }
+  if (!SSL_CTX_set_tlsext_ticket_keys(sslCTX, keys.data(), keyLen)) {
+    LOG(ERROR) << "SSL_CTX_set_tlsext_ticket_keys failed: "
+               << get_ssl_err_string();
+    return false;
+  }
+  return true;
+}
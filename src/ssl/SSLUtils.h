@@ -34,3 +34,18 @@ SSL_CTX *get_client_SSL_CTX_With_Cache();
 
 SSL_CTX *
 get_server_SSL_CTX(const std::string &certFile, const std::string &keyFile);
+
+// Let OpenSSL hand the keys of established connections to the kernel (kTLS).
+// Returns false if this OpenSSL is built without kTLS.
+bool enable_SSL_CTX_ktls(SSL_CTX *sslCTX);
+// Returns true if OpenSSL has handed both directions of an established
+// connection to the kernel and has nothing buffered, the socket can be
+// used without OpenSSL then. Otherwise the connection stays on OpenSSL.
+bool is_SSL_ktls_active(SSL *ssl);
+
+// Session resumption for the server: a session cache and session tickets.
+// The ticket keys are read from ticketKeyFile if it is not empty, so that
+// sservers sharing the file resume the sessions of each other.
+// Generate the file with: openssl rand 80 > ticket.key
+bool setup_server_SSL_CTX_resumption(
+    SSL_CTX *sslCTX, const std::string &ticketKeyFile, long timeout);
@@ -33,6 +33,7 @@
 class GwMakerHandlerVcash : public GwMakerHandlerJson {
   bool checkFields(JsonNode &r) override;
   string constructRawMsg(JsonNode &r) override;
+  string getWorkIdField() override { return "blockHashForMergedMining"; }
   string getRequestData() override { return ""; }
 };
 
@@ -0,0 +1,158 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#ifndef LOCAL_HTTP_SERVER_H_
+#define LOCAL_HTTP_SERVER_H_
+
+#include "Common.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+// A one-thread HTTP server on 127.0.0.1 that answers every request with
+// `status` and `body`, or never answers if `status` is 0.
+// The response can be changed with setResponse() while it runs.
+class LocalHttpServer {
+public:
+  LocalHttpServer(int status, const string &body)
+    : status_(status)
+    , body_(body)
+    , running_(true) {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd_, (sockaddr *)&addr, len) != 0 || listen(fd_, 16) != 0 ||
+        getsockname(fd_, (sockaddr *)&addr, &len) != 0) {
+      throw std::runtime_error("LocalHttpServer: cannot listen");
+    }
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread(&LocalHttpServer::run, this);
+  }
+
+  ~LocalHttpServer() {
+    running_ = false;
+    thread_.join();
+    close(fd_);
+  }
+
+  string url() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/";
+  }
+
+  void setResponse(int status, const string &body) {
+    ScopeLock sl(lock_);
+    status_ = status;
+    body_ = body;
+  }
+
+  size_t connections() const { return connections_; }
+  vector<string> requests() {
+    ScopeLock sl(lock_);
+    return requests_;
+  }
+
+private:
+  void run() {
+    vector<int> clients;
+    std::map<int, string> buffers;
+    while (running_) {
+      vector<pollfd> fds{{fd_, POLLIN, 0}};
+      for (int c : clients) {
+        fds.push_back({c, POLLIN, 0});
+      }
+      if (poll(fds.data(), fds.size(), 50) <= 0) {
+        continue;
+      }
+      if (fds[0].revents & POLLIN) {
+        clients.push_back(accept(fd_, nullptr, nullptr));
+        connections_++;
+      }
+      for (size_t i = 1; i < fds.size(); i++) {
+        if (fds[i].revents == 0) {
+          continue;
+        }
+        const int c = fds[i].fd;
+        char buf[4096];
+        ssize_t n = recv(c, buf, sizeof(buf), 0);
+        if (n <= 0) {
+          close(c);
+          clients.erase(std::find(clients.begin(), clients.end(), c));
+          buffers.erase(c);
+          continue;
+        }
+        string &request = buffers[c];
+        request.append(buf, n);
+        if (!complete(request)) {
+          continue;
+        }
+        string resp;
+        {
+          ScopeLock sl(lock_);
+          requests_.push_back(request);
+          if (status_ != 0) {
+            resp = "HTTP/1.1 " + std::to_string(status_) +
+                " X\r\nContent-Length: " + std::to_string(body_.size()) +
+                "\r\n\r\n" + body_;
+          }
+        }
+        request.clear();
+        if (!resp.empty()) {
+          send(c, resp.data(), resp.size(), MSG_NOSIGNAL);
+        }
+      }
+    }
+    for (int c : clients) {
+      close(c);
+    }
+  }
+
+  // headers and Content-Length bytes of body are received
+  static bool complete(const string &request) {
+    size_t end = request.find("\r\n\r\n");
+    if (end == string::npos) {
+      return false;
+    }
+    size_t length = 0;
+    size_t pos = request.find("Content-Length: ");
+    if (pos != string::npos && pos < end) {
+      length = strtoul(request.c_str() + pos + 16, nullptr, 10);
+    }
+    return request.size() >= end + 4 + length;
+  }
+
+  int status_;
+  string body_;
+  int fd_;
+  uint16_t port_;
+  atomic<bool> running_;
+  atomic<size_t> connections_{0};
+  mutex lock_;
+  vector<string> requests_;
+  thread thread_;
+};
+
+#endif // LOCAL_HTTP_SERVER_H_
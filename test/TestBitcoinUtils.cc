@@ -80,6 +80,34 @@ TEST(BitcoinUtils, GetBlockRewardZCash) {
   TestBitcoinBlockReward(13300000, 38146);
   TestBitcoinBlockReward(70000000, 0);
 }
+
+TEST(BitcoinUtils, CheckEquihashSolution) {
+  SelectParams(CBaseChainParams::MAIN);
+  CBlockHeader header = Params().GenesisBlock().GetBlockHeader();
+
+  // twice, the second check uses the cached hash state
+  ASSERT_TRUE(CheckEquihashSolution(&header, Params()));
+  ASSERT_TRUE(CheckEquihashSolution(&header, Params()));
+
+  // decoded from the hex of a share
+  string hex = "fd4005" + HexStr(header.nSolution);
+  std::vector<unsigned char> solution;
+  DecodeEquihashSolution(hex, solution);
+  ASSERT_EQ(solution, header.nSolution);
+
+  CBlockHeader bad = header;
+  bad.nSolution[100] ^= 1;
+  ASSERT_FALSE(CheckEquihashSolution(&bad, Params()));
+  bad = header;
+  *bad.nNonce.begin() ^= 1;
+  ASSERT_FALSE(CheckEquihashSolution(&bad, Params()));
+  bad = header;
+  bad.nSolution.pop_back();
+  ASSERT_FALSE(CheckEquihashSolution(&bad, Params()));
+
+  // the cached state of the header is still right
+  ASSERT_TRUE(CheckEquihashSolution(&header, Params()));
+}
 #else
 TEST(BitcoinUtils, GetBlockRewardBitcoin) {
   TestBitcoinBlockReward(1, 5000000000); // 50 BTC
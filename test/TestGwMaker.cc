@@ -0,0 +1,137 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#include "gtest/gtest.h"
+#include "Common.h"
+#include "GwMaker.h"
+#include "HttpClient.h"
+#include "LocalHttpServer.h"
+
+class GwMakerHandlerTest : public GwMakerHandler {
+  string processRawGw(const string &gw) override { return gw; }
+};
+
+// Keeps the RawGw messages instead of sending them to kafka.
+class GwMakerTest : public GwMaker {
+public:
+  using GwMaker::GwMaker;
+
+  vector<string> messages() {
+    ScopeLock sl(lock_);
+    return messages_;
+  }
+
+protected:
+  bool initKafkaProducer() override { return true; }
+  void kafkaProduceMsg(const void *payload, size_t len) override {
+    ScopeLock sl(lock_);
+    messages_.emplace_back((const char *)payload, len);
+  }
+
+  mutex lock_;
+  vector<string> messages_;
+};
+
+static uint16_t unusedPort() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  bind(fd, (sockaddr *)&addr, len);
+  getsockname(fd, (sockaddr *)&addr, &len);
+  close(fd);
+  return ntohs(addr.sin_port);
+}
+
+// calls predicate() until it is true, for at most 5s
+template <typename Predicate>
+static bool waitFor(Predicate predicate) {
+  for (int i = 0; i < 500; i++) {
+    if (predicate()) {
+      return true;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  return false;
+}
+
+TEST(GwMaker, PublishOncePerNotifiedChange) {
+  LocalHttpServer node(200, "{\"hHash\":\"0x01\"}");
+
+  GwMakerDefinition def;
+  def.chainType_ = "TEST";
+  def.enabled_ = true;
+  def.rpcAddr_ = node.url();
+  // long enough that only notifications fetch the work
+  def.rpcInterval_ = 60000;
+  def.rpcIntervalMax_ = 60000;
+  def.workRefreshInterval_ = 60000;
+  def.notifyHost_ = "127.0.0.1";
+  def.notifyPort_ = unusedPort();
+  def.rawGwTopic_ = "RawGw";
+
+  auto handler = std::make_shared<GwMakerHandlerTest>();
+  handler->init(def);
+  GwMakerTest gwMaker(handler, "");
+  ASSERT_TRUE(gwMaker.init());
+  thread runner(&GwMaker::run, &gwMaker);
+  std::shared_ptr<void> stopRunner(nullptr, [&](void *) {
+    gwMaker.stop();
+    runner.join();
+  });
+
+  const string notifyUrl =
+      "http://127.0.0.1:" + std::to_string(def.notifyPort_) + "/notify";
+  auto notify = [&notifyUrl]() {
+    // the httpd is started in the background
+    HttpRequest req;
+    req.url_ = notifyUrl;
+    req.body_ = std::make_shared<const string>("{}");
+    string response;
+    return waitFor([&]() {
+      return AsyncHttpClient::shared().requestSync(req, response);
+    });
+  };
+
+  // new work is published
+  ASSERT_TRUE(notify());
+  ASSERT_TRUE(waitFor([&]() { return gwMaker.messages().size() == 1; }));
+  ASSERT_EQ(gwMaker.messages()[0], "{\"hHash\":\"0x01\"}");
+  ASSERT_EQ(node.requests().size(), 1u);
+
+  // the work is fetched again but unchanged, nothing is published
+  ASSERT_TRUE(notify());
+  ASSERT_TRUE(waitFor([&]() { return node.requests().size() == 2; }));
+  std::this_thread::sleep_for(100ms);
+  ASSERT_EQ(gwMaker.messages().size(), 1u);
+
+  // changed work is published once
+  node.setResponse(200, "{\"hHash\":\"0x02\"}");
+  ASSERT_TRUE(notify());
+  ASSERT_TRUE(waitFor([&]() { return gwMaker.messages().size() == 2; }));
+  ASSERT_EQ(gwMaker.messages()[1], "{\"hHash\":\"0x02\"}");
+  std::this_thread::sleep_for(100ms);
+  ASSERT_EQ(gwMaker.messages().size(), 2u);
+  ASSERT_EQ(node.requests().size(), 3u);
+}
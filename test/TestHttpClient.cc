@@ -0,0 +1,118 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#include "gtest/gtest.h"
+#include "Common.h"
+#include "HttpClient.h"
+#include "LocalHttpServer.h"
+
+#include <future>
+
+TEST(AsyncHttpClient, Success) {
+  LocalHttpServer server(200, "{\"result\":1}");
+  AsyncHttpClient client;
+
+  string response;
+  ASSERT_TRUE(client.requestSync(HttpRequest{server.url()}, response));
+  ASSERT_EQ(response, "{\"result\":1}");
+
+  // the callback runs on the client's thread
+  std::promise<std::pair<bool, string>> done;
+  client.rpcCall(
+      server.url(),
+      "user:pass",
+      std::make_shared<const string>("{\"method\":\"getinfo\"}"),
+      [&done](bool ok, const string &resp) {
+        done.set_value(std::make_pair(ok, resp));
+      });
+  auto result = done.get_future().get();
+  ASSERT_TRUE(result.first);
+  ASSERT_EQ(result.second, "{\"result\":1}");
+}
+
+TEST(AsyncHttpClient, KeepAliveWithoutExpect) {
+  LocalHttpServer server(200, "ok");
+  AsyncHttpClient client;
+
+  // large enough for curl to send 'Expect: 100-continue' if not suppressed
+  auto body = std::make_shared<const string>(2 * 1024 * 1024, 'x');
+  string response;
+  for (int i = 0; i < 3; i++) {
+    HttpRequest req;
+    req.url_ = server.url();
+    req.body_ = body;
+    ASSERT_TRUE(client.requestSync(req, response));
+  }
+
+  // the connection is reused and no request waits for a 100 Continue
+  ASSERT_EQ(server.connections(), 1u);
+  for (const string &request : server.requests()) {
+    ASSERT_NE(request.find(" HTTP/1.1\r\n"), string::npos);
+    ASSERT_EQ(request.find("Expect:"), string::npos);
+  }
+  ASSERT_EQ(server.requests().size(), 3u);
+}
+
+TEST(AsyncHttpClient, Error) {
+  AsyncHttpClient client;
+  string response;
+
+  // not 2xx
+  {
+    LocalHttpServer server(500, "internal error");
+    ASSERT_FALSE(client.requestSync(HttpRequest{server.url()}, response));
+    ASSERT_EQ(response, "internal error");
+  }
+
+  // connection refused, the port is closed with the server above
+  {
+    string url;
+    {
+      LocalHttpServer server(200, "");
+      url = server.url();
+    }
+    std::promise<bool> done;
+    client.request(HttpRequest{url}, [&done](bool ok, const string &) {
+      done.set_value(ok);
+    });
+    ASSERT_FALSE(done.get_future().get());
+  }
+}
+
+TEST(AsyncHttpClient, Timeout) {
+  LocalHttpServer server(0 /* never answers */, "");
+  AsyncHttpClient client;
+
+  HttpRequest req;
+  req.url_ = server.url();
+  req.timeoutMs_ = 200;
+
+  const auto start = std::chrono::steady_clock::now();
+  string response;
+  ASSERT_FALSE(client.requestSync(req, response));
+  const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  ASSERT_GE(elapsedMs, 200);
+  ASSERT_LT(elapsedMs, 2000);
+}
@@ -0,0 +1,372 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include "Common.h"
+
+#ifdef CHAIN_TYPE_BTC
+
+#include "bitcoin/GbtMaker.h"
+#include "bitcoin/MempoolMirror.h"
+
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <version.h>
+
+#include <chrono>
+#include <thread>
+
+// The messages a node would send for a transaction spending `prevouts`.
+static string MakeRawTx(
+    const vector<std::pair<uint256, uint32_t>> &prevouts,
+    uint32_t outputs,
+    uint32_t tag) {
+  CMutableTransaction tx;
+  for (const auto &prevout : prevouts) {
+    tx.vin.emplace_back(COutPoint(prevout.first, prevout.second));
+  }
+  for (uint32_t i = 0; i < outputs; i++) {
+    // P2WPKH
+    tx.vout.emplace_back(
+        1000, CScript() << OP_0 << vector<unsigned char>(20, tag));
+  }
+  tx.nLockTime = tag;
+
+  CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+  stream << tx;
+  return string(stream.begin(), stream.end());
+}
+
+// `mempoolSequence` is sent with the `A` and `R` labels only.
+static string
+MakeSequence(const uint256 &txid, char label, uint64_t mempoolSequence = 0) {
+  string content(txid.begin(), txid.end());
+  std::reverse(content.begin(), content.end());
+  content.push_back(label);
+  if (label == 'A' || label == 'R') {
+    for (int i = 0; i < 8; i++) {
+      content.push_back((char)(mempoolSequence >> (8 * i)));
+    }
+  }
+  return content;
+}
+
+static uint256 AddRawTx(MempoolMirror &mempool, const string &raw) {
+  EXPECT_TRUE(mempool.handleZmqMessage("rawtx", raw.data(), raw.size()));
+  MempoolTx tx;
+  EXPECT_TRUE(tx.decode(raw.data(), raw.size()));
+  return tx.txid_;
+}
+
+TEST(MempoolMirror, DecodeAndRemove) {
+  MempoolMirror mempool;
+  const uint256 funding = uint256S("01");
+  const string raw = MakeRawTx({{funding, 0}}, 2, 1);
+
+  const uint256 txid = AddRawTx(mempool, raw);
+  ASSERT_EQ(mempool.size(), 1u);
+  const MempoolTx *tx = mempool.get(txid);
+  ASSERT_NE(tx, nullptr);
+  ASSERT_FALSE(tx->hasFee());
+  ASSERT_EQ(tx->outputs_, 2u);
+  ASSERT_EQ(tx->weight_, (int64_t)raw.size() * 4);
+  string hex;
+  Bin2Hex((const uint8_t *)raw.data(), raw.size(), hex);
+  ASSERT_EQ(tx->data_, hex);
+
+  // the fee is needed to select it
+  ASSERT_EQ(mempool.txidsWithoutFee(10), vector<uint256>{txid});
+  ASSERT_TRUE(mempool.assemble(4000000, 80000).txs_.empty());
+  ASSERT_TRUE(mempool.setFee(txid, 500, {}));
+  ASSERT_TRUE(mempool.txidsWithoutFee(10).empty());
+
+  const string seq = MakeSequence(txid, 'R');
+  ASSERT_TRUE(mempool.handleZmqMessage("sequence", seq.data(), seq.size()));
+  ASSERT_EQ(mempool.size(), 0u);
+
+  ASSERT_FALSE(mempool.handleZmqMessage("rawtx", "bad", 3));
+  ASSERT_FALSE(mempool.handleZmqMessage("hashtx", seq.data(), seq.size()));
+}
+
+TEST(MempoolMirror, ChildPaysForParent) {
+  MempoolMirror mempool;
+  const uint256 a = AddRawTx(mempool, MakeRawTx({{uint256S("01"), 0}}, 1, 1));
+  const uint256 b = AddRawTx(mempool, MakeRawTx({{uint256S("02"), 0}}, 1, 2));
+  const uint256 child = AddRawTx(mempool, MakeRawTx({{a, 0}}, 1, 3));
+
+  // a pays little, its child pays for both
+  ASSERT_TRUE(mempool.setFee(a, 100, {}));
+  ASSERT_TRUE(mempool.setFee(b, 1000, {}));
+  ASSERT_TRUE(mempool.setFee(child, 10000, {uint256(a)}));
+
+  auto t = mempool.assemble(4000000, 80000);
+  ASSERT_EQ(t.txs_.size(), 3u);
+  ASSERT_EQ(t.txs_[0]->txid_, a);
+  ASSERT_EQ(t.txs_[1]->txid_, child);
+  ASSERT_EQ(t.txs_[2]->txid_, b);
+  ASSERT_EQ(t.fees_, 11100);
+  ASSERT_EQ(t.weight_, t.txs_[0]->weight_ * 3);
+
+  // room for one package only
+  t = mempool.assemble(t.txs_[0]->weight_ * 2, 80000);
+  ASSERT_EQ(t.txs_.size(), 2u);
+  ASSERT_EQ(t.fees_, 10100);
+
+  // the child is left out without its parent
+  mempool.remove(a);
+  ASSERT_EQ(mempool.txidsWithoutFee(10), vector<uint256>{child});
+  t = mempool.assemble(4000000, 80000);
+  ASSERT_EQ(t.txs_.size(), 1u);
+  ASSERT_EQ(t.txs_[0]->txid_, b);
+}
+
+TEST(MempoolMirror, LateParent) {
+  MempoolMirror mempool;
+  const string rawParent = MakeRawTx({{uint256S("01"), 0}}, 1, 1);
+  MempoolTx parent;
+  ASSERT_TRUE(parent.decode(rawParent.data(), rawParent.size()));
+  const uint256 a = parent.txid_;
+  const uint256 child = AddRawTx(mempool, MakeRawTx({{a, 0}}, 1, 2));
+  const uint256 grandchild = AddRawTx(mempool, MakeRawTx({{child, 0}}, 1, 3));
+  ASSERT_TRUE(mempool.setFee(child, 1000, {uint256(a)}));
+  ASSERT_TRUE(mempool.setFee(grandchild, 1000, {uint256(child)}));
+
+  // the parent is not mirrored yet
+  ASSERT_TRUE(mempool.assemble(4000000, 80000).txs_.empty());
+
+  parent.fee_ = 10;
+  mempool.add(std::move(parent));
+  auto t = mempool.assemble(4000000, 80000);
+  ASSERT_EQ(t.txs_.size(), 3u);
+  ASSERT_EQ(t.txs_[0]->txid_, a);
+  ASSERT_EQ(t.txs_[1]->txid_, child);
+  ASSERT_EQ(t.txs_[2]->txid_, grandchild);
+  ASSERT_EQ(t.fees_, 2010);
+
+  // the packages of the descendants follow the fee of the parent
+  ASSERT_TRUE(mempool.setFee(a, 100000, {}));
+  ASSERT_EQ(mempool.assemble(4000000, 80000).fees_, 102000);
+
+  // and its removal
+  mempool.remove(a);
+  ASSERT_TRUE(mempool.assemble(4000000, 80000).txs_.empty());
+}
+
+TEST(MempoolMirror, Replacement) {
+  MempoolMirror mempool;
+  const uint256 a = AddRawTx(mempool, MakeRawTx({{uint256S("01"), 0}}, 1, 1));
+  const uint256 child = AddRawTx(mempool, MakeRawTx({{a, 0}}, 1, 2));
+  ASSERT_EQ(mempool.size(), 2u);
+
+  // spends the same output, the removal of `a` was not received
+  const uint256 b = AddRawTx(mempool, MakeRawTx({{uint256S("01"), 0}}, 1, 3));
+  ASSERT_EQ(mempool.size(), 1u);
+  ASSERT_NE(mempool.get(b), nullptr);
+  ASSERT_EQ(mempool.get(a), nullptr);
+  ASSERT_EQ(mempool.get(child), nullptr);
+}
+
+TEST(MempoolMirror, Reconcile) {
+  MempoolMirror mempool;
+  ASSERT_TRUE(mempool.needsReconcile());
+
+  const uint256 a = AddRawTx(mempool, MakeRawTx({{uint256S("01"), 0}}, 1, 1));
+  const uint256 b = AddRawTx(mempool, MakeRawTx({{uint256S("02"), 0}}, 1, 2));
+  const uint256 c = uint256S("03");
+
+  // a block confirmed `a` and the mirror missed `c`
+  const string seq = MakeSequence(uint256S("ff"), 'C');
+  uint64_t requests = mempool.reconcileRequests();
+  uint64_t version = mempool.version();
+  ASSERT_EQ(mempool.tipUpdates(), 0u);
+  ASSERT_TRUE(mempool.handleZmqMessage("sequence", seq.data(), seq.size()));
+  ASSERT_EQ(mempool.tipUpdates(), 1u);
+  ASSERT_EQ(mempool.get(a)->txid_, a);
+
+  // the block came after getrawmempool
+  ASSERT_EQ(
+      mempool.reconcile({b, c}, 10, requests, version), vector<uint256>{c});
+  ASSERT_TRUE(mempool.needsReconcile());
+  ASSERT_EQ(mempool.get(a), nullptr);
+
+  version = mempool.version();
+  requests = mempool.reconcileRequests();
+  ASSERT_EQ(
+      mempool.reconcile({b, c}, 10, requests, version), vector<uint256>{c});
+  ASSERT_FALSE(mempool.needsReconcile());
+  ASSERT_EQ(mempool.size(), 1u);
+  ASSERT_EQ(mempool.version(), version);
+}
+
+TEST(MempoolMirror, ReconcileKeepsNewer) {
+  MempoolMirror mempool;
+  auto addWithSequence = [&](const string &raw, uint64_t sequence) {
+    const uint256 txid = AddRawTx(mempool, raw);
+    const string seq = MakeSequence(txid, 'A', sequence);
+    EXPECT_TRUE(mempool.handleZmqMessage("sequence", seq.data(), seq.size()));
+    return txid;
+  };
+  const uint256 a = addWithSequence(MakeRawTx({{uint256S("01"), 0}}, 1, 1), 1);
+  const uint256 b = addWithSequence(MakeRawTx({{uint256S("02"), 0}}, 1, 2), 2);
+  ASSERT_TRUE(mempool.setFee(a, 500, {}));
+
+  // getrawmempool is called at mempool sequence 3, `b` was removed before
+  // and its `R` message was lost
+  const uint64_t requests = mempool.reconcileRequests();
+  const uint64_t version = mempool.version();
+
+  // the rawtx of bitcoind while the rpc was in flight
+  const uint256 c = addWithSequence(MakeRawTx({{a, 0}}, 1, 3), 4);
+  ASSERT_TRUE(mempool.setFee(c, 5000, {a}));
+  // and one whose `A` message was not handled yet
+  const uint256 d = AddRawTx(mempool, MakeRawTx({{uint256S("04"), 0}}, 1, 4));
+  // `A` tells this one was added before the snapshot, which lacks it
+  const uint256 e = addWithSequence(MakeRawTx({{uint256S("05"), 0}}, 1, 5), 3);
+
+  ASSERT_TRUE(mempool.reconcile({a}, 3, requests, version).empty());
+  ASSERT_FALSE(mempool.needsReconcile());
+  ASSERT_NE(mempool.get(a), nullptr);
+  ASSERT_EQ(mempool.get(b), nullptr);
+  ASSERT_EQ(mempool.get(e), nullptr);
+  ASSERT_NE(mempool.get(d), nullptr);
+  // the child keeps its fee and is selected with its parent
+  ASSERT_NE(mempool.get(c), nullptr);
+  ASSERT_TRUE(mempool.get(c)->hasFee());
+  const MempoolMirror::Template t = mempool.assemble(4000000, 80000);
+  ASSERT_EQ(t.txs_.size(), 2u);
+  ASSERT_EQ(t.fees_, 5500);
+
+  // gone at the next snapshot
+  const uint64_t nextVersion = mempool.version();
+  ASSERT_TRUE(
+      mempool.reconcile({a, c}, 5, mempool.reconcileRequests(), nextVersion)
+          .empty());
+  ASSERT_EQ(mempool.get(d), nullptr);
+  ASSERT_EQ(mempool.size(), 2u);
+}
+
+// Replays the zmq messages of a node. The frames are sent as bitcoind sends
+// them: the topic, the content and a 4-byte little endian sequence number.
+class ZmqReplayPublisher {
+public:
+  ZmqReplayPublisher(zmq::context_t &context, const string &address)
+    : socket_(context, ZMQ_XPUB) {
+    socket_.bind(address);
+  }
+
+  // XPUB tells the subscriptions, nothing sent before them is received
+  bool waitForSubscriptions(size_t count) {
+    int timeoutMs = 5000;
+    socket_.setsockopt(ZMQ_RCVTIMEO, &timeoutMs, sizeof(timeoutMs));
+    for (size_t i = 0; i < count; i++) {
+      zmq::message_t subscription;
+      if (!socket_.recv(&subscription)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void send(const string &type, const string &content) {
+    socket_.send(type.data(), type.size(), ZMQ_SNDMORE);
+    socket_.send(content.data(), content.size(), ZMQ_SNDMORE);
+    socket_.send(&sequence_, sizeof(sequence_));
+    sequence_++;
+  }
+
+private:
+  zmq::socket_t socket_;
+  uint32_t sequence_ = 0;
+};
+
+TEST(MempoolMirror, ZmqReplay) {
+  zmq::context_t context(1);
+  const string address = "inproc://mempool-mirror-replay";
+  ZmqReplayPublisher publisher(context, address);
+
+  // as GbtMaker::threadListenMempool() feeds its mirror
+  MempoolMirror mempool;
+  std::mutex lock;
+  size_t received = 0;
+  std::atomic<bool> running{true};
+  std::thread listener([&]() {
+    ListenToZmqMessages(
+        context,
+        address,
+        {"rawtx", "sequence"},
+        running,
+        1,
+        [&](const string &type, const zmq::message_t &content) {
+          std::lock_guard<std::mutex> l(lock);
+          mempool.handleZmqMessage(
+              type, static_cast<const char *>(content.data()), content.size());
+          received++;
+        });
+  });
+  std::shared_ptr<void> stopListener(nullptr, [&](void *) {
+    running = false;
+    listener.join();
+  });
+  ASSERT_TRUE(publisher.waitForSubscriptions(2));
+
+  const string rawA = MakeRawTx({{uint256S("01"), 0}}, 1, 1);
+  const string rawB = MakeRawTx({{uint256S("02"), 0}}, 1, 2);
+  MempoolTx a, b;
+  ASSERT_TRUE(a.decode(rawA.data(), rawA.size()));
+  ASSERT_TRUE(b.decode(rawB.data(), rawB.size()));
+  const string rawChild = MakeRawTx({{a.txid_, 0}}, 1, 3);
+  MempoolTx child;
+  ASSERT_TRUE(child.decode(rawChild.data(), rawChild.size()));
+
+  // b is evicted, hashtx is not subscribed
+  publisher.send("rawtx", rawA);
+  publisher.send("hashtx", string(a.txid_.begin(), a.txid_.end()));
+  publisher.send("sequence", MakeSequence(a.txid_, 'A', 1));
+  publisher.send("rawtx", rawB);
+  publisher.send("sequence", MakeSequence(b.txid_, 'A', 2));
+  publisher.send("rawtx", rawChild);
+  publisher.send("sequence", MakeSequence(child.txid_, 'A', 3));
+  publisher.send("sequence", MakeSequence(b.txid_, 'R', 4));
+  const size_t sent = 7;
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (std::chrono::steady_clock::now() < deadline) {
+    {
+      std::lock_guard<std::mutex> l(lock);
+      if (received >= sent) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::lock_guard<std::mutex> l(lock);
+  ASSERT_EQ(received, sent);
+  ASSERT_EQ(mempool.size(), 2u);
+  ASSERT_NE(mempool.get(a.txid_), nullptr);
+  ASSERT_NE(mempool.get(child.txid_), nullptr);
+  ASSERT_EQ(mempool.get(b.txid_), nullptr);
+}
+
+#endif // CHAIN_TYPE_BTC
@@ -0,0 +1,91 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+
+#include "prometheus/Histogram.h"
+
+#include <thread>
+
+using prometheus::Histogram;
+
+TEST(Histogram, Observe) {
+  Histogram histogram({1, 2, 4});
+  histogram.observe(0.5);
+  histogram.observe(1);
+  histogram.observe(3);
+  histogram.observe(10);
+
+  auto snapshot = histogram.snapshot();
+  ASSERT_EQ(snapshot.buckets, std::vector<uint64_t>({2, 2, 3, 4}));
+  ASSERT_EQ(snapshot.count, 4u);
+  ASSERT_DOUBLE_EQ(snapshot.sum, 14.5);
+
+  ASSERT_EQ(snapshot.quantile(0.5), 1);
+  ASSERT_EQ(snapshot.quantile(0.75), 4);
+  ASSERT_EQ(snapshot.quantile(1), 4); // in +Inf
+  ASSERT_EQ(snapshot.quantile(0), 1);
+
+  histogram.observe(1.5);
+  auto since = histogram.snapshot().since(snapshot);
+  ASSERT_EQ(since.buckets, std::vector<uint64_t>({0, 1, 1, 1}));
+  ASSERT_EQ(since.count, 1u);
+  ASSERT_DOUBLE_EQ(since.sum, 1.5);
+  ASSERT_EQ(since.quantile(0.99), 2);
+  ASSERT_EQ(Histogram({1}).snapshot().quantile(0.5), 0);
+}
+
+TEST(Histogram, Threads) {
+  Histogram histogram(Histogram::LatencyBounds());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < Histogram::kShards * 2; i++) {
+    threads.emplace_back([&histogram]() {
+      for (int j = 0; j < 10000; j++) {
+        histogram.observe(0.5);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto snapshot = histogram.snapshot();
+  ASSERT_EQ(snapshot.count, Histogram::kShards * 2 * 10000);
+  ASSERT_DOUBLE_EQ(snapshot.sum, Histogram::kShards * 10000);
+  ASSERT_EQ(snapshot.buckets.size(), snapshot.bounds.size() + 1);
+  ASSERT_EQ(snapshot.buckets[0], 0u);
+}
+
+TEST(Histogram, ShardsOnOwnCacheLines) {
+  for (size_t numBounds : {1, 6, 7, 20}) {
+    Histogram histogram(Histogram::ExponentialBounds(1, 2, numBounds));
+    for (size_t i = 0; i < Histogram::kShards; i++) {
+      auto address = reinterpret_cast<uintptr_t>(histogram.shard(i));
+      ASSERT_EQ(address % Histogram::kCacheLine, 0u);
+    }
+    // the last counter of a shard is still before the next shard
+    auto end = histogram.shard(0) + numBounds + 2;
+    ASSERT_LE(end, histogram.shard(1));
+  }
+}
@@ -0,0 +1,273 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include "ssl/SSLUtils.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/x509.h>
+
+#include <glog/logging.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+namespace {
+
+// A connected pair of loopback TCP sockets, kTLS needs real TCP sockets.
+bool tcpPair(int &client, int &server) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listener, 1) != 0 ||
+      getsockname(listener, (sockaddr *)&addr, &len) != 0) {
+    close(listener);
+    return false;
+  }
+  client = socket(AF_INET, SOCK_STREAM, 0);
+  if (connect(client, (sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(client);
+    close(listener);
+    return false;
+  }
+  server = accept(listener, nullptr, nullptr);
+  close(listener);
+  return server >= 0;
+}
+
+// Whether the kernel can attach the `tls` ULP, i.e. the tls module is there.
+bool kernelHasTlsUlp() {
+  int client, server;
+  if (!tcpPair(client, server)) {
+    return false;
+  }
+  bool ok = setsockopt(server, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+  close(client);
+  close(server);
+  return ok;
+}
+
+// A server context with a throwaway self-signed P-256 certificate.
+SSL_CTX *newServerCTX() {
+  EVP_PKEY *pkey = nullptr;
+  EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  EVP_PKEY_keygen_init(pctx);
+  EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1);
+  EVP_PKEY_keygen(pctx, &pkey);
+  EVP_PKEY_CTX_free(pctx);
+
+  X509 *cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, pkey);
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(
+      name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_sign(cert, pkey, EVP_sha256());
+
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+  SSL_CTX_use_certificate(ctx, cert);
+  SSL_CTX_use_PrivateKey(ctx, pkey);
+  X509_free(cert);
+  EVP_PKEY_free(pkey);
+  return ctx;
+}
+
+struct TLSPair {
+  int clientFd_ = -1;
+  int serverFd_ = -1;
+  SSL_CTX *clientCTX_ = nullptr;
+  SSL *client_ = nullptr;
+  SSL *server_ = nullptr;
+
+  ~TLSPair() {
+    // an SSL freed without a close_notify makes its session not resumable
+    if (client_ != nullptr) {
+      SSL_shutdown(client_);
+    }
+    SSL_free(client_);
+    SSL_free(server_);
+    SSL_CTX_free(clientCTX_);
+    if (clientFd_ >= 0)
+      close(clientFd_);
+    if (serverFd_ >= 0)
+      close(serverFd_);
+  }
+
+  // The client offers `session` for resumption if it is not null.
+  bool handshake(SSL_CTX *serverCTX, SSL_SESSION *session = nullptr) {
+    if (!tcpPair(clientFd_, serverFd_)) {
+      return false;
+    }
+    clientCTX_ = SSL_CTX_new(TLS_client_method());
+    client_ = SSL_new(clientCTX_);
+    server_ = SSL_new(serverCTX);
+    SSL_set_fd(client_, clientFd_);
+    SSL_set_fd(server_, serverFd_);
+    if (session != nullptr) {
+      SSL_set_session(client_, session);
+    }
+
+    int connected = 0;
+    std::thread t([&]() { connected = SSL_connect(client_); });
+    int accepted = SSL_accept(server_);
+    t.join();
+    return connected == 1 && accepted == 1;
+  }
+
+  // The session of the client, once the server has sent its ticket.
+  // TLS 1.3 sends tickets after the handshake, so a record is exchanged.
+  SSL_SESSION *clientSession() {
+    char buf[1];
+    if (SSL_write(server_, "x", 1) != 1 || SSL_read(client_, buf, 1) != 1) {
+      return nullptr;
+    }
+    return SSL_get1_session(client_);
+  }
+};
+
+// Whether a session of a server with `ticketKeyFile` resumes on another one.
+bool resumesAcross(const std::string &ticketKeyFile) {
+  SSL_CTX *first = newServerCTX();
+  SSL_CTX *second = newServerCTX();
+  bool resumed = false;
+  if (setup_server_SSL_CTX_resumption(first, ticketKeyFile, 300) &&
+      setup_server_SSL_CTX_resumption(second, ticketKeyFile, 300)) {
+    SSL_SESSION *session = nullptr;
+    {
+      TLSPair tls;
+      if (tls.handshake(first)) {
+        session = tls.clientSession();
+      }
+    }
+    if (session != nullptr) {
+      TLSPair tls;
+      resumed = tls.handshake(second, session) &&
+          SSL_session_reused(tls.client_) && SSL_session_reused(tls.server_);
+      SSL_SESSION_free(session);
+    }
+  }
+  SSL_CTX_free(first);
+  SSL_CTX_free(second);
+  return resumed;
+}
+
+} // namespace
+
+TEST(SSLUtils, KernelTLS) {
+  if (!kernelHasTlsUlp()) {
+    LOG(INFO) << "skipped: the kernel has no tls ULP";
+    return;
+  }
+  SSL_CTX *ctx = newServerCTX();
+  ASSERT_TRUE(enable_SSL_CTX_ktls(ctx));
+  {
+    TLSPair tls;
+    ASSERT_TRUE(tls.handshake(ctx));
+    ASSERT_TRUE(is_SSL_ktls_active(tls.server_));
+
+    // OpenSSL attached the ULP and installed both keys on the socket
+    char ulp[16] = {0};
+    socklen_t len = sizeof(ulp);
+    ASSERT_EQ(getsockopt(tls.serverFd_, SOL_TCP, TCP_ULP, ulp, &len), 0);
+    ASSERT_EQ(std::string(ulp), "tls");
+
+    // the kernel decrypts and encrypts the records of the plain socket now
+    ASSERT_EQ(SSL_write(tls.client_, "ping", 4), 4);
+    char buf[16];
+    ASSERT_EQ(recv(tls.serverFd_, buf, sizeof(buf), 0), 4);
+    ASSERT_EQ(std::string(buf, 4), "ping");
+
+    ASSERT_EQ(send(tls.serverFd_, "pong", 4, 0), 4);
+    ASSERT_EQ(SSL_read(tls.client_, buf, sizeof(buf)), 4);
+    ASSERT_EQ(std::string(buf, 4), "pong");
+  }
+  SSL_CTX_free(ctx);
+}
+
+TEST(SSLUtils, KernelTLSFallback) {
+  // no kernel offloads a CBC cipher, the connection has to stay on OpenSSL
+  SSL_CTX *ctx = newServerCTX();
+  enable_SSL_CTX_ktls(ctx);
+  SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+  ASSERT_EQ(SSL_CTX_set_cipher_list(ctx, "ECDHE-ECDSA-AES256-SHA"), 1);
+  {
+    TLSPair tls;
+    ASSERT_TRUE(tls.handshake(ctx));
+    ASSERT_FALSE(is_SSL_ktls_active(tls.server_));
+
+    // and still works in userspace
+    char buf[16];
+    ASSERT_EQ(SSL_write(tls.client_, "ping", 4), 4);
+    ASSERT_EQ(SSL_read(tls.server_, buf, sizeof(buf)), 4);
+    ASSERT_EQ(std::string(buf, 4), "ping");
+
+    ASSERT_EQ(SSL_write(tls.server_, "pong", 4), 4);
+    ASSERT_EQ(SSL_read(tls.client_, buf, sizeof(buf)), 4);
+    ASSERT_EQ(std::string(buf, 4), "pong");
+  }
+  SSL_CTX_free(ctx);
+}
+
+TEST(SSLUtils, Resumption) {
+  SSL_CTX *ctx = newServerCTX();
+  long keyLen = SSL_CTX_get_tlsext_ticket_keys(ctx, nullptr, 0);
+  std::vector<unsigned char> keys(keyLen);
+  ASSERT_EQ(RAND_bytes(keys.data(), keyLen), 1);
+  char path[] = "/tmp/TestSSLUtils.ticket.XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, keys.data(), keyLen), keyLen);
+  close(fd);
+
+  // sservers sharing the key file resume the sessions of each other
+  ASSERT_TRUE(resumesAcross(path));
+  // random keys are per process, here per SSL_CTX
+  ASSERT_FALSE(resumesAcross(""));
+
+  // a key file of the wrong size is refused
+  ASSERT_EQ(truncate(path, 16), 0);
+  ASSERT_FALSE(setup_server_SSL_CTX_resumption(ctx, path, 300));
+  SSL_CTX_free(ctx);
+  unlink(path);
+}
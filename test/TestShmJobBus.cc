@@ -0,0 +1,200 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+#include "Common.h"
+#include "Utils.h"
+#include "ShmJobBus.h"
+
+#include <sys/mman.h>
+
+static string testBusName(const char *tag) {
+  return Strings::Format("/btcpool_unittest_%s_%d", tag, getpid());
+}
+
+TEST(ShmJobBus, ReadWrite) {
+  const string name = testBusName("rw");
+  shm_unlink(name.c_str());
+
+  ShmJobBusWriter writer(name, 4, 1024);
+  ASSERT_TRUE(writer.setup());
+
+  // readers start at the next message
+  ShmJobBusReader reader1(name), reader2(name);
+  string msg;
+  ASSERT_FALSE(reader1.read(msg, 1));
+  ASSERT_FALSE(reader2.read(msg, 1));
+  ASSERT_TRUE(reader1.isAttached());
+
+  ASSERT_TRUE(writer.write("job1", 4));
+  ASSERT_TRUE(writer.write("job2", 4));
+
+  // every reader sees every message
+  for (auto reader : {&reader1, &reader2}) {
+    ASSERT_TRUE(reader->read(msg, 1));
+    ASSERT_EQ(msg, "job1");
+    ASSERT_TRUE(reader->read(msg, 1));
+    ASSERT_EQ(msg, "job2");
+    ASSERT_FALSE(reader->read(msg, 1));
+  }
+
+  // too large
+  string large(writer.maxMessageSize() + 1, 'x');
+  ASSERT_FALSE(writer.write(large.data(), large.size()));
+  large.resize(writer.maxMessageSize());
+  ASSERT_TRUE(writer.write(large.data(), large.size()));
+  ASSERT_TRUE(reader1.read(msg, 1));
+  ASSERT_EQ(msg, large);
+
+  shm_unlink(name.c_str());
+}
+
+TEST(ShmJobBus, LaggedReader) {
+  const string name = testBusName("lag");
+  shm_unlink(name.c_str());
+
+  ShmJobBusWriter writer(name, 4, 1024);
+  ASSERT_TRUE(writer.setup());
+
+  ShmJobBusReader reader(name);
+  string msg;
+  ASSERT_FALSE(reader.read(msg, 1));
+
+  // overrun the ring, the reader skips to the latest message
+  for (int i = 0; i < 10; i++) {
+    string job = Strings::Format("job%d", i);
+    ASSERT_TRUE(writer.write(job.data(), job.size()));
+  }
+  ASSERT_TRUE(reader.read(msg, 1));
+  ASSERT_EQ(msg, "job9");
+  ASSERT_FALSE(reader.read(msg, 1));
+
+  shm_unlink(name.c_str());
+}
+
+TEST(ShmJobBus, WriterRestart) {
+  const string name = testBusName("restart");
+  shm_unlink(name.c_str());
+
+  ShmJobBusReader reader(name);
+  string msg;
+  // not created yet
+  ASSERT_FALSE(reader.read(msg, 1));
+  ASSERT_FALSE(reader.isAttached());
+
+  {
+    ShmJobBusWriter writer(name, 4, 1024);
+    ASSERT_TRUE(writer.setup());
+    ASSERT_FALSE(reader.read(msg, 1));
+    ASSERT_TRUE(writer.write("job1", 4));
+  }
+  {
+    // the same geometry, the ring and its sequence are kept
+    ShmJobBusWriter writer(name, 4, 1024);
+    ASSERT_TRUE(writer.setup());
+    ASSERT_TRUE(writer.write("job2", 4));
+  }
+
+  ASSERT_TRUE(reader.read(msg, 1));
+  ASSERT_EQ(msg, "job1");
+  ASSERT_TRUE(reader.read(msg, 1));
+  ASSERT_EQ(msg, "job2");
+
+  shm_unlink(name.c_str());
+}
+
+TEST(ShmJobBus, WriterChangesGeometry) {
+  const string name = testBusName("geometry");
+  shm_unlink(name.c_str());
+
+  ShmJobBusReader reader(name);
+  string msg;
+  {
+    ShmJobBusWriter writer(name, 4, 1024);
+    ASSERT_TRUE(writer.setup());
+    ASSERT_FALSE(reader.read(msg, 1));
+    ASSERT_TRUE(reader.isAttached());
+    ASSERT_TRUE(writer.write("job1", 4));
+    ASSERT_TRUE(reader.read(msg, 1));
+    ASSERT_EQ(msg, "job1");
+  }
+
+  // a smaller ring replaces the mapped one, the reader must not touch the
+  // pages it mapped before
+  ShmJobBusWriter writer(name, 2, 512);
+  ASSERT_TRUE(writer.setup());
+  ASSERT_FALSE(reader.read(msg, 1));
+  ASSERT_TRUE(reader.isAttached());
+  ASSERT_TRUE(writer.write("job2", 4));
+  ASSERT_TRUE(reader.read(msg, 1));
+  ASSERT_EQ(msg, "job2");
+
+  // and a larger one
+  ShmJobBusWriter writer2(name, 8, 2048);
+  ASSERT_TRUE(writer2.setup());
+  ASSERT_FALSE(reader.read(msg, 1));
+  ASSERT_TRUE(writer2.write("job3", 4));
+  ASSERT_TRUE(reader.read(msg, 1));
+  ASSERT_EQ(msg, "job3");
+
+  shm_unlink(name.c_str());
+}
+
+TEST(ShmJobBus, Wakeup) {
+  const string name = testBusName("wakeup");
+  shm_unlink(name.c_str());
+
+  ShmJobBusWriter writer(name, 16, 1024);
+  ASSERT_TRUE(writer.setup());
+
+  ShmJobBusReader reader(name);
+  string msg;
+  ASSERT_FALSE(reader.read(msg, 1));
+
+  const int kMessages = 1000;
+  std::thread producer([&writer]() {
+    for (int i = 0; i < kMessages; i++) {
+      string job = Strings::Format("job%d", i);
+      writer.write(job.data(), job.size());
+      if (i % 8 == 0) {
+        std::this_thread::sleep_for(1ms);
+      }
+    }
+  });
+
+  // messages may be skipped if the reader lags, but never reordered or torn
+  int last = -1;
+  while (last < kMessages - 1) {
+    if (!reader.read(msg, 1000)) {
+      break;
+    }
+    ASSERT_EQ(msg.substr(0, 3), "job");
+    int i = atoi(msg.c_str() + 3);
+    ASSERT_GT(i, last);
+    last = i;
+  }
+  producer.join();
+  ASSERT_EQ(last, kMessages - 1);
+
+  shm_unlink(name.c_str());
+}
@@ -177,6 +177,30 @@ TEST(Stratum, StratumWorker) {
   ASSERT_EQ(w.fullName_, "abcdefg.__default__");
 }
 
+TEST(Stratum, InternedString) {
+  size_t poolSize = InternedString::poolSize();
+  {
+    InternedString a("cgminer/4.10.0");
+    InternedString b(string("cgminer/4.10.0"));
+    InternedString c = a;
+    ASSERT_EQ(a, b);
+    ASSERT_EQ(a, "cgminer/4.10.0");
+    ASSERT_EQ(&a.str(), &c.str());
+    ASSERT_EQ(InternedString::poolSize(), poolSize + 1);
+
+    b = "bmminer/2.0.0";
+    ASSERT_NE(a, b);
+    ASSERT_EQ(b.str(), "bmminer/2.0.0");
+    ASSERT_EQ(InternedString::poolSize(), poolSize + 2);
+
+    InternedString empty("");
+    ASSERT_TRUE(empty.empty());
+    ASSERT_EQ(empty, InternedString());
+  }
+  // freed with the last one
+  ASSERT_EQ(InternedString::poolSize(), poolSize);
+}
+
 #ifdef CHAIN_TYPE_LTC
 TEST(JobMaker, LitecoinAddress) {
   // main net
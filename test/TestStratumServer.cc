@@ -183,6 +183,51 @@ TEST(StratumServer, SessionIDManager8Bits) {
   ASSERT_EQ(m.ifFull(), true);
 }
 
+TEST(StratumServer, SessionIDManagerThreads) {
+  SessionIDManagerT<16> m(0x99u);
+  std::vector<std::atomic<int>> owners(0x10000);
+  for (auto &owner : owners) {
+    owner = 0;
+  }
+
+  // alloc and free from several threads, an id never has two owners
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&m, &owners, t]() {
+      std::mt19937 rng(t);
+      std::vector<uint32_t> ids;
+      for (int i = 0; i < 100000; i++) {
+        uint32_t sessionID;
+        if (ids.size() < 0x3800 && rng() % 3 != 0) {
+          ASSERT_EQ(m.allocSessionId(&sessionID), true);
+          ASSERT_EQ(owners[sessionID & 0xFFFFu]++, 0);
+          ids.push_back(sessionID);
+        } else if (!ids.empty()) {
+          size_t k = rng() % ids.size();
+          owners[ids[k] & 0xFFFFu]--;
+          m.freeSessionId(ids[k]);
+          ids[k] = ids.back();
+          ids.pop_back();
+        }
+      }
+      for (auto id : ids) {
+        owners[id & 0xFFFFu]--;
+        m.freeSessionId(id);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // all of them are free again
+  uint32_t sessionID;
+  for (uint32_t i = 0; i <= 0x0000FFFFu; i++) {
+    ASSERT_EQ(m.allocSessionId(&sessionID), true);
+  }
+  ASSERT_EQ(m.ifFull(), true);
+}
+
 #endif // #ifndef WORK_WITH_STRATUM_SWITCHER
 
 #ifndef CHAIN_TYPE_ZEC
@@ -367,3 +412,46 @@ TEST(StratumServerEth, EthashCalculator) {
   LOG(INFO) << "ethash_light_new() in debug build was too slow, skip the test.";
 #endif
 }
+
+TEST(StratumServerEth, EthashCalculatorCacheFile) {
+#ifdef NDEBUG
+  const string prefix =
+      Strings::Format("/tmp/btcpool_unittest_dagcache_%d", getpid());
+
+  uint64_t height = 0x6eab2a;
+  uint64_t nonce = 0x41ba179e96428b55;
+  uint256 header = uint256S(
+      "0x729a3740005234239728098a2d75855f5cb0fd7c536ad1337013bbc5159aefce");
+  const string expected =
+      "0000000042901566d9a95493277579e6bca96c8c6bc5998c73f4fd96c8f63627";
+
+  ethash_h256_t etheader;
+  Uint256ToEthash256(header, etheader);
+  ethash_return_value_t r;
+
+  const string file = Strings::Format(
+      "%s-epoch%u.dat", prefix, (uint32_t)(height / ETHASH_EPOCH_LENGTH));
+  unlink(file.c_str());
+
+  // built and saved
+  {
+    EthashCalculator ethashCalc(prefix);
+    ethashCalc.compute(height, etheader, nonce, r);
+    ASSERT_EQ(r.success, true);
+    ASSERT_EQ(Ethash256ToUint256(r.result).ToString(), expected);
+  }
+  ASSERT_TRUE(fileNonEmpty(file.c_str()));
+
+  // mapped from the file
+  {
+    EthashCalculator ethashCalc(prefix);
+    ethashCalc.compute(height, etheader, nonce, r);
+    ASSERT_EQ(r.success, true);
+    ASSERT_EQ(Ethash256ToUint256(r.result).ToString(), expected);
+  }
+
+  unlink(file.c_str());
+#else
+  LOG(INFO) << "ethash_light_new() in debug build was too slow, skip the test.";
+#endif
+}
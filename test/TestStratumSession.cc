@@ -96,6 +96,88 @@ TEST(StratumSession, LocalJob) {
   }
 }
 
+TEST(StratumSession, LocalJobManyShares) {
+  // the shares of the miners behind an agent
+  LocalJob lj(0, 0);
+  const uint32_t n = LocalJob::kMaxFlatShares * 4;
+  for (uint32_t i = 0; i < n; i++) {
+    ASSERT_TRUE(lj.addLocalShare(LocalShare(i % 7, i, 0x5c39a313, i % 3)));
+    ASSERT_EQ(lj.manyShares_ != nullptr, i >= LocalJob::kMaxFlatShares);
+  }
+  ASSERT_TRUE(lj.submitShares_.empty());
+  for (uint32_t i = 0; i < n; i++) {
+    ASSERT_FALSE(lj.addLocalShare(LocalShare(i % 7, i, 0x5c39a313, i % 3)));
+  }
+  ASSERT_TRUE(lj.addLocalShare(LocalShare(0, 0, 0x5c39a314, 0)));
+  ASSERT_EQ(lj.manyShares_->size(), n + 1);
+}
+
+TEST(StratumSession, LocalJobRing) {
+  LocalJobRing<LocalJob, 32, 8> jobs;
+  ASSERT_TRUE(jobs.empty());
+  ASSERT_EQ(jobs.allocatedBytes(), 0u);
+
+  std::vector<LocalJob *> addrs;
+  for (uint64_t i = 0; i < 32; i++) {
+    addrs.push_back(&jobs.emplace_back(0, i));
+  }
+  ASSERT_EQ(jobs.size(), 32u);
+  ASSERT_EQ(jobs.front().jobId_, 0u);
+  ASSERT_EQ(jobs.back().jobId_, 31u);
+  // 4 chunks of 8 jobs and their table
+  ASSERT_EQ(jobs.allocatedBytes(), 4 * sizeof(void *) + 32 * sizeof(LocalJob));
+
+  // the slots of the evicted jobs are reused, other jobs never move
+  for (uint64_t i = 32; i < 40; i++) {
+    jobs.pop_front();
+    ASSERT_EQ(&jobs.emplace_back(0, i), addrs[i % 32]);
+  }
+  ASSERT_EQ(jobs.size(), 32u);
+  ASSERT_EQ(&jobs[0], addrs[8]);
+
+  uint64_t jobId = 8;
+  for (auto &job : jobs) {
+    ASSERT_EQ(job.jobId_, jobId++);
+  }
+  ASSERT_EQ(jobId, 40u);
+}
+
+TEST(StratumSession, LocalJobDiffs) {
+  std::vector<LocalJob> jobs;
+  for (uint64_t i = 0; i < 10; i++) {
+    jobs.emplace_back(0, i);
+  }
+
+  LocalJobDiffs<uint64_t> diffs;
+  for (size_t i = 0; i < 4; i++) {
+    diffs[&jobs[i]] = i * 100;
+  }
+  ASSERT_EQ(diffs.size(), 4u);
+  ASSERT_EQ(diffs.find(&jobs[4]), diffs.end());
+  ASSERT_EQ(diffs.find(&jobs[2])->second, 200u);
+
+  // oldest first, as the session does
+  diffs.erase(&jobs[0]);
+  ASSERT_EQ(diffs.find(&jobs[0]), diffs.end());
+  // and from the middle
+  diffs.erase(&jobs[2]);
+  ASSERT_EQ(diffs.find(&jobs[2]), diffs.end());
+  ASSERT_EQ(diffs.size(), 2u);
+
+  for (size_t i = 4; i < 10; i++) {
+    diffs[&jobs[i]] = i * 100;
+  }
+  ASSERT_EQ(diffs.size(), 8u);
+  ASSERT_EQ(diffs.find(&jobs[1])->second, 100u);
+  ASSERT_EQ(diffs.find(&jobs[3])->second, 300u);
+  ASSERT_EQ(diffs.find(&jobs[9])->second, 900u);
+
+  for (size_t i = 0; i < 10; i++) {
+    diffs.erase(&jobs[i]);
+  }
+  ASSERT_EQ(diffs.size(), 0u);
+}
+
 class StratumSessionMock : public IStratumSession {
 public:
   MOCK_METHOD3(addWorker, void(const string &, const string &, int64_t));
@@ -597,6 +679,61 @@ TEST(StratumSession, StratumClientAgentHandler) {
   }
 }
 
+TEST(StratumSession, StratumClientAgentHandler_AddLocalJob) {
+  StratumSessionMock connection;
+  StratumMessageAgentDispatcher agent(connection, diffController);
+  LocalJob localJob(0, 1);
+
+  vector<StratumMinerMock *> miners;
+  for (uint16_t i = 0; i < 3; i++) {
+    auto workerName = "w" + std::to_string(i);
+    auto miner =
+        new StratumMinerMock(connection, diffController, "", workerName, i);
+    EXPECT_CALL(connection, createMiner("", workerName, i))
+        .WillOnce(Return(ByMove(unique_ptr<StratumMiner>(miner))));
+    EXPECT_CALL(connection, addWorker("", workerName, i)).Times(1);
+    agent.registerWorker(i, "", workerName, i);
+    miners.push_back(miner);
+  }
+  ASSERT_EQ(agent.getNumMiners(), 3u);
+  EXPECT_CALL(connection, sendSetDifficulty(_, _)).Times(1);
+
+  // only the moved miners are in the message
+  map<uint8_t, vector<uint16_t>> diffSessionIds;
+  string expected;
+  diffSessionIds[20] = {1, 2};
+  agent.getSetDiffCommand(diffSessionIds, expected);
+  EXPECT_CALL(*miners[0], addLocalJob(_)).WillOnce(Return(1));
+  EXPECT_CALL(*miners[1], addLocalJob(_)).WillOnce(Return(1 << 20));
+  EXPECT_CALL(*miners[2], addLocalJob(_)).WillOnce(Return(1 << 20));
+  EXPECT_CALL(connection, sendData(expected)).Times(1);
+  agent.addLocalJob(localJob);
+  Mock::VerifyAndClearExpectations(&connection);
+
+  // the last miner takes the place of the removed one
+  EXPECT_CALL(connection, removeWorker("", "w1", 1)).Times(1);
+  agent.unregisterWorker(1);
+  ASSERT_EQ(agent.getNumMiners(), 2u);
+
+  diffSessionIds.clear();
+  diffSessionIds[20] = {0};
+  agent.getSetDiffCommand(diffSessionIds, expected);
+  EXPECT_CALL(*miners[0], addLocalJob(_)).WillOnce(Return(1 << 20));
+  EXPECT_CALL(*miners[2], addLocalJob(_)).WillOnce(Return(1 << 20));
+  EXPECT_CALL(connection, sendData(expected)).Times(1);
+  agent.addLocalJob(localJob);
+  Mock::VerifyAndClearExpectations(&connection);
+
+  // nothing moved, nothing sent
+  EXPECT_CALL(*miners[0], addLocalJob(_)).WillOnce(Return(1 << 20));
+  EXPECT_CALL(*miners[2], addLocalJob(_)).WillOnce(Return(1 << 20));
+  EXPECT_CALL(connection, sendData(An<const string &>())).Times(0);
+  agent.addLocalJob(localJob);
+  Mock::VerifyAndClearExpectations(&connection);
+
+  EXPECT_CALL(connection, removeWorker(_, _, _)).Times(2);
+}
+
 TEST(StratumSession, SetDiff) {
   using namespace boost::algorithm;
 
@@ -0,0 +1,81 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+#include "Common.h"
+#include "Utils.h"
+#include "bytom/TensorityBytom.h"
+
+// Test vectors of the Go implementation (tensority.AIHash),
+// from 3rdparty/bytom/cutil/test/nonceutil_test.go.
+static const char *kTensorityVectors[][3] = {
+    // header hash, seed, result
+    {"d0dad73fb2dabf3353fda15571b4e5f6ac62ff187b354fadd4840d9ff2f1afdf",
+     "0737520781345b11b7bd0f843c1bdd9aea81b6da94fd141cc9f2df53ac6744d2",
+     "e35da54795d82f8549c0e580cbf2e3757ab5ef8fed1bdbe439416c7e6f8df227"},
+    {"0000000000000000000000000000000000000000000000000000000000000000",
+     "48dda5bbe9171a6656206ec56c595c5834b6cf38c5fe71bcb44fe43833aee9df",
+     "26db94efa422d76c402a54eeb61dd5f53282cd3ce1a0ac677e177051edaa98c1"},
+    {"8d969eef6ecad3c29a3a629280e686cf0c3f5d5a86aff3ca12020c923adc6c92",
+     "0e3b78d8380844b0f697bb912da7f4d210382c6714194fd16039ef2acd924dcf",
+     "fecec33669737592f7754b215b20bacefba64d2e4ca1656f85ea1d3dbe162839"},
+    {"2f014311e0926fa8b3d6e6de2051bf69332123baadfe522b62f4645655859e7a",
+     "0000000000000000000000000000000000000000000000000000000000000000",
+     "c1c3cf4c76968e2967f0053c76f2084cc01ed0fe9766428db99c45bedf0cdbe2"},
+    {"e0e3c43178a126d04871b9c5d0c642e5e08b9679a5f66b821bd9a030eff02ce7",
+     "6ab21e1301f5752c2fca1b5598f49d3769482e073c1f26e3b8365f405553ea31",
+     "abbc2cb39638f684235fbc1b3ff107945948c581b6929bae2cd681889ff2d824"},
+};
+
+TEST(TensorityBytom, Hash) {
+  TensorityCalculator calc;
+  for (auto &vec : kTensorityVectors) {
+    vector<char> header;
+    ASSERT_TRUE(Hex2Bin(vec[0], header));
+    ASSERT_EQ(header.size(), 32u);
+
+    uint8_t result[32];
+    ASSERT_TRUE(calc.compute((const uint8_t *)header.data(), vec[1], result));
+    string resultHex;
+    Bin2Hex(result, 32, resultHex);
+    ASSERT_EQ(resultHex, vec[2]);
+  }
+
+  uint8_t result[32];
+  ASSERT_FALSE(calc.compute(result, "not a seed", result));
+}
+
+TEST(TensorityBytom, MatListCache) {
+  TensorityCalculator calc;
+  auto matList0 = calc.getMatList(kTensorityVectors[0][1]);
+  auto matList1 = calc.getMatList(kTensorityVectors[1][1]);
+  ASSERT_NE(matList0, nullptr);
+  ASSERT_NE(matList1, nullptr);
+  ASSERT_EQ(calc.getMatList(kTensorityVectors[0][1]), matList0);
+  ASSERT_EQ(calc.getMatList(kTensorityVectors[1][1]), matList1);
+
+  // the least recently used seed is evicted
+  calc.getMatList(kTensorityVectors[2][1]);
+  ASSERT_EQ(calc.getMatList(kTensorityVectors[1][1]), matList1);
+  ASSERT_NE(calc.getMatList(kTensorityVectors[0][1]), matList0);
+}
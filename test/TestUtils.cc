@@ -273,6 +273,20 @@ TEST(Utils, Bin2Hex) {
   EXPECT_NE(result2, rightHex);
 }
 
+TEST(Utils, Hex2BinFixed) {
+  uint8_t bin[4] = {0};
+  EXPECT_TRUE(Hex2BinFixed("f0FA6e01", bin, sizeof(bin)));
+  EXPECT_EQ(bin[0], 0xF0);
+  EXPECT_EQ(bin[1], 0xFA);
+  EXPECT_EQ(bin[2], 0x6E);
+  EXPECT_EQ(bin[3], 0x01);
+
+  EXPECT_FALSE(Hex2BinFixed("f0fa6x01", bin, sizeof(bin)));
+  // too short
+  EXPECT_FALSE(Hex2BinFixed("f0fa6", bin, sizeof(bin)));
+  EXPECT_FALSE(Hex2BinFixed("f0fa", bin, sizeof(bin)));
+}
+
 /*
 * Logs from beam-node
 I 2019-01-03.11:52:01.533 GenerateNewBlock: size of block = 295; amount of tx =
@@ -0,0 +1,132 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include "Common.h"
+
+#include "DiffController.h"
+#include "VardiffEngine.h"
+
+// Miners of very different hashrates against their own DiffController and
+// a slot of the engine, with the same shares at the same times. The clock
+// sometimes stops, jumps ahead or goes back.
+TEST(VardiffEngine, SameAsDiffController) {
+  DiffController prototype(0x4000, 0x4000000000000000, 0x40, 10, 900);
+  auto engine = prototype.getVardiffEngine();
+  ASSERT_EQ(engine, prototype.getVardiffEngine());
+
+  const size_t kMiners = 64;
+  std::mt19937_64 rng(1);
+  vector<unique_ptr<DiffController>> controllers;
+  vector<uint32_t> slots;
+  vector<double> hashrates; // diff 1 shares per second
+  for (size_t i = 0; i < kMiners; i++) {
+    controllers.emplace_back(new DiffController(prototype));
+    slots.push_back(engine->add());
+    hashrates.push_back(std::pow(2.0, (double)(rng() % 48)));
+  }
+  ASSERT_EQ(engine->size(), kMiners);
+
+  time_t now = 1500000000;
+  size_t calcs = 0;
+  for (int round = 0; round < 2000; round++) {
+    switch (rng() % 40) {
+    case 0:
+      now += 600 + rng() % 1200; // gone for a while
+      break;
+    case 1:
+      now -= rng() % 30; // the clock goes back
+      break;
+    default:
+      now += rng() % 15;
+    }
+
+    for (size_t i = 0; i < kMiners; i++) {
+      auto &dc = *controllers[i];
+      auto slot = slots[i];
+
+      // shares since the last job
+      double expected = hashrates[i] * 10 / dc.curDiff_;
+      size_t shares = std::poisson_distribution<size_t>(
+          std::min(expected, 50.0))(rng);
+      for (size_t j = 0; j < shares; j++) {
+        time_t t = now - rng() % 10;
+        dc.addAcceptedShare(dc.curDiff_, t);
+        engine->addAcceptedShare(slot, dc.curDiff_, t);
+      }
+
+      if (rng() % 500 == 0) {
+        uint64_t diff = 1ull << (rng() % 40);
+        dc.resetCurDiff(diff);
+        engine->resetCurDiff(slot, diff);
+      }
+      if (rng() % 500 == 0) {
+        uint64_t diff = 1ull << (rng() % 20);
+        dc.setMinDiff(diff);
+        engine->setMinDiff(slot, diff);
+      }
+
+      ASSERT_EQ(engine->calcCurDiff(slot, now), dc.calcCurDiff(now))
+          << "miner " << i << ", round " << round;
+      calcs++;
+    }
+  }
+  ASSERT_EQ(calcs, kMiners * 2000);
+
+  for (auto slot : slots) {
+    engine->remove(slot);
+  }
+  ASSERT_EQ(engine->size(), 0u);
+}
+
+TEST(VardiffEngine, CalcCurDiffs) {
+  DiffController prototype(0x4000, 0x4000000000000000, 0x40, 10, 900);
+  VardiffEngine engine(prototype);
+  DiffController dc(prototype);
+
+  time_t now = 1500000000;
+  vector<uint32_t> slots;
+  for (size_t i = 0; i < 4; i++) {
+    slots.push_back(engine.add());
+  }
+
+  // a fast miner: the difficulty goes up with every job
+  for (int job = 0; job < 10; job++) {
+    for (int i = 0; i < 100; i++) {
+      dc.addAcceptedShare(dc.curDiff_, now);
+      for (auto slot : slots) {
+        engine.addAcceptedShare(slot, dc.curDiff_, now);
+      }
+    }
+    now += 30;
+
+    engine.calcCurDiffs(slots.data(), slots.size(), now);
+    uint64_t diff = dc.calcCurDiff(now);
+    for (auto slot : slots) {
+      // the result of the pass, not calculated again
+      ASSERT_EQ(engine.calcCurDiff(slot, now), diff);
+    }
+  }
+  ASSERT_GT(dc.curDiff_, 0x4000u);
+}
@@ -0,0 +1,76 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include "decred/CommonDecred.h"
+
+#include "gtest/gtest.h"
+
+#include <random>
+
+// the genesis block of the mainnet
+static BlockHeaderDecred MakeGenesisHeader() {
+  BlockHeaderDecred header;
+  memset(&header, 0, sizeof(header));
+  header.version = 1;
+  header.merkelRoot = uint256S(
+      "66aa7491b9adce110585ccab7e3fb5fe280de174530cca10eba2c6c3df01c10d");
+  header.nBits = 0x1b01ffff;
+  header.sBits = 200000000;
+  header.timestamp = 1454954400;
+  return header;
+}
+
+TEST(CommonDecred, BlockHeaderGetHash) {
+  auto header = MakeGenesisHeader();
+  ASSERT_EQ(
+      header.getHash().ToString(),
+      "298e5cc3d985bfe7f81dc135f360abe089edd4396b86d2de66b0cef42b21d980");
+
+  BlockHeaderHasherDecred hasher(header);
+  ASSERT_EQ(hasher.getHash(header), header.getHash());
+}
+
+TEST(CommonDecred, BlockHeaderHasher) {
+  std::mt19937 gen(1);
+  for (int i = 0; i < 100; i++) {
+    BlockHeaderDecred header;
+    auto bytes = reinterpret_cast<uint8_t *>(&header);
+    for (size_t j = 0; j < sizeof(header); j++) {
+      bytes[j] = gen();
+    }
+
+    // the fields of shares
+    BlockHeaderHasherDecred hasher(header);
+    for (int j = 0; j < 10; j++) {
+      header.timestamp = gen();
+      header.nonce = gen();
+      header.extraData.begin()[j] = gen();
+      ASSERT_EQ(hasher.getHash(header), header.getHash());
+      ASSERT_EQ(hasher.getHashScalar(header), header.getHash());
+      if (__builtin_cpu_supports("sse4.1")) {
+        ASSERT_EQ(hasher.getHashSse41(header), header.getHash());
+      }
+    }
+  }
+}
@@ -63,3 +63,64 @@ TEST(CommonGrin, VerifyPowGrinSecondary_V2_19) {
   };
   ASSERT_TRUE(VerifyPowGrinSecondary(solution, hash, 19));
 }
+
+TEST(CommonGrin, SiphashBatch) {
+  siphash_keys keys{
+      0x6a54f2a35ab7e976,
+      0x68818717ff5cd30e,
+      0x9c14260c1bdbaf7,
+      0xea5b4cd5d0de3cf0,
+  };
+
+  // odd sizes to cover the scalar tails
+  std::vector<uint64_t> nonces;
+  for (uint64_t i = 0; i < 87; i++) {
+    nonces.push_back(i * 0x9e3779b97f4a7c15ULL);
+  }
+  std::vector<uint64_t> out(nonces.size());
+  siphash24_batch(keys, nonces.data(), out.data(), nonces.size());
+  for (size_t i = 0; i < nonces.size(); i++) {
+    ASSERT_EQ(out[i], keys.siphash24(nonces[i])) << i;
+  }
+
+  const size_t kBlockSize = 64;
+  std::vector<uint64_t> starts;
+  for (uint64_t i = 0; i < 43; i++) {
+    starts.push_back((i * 0x1f3d5b79ULL) & ~(kBlockSize - 1));
+  }
+  std::vector<uint64_t> blocks(starts.size() * kBlockSize);
+  siphash24_blocks(
+      keys, starts.data(), starts.size(), kBlockSize, blocks.data());
+  for (size_t i = 0; i < starts.size(); i++) {
+    siphash_state shs(keys);
+    for (size_t j = 0; j < kBlockSize; j++) {
+      shs.hash24(starts[i] + j);
+      ASSERT_EQ(blocks[i * kBlockSize + j], shs.xor_lanes()) << i << "," << j;
+    }
+  }
+}
+
+TEST(CommonGrin, VerifyPowGrinSecondary_Invalid) {
+  siphash_keys hash{
+      0x6a54f2a35ab7e976,
+      0x68818717ff5cd30e,
+      0x9c14260c1bdbaf7,
+      0xea5b4cd5d0de3cf0,
+  };
+  std::vector<uint64_t> solution{
+      0x2b1e,  0x67d3,  0xb041,  0xb289,  0xc6c3,  0xd31e,  0xd75c,
+      0x111d7, 0x145aa, 0x1712e, 0x1a3af, 0x1ecc5, 0x206b1, 0x2a55c,
+      0x2a9cd, 0x2b67e, 0x321d8, 0x35dde, 0x3721e, 0x37ac0, 0x39edb,
+      0x3b80b, 0x3fc79, 0x4148b, 0x42a48, 0x44395, 0x4bbc9, 0x4f775,
+      0x515c5, 0x56f97, 0x5aa10, 0x5bc1b, 0x5c56d, 0x5d552, 0x60a2e,
+      0x66646, 0x6c3aa, 0x70709, 0x71d13, 0x762a3, 0x79d88, 0x7e3ae,
+  };
+  solution[20]++;
+  ASSERT_FALSE(VerifyPowGrinSecondary(solution, hash, 19));
+  // descending
+  solution[20] = 0x3721e;
+  ASSERT_FALSE(VerifyPowGrinSecondary(solution, hash, 19));
+  // beyond the edge mask
+  solution.back() = 0x80000;
+  ASSERT_FALSE(VerifyPowGrinSecondary(solution, hash, 19));
+}
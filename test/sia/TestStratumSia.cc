@@ -0,0 +1,79 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include "sia/StratumSia.h"
+#include "Utils.h"
+
+#include "gtest/gtest.h"
+
+// a share of the header in the comments of StratumMinerSia
+static const char kHeader[] =
+    "00000000000000021f3e8ede65495c4311ef59e5b7a4338542e573819f5979e9"
+    "82719d0366014155e935aa5a00000000201929782a8fe3209b152520c51d2a82"
+    "dc364e4a3eb6fb8131439835e278ff8b";
+
+TEST(StratumSia, JobHashShare) {
+  // the job has another nonce
+  string headerOfJob = kHeader;
+  headerOfJob.replace(64, 16, "0000000000000000");
+  const string json = Strings::Format(
+      "{\"created_at_ts\":1521169869"
+      ",\"jobId\":6534559187219136513"
+      ",\"target\":\"%064x\""
+      ",\"hHash\":\"%s\"}",
+      1,
+      headerOfJob);
+
+  StratumJobSia sjob;
+  ASSERT_TRUE(sjob.unserializeFromJson(json.c_str(), json.size()));
+  ASSERT_EQ(sjob.jobId_, 6534559187219136513ull);
+  ASSERT_EQ(sjob.blockHashForMergedMining_, headerOfJob);
+
+  uint8_t nonce[StratumJobSia::kNonceSize];
+  ASSERT_TRUE(Hex2BinFixed(kHeader + 64, nonce, sizeof(nonce)));
+  uint8_t header[StratumJobSia::kHeaderSize];
+  uint256 hash;
+  sjob.hashShare(nonce, header, hash);
+
+  string hex;
+  Bin2Hex(header, sizeof(header), hex);
+  ASSERT_EQ(hex, kHeader);
+  Bin2Hex(hash.begin(), sizeof(hash), hex);
+  ASSERT_EQ(
+      hex, "0000000004dc841c49e7de9713483d265675f66568fde260f24745565d0c0651");
+
+  // the hash does not depend on the previous shares
+  sjob.hashShare(nonce, header, hash);
+  Bin2Hex(hash.begin(), sizeof(hash), hex);
+  ASSERT_EQ(
+      hex, "0000000004dc841c49e7de9713483d265675f66568fde260f24745565d0c0651");
+}
+
+TEST(StratumSia, JobInvalidHeader) {
+  const string json =
+      "{\"created_at_ts\":1521169869,\"jobId\":1,\"target\":\"00ff\","
+      "\"hHash\":\"0000\"}";
+  StratumJobSia sjob;
+  ASSERT_FALSE(sjob.unserializeFromJson(json.c_str(), json.size()));
+}